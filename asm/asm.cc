@@ -1,27 +1,225 @@
 #include <asm/source_line.h>
 #include <asm/program.h>
+#include <asm/incremental_program.h>
+#include <asm/optimizer.h>
+#include <asm/listing.h>
+#include <asm/timing_analyzer.h>
+#include <server/asm_server.h>
 
+#include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+std::vector<std::string> ReadLines(const std::string& path)
+{
+	std::ifstream in(path);
+	std::vector<std::string> lines;
+	std::string s;
+	while (std::getline(in, s))
+		lines.push_back(s);
+	return lines;
+}
+
+void WriteImage(const std::string& path, const std::vector<uint8_t>& image, const std::vector<Cpu::ImagePatch>& patches)
+{
+	std::fstream out(path, std::ios::in | std::ios::out | std::ios::binary);
+	if (!out)
+	{
+		std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(image.data()), image.size());
+		return;
+	}
+	for (const auto& patch : patches)
+	{
+		out.seekp(patch.address);
+		out.write(reinterpret_cast<const char*>(patch.bytes.data()), patch.bytes.size());
+	}
+	//the program may have shrunk
+	out.close();
+	std::filesystem::resize_file(path, image.size());
+}
+
+//asm --watch source [image]
+//Reassembles source each time it changes, writing only the changed bytes to image
+//and printing them to stdout as 'address : value' for the loader
+int Watch(const std::string& source, const std::string& image)
+{
+	Cpu::IncrementalProgram program;
+	std::filesystem::file_time_type lastWrite;
+
+	while (true)
+	{
+		std::error_code ec;
+		const auto writeTime = std::filesystem::last_write_time(source, ec);
+		if (ec || writeTime == lastWrite)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			continue;
+		}
+		lastWrite = writeTime;
+
+		const auto start = std::chrono::steady_clock::now();
+		try
+		{
+			const auto patches = program.Update(ReadLines(source));
+			if (!image.empty())
+				WriteImage(image, program.Image(), patches);
+
+			std::string out;
+			for (const auto& patch : patches)
+			{
+				for (size_t i = 0; i < patch.bytes.size(); i++)
+					out += std::to_string(patch.address + i) + " : " + std::to_string(patch.bytes[i]) + "\n";
+			}
+			std::cout << out << std::flush;
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << source << ": " << e.what() << std::endl;
+			continue;
+		}
+		const auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		std::cerr << "; " << program.EncodedLines() << " lines encoded, " << program.Image().size() << " bytes, " << us << "us" << std::endl;
+	}
+	return 0;
+}
+
+//asm --serve socket [--threads n]
+//Serves assemble, simulate and cost requests on a Unix domain socket, see AsmServer
+int Serve(const std::string& path, unsigned threads)
+{
+	try
+	{
+		Cpu::AsmServer server(threads);
+		server.Listen(path);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+//asm --connect socket [--optimize] [--timing] [--listing] [--simulate | --cost] < source
+//Sends the source to asm --serve, printing what asm, sim or asm --timing would have
+int Connect(const std::string& path, int argc, char** args)
+{
+	Cpu::ServerRequest request;
+	for (int i = 3; i < argc; i++)
+	{
+		const std::string arg = args[i];
+		if (arg == "--optimize")
+			request.flags |= Cpu::ServerRequest::OPTIMIZE;
+		else if (arg == "--timing")
+			request.flags |= Cpu::ServerRequest::TIMING;
+		else if (arg == "--listing")
+			request.flags |= Cpu::ServerRequest::LISTING;
+		else if (arg == "--simulate")
+			request.kind = Cpu::ServerRequest::SIMULATE;
+		else if (arg == "--cost")
+			request.kind = Cpu::ServerRequest::COST;
+	}
+	std::ostringstream source;
+	source << std::cin.rdbuf();
+	request.source = source.str();
+
+	try
+	{
+		const auto response = Cpu::AsmClient(path).Send(request);
+		std::cout << response.out << std::flush;
+		std::cerr << response.err << std::flush;
+		return response.status;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
+
+}
 
 int main(int argc, char** args)
 {
-	Cpu::Program p;
+	if (argc >= 3 && std::string(args[1]) == "--watch")
+		return Watch(args[2], argc >= 4 ? args[3] : "");
+	if (argc >= 3 && std::string(args[1]) == "--serve")
+		return Serve(args[2], argc >= 5 && std::string(args[3]) == "--threads" ? std::stoi(args[4]) : std::thread::hardware_concurrency());
+	if (argc >= 3 && std::string(args[1]) == "--connect")
+		return Connect(args[2], argc, args);
+
+	//asm [--optimize] [--timing] [--listing] < source
+	//--timing prints best and worst case cycles for each function to stderr
+	//--listing prints an annotated listing instead of the machine code
+	bool optimize = false;
+	bool timing = false;
+	bool listing = false;
+	for (int i = 1; i < argc; i++)
+	{
+		optimize = optimize || std::string(args[i]) == "--optimize";
+		timing = timing || std::string(args[i]) == "--timing";
+		listing = listing || std::string(args[i]) == "--listing";
+	}
+
+	std::vector<Cpu::SourceLine> lines;
 	while (!std::cin.eof())
 	{
 		std::string s;
 		std::getline(std::cin, s);
 
-		p.AddLine(Cpu::SourceLine::Parse(s));
+		lines.push_back(Cpu::SourceLine::Parse(s));
 	}
 
-	const auto& mc = p.MachineCode();
+	if (optimize)
+	{
+		Cpu::Optimizer optimizer;
+		lines = optimizer.Optimize(lines);
+		optimizer.Report().Print(std::cerr);
+	}
+
+	Cpu::Program p;
+	for (const auto& line : lines)
+		p.AddLine(line);
 
-	for (const auto b : mc)
+	if (timing)
 	{
-		std::cout << (uint32_t)b << std::endl;
+		try
+		{
+			Cpu::TimingAnalyzer(p).Analyze().Print(std::cerr);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "timing: " << e.what() << std::endl;
+		}
 	}
 
+	std::string out;
+	try
+	{
+		if (listing)
+		{
+			out = Cpu::program_listing(p);
+		}
+		else
+		{
+			for (const auto b : p.MachineCode())
+				out += std::to_string(b) + "\n";
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	std::cout << out << std::flush;
+
     return 0;
 }
-
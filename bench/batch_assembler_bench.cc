@@ -0,0 +1,66 @@
+#include <benchmark/benchmark.h>
+#include <asm/batch_assembler.h>
+#include <asm/program.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+//Tiny generated programs, the kind produced by the superoptimizer and fuzzer
+std::vector<std::string> MakePrograms(size_t count)
+{
+	const char* ops[] = {"ADD A", "SUB [A]", "MOV A, ALO", "MOV B, 12", "AND 7", "MOV [40], A", "XOR B", "MOV OUT, A"};
+	std::vector<std::string> programs;
+	for (size_t i = 0; i < count; i++)
+	{
+		std::string p = "start: MOV A, " + std::to_string(i % 256) + "\n";
+		for (size_t j = 0; j < 6; j++)
+			p += std::string(ops[(i * 7 + j * 3) % 8]) + "\n";
+		p += "JZ #start\nHLT";
+		programs.push_back(p);
+	}
+	return programs;
+}
+
+void BM_Program(benchmark::State& state)
+{
+	const auto programs = MakePrograms(1024);
+	for (auto _ : state)
+	{
+		for (const auto& source : programs)
+		{
+			Cpu::Program p;
+			std::istringstream in(source);
+			std::string s;
+			while (std::getline(in, s))
+				p.AddLine(Cpu::SourceLine::Parse(s));
+			benchmark::DoNotOptimize(p.MachineCode());
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * programs.size());
+}
+BENCHMARK(BM_Program);
+
+void BM_BatchAssembler(benchmark::State& state)
+{
+	const auto programs = MakePrograms(1024);
+	const std::vector<std::string_view> views(programs.begin(), programs.end());
+
+	std::byte buffer[4096];
+	std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer));
+	Cpu::BatchAssembler assembler(arena);
+	std::vector<uint8_t> output;
+	std::vector<uint32_t> offsets;
+	for (auto _ : state)
+	{
+		output.clear();
+		assembler.Assemble(views.data(), views.size(), output, offsets);
+		benchmark::DoNotOptimize(output.data());
+	}
+	state.SetItemsProcessed(state.iterations() * programs.size());
+}
+BENCHMARK(BM_BatchAssembler);
+
+}
@@ -0,0 +1,15 @@
+;Counts from 0 to 255 writing the BCD digits of each to OUT, the hundreds then the tens and ones.
+;Linked with routines/bcd.asm.
+loop:	MOV A, [#count]
+		CALL #bcd8
+		MOV A, [#bcd8_hi]
+		MOV OUT, A
+		MOV A, [#bcd8_lo]
+		MOV OUT, A
+		INC [#count]
+		MOV [#count], ALO
+		JZ #done
+		JMP #loop
+done:	HLT
+
+count:	DB 0
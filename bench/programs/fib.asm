@@ -0,0 +1,29 @@
+;Writes the 16 bit Fibonacci numbers to OUT low byte first, stopping at the first that doesn't fit
+loop:	MOV A, [#y_lo]
+		MOV OUT, A
+		MOV A, [#y_hi]
+		MOV OUT, A
+		MOV B, [#x_lo]
+		ADD [#y_lo]
+		MOV [#t_lo], ALO
+		MOV B, [#x_hi]
+		ADC [#y_hi]
+		MOV [#t_hi], ALO
+		JC #done
+		MOV A, [#y_lo]
+		MOV [#x_lo], A
+		MOV A, [#y_hi]
+		MOV [#x_hi], A
+		MOV A, [#t_lo]
+		MOV [#y_lo], A
+		MOV A, [#t_hi]
+		MOV [#y_hi], A
+		JMP #loop
+done:	HLT
+
+x_lo:	DB 0
+x_hi:	DB 0
+y_lo:	DB 1
+y_hi:	DB 0
+t_lo:	DB 0
+t_hi:	DB 0
@@ -0,0 +1,46 @@
+;Writes the primes below 64 to OUT, sieving with a byte per number from address 128
+		MOV A, 128
+		MOV B, 0
+		ADD A
+		MOV B, 192
+		MOV A, 0
+		FILL
+		MOV A, 2
+		MOV [#n], A
+next:	MOV A, [#n]
+		MOV B, 128
+		ADD A
+		MOV A, [ALO]
+		MOV B, 0
+		CMP A
+		JE #prime
+step:	MOV A, [#n]
+		INC A
+		MOV [#n], ALO
+		MOV A, ALO
+		MOV B, 64
+		CMP A
+		JE #done
+		JMP #next
+prime:	MOV A, [#n]
+		MOV OUT, A
+		MOV B, A
+		ADD A
+mark:	MOV A, ALO
+		MOV [#m], A
+		MOV B, 64
+		SUB A
+		JC #step
+		MOV A, [#m]
+		MOV B, 128
+		ADD A
+		MOV A, 1
+		MOV [ALO], A
+		MOV B, [#n]
+		MOV A, [#m]
+		ADD A
+		JMP #mark
+done:	HLT
+
+n:		DB 0
+m:		DB 0
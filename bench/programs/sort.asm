@@ -0,0 +1,62 @@
+;Bubble sorts the 16 bytes at data into ascending order then writes them to OUT
+sort:	MOV A, 0
+		MOV [#swapped], A
+		MOV A, #data
+		MOV [#p], A
+next:	MOV A, [#p]
+		MOV B, [A]
+		INC A
+		MOV A, [ALO]
+		CMP A
+		JC #ordered
+		JE #ordered
+		MOV [#t], A
+		MOV A, [#p]
+		INC A
+		MOV [ALO], B
+		MOV B, [#t]
+		MOV [A], B
+		MOV A, 1
+		MOV [#swapped], A
+ordered:	MOV A, [#p]
+		INC A
+		MOV [#p], ALO
+		MOV A, ALO
+		MOV B, #last
+		CMP A
+		JE #pass
+		JMP #next
+pass:	MOV A, [#swapped]
+		MOV B, 0
+		CMP A
+		JE #print
+		JMP #sort
+print:	MOV A, #data
+show:	MOV OUT, [A]
+		MOV B, #last
+		CMP A
+		JE #done
+		INC A
+		MOV A, ALO
+		JMP #show
+done:	HLT
+
+p:		DB 0
+t:		DB 0
+swapped:	DB 0
+data:	DB 200
+		DB 13
+		DB 77
+		DB 5
+		DB 250
+		DB 99
+		DB 1
+		DB 42
+		DB 180
+		DB 66
+		DB 33
+		DB 120
+		DB 7
+		DB 255
+		DB 90
+last:	DB 150
@@ -0,0 +1,308 @@
+#include <benchmark/benchmark.h>
+#include <asm/program.h>
+#include <sim/microcode_simulator.h>
+#include <sim/profiler.h>
+#include <sim/time_travel.h>
+#include <sim/trace.h>
+
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace {
+
+//Nested loops with a call in the inner one, about 100k cycles
+const char* source = R"(start: MOV A, 40
+outer: MOV [200], A
+MOV A, 40
+inner: CALL #dec
+MOV B, 0
+ADD A
+JZ #next
+JMP #inner
+next: MOV A, [200]
+CALL #dec
+MOV B, 0
+ADD A
+JZ #done
+JMP #outer
+done: HLT
+dec: MOV B, 1
+SUB A
+MOV A, ALO
+RET)";
+
+Cpu::Program Assemble()
+{
+	Cpu::Program p;
+	std::istringstream in(source);
+	std::string s;
+	while (std::getline(in, s))
+		p.AddLine(Cpu::SourceLine::Parse(s));
+	return p;
+}
+
+void BM_FastSimulator(benchmark::State& state)
+{
+	const auto p = Assemble();
+	const auto image = p.MachineCode();
+	Cpu::FastSimulator sim;
+	uint64_t cycles = 0;
+	for (auto _ : state)
+	{
+		sim.Reset();
+		sim.Load(image);
+		cycles += sim.Run(10000000);
+	}
+	state.SetItemsProcessed(cycles);
+}
+BENCHMARK(BM_FastSimulator);
+
+//A breakpoint and a watchpoint that are never hit, 1 should stay close to 0
+void BM_Debugging(benchmark::State& state)
+{
+	const auto image = Assemble().MachineCode();
+	Cpu::FastSimulator sim;
+	if (state.range(0))
+	{
+		sim.SetBreakpoint(250);
+		sim.SetWatchpoint(250);
+	}
+	uint64_t cycles = 0;
+	for (auto _ : state)
+	{
+		sim.Reset();
+		sim.Load(image);
+		cycles += sim.Run(10000000);
+	}
+	state.SetItemsProcessed(cycles);
+}
+BENCHMARK(BM_Debugging)->Arg(0)->Arg(1);
+
+//Should stay within 10% of BM_FastSimulator
+void BM_Profiler(benchmark::State& state)
+{
+	const auto p = Assemble();
+	const auto image = p.MachineCode();
+	Cpu::FastSimulator sim;
+	uint64_t cycles = 0;
+	for (auto _ : state)
+	{
+		sim.Reset();
+		sim.Load(image);
+		Cpu::Profiler profiler(sim, p.Labels());
+		cycles += profiler.Run(10000000);
+		benchmark::DoNotOptimize(profiler.TotalCycles());
+	}
+	state.SetItemsProcessed(cycles);
+}
+BENCHMARK(BM_Profiler);
+
+//Trace on should stay within 2x of trace off, the ring wraps as a streamer would drain it
+template <typename Sim>
+void BM_Trace(benchmark::State& state)
+{
+	const auto p = Assemble();
+	const auto image = p.MachineCode();
+	Sim sim;
+	Cpu::TraceBuffer buffer(1 << 16);
+	if (state.range(0))
+		sim.Trace(&buffer);
+	uint64_t cycles = 0;
+	for (auto _ : state)
+	{
+		sim.Reset();
+		sim.Load(image);
+		cycles += sim.Run(10000000);
+	}
+	state.SetItemsProcessed(cycles);
+}
+BENCHMARK_TEMPLATE(BM_Trace, Cpu::FastSimulator)->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_Trace, Cpu::MicrocodeSimulator)->Arg(0)->Arg(1);
+
+//Runs the program to part way then explores 16 values of a RAM byte from there, either
+//re-running the shared prefix each time or forking the state reached
+void BM_Explore(benchmark::State& state)
+{
+	const auto p = Assemble();
+	const auto image = p.MachineCode();
+	Cpu::FastSimulator sim;
+	const uint64_t prefix = 80000;
+	for (auto _ : state)
+	{
+		sim.Reset();
+		sim.Load(image);
+		sim.Run(prefix);
+		const Cpu::Snapshot start = sim.Save();
+		for (uint8_t value = 0; value < 16; value++)
+		{
+			if (state.range(0))
+			{
+				sim.Restore(start);
+			}
+			else
+			{
+				sim.Reset();
+				sim.Load(image);
+				sim.Run(prefix);
+			}
+			sim.State().ram[200] = value;
+			sim.Run(10000000);
+			benchmark::DoNotOptimize(sim.Hash());
+		}
+	}
+	//branches explored
+	state.SetItemsProcessed(state.iterations() * 16);
+}
+BENCHMARK(BM_Explore)->Arg(0)->Arg(1);
+
+//A reverse step after range(0) cycles, should take about the same time however long the run
+void BM_ReverseStep(benchmark::State& state)
+{
+	Cpu::Program p;
+	for (const char* s : {"loop: MOV B, 1", "ADD A", "MOV A, ALO", "MOV [100], A", "JMP #loop"})
+		p.AddLine(Cpu::SourceLine::Parse(s));
+	Cpu::FastSimulator sim;
+	sim.Load(p.MachineCode());
+	Cpu::TimeTravel tt(sim);
+	tt.Run(state.range(0));
+	for (auto _ : state)
+	{
+		tt.ReverseStep();
+		tt.Run(1);
+	}
+}
+BENCHMARK(BM_ReverseStep)->Arg(1000000)->Arg(100000000)->Unit(benchmark::kMillisecond);
+
+//routines/math16.asm as it had to be written before ADC, SBC and SFC took the carry flag,
+//branching on the low byte's carry
+const char* math16_branchy = R"(add16: MOV B, [#y16_lo]
+ADD [#x16_lo]
+MOV [#x16_lo], ALO
+MOV B, [#y16_hi]
+JC #add16_c
+ADD [#x16_hi]
+MOV [#x16_hi], ALO
+RET
+add16_c: INC [#x16_hi]
+MOV A, ALO
+ADD A
+MOV [#x16_hi], ALO
+RET
+sub16: MOV B, [#y16_lo]
+SUB [#x16_lo]
+MOV [#x16_lo], ALO
+MOV B, [#y16_hi]
+JC #sub16_nb
+DEC [#x16_hi]
+MOV A, ALO
+SUB A
+MOV [#x16_hi], ALO
+RET
+sub16_nb: SUB [#x16_hi]
+MOV [#x16_hi], ALO
+RET
+shl16: SFT [#x16_lo]
+MOV [#x16_lo], ALO
+JC #shl16_c
+SFT [#x16_hi]
+MOV [#x16_hi], ALO
+RET
+shl16_c: SFT [#x16_hi]
+MOV A, ALO
+INC A
+MOV [#x16_hi], ALO
+RET
+cmp16: MOV B, [#y16_lo]
+SUB [#x16_lo]
+MOV B, [#y16_hi]
+JC #cmp16_nb
+CMP [#x16_hi]
+JMP #cmp16_t
+cmp16_nb: SUB [#x16_hi]
+cmp16_t: MOV A, 0
+JC #cmp16_ge
+RET
+cmp16_ge: MOV A, 1
+RET
+x16_lo: DB 0
+x16_hi: DB 0
+y16_lo: DB 0
+y16_hi: DB 0)";
+
+//Average cycles for a call to each routine over random operands, range(0) picks the branchy
+//versions above or the library
+void BM_Math16(benchmark::State& state)
+{
+	std::ostringstream library;
+	if (state.range(0))
+		library << std::ifstream(ROUTINES_DIR "/math16.asm").rdbuf();
+	else
+		library << math16_branchy;
+
+	Cpu::Program p;
+	std::istringstream in("MOV A, [#target]\nCALL A\nHLT\ntarget: DB 0\n" + library.str());
+	std::string line;
+	while (std::getline(in, line))
+		p.AddLine(Cpu::SourceLine::Parse(line));
+	const auto image = p.MachineCode();
+	const auto& labels = p.Labels();
+
+	std::mt19937 rng(42);
+	Cpu::FastSimulator sim;
+	uint64_t calls = 0;
+	std::map<std::string, uint64_t> cycles;
+	for (auto _ : state)
+	{
+		for (const char* routine : {"add16", "sub16", "shl16", "cmp16"})
+		{
+			sim.Reset();
+			sim.Load(image);
+			sim.State().ram[labels.at("target")] = labels.at(routine);
+			for (const char* operand : {"x16_lo", "x16_hi", "y16_lo", "y16_hi"})
+				sim.State().ram[labels.at(operand)] = uint8_t(rng());
+			cycles[routine] += sim.Run(10000);
+		}
+		calls++;
+	}
+	for (const auto& [routine, total] : cycles)
+		state.counters[routine] = double(total) / calls;
+}
+BENCHMARK(BM_Math16)->Arg(0)->Arg(1);
+
+//Average cycles for a call, driver included, to the arithmetic routine range(0) picks over random arguments in A
+//and B, the worst cases are the budgets gated by routines_test
+void BM_Routines(benchmark::State& state)
+{
+	const std::pair<const char*, const char*> routines[] = {{"mul8.asm", "mul8"}, {"div16.asm", "div16"}, {"bcd.asm", "bcd8"}};
+	const auto [file, routine] = routines[state.range(0)];
+	Cpu::Program p;
+	std::istringstream in(std::string("MOV B, [#arg_b]\nMOV A, [#arg_a]\nCALL #") + routine + "\nHLT\narg_a: DB 0\narg_b: DB 0");
+	std::ifstream library(std::string(ROUTINES_DIR "/") + file);
+	std::string line;
+	while (std::getline(in, line))
+		p.AddLine(Cpu::SourceLine::Parse(line));
+	while (std::getline(library, line))
+		p.AddLine(Cpu::SourceLine::Parse(line));
+
+	std::mt19937 rng(47);
+	Cpu::FastSimulator sim;
+	sim.Load(p.MachineCode());
+	const Cpu::Snapshot start = sim.Save();
+	uint64_t cycles = 0;
+	for (auto _ : state)
+	{
+		sim.Restore(start);
+		sim.State().ram[p.Labels().at("arg_a")] = uint8_t(rng());
+		//a divisor of at least 1
+		sim.State().ram[p.Labels().at("arg_b")] = uint8_t(rng() | 1);
+		cycles += sim.Run(100000);
+	}
+	state.SetLabel(routine);
+	state.counters["cycles"] = double(cycles) / state.iterations();
+}
+BENCHMARK(BM_Routines)->DenseRange(0, 2);
+
+}
@@ -0,0 +1,201 @@
+#include <benchmark/benchmark.h>
+#include <asm/disassembler.h>
+#include <asm/program.h>
+#include <ctrl/microcode.h>
+#include <server/asm_server.h>
+#include <sim/fast_simulator.h>
+#include <sim/microcode_simulator.h>
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+//bench/programs, each listed with any routines it is linked with
+const std::vector<std::vector<std::string>> programs = {
+	{PROGRAMS_DIR "/sort.asm"},
+	{PROGRAMS_DIR "/primes.asm"},
+	{PROGRAMS_DIR "/fib.asm"},
+	{PROGRAMS_DIR "/bcd_display.asm", ROUTINES_DIR "/bcd.asm"}};
+
+std::vector<std::string> ReadLines(const std::vector<std::string>& files)
+{
+	std::vector<std::string> lines;
+	for (const auto& file : files)
+	{
+		std::ifstream in(file);
+		std::string s;
+		while (std::getline(in, s))
+			lines.push_back(s);
+	}
+	return lines;
+}
+
+Cpu::Program Assemble(const std::vector<std::string>& lines)
+{
+	Cpu::Program p;
+	for (const auto& s : lines)
+		p.AddLine(Cpu::SourceLine::Parse(s));
+	return p;
+}
+
+//Every line of every program
+std::vector<std::string> AllLines()
+{
+	std::vector<std::string> lines;
+	for (const auto& files : programs)
+		for (auto& s : ReadLines(files))
+			lines.push_back(std::move(s));
+	return lines;
+}
+
+void BM_Parse(benchmark::State& state)
+{
+	const auto lines = AllLines();
+	for (auto _ : state)
+		for (const auto& s : lines)
+			benchmark::DoNotOptimize(Cpu::SourceLine::Parse(s));
+	state.SetItemsProcessed(state.iterations() * lines.size());
+}
+BENCHMARK(BM_Parse);
+
+void BM_Encode(benchmark::State& state)
+{
+	std::vector<Cpu::Instruction> instructions;
+	for (const auto& s : AllLines())
+		instructions.emplace_back(Cpu::SourceLine::Parse(s));
+	const Cpu::LabelResolver<Width8> resolve = [](const std::string&) {return uint8_t(42);};
+	for (auto _ : state)
+		for (const auto& instr : instructions)
+			benchmark::DoNotOptimize(instr.Encode(resolve));
+	state.SetItemsProcessed(state.iterations() * instructions.size());
+}
+BENCHMARK(BM_Encode);
+
+//Label resolution and encoding of whole programs already parsed
+void BM_MachineCode(benchmark::State& state)
+{
+	std::vector<Cpu::Program> assembled;
+	for (const auto& files : programs)
+		assembled.push_back(Assemble(ReadLines(files)));
+	for (auto _ : state)
+		for (const auto& p : assembled)
+			benchmark::DoNotOptimize(p.MachineCode());
+	state.SetItemsProcessed(state.iterations() * assembled.size());
+}
+BENCHMARK(BM_MachineCode);
+
+//Building the table with the instruction builders and flattening it into the ROM image
+void BM_Microcode(benchmark::State& state)
+{
+	const MicrocodeOptions options;
+	for (auto _ : state)
+	{
+		const auto table = make_microcode(options);
+		benchmark::DoNotOptimize(Cpu::make_rom(table).data());
+	}
+}
+BENCHMARK(BM_Microcode)->Unit(benchmark::kMillisecond);
+
+//Decoding 1MB of random bytes, then the source of each 256 byte page of it
+void BM_Disassemble(benchmark::State& state)
+{
+	std::vector<uint8_t> image(1 << 20);
+	std::mt19937 rng(50);
+	for (auto& b : image)
+		b = uint8_t(rng());
+	std::vector<Cpu::DecodedInstruction> decoded;
+	for (auto _ : state)
+	{
+		if (state.range(0) == 0)
+		{
+			Cpu::Disassembler::Decode(image.data(), image.size(), decoded);
+			benchmark::DoNotOptimize(decoded.data());
+		}
+		else
+		{
+			for (size_t page = 0; page < image.size(); page += 256)
+				benchmark::DoNotOptimize(Cpu::Disassembler::Disassemble({image.begin() + page, image.begin() + page + 256}));
+		}
+	}
+	state.SetBytesProcessed(state.iterations() * image.size());
+}
+BENCHMARK(BM_Disassemble)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+//Runs the program range(0) picks to HLT on an engine, reporting instructions and cycles a second
+template <typename Sim>
+void BM_Engine(benchmark::State& state)
+{
+	const auto& files = programs[state.range(0)];
+	const auto image = Assemble(ReadLines(files)).MachineCode();
+
+	//counted once on the fast engine, both run the same instructions
+	uint64_t instructions = 0;
+	{
+		Cpu::FastSimulator counter;
+		counter.Load(image);
+		counter.Run(10000000, [&instructions](uint8_t, uint64_t) {instructions++;});
+	}
+
+	Sim sim;
+	sim.Load(image);
+	const Cpu::Snapshot start = sim.Save();
+	uint64_t cycles = 0;
+	for (auto _ : state)
+	{
+		sim.Restore(start);
+		cycles += sim.Run(10000000);
+	}
+	state.SetLabel(files.front().substr(files.front().rfind('/') + 1));
+	state.counters["instructions/s"] = benchmark::Counter(double(instructions * state.iterations()), benchmark::Counter::kIsRate);
+	state.counters["cycles/s"] = benchmark::Counter(double(cycles), benchmark::Counter::kIsRate);
+}
+BENCHMARK_TEMPLATE(BM_Engine, Cpu::FastSimulator)->DenseRange(0, 3);
+BENCHMARK_TEMPLATE(BM_Engine, Cpu::MicrocodeSimulator)->DenseRange(0, 3);
+
+//Assembling sort.asm on a warm server, in process then round trip over the socket
+void BM_Server(benchmark::State& state)
+{
+	std::string source;
+	for (const auto& s : ReadLines(programs[0]))
+		source += s + "\n";
+	const Cpu::ServerRequest request{Cpu::ServerRequest::ASSEMBLE, 0, source};
+
+	Cpu::AsmServer server(1);
+	if (state.range(0) == 0)
+	{
+		for (auto _ : state)
+			benchmark::DoNotOptimize(server.Handle(request));
+		return;
+	}
+
+	const std::string path = (std::filesystem::temp_directory_path() / ("asm_bench." + std::to_string(getpid()))).string();
+	std::thread listener([&server, &path]() {server.Listen(path);});
+	std::unique_ptr<Cpu::AsmClient> client;
+	while (!client)
+	{
+		try
+		{
+			client = std::make_unique<Cpu::AsmClient>(path);
+		}
+		catch (const std::runtime_error&)
+		{
+			std::this_thread::yield();
+		}
+	}
+	for (auto _ : state)
+		benchmark::DoNotOptimize(client->Send(request));
+	client.reset();
+	server.Stop();
+	listener.join();
+}
+BENCHMARK(BM_Server)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+}
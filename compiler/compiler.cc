@@ -0,0 +1,34 @@
+#include <compiler/compiler.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+//compiler [--naive] < source > program.asm
+//Compiles source to assembly for the asm tool
+int main(int argc, char** args)
+{
+	Cpu::CompilerOptions options;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(args[i]) == "--naive")
+			options.optimize = false;
+	}
+
+	std::stringstream source;
+	source << std::cin.rdbuf();
+	try
+	{
+		for (const auto& line : Cpu::Compiler(options).Compile(source.str()))
+		{
+			line.Print(std::cout);
+			std::cout << "\n";
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
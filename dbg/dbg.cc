@@ -0,0 +1,242 @@
+#include <asm/source_line.h>
+#include <asm/program.h>
+#include <sim/fast_simulator.h>
+#include <sim/time_travel.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+const char* help = R"(break loc       b    stop before the instruction at loc
+delete loc      d    remove a breakpoint or watchpoint
+watch loc       w    stop after loc is written
+continue        c    run to the next breakpoint, watchpoint or HLT
+step [n]        s    run n instructions
+rstep           rs   back one instruction
+rcontinue       rc   back to the last breakpoint
+rwatch loc      rw   back to the last write of loc
+print           p    registers
+x loc [n]            n bytes of RAM from loc
+list            l    the program around PC
+quit            q
+loc is a label, label+n or an address)";
+
+class Debugger
+{
+public:
+	explicit Debugger(const Cpu::Program& program)
+	:	mProgram(program),
+		mTime(mSim)
+	{
+		mSim.Load(program.MachineCode());
+		mTime.Modified();
+		mSim.OnOut([](uint8_t value) {std::cout << "OUT " << unsigned(value) << "\n";});
+	}
+
+	bool Command(const std::string& line);
+
+private:
+	int Location(const std::string& loc) const;
+	std::string Name(uint8_t address) const;
+	void Where(const char* why);
+	void Continue();
+
+	const Cpu::Program& mProgram;
+	Cpu::FastSimulator mSim;
+	Cpu::TimeTravel mTime;
+};
+
+int Debugger::Location(const std::string& loc) const
+{
+	const auto plus = loc.find('+');
+	const std::string name = loc.substr(0, plus);
+	const int offset = plus == std::string::npos ? 0 : std::stoi(loc.substr(plus + 1));
+	auto it = mProgram.Labels().find(name);
+	if (it != mProgram.Labels().end())
+		return (it->second + offset) & 0xFF;
+	if (!name.empty() && std::isdigit(name[0]))
+		return (std::stoi(name, nullptr, 0) + offset) & 0xFF;
+	std::cout << "no label " << name << "\n";
+	return -1;
+}
+
+std::string Debugger::Name(uint8_t address) const
+{
+	//the closest label at or before address
+	std::string best;
+	int bestAddress = -1;
+	for (const auto& [label, labelAddress] : mProgram.Labels())
+	{
+		if (labelAddress <= address && labelAddress > bestAddress)
+		{
+			best = label;
+			bestAddress = labelAddress;
+		}
+	}
+	if (bestAddress < 0)
+		return std::to_string(address);
+	if (bestAddress == address)
+		return best;
+	return best + "+" + std::to_string(address - bestAddress);
+}
+
+void Debugger::Where(const char* why)
+{
+	const auto& m = mSim.State();
+	std::cout << why << " at " << Name(m.pc) << " (" << unsigned(m.pc) << "), cycle " << mSim.Cycles() << "\n";
+	auto it = mProgram.Instructions().find(m.pc);
+	if (it != mProgram.Instructions().end() && !m.halted)
+	{
+		it->second.Line().Print(std::cout);
+		std::cout << "\n";
+	}
+}
+
+void Debugger::Continue()
+{
+	mTime.Run(UINT64_MAX);
+	switch (mSim.Stopped())
+	{
+	case Cpu::Simulator::STOP_BREAKPOINT:
+		Where("breakpoint");
+		break;
+	case Cpu::Simulator::STOP_WATCHPOINT:
+		Where("watchpoint");
+		break;
+	default:
+		Where(mSim.State().halted ? "halted" : "stopped");
+		break;
+	}
+}
+
+bool Debugger::Command(const std::string& line)
+{
+	std::istringstream in(line);
+	std::string cmd, arg;
+	in >> cmd >> arg;
+
+	if (cmd == "q" || cmd == "quit")
+		return false;
+	if (cmd == "b" || cmd == "break" || cmd == "d" || cmd == "delete" || cmd == "w" || cmd == "watch")
+	{
+		const int address = Location(arg);
+		if (address < 0)
+			return true;
+		if (cmd[0] == 'b')
+			mSim.SetBreakpoint(uint8_t(address));
+		else if (cmd[0] == 'w')
+			mSim.SetWatchpoint(uint8_t(address));
+		else
+		{
+			mSim.SetBreakpoint(uint8_t(address), false);
+			mSim.SetWatchpoint(uint8_t(address), false);
+		}
+	}
+	else if (cmd == "c" || cmd == "continue")
+	{
+		Continue();
+	}
+	else if (cmd == "s" || cmd == "step")
+	{
+		const int count = arg.empty() ? 1 : std::stoi(arg);
+		for (int i = 0; i < count && !mSim.State().halted; i++)
+			mTime.Run(1);
+		Where(mSim.State().halted ? "halted" : "stepped");
+	}
+	else if (cmd == "rs" || cmd == "rstep")
+	{
+		if (mTime.ReverseStep())
+			Where("stepped back");
+		else
+			std::cout << "at the start of history\n";
+	}
+	else if (cmd == "rc" || cmd == "rcontinue")
+	{
+		if (mTime.ReverseContinue([this](const Cpu::Machine& m) {return m.mc == 0 && mSim.IsBreakpoint(m.pc);}))
+			Where("breakpoint");
+		else
+			std::cout << "no breakpoint earlier\n";
+	}
+	else if (cmd == "rw" || cmd == "rwatch")
+	{
+		const int address = Location(arg);
+		if (address < 0)
+			return true;
+		if (mTime.ReverseToWrite(uint8_t(address)))
+			Where("before the write");
+		else
+			std::cout << "no earlier write\n";
+	}
+	else if (cmd == "p" || cmd == "print")
+	{
+		const auto& m = mSim.State();
+		std::cout << "A " << unsigned(m.a) << ", B " << unsigned(m.b) << ", ALO " << unsigned(m.alo)
+			<< ", PC " << unsigned(m.pc) << ", SP " << unsigned(m.sp) << ", MAR " << unsigned(m.mar)
+			<< ", OUT " << unsigned(m.out) << ", flags " << unsigned(m.flags) << "\n";
+	}
+	else if (cmd == "x")
+	{
+		const int address = Location(arg);
+		int count = 1;
+		in >> count;
+		if (address < 0)
+			return true;
+		for (int i = 0; i < count; i++)
+		{
+			const uint8_t a = uint8_t(address + i);
+			std::cout << Name(a) << " (" << unsigned(a) << "): " << unsigned(mSim.State().ram[a]) << "\n";
+		}
+	}
+	else if (cmd == "l" || cmd == "list")
+	{
+		const uint8_t pc = mSim.State().pc;
+		for (const auto& [address, instr] : mProgram.Instructions())
+		{
+			if (address + 8 < pc || address > pc + 8)
+				continue;
+			std::cout << (address == pc ? "=>" : "  ") << (mSim.IsBreakpoint(address) ? "*" : " ") << unsigned(address) << "\t";
+			instr.Line().Print(std::cout);
+			std::cout << "\n";
+		}
+	}
+	else if (!cmd.empty())
+	{
+		std::cout << help << "\n";
+	}
+	return true;
+}
+
+}
+
+//dbg source
+//Assembles source and runs it under a debugger reading commands from stdin, help lists them
+int main(int argc, char** args)
+{
+	if (argc < 2)
+	{
+		std::cerr << "dbg source" << std::endl;
+		return 1;
+	}
+
+	Cpu::Program p;
+	std::ifstream source(args[1]);
+	if (!source)
+	{
+		std::cerr << "can't open " << args[1] << std::endl;
+		return 1;
+	}
+	std::string s;
+	while (std::getline(source, s))
+		p.AddLine(Cpu::SourceLine::Parse(s));
+
+	Debugger debugger(p);
+	std::string line;
+	std::cout << "(dbg) " << std::flush;
+	while (std::getline(std::cin, line) && debugger.Command(line))
+		std::cout << "(dbg) " << std::flush;
+	return 0;
+}
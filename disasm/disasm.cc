@@ -0,0 +1,79 @@
+#include <asm/disassembler.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//asm's output, a byte a line
+std::vector<uint8_t> ReadBytes(std::istream& in)
+{
+	std::vector<uint8_t> image;
+	std::string s;
+	while (std::getline(in, s))
+	{
+		if (s.find_first_not_of("\r\t ") != std::string::npos)
+			image.push_back(uint8_t(std::stoul(s)));
+	}
+	return image;
+}
+
+std::vector<uint8_t> ReadBinary(std::istream& in)
+{
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+}
+
+//disasm [--binary] [--origin n] [--no-labels] [--addresses] [file]
+//Prints the source of the machine code in file, or stdin, as asm writes it a byte a line
+//--binary reads raw bytes instead, eg a RAM dump
+//--origin is the address the first byte was loaded at
+//--addresses adds a comment after each instruction with its address and bytes
+int main(int argc, char** args)
+{
+	bool binary = false;
+	Cpu::Disassembler::Options options;
+	std::string path;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = args[i];
+		if (arg == "--binary")
+			binary = true;
+		else if (arg == "--origin" && i + 1 < argc)
+			options.origin = uint8_t(std::stoul(args[++i]));
+		else if (arg == "--no-labels")
+			options.labels = false;
+		else if (arg == "--addresses")
+			options.addresses = true;
+		else
+			path = arg;
+	}
+
+	try
+	{
+		std::ifstream file;
+		if (!path.empty())
+		{
+			file.open(path, binary ? std::ios::binary : std::ios::in);
+			if (!file)
+			{
+				std::cerr << "can't open " << path << std::endl;
+				return 1;
+			}
+		}
+		std::istream& in = path.empty() ? std::cin : file;
+		const auto image = binary ? ReadBinary(in) : ReadBytes(in);
+		std::cout << Cpu::Disassembler::Disassemble(image, options) << std::flush;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,94 @@
+#include <dse/design_space.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+std::string ReadFile(const std::string& path)
+{
+	std::ifstream in(path);
+	if (!in)
+		throw std::runtime_error("can't read " + path);
+	std::ostringstream s;
+	s << in.rdbuf();
+	return s.str();
+}
+
+//source[,fallback...], named after the first file
+Cpu::Workload ReadWorkload(const std::string& arg)
+{
+	Cpu::Workload w;
+	std::stringstream ss(arg);
+	std::string path;
+	while (std::getline(ss, path, ','))
+	{
+		if (w.name.empty())
+			w.name = std::filesystem::path(path).stem().string();
+		w.sources.push_back(ReadFile(path));
+	}
+	return w;
+}
+
+}
+
+//dse [--threads n] [--cycles n] [--variant name]... workload[,fallback...]...
+//Builds every combination of the microcode options, runs each workload on each and prints them
+//ranked by total cycles then ROM entries. A workload is an assembly file ending in HLT, with
+//versions for smaller instruction sets after it, eg dse/workloads/sum.asm,dse/workloads/sum.plain.asm.
+//--variant limits the run to the named variants, as the report names them.
+int main(int argc, char** args)
+{
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	uint64_t maxCycles = 1000000;
+	std::vector<std::string> names;
+	std::vector<std::string> workloadArgs;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = args[i];
+		if (arg == "--threads" && i + 1 < argc)
+			threads = std::max(1, std::stoi(args[++i]));
+		else if (arg == "--cycles" && i + 1 < argc)
+			maxCycles = std::stoull(args[++i]);
+		else if (arg == "--variant" && i + 1 < argc)
+			names.push_back(args[++i]);
+		else
+			workloadArgs.push_back(arg);
+	}
+	if (workloadArgs.empty())
+	{
+		std::cerr << "dse [--threads n] [--cycles n] [--variant name]... workload.asm[,fallback.asm...]..." << std::endl;
+		return 1;
+	}
+
+	try
+	{
+		std::vector<Cpu::Workload> workloads;
+		for (const auto& arg : workloadArgs)
+		{
+			workloads.push_back(ReadWorkload(arg));
+			workloads.back().maxCycles = maxCycles;
+		}
+
+		std::vector<Cpu::IsaVariant> variants;
+		for (const auto& v : Cpu::DesignSpaceExplorer::AllVariants())
+			if (names.empty() || std::find(names.begin(), names.end(), v.name) != names.end())
+				variants.push_back(v);
+
+		const Cpu::DesignSpaceExplorer explorer(workloads);
+		Cpu::DesignSpaceExplorer::Report(explorer.Explore(variants, threads), workloads, std::cout);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,17 @@
+;Calls a routine saving and restoring A 40 times, the count to OUT
+loop:	CALL #bump
+		MOV A, [#n]
+		MOV B, 40
+		CMP A
+		JE #done
+		JMP #loop
+done:	MOV A, [#n]
+		MOV OUT, A
+		HLT
+bump:	PUSH A
+		MOV A, [#n]
+		INC A
+		MOV [#n], ALO
+		POP A
+		RET
+n:		DB 0
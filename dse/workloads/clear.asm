@@ -0,0 +1,14 @@
+;Sets [100, 200) to 85 and writes three bytes from around the end to OUT
+		MOV A, 100
+		MOV B, 0
+		ADD A
+		MOV B, 200
+		MOV A, 85
+		FILL
+		MOV A, [150]
+		MOV OUT, A
+		MOV A, [199]
+		MOV OUT, A
+		MOV A, [200]
+		MOV OUT, A
+		HLT
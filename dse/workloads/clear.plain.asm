@@ -0,0 +1,17 @@
+;clear.asm a byte at a time, for instruction sets without FILL
+		MOV A, 100
+loop:	MOV B, 85
+		MOV [A], B
+		INC A
+		MOV A, ALO
+		MOV B, 200
+		CMP A
+		JE #done
+		JMP #loop
+done:	MOV A, [150]
+		MOV OUT, A
+		MOV A, [199]
+		MOV OUT, A
+		MOV A, [200]
+		MOV OUT, A
+		HLT
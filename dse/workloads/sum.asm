@@ -0,0 +1,34 @@
+;Adds up the 16 bytes of table with indexed loads, the total to OUT
+		MOV B, 0
+loop:	MOV A, [#table+B]
+		MOV [#index], B
+		MOV B, A
+		ADD [#total]
+		MOV [#total], ALO
+		MOV A, [#index]
+		INC A
+		MOV B, ALO
+		CMP 16
+		JE #done
+		JMP #loop
+done:	MOV A, [#total]
+		MOV OUT, A
+		HLT
+index:	DB 0
+total:	DB 0
+table:	DB 11
+		DB 48
+		DB 85
+		DB 122
+		DB 159
+		DB 196
+		DB 233
+		DB 14
+		DB 51
+		DB 88
+		DB 125
+		DB 162
+		DB 199
+		DB 236
+		DB 17
+		DB 54
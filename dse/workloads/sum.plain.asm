@@ -0,0 +1,37 @@
+;sum.asm through a pointer, for instruction sets without indexed loads or ALU operations on [imm]
+		MOV A, #table
+		MOV [#ptr], A
+loop:	MOV A, [#ptr]
+		MOV B, [A]
+		MOV A, [#total]
+		ADD A
+		MOV [#total], ALO
+		MOV A, [#ptr]
+		INC A
+		MOV [#ptr], ALO
+		MOV B, ALO
+		CMP #end
+		JE #done
+		JMP #loop
+done:	MOV A, [#total]
+		MOV OUT, A
+		HLT
+ptr:	DB 0
+total:	DB 0
+table:	DB 11
+		DB 48
+		DB 85
+		DB 122
+		DB 159
+		DB 196
+		DB 233
+		DB 14
+		DB 51
+		DB 88
+		DB 125
+		DB 162
+		DB 199
+		DB 236
+		DB 17
+		DB 54
+end:	DB 0
@@ -0,0 +1,82 @@
+#include <sim/fuzzer.h>
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+//fuzz [--runs n] [--threads n] [--seed n] [--no-feedback] [--coverage file] [--report]
+//Runs random programs on both simulator engines and prints any that disagree
+//--coverage merges the microcode ROM coverage into file, kept across runs
+//--report prints the coverage of every opcode, step and condition
+int main(int argc, char** args)
+{
+	uint64_t runs = 100000;
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t seed = 1;
+	bool feedback = true;
+	bool report = false;
+	std::string coveragePath;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = args[i];
+		if (arg == "--runs" && i + 1 < argc)
+			runs = std::stoull(args[++i]);
+		else if (arg == "--threads" && i + 1 < argc)
+			threads = std::max(1, std::stoi(args[++i]));
+		else if (arg == "--seed" && i + 1 < argc)
+			seed = uint32_t(std::stoul(args[++i]));
+		else if (arg == "--no-feedback")
+			feedback = false;
+		else if (arg == "--coverage" && i + 1 < argc)
+			coveragePath = args[++i];
+		else if (arg == "--report")
+			report = true;
+	}
+
+	std::vector<std::unique_ptr<Cpu::DifferentialFuzzer>> fuzzers;
+	std::vector<std::thread> workers;
+	for (unsigned i = 0; i < threads; i++)
+	{
+		fuzzers.push_back(std::make_unique<Cpu::DifferentialFuzzer>(seed + i));
+		fuzzers.back()->SetFeedback(feedback);
+		const uint64_t count = runs / threads + (i < runs % threads);
+		workers.emplace_back([f = fuzzers.back().get(), count]() {f->Run(count);});
+	}
+	for (auto& w : workers)
+		w.join();
+
+	Cpu::MicrocodeCoverage coverage;
+	size_t corpus = 0;
+	size_t mismatches = 0;
+	for (const auto& f : fuzzers)
+	{
+		coverage.Merge(f->Coverage());
+		corpus += f->Corpus().size();
+		for (const auto& m : f->Mismatches())
+		{
+			std::cout << m.difference << ":";
+			for (const auto b : m.image)
+				std::cout << " " << unsigned(b);
+			std::cout << "\n";
+		}
+		mismatches += f->Mismatches().size();
+	}
+	std::cerr << "; " << runs << " runs, " << mismatches << " mismatches, " << corpus << " kept, "
+		<< coverage.Count() << " ROM entries hit" << std::endl;
+
+	if (!coveragePath.empty())
+	{
+		std::ifstream in(coveragePath, std::ios::binary);
+		if (in)
+			coverage.Read(in);
+		in.close();
+		std::ofstream out(coveragePath, std::ios::binary);
+		coverage.Write(out);
+	}
+	if (report)
+		coverage.Report(std::cout);
+	return mismatches ? 1 : 0;
+}
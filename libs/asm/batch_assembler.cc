@@ -0,0 +1,350 @@
+#include "batch_assembler.h"
+#include "instructions.h"
+
+#include <algorithm>
+#include <charconv>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+namespace Cpu
+{
+
+namespace {
+
+const std::string_view white_space = "\r\n\t ";
+
+//The encoders in constants.h assert on operands they can't encode, as in Instruction
+void CheckCond(bool cond, const char* error)
+{
+	if (!cond)
+		throw std::runtime_error(error);
+}
+
+std::string_view Trim(std::string_view s)
+{
+	const auto first = s.find_first_not_of(white_space);
+	if (first == std::string_view::npos)
+		return {};
+	return s.substr(first, s.find_last_not_of(white_space) - first + 1);
+}
+
+//Params: A, [A], 42, [42], #label, [#label], [42+B], [#label+B]
+struct ParamView
+{
+	ParamView(std::string_view p)
+	{
+		CheckCond(!p.empty(), "missing parameter");
+		if (p[0] == '[')
+		{
+			if (p.back() != ']')
+				throw std::runtime_error("where's the ']'?");
+			p = p.substr(1, p.size() - 2);
+			deref = true;
+
+			if (p.size() > 2 && p.substr(p.size() - 2) == "+B")
+			{
+				p = p.substr(0, p.size() - 2);
+				indexed = true;
+			}
+			CheckCond(!p.empty(), "missing parameter");
+		}
+
+		reg = GetRegister(p);
+		if (reg != 0xFF)
+		{
+			if (indexed)
+				throw std::runtime_error("only an immediate address can be indexed");
+			return;
+		}
+		if (p[0] == '#')
+		{
+			label = p.substr(1);
+			return;
+		}
+		//all of it, 42+B isn't 42
+		int value = 0;
+		const auto result = std::from_chars(p.data(), p.data() + p.size(), value);
+		if (result.ec != std::errc() || result.ptr != p.data() + p.size())
+			throw std::runtime_error("bad parameter");
+		literal = static_cast<uint8_t>(value);
+	}
+
+	bool IsRegister() const {return reg != 0xFF;}
+	bool IsLabel() const {return !label.empty();}
+	bool IsImmediate() const {return literal.has_value() || IsLabel();}
+
+	bool deref = false;
+	bool indexed = false;
+	uint8_t reg = 0xFF;
+	std::optional<uint8_t> literal;
+	std::string_view label;
+};
+
+struct LineView
+{
+	std::string_view op;
+	std::optional<ParamView> p1;
+	std::optional<ParamView> p2;
+};
+
+size_t TokenEnd(std::string_view s, size_t pos, std::string_view stop)
+{
+	const auto end = s.find_first_of(stop, pos);
+	return end == std::string_view::npos ? s.size() : end;
+}
+
+//Same grammar as SourceLine::Parse, label: OP p1, p2 ;comment
+LineView ParseLine(std::string_view line, std::string_view& label)
+{
+	line = line.substr(0, TokenEnd(line, 0, ";"));
+	const auto colon = line.find(':');
+	if (colon != std::string_view::npos)
+	{
+		label = Trim(line.substr(0, colon));
+		line = line.substr(colon + 1);
+	}
+
+	LineView result;
+	size_t pos = line.find_first_not_of(white_space);
+	if (pos == std::string_view::npos)
+		return result;
+	size_t end = TokenEnd(line, pos, white_space);
+	result.op = line.substr(pos, end - pos);
+
+	pos = line.find_first_not_of(",\r\n\t ", end);
+	if (pos == std::string_view::npos)
+		return result;
+	end = TokenEnd(line, pos, ",\r\n\t ");
+	result.p1.emplace(line.substr(pos, end - pos));
+
+	pos = line.find_first_not_of(",\r\n\t ", end);
+	if (pos == std::string_view::npos)
+		return result;
+	end = TokenEnd(line, pos, white_space);
+	result.p2.emplace(line.substr(pos, end - pos));
+	return result;
+}
+
+//A, [A], B, [B], ALO or [ALO]
+uint8_t SourceReg(const ParamView& p, bool deref)
+{
+	CheckCond(p.IsRegister() && p.reg != R_OUT, "can't read from that register");
+	return encode_source_reg(p.reg, deref);
+}
+
+//A, [A], B, [B], [ALO] or OUT
+uint8_t DestReg(const ParamView& p)
+{
+	CheckCond(p.IsRegister(), "can't write to that");
+	CheckCond(p.reg == R_ALO ? p.deref : p.reg != R_OUT || !p.deref, "can't write to that register");
+	return encode_dest_reg(p.reg, p.deref);
+}
+
+uint8_t EncodedLength(const LineView& line)
+{
+	if (line.op.empty())
+		return 0;
+	if (line.op == "DB")
+		return 1;
+	//MOV [42], A has the immediate first
+	if ((line.p1 && line.p1->IsImmediate()) || (line.p2 && line.p2->IsImmediate()))
+		return 2;
+	return 1;
+}
+
+template <typename Labels>
+uint8_t ResolveLabel(const Labels& labels, std::string_view label)
+{
+	for (const auto& l : labels)
+	{
+		if (l.first == label)
+			return l.second;
+	}
+	throw std::runtime_error("unknown label " + std::string(label));
+}
+
+//Literal or label address
+template <typename Labels>
+uint8_t Immediate(const ParamView& p, const Labels& labels)
+{
+	return p.literal ? *p.literal : ResolveLabel(labels, p.label);
+}
+
+template <typename Labels>
+void Encode(const LineView& line, const Labels& labels, std::vector<uint8_t>& out)
+{
+	if (line.op == "MOV")
+	{
+		CheckCond(line.p1 && line.p2, "MOV takes two parameters");
+		const auto& source = *line.p2;
+		const auto& dest = *line.p1;
+		if (dest.indexed)
+		{
+			//MOV [imm+B], A
+			if (!source.IsRegister() || source.deref || source.reg != R_A)
+				throw std::runtime_error("only A can be stored to an indexed address");
+			out.push_back(make_indexed_instruction_code(R_A, false));
+			out.push_back(Immediate(dest, labels));
+			return;
+		}
+		if (dest.deref)
+		{
+			CheckCond(source.IsRegister() && !source.deref, "only a register can be stored");
+			if (dest.IsImmediate())
+			{
+				//MOV [imm], reg
+				out.push_back(make_mov_instruction_code(encode_dest_reg(R_PC, true), SourceReg(source, false)));
+				out.push_back(Immediate(dest, labels));
+			}
+			else
+			{
+				//MOV [reg], reg
+				out.push_back(make_mov_instruction_code(DestReg(dest), SourceReg(source, false)));
+			}
+			return;
+		}
+		CheckCond(dest.IsRegister(), "can't load into an immediate");
+		if (source.indexed)
+		{
+			//MOV reg, [imm+B]
+			if (dest.reg != R_A && dest.reg != R_B)
+				throw std::runtime_error("only A and B can be loaded from an indexed address");
+			out.push_back(make_indexed_instruction_code(dest.reg, true));
+			out.push_back(Immediate(source, labels));
+			return;
+		}
+		if (source.IsRegister())
+		{
+			//MOV reg, reg and MOV reg, [reg]
+			out.push_back(make_mov_instruction_code(DestReg(dest), SourceReg(source, source.deref)));
+		}
+		else
+		{
+			//MOV reg, imm and MOV reg, [imm]
+			out.push_back(make_mov_instruction_code(DestReg(dest), encode_source_reg(R_PC, source.deref)));
+			out.push_back(Immediate(source, labels));
+		}
+		return;
+	}
+
+	if (const auto op = GetJumpOpCode(line.op); op != 0xFF)
+	{
+		CheckCond(line.p1 && !line.p2, "jumps take one parameter");
+		const auto& p = *line.p1;
+		if (p.IsRegister())
+		{
+			out.push_back(make_ancillory_instruction_code(op, SourceReg(p, false)));
+			return;
+		}
+		out.push_back(make_ancillory_instruction_code(op, encode_source_reg(R_PC, false)));
+		out.push_back(Immediate(p, labels));
+		return;
+	}
+
+	if (const auto op = GetAluOpCode(line.op); op != 0xFF)
+	{
+		CheckCond(line.p1 && !line.p2, "ALU operations take one parameter");
+		const auto& p = *line.p1;
+		if (p.IsRegister())
+		{
+			out.push_back(make_alu_instruction_code(op, SourceReg(p, p.deref)));
+			return;
+		}
+		//ADD 12 and ADD [12]
+		if (p.indexed)
+			throw std::runtime_error("ALU operations can't be indexed");
+		out.push_back(make_alu_instruction_code(op, encode_source_reg(R_PC, p.deref)));
+		out.push_back(Immediate(p, labels));
+		return;
+	}
+
+	if (line.op == "DB")
+	{
+		CheckCond(line.p1 && !line.p1->IsRegister(), "DB needs a value");
+		out.push_back(Immediate(*line.p1, labels));
+		return;
+	}
+
+	if (const auto op = GetAncillaryOpCode(line.op); op != 0)
+	{
+		if (op == INSTR_PUSH || op == INSTR_POP)
+		{
+			CheckCond(line.p1 && line.p1->IsRegister() && !line.p1->deref, "PUSH and POP need a register");
+			//POP B encodes to RET and POP ALO to FILL
+			CheckCond(op == INSTR_PUSH || line.p1->reg == R_A, "POP needs A");
+			out.push_back(make_ancillory_instruction_code(op, SourceReg(*line.p1, false)));
+		}
+		else if (op == INSTR_CALL)
+		{
+			CheckCond(line.p1.has_value(), "CALL needs a target");
+			if (line.p1->IsRegister())
+			{
+				out.push_back(make_ancillory_instruction_code(op, SourceReg(*line.p1, false)));
+			}
+			else
+			{
+				out.push_back(make_ancillory_instruction_code(op, encode_source_reg(R_PC, false)));
+				out.push_back(Immediate(*line.p1, labels));
+			}
+		}
+		else
+		{
+			out.push_back(op);
+		}
+	}
+}
+
+}
+
+struct BatchAssembler::Line : LineView
+{
+};
+
+BatchAssembler::BatchAssembler(std::pmr::monotonic_buffer_resource& arena)
+:	mLines(&arena),
+	mLabels(&arena)
+{
+}
+
+BatchAssembler::~BatchAssembler() = default;
+
+void BatchAssembler::Assemble(const std::string_view* sources, size_t count,
+	std::vector<uint8_t>& output, std::vector<uint32_t>& offsets)
+{
+	offsets.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		offsets.push_back(static_cast<uint32_t>(output.size()));
+		Assemble(sources[i], output);
+	}
+	offsets.push_back(static_cast<uint32_t>(output.size()));
+}
+
+void BatchAssembler::Assemble(std::string_view source, std::vector<uint8_t>& output)
+{
+	//whatever an earlier program left, thrown out of or not, the capacity is kept
+	mLines.clear();
+	mLabels.clear();
+	mLines.reserve(std::count(source.begin(), source.end(), '\n') + 1);
+
+	//first pass, parse and assign addresses
+	uint8_t address = 0;
+	size_t pos = 0;
+	while (pos < source.size())
+	{
+		const auto end = TokenEnd(source, pos, "\n");
+		std::string_view label;
+		mLines.push_back({ParseLine(source.substr(pos, end - pos), label)});
+		if (!label.empty())
+			mLabels.emplace_back(label, address);
+		address += EncodedLength(mLines.back());
+		pos = end + 1;
+	}
+
+	//second pass, encode
+	for (const auto& line : mLines)
+		Encode(line, mLabels, output);
+}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace Cpu
+{
+
+/*
+Assembles many small programs into one contiguous buffer.
+
+Unlike Program, the source is never copied. Lines, parameters and labels are held
+as views into the source, in scratch vectors which are kept from one program to the
+next and grow from the caller's arena. Once they have grown to fit the largest
+program, and output and offsets to fit the batch, assembling further batches
+allocates nothing, a program which fails to assemble included.
+*/
+class BatchAssembler
+{
+public:
+	explicit BatchAssembler(std::pmr::monotonic_buffer_resource& arena);
+	~BatchAssembler();
+
+	//Appends the machine code for each source to output. offsets receives count + 1 entries,
+	//program i occupies output[offsets[i]] up to output[offsets[i + 1]].
+	void Assemble(const std::string_view* sources, size_t count,
+		std::vector<uint8_t>& output, std::vector<uint32_t>& offsets);
+
+	//Assembles a single program, appending its machine code to output
+	void Assemble(std::string_view source, std::vector<uint8_t>& output);
+
+private:
+	//A parsed line, defined with the parser
+	struct Line;
+
+	std::pmr::vector<Line> mLines;
+	std::pmr::vector<std::pair<std::string_view, uint8_t>> mLabels;
+};
+
+}
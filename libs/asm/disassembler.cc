@@ -0,0 +1,225 @@
+#include "disassembler.h"
+
+#include <ctrl/constants.h>
+
+#include <bitset>
+#include <initializer_list>
+#include <utility>
+
+namespace Cpu
+{
+
+namespace
+{
+
+//As the assembler spells them, alu_op_name() has SHIFT for SFT
+const char* alu_mnemonics[] = {"INC", "DEC", "ADD", "ADC", "SUB", "SBC", "SFT", "CMP", "NOT", "AND", "OR", "XOR", "SFC"};
+
+const std::pair<uint8_t, const char*> jump_mnemonics[] = {
+	{INSTR_JMP, "JMP"}, {INSTR_JZ, "JZ"}, {INSTR_JE, "JE"}, {INSTR_JC, "JC"}, {INSTR_JN, "JN"}, {INSTR_CALL, "CALL"}};
+
+//Registers which can be named as a source, dereferenced or not
+const uint8_t registers[] = {R_A, R_B, R_ALO};
+
+void set(std::array<OpcodeInfo, 256>& table, uint8_t opcode, const char* mnemonic, Operand op1 = {}, Operand op2 = {})
+{
+	auto& info = table[opcode];
+	info.mnemonic = mnemonic;
+	info.operands[0] = op1;
+	info.operands[1] = op2;
+	info.length = op1.kind > Operand::REGISTER || op2.kind > Operand::REGISTER ? 2 : 1;
+}
+
+Operand reg(const char* name)
+{
+	return {Operand::REGISTER, name};
+}
+
+std::array<OpcodeInfo, 256> make_decode_table()
+{
+	std::array<OpcodeInfo, 256> table;
+
+	for (uint8_t op = ALU_INC; op <= ALU_SFC; op++)
+	{
+		for (const auto r : registers)
+		{
+			for (const bool deref : {false, true})
+				set(table, make_alu_instruction_code(op, encode_source_reg(r, deref)), alu_mnemonics[op], reg(source_reg_name(r, deref)));
+		}
+		set(table, make_alu_instruction_code(op, encode_source_reg(R_PC, false)), alu_mnemonics[op], {Operand::IMMEDIATE});
+		set(table, make_alu_instruction_code(op, encode_source_reg(R_PC, true)), alu_mnemonics[op], {Operand::ADDRESS});
+	}
+
+	//loads
+	for (const auto dest : {R_A, R_B, R_OUT})
+	{
+		const uint8_t d = encode_dest_reg(dest, false);
+		const Operand to = reg(dest_reg_name(dest, false));
+		for (const auto r : registers)
+		{
+			for (const bool deref : {false, true})
+				set(table, make_mov_instruction_code(d, encode_source_reg(r, deref)), "MOV", to, reg(source_reg_name(r, deref)));
+		}
+		set(table, make_mov_instruction_code(d, encode_source_reg(R_PC, false)), "MOV", to, {Operand::IMMEDIATE});
+		set(table, make_mov_instruction_code(d, encode_source_reg(R_PC, true)), "MOV", to, {Operand::ADDRESS});
+	}
+
+	//stores
+	for (const auto r : registers)
+	{
+		const uint8_t s = encode_source_reg(r, false);
+		const Operand from = reg(source_reg_name(r, false));
+		for (const auto dest : registers)
+			set(table, make_mov_instruction_code(encode_dest_reg(dest, true), s), "MOV", reg(dest_reg_name(dest, true)), from);
+		set(table, make_mov_instruction_code(encode_dest_reg(R_PC, true), s), "MOV", {Operand::ADDRESS}, from);
+	}
+
+	set(table, make_indexed_instruction_code(R_A, false), "MOV", {Operand::INDEXED}, reg("A"));
+	set(table, make_indexed_instruction_code(R_A, true), "MOV", reg("A"), {Operand::INDEXED});
+	set(table, make_indexed_instruction_code(R_B, true), "MOV", reg("B"), {Operand::INDEXED});
+
+	for (const auto& [op, mnemonic] : jump_mnemonics)
+	{
+		for (const auto r : registers)
+			set(table, make_ancillory_instruction_code(op, encode_source_reg(r, false)), mnemonic, reg(source_reg_name(r, false)));
+		set(table, make_ancillory_instruction_code(op, encode_source_reg(R_PC, false)), mnemonic, {Operand::TARGET});
+	}
+
+	for (const auto r : registers)
+	{
+		set(table, make_ancillory_instruction_code(INSTR_PUSH, encode_source_reg(r, false)), "PUSH", reg(source_reg_name(r, false)));
+		set(table, make_ancillory_instruction_code(INSTR_POP, encode_source_reg(r, false)), "POP", reg(source_reg_name(r, false)));
+	}
+
+	//last, POP B is RET and POP ALO is FILL
+	for (const auto& [op, mnemonic] : {std::make_pair(INSTR_HALT, "HLT"), std::make_pair(INSTR_RET, "RET"),
+		std::make_pair(INSTR_NOOP, "NOOP"), std::make_pair(INSTR_FILL, "FILL"), std::make_pair(INSTR_EI, "EI"),
+		std::make_pair(INSTR_DI, "DI"), std::make_pair(INSTR_RETI, "RETI")})
+		set(table, uint8_t(op), mnemonic);
+
+	return table;
+}
+
+void append_operand(std::string& out, const Operand& op, uint8_t immediate, const std::bitset<256>* labelled)
+{
+	switch (op.kind)
+	{
+	case Operand::REGISTER:
+		out += op.reg;
+		break;
+	case Operand::IMMEDIATE:
+		out += std::to_string(immediate);
+		break;
+	case Operand::ADDRESS:
+		out += "[" + std::to_string(immediate) + "]";
+		break;
+	case Operand::INDEXED:
+		out += "[" + std::to_string(immediate) + "+B]";
+		break;
+	case Operand::TARGET:
+		if (labelled && labelled->test(immediate))
+			out += "#loc_";
+		out += std::to_string(immediate);
+		break;
+	case Operand::NONE:
+		break;
+	}
+}
+
+void append_instruction(std::string& out, const DecodedInstruction& instr, const std::bitset<256>* labelled)
+{
+	const auto& info = decode_table()[instr.opcode];
+	if (!info.mnemonic || instr.length < info.length)
+	{
+		out += "DB " + std::to_string(instr.opcode);
+		return;
+	}
+	out += info.mnemonic;
+	for (unsigned i = 0; i < 2 && info.operands[i].kind != Operand::NONE; i++)
+	{
+		out += i ? ", " : " ";
+		append_operand(out, info.operands[i], instr.immediate, labelled);
+	}
+}
+
+}
+
+const std::array<OpcodeInfo, 256>& decode_table()
+{
+	static const std::array<OpcodeInfo, 256> table = make_decode_table();
+	return table;
+}
+
+void Disassembler::Decode(const uint8_t* image, size_t size, std::vector<DecodedInstruction>& out, uint8_t origin)
+{
+	//the lengths on their own, each instruction's length is needed before the next can be found
+	static const std::array<uint8_t, 256> lengths = []()
+	{
+		std::array<uint8_t, 256> result;
+		for (unsigned i = 0; i < 256; i++)
+			result[i] = decode_table()[i].length;
+		return result;
+	}();
+
+	//at most an instruction a byte, cut down once the count is known
+	out.resize(size);
+	DecodedInstruction* next = out.data();
+	size_t i = 0;
+	//every immediate is in the image up to the last byte
+	for (; i + 1 < size; next++)
+	{
+		const uint8_t opcode = image[i];
+		const uint8_t length = lengths[opcode];
+		*next = {uint8_t(origin + i), opcode, image[i + 1], length};
+		i += length;
+	}
+	if (i < size)
+		*next++ = {uint8_t(origin + i), image[i], 0, 1};
+	out.resize(next - out.data());
+}
+
+std::string Disassembler::Format(const DecodedInstruction& instr)
+{
+	std::string out;
+	append_instruction(out, instr, nullptr);
+	return out;
+}
+
+std::string Disassembler::Disassemble(const std::vector<uint8_t>& image, const Options& options)
+{
+	std::vector<DecodedInstruction> instructions;
+	Decode(image.data(), image.size(), instructions, options.origin);
+
+	std::bitset<256> labelled;
+	if (options.labels)
+	{
+		std::bitset<256> starts;
+		for (const auto& instr : instructions)
+			starts.set(instr.address);
+		for (const auto& instr : instructions)
+		{
+			const auto& info = decode_table()[instr.opcode];
+			if (info.operands[0].kind == Operand::TARGET && instr.length == info.length && starts.test(instr.immediate))
+				labelled.set(instr.immediate);
+		}
+	}
+
+	std::string out;
+	out.reserve(instructions.size() * 16);
+	for (const auto& instr : instructions)
+	{
+		if (labelled.test(instr.address))
+			out += "loc_" + std::to_string(instr.address) + ": ";
+		append_instruction(out, instr, &labelled);
+		if (options.addresses)
+		{
+			out += "\t; " + std::to_string(instr.address) + ": " + std::to_string(instr.opcode);
+			if (instr.length == 2)
+				out += " " + std::to_string(instr.immediate);
+		}
+		out += "\n";
+	}
+	return out;
+}
+
+}
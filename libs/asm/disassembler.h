@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace Cpu
+{
+
+//An operand of an opcode, the byte after the opcode for all but REGISTER
+struct Operand
+{
+	enum Kind : uint8_t
+	{
+		NONE,
+		//A, [A], B, [B], ALO, [ALO] or OUT, given by reg
+		REGISTER,
+		//42
+		IMMEDIATE,
+		//[42]
+		ADDRESS,
+		//[42+B]
+		INDEXED,
+		//the address of a jump or CALL, named by a label when one can be found
+		TARGET
+	};
+
+	Kind kind = NONE;
+	const char* reg = "";
+};
+
+//What the assembler encodes to an opcode
+struct OpcodeInfo
+{
+	//nullptr for bytes no instruction encodes to, they are disassembled as DB
+	const char* mnemonic = nullptr;
+	Operand operands[2];
+	uint8_t length = 1;
+};
+
+//Every opcode, built once from the encodings in constants.h. Where opcodes collide, POP B and
+//RET, the instruction the microcode implements is the one listed.
+const std::array<OpcodeInfo, 256>& decode_table();
+
+//An instruction found in an image, immediate is the byte after the opcode if length is 2
+struct DecodedInstruction
+{
+	uint8_t address;
+	uint8_t opcode;
+	uint8_t immediate;
+	uint8_t length;
+};
+
+/*
+Turns the board's machine code back into source.
+
+Decoding is a walk through the image with a lookup in the decode table for each instruction,
+nothing is allocated once out has grown to fit. An opcode whose immediate would run past the end
+of the image is decoded as DB.
+
+The source assembles back to the same bytes. Jump and CALL targets which are the start of an
+instruction in the image get a label, loc_ and the address, other addresses are left as numbers.
+Data is decoded as whatever instructions its bytes happen to encode.
+*/
+class Disassembler
+{
+public:
+	struct Options
+	{
+		//the address image[0] is loaded at
+		uint8_t origin = 0;
+		bool labels = true;
+		//a comment after each instruction with its address and bytes
+		bool addresses = false;
+	};
+
+	static void Decode(const uint8_t* image, size_t size, std::vector<DecodedInstruction>& out, uint8_t origin = 0);
+
+	//One instruction with its immediate, the operand of a jump or CALL as a number
+	static std::string Format(const DecodedInstruction& instr);
+
+	//The source of the whole image, a line for each instruction
+	static std::string Disassemble(const std::vector<uint8_t>& image, const Options& options);
+	static std::string Disassemble(const std::vector<uint8_t>& image) {return Disassemble(image, Options());}
+};
+
+}
@@ -0,0 +1,110 @@
+#include "incremental_program.h"
+
+namespace Cpu
+{
+
+namespace
+{
+
+//The same instruction, whatever the comments say
+bool same_code(const SourceLine& a, const SourceLine& b)
+{
+	return a.Label() == b.Label() && a.OpCode() == b.OpCode() && a.Param1() == b.Param1() && a.Param2() == b.Param2();
+}
+
+}
+
+std::vector<ImagePatch> IncrementalProgram::Update(const std::vector<std::string>& source)
+{
+	//address to the previous encoding of the lines there
+	std::multimap<uint8_t, const Line*> previous;
+	for (const auto& line : mLines)
+		previous.emplace(line.address, &line);
+
+	//first pass, addresses and labels
+	std::vector<const Instruction*> instructions;
+	std::map<std::string, uint8_t> labels;
+	uint8_t nextAddress = 0;
+	instructions.reserve(source.size());
+	for (const auto& text : source)
+	{
+		auto it = mParsed.find(text);
+		if (it == mParsed.end())
+			it = mParsed.emplace(text, Instruction(SourceLine::Parse(text))).first;
+
+		const auto& label = it->second.Line().Label();
+		if (label)
+			labels[*label] = nextAddress;
+		instructions.push_back(&it->second);
+		nextAddress += it->second.EncodedLength();
+	}
+
+	auto labelLookup = [&labels](const std::string& label)
+	{
+		auto it = labels.find(label);
+		if (it == labels.end())
+			throw std::runtime_error("unknown label " + label);
+		return it->second;
+	};
+
+	//second pass, reuse the bytes of any line which has not moved and whose labels still resolve the same
+	std::vector<Line> lines;
+	std::vector<uint8_t> image;
+	lines.reserve(instructions.size());
+	image.reserve(nextAddress);
+	mEncodedLines = 0;
+	uint8_t address = 0;
+	for (const auto* instr : instructions)
+	{
+		Line line {instr, address, {}, {}};
+
+		auto [it, end] = previous.equal_range(address);
+		while (it != end && !same_code(it->second->instr->Line(), instr->Line()))
+			++it;
+		bool reuse = it != end;
+		if (reuse)
+		{
+			for (const auto& target : it->second->targets)
+				reuse = reuse && labelLookup(target.first) == target.second;
+		}
+
+		if (reuse)
+		{
+			line.bytes = it->second->bytes;
+			line.targets = it->second->targets;
+		}
+		else
+		{
+			line.bytes = instr->Encode([&](const std::string& label)
+			{
+				return line.targets[label] = labelLookup(label);
+			});
+			mEncodedLines++;
+		}
+
+		image.insert(image.end(), line.bytes.begin(), line.bytes.end());
+		address += instr->EncodedLength();
+		lines.push_back(std::move(line));
+	}
+
+	auto patches = Diff(mImage, image);
+	mLines = std::move(lines);
+	mImage = std::move(image);
+	return patches;
+}
+
+std::vector<ImagePatch> IncrementalProgram::Diff(const std::vector<uint8_t>& from, const std::vector<uint8_t>& to)
+{
+	std::vector<ImagePatch> result;
+	for (size_t i = 0; i < to.size(); i++)
+	{
+		if (i < from.size() && from[i] == to[i])
+			continue;
+		if (result.empty() || result.back().address + result.back().bytes.size() != i)
+			result.push_back(ImagePatch{static_cast<uint8_t>(i), {}});
+		result.back().bytes.push_back(to[i]);
+	}
+	return result;
+}
+
+}
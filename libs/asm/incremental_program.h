@@ -0,0 +1,57 @@
+#pragma once
+
+#include "source_line.h"
+#include "instruction.h"
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace Cpu
+{
+
+//A run of bytes in the output image which changed during an update
+struct ImagePatch
+{
+	uint8_t address;
+	std::vector<uint8_t> bytes;
+};
+
+/*
+Keeps an assembled program resident between edits of the same source.
+
+Parsed instructions are cached by the text of the line, only new text is parsed. A line
+is only re-encoded when its code is new, ignoring comments, when its address moved or when
+one of the labels it references now resolves to a different address. Update() returns the
+bytes of the image which changed.
+*/
+class IncrementalProgram
+{
+public:
+	std::vector<ImagePatch> Update(const std::vector<std::string>& source);
+
+	const std::vector<uint8_t>& Image() const {return mImage;}
+	//Number of lines re-encoded by the last Update()
+	size_t EncodedLines() const {return mEncodedLines;}
+
+private:
+	struct Line
+	{
+		//in mParsed, entries are never removed
+		const Instruction* instr;
+		uint8_t address;
+		std::vector<uint8_t> bytes;
+		//labels referenced by the line and the address they resolved to
+		std::map<std::string, uint8_t> targets;
+	};
+
+	static std::vector<ImagePatch> Diff(const std::vector<uint8_t>& from, const std::vector<uint8_t>& to);
+
+	std::unordered_map<std::string, Instruction> mParsed;
+	std::vector<Line> mLines;
+	std::vector<uint8_t> mImage;
+	size_t mEncodedLines = 0;
+};
+
+}
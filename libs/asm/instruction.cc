@@ -1,13 +1,13 @@
 #include "instruction.h"
+#include "instructions.h"
 #include "source_line.h"
 #include <ctrl/constants.h>
+#include <ctrl/microcode.h>
 
 namespace Cpu
 {
 
-namespace {
-
-uint8_t GetAncillaryOpCode(const std::string& op)
+uint8_t GetAncillaryOpCode(std::string_view op)
 {
 	if (op == "PUSH")
 		return INSTR_PUSH;
@@ -21,10 +21,18 @@ uint8_t GetAncillaryOpCode(const std::string& op)
 		return INSTR_HALT;
 	if (op == "NOOP")
 		return INSTR_NOOP;
-	return 0xFF;
+	if (op == "FILL")
+		return INSTR_FILL;
+	if (op == "EI")
+		return INSTR_EI;
+	if (op == "DI")
+		return INSTR_DI;
+	if (op == "RETI")
+		return INSTR_RETI;
+	return 0;
 }
 
-uint8_t GetJumpOpCode(const std::string& op)
+uint8_t GetJumpOpCode(std::string_view op)
 {
 	if (op == "JMP")
 		return INSTR_JMP;
@@ -39,7 +47,7 @@ uint8_t GetJumpOpCode(const std::string& op)
 	return 0xFF;
 }
 
-uint8_t GetAluOpCode(const std::string& op)
+uint8_t GetAluOpCode(std::string_view op)
 {
 	if (op == "INC")
 		return ALU_INC;
@@ -65,8 +73,74 @@ uint8_t GetAluOpCode(const std::string& op)
 		return ALU_OR;
 	if (op == "XOR")
 		return ALU_XOR;
+	if (op == "SFC")
+		return ALU_SFC;
 	return 0xFF;
 }
+
+uint8_t GetRegister(std::string_view name)
+{
+	if (name == "A")
+		return R_A;
+	if (name == "B")
+		return R_B;
+	if (name == "ALO")
+		return R_ALO;
+	if (name == "OUT")
+		return R_OUT;
+	return 0xFF;
+}
+
+namespace
+{
+
+//The encoders in constants.h assert on operands they can't encode, source can reach them
+void CheckCond(bool cond, const char* error)
+{
+	if (!cond)
+		throw std::runtime_error(error);
+}
+
+//A, [A], B, [B], ALO or [ALO]
+uint8_t SourceReg(const Parameter& p, bool deref)
+{
+	CheckCond(p.IsRegister() && p.Register() != R_OUT, "can't read from that register");
+	return encode_source_reg(p.Register(), deref);
+}
+
+//A, [A], B, [B], [ALO] or OUT
+uint8_t DestReg(const Parameter& p)
+{
+	CheckCond(p.IsRegister(), "can't write to that");
+	const auto reg = p.Register();
+	CheckCond(reg == R_ALO ? p.IsDereferenced() : reg != R_OUT || !p.IsDereferenced(), "can't write to that register");
+	return encode_dest_reg(reg, p.IsDereferenced());
+}
+
+//Literal or label as a data byte
+template <typename W>
+uint8_t Value(const Parameter& p, const LabelResolver<W>& resolveLabel)
+{
+	if (!p.IsLabel())
+		return uint8_t(p.Literal());
+	const auto address = resolveLabel(p.Label());
+	if constexpr (sizeof(address) > 1)
+	{
+		if (address > 0xFF)
+			throw std::runtime_error("#" + p.Label() + " doesn't fit in a byte");
+	}
+	return uint8_t(address);
+}
+
+//Literal or label as an immediate address, low byte first
+template <typename W>
+void AppendAddress(std::vector<uint8_t>& bytes, const Parameter& p, const LabelResolver<W>& resolveLabel)
+{
+	const typename W::Address address = p.IsLabel() ? resolveLabel(p.Label()) : typename W::Address(p.Literal());
+	for (unsigned i = 0; i < W::addressBytes; i++)
+		bytes.push_back(uint8_t(address >> (8 * i)));
+}
+
 }
 
 Parameter::Parameter(const std::string& p)
@@ -79,25 +153,19 @@ Parameter::Parameter(const std::string& p)
 			throw std::runtime_error("where's the ']'?");
 		param = p.substr(1, p.size()-2);
 		mDeref = true;
+
+		if (param.size() > 2 && param.compare(param.size() - 2, 2, "+B") == 0)
+		{
+			param.resize(param.size() - 2);
+			mIndexed = true;
+		}
 	}
 
-	//Params: A, [A], 42, [42], #label, [#label]
+	//Params: A, [A], 42, [42], #label, [#label], [42+B], [#label+B]
 	//Registers: A, B, ALO, OUT
-	if (param == "A")
-	{
-		mReg = R_A;
-	}
-	else if (param == "B")
-	{
-		mReg = R_B;
-	}
-	else if (param == "ALO")
+	if (GetRegister(param) != 0xFF)
 	{
-		mReg = R_ALO;
-	}
-	else if (param == "OUT")
-	{
-		mReg = R_OUT;
+		mReg = GetRegister(param);
 	}
 	else if (param[0] == '#')
 	{
@@ -107,6 +175,9 @@ Parameter::Parameter(const std::string& p)
 	{
 		mLiteral = std::stoi(param);
 	}
+
+	if (mIndexed && mReg)
+		throw std::runtime_error("only an immediate address can be indexed");
 }
 
 Instruction::Instruction(const SourceLine& line)
@@ -135,83 +206,114 @@ bool Instruction::IsJumpOp() const
 
 bool Instruction::IsAncillaryOpCode() const
 {
-	return GetAncillaryOpCode(mLine.OpCode()) != 0xFF;
+	return GetAncillaryOpCode(mLine.OpCode()) != 0;
+}
+
+bool Instruction::IsDataOp() const
+{
+	return mLine.OpCode() == "DB";
 }
 
+template <typename W>
 uint8_t Instruction::EncodedLength() const
 {
-	if(mParam2)
-		return mParam2->IsLiteral() ? 2 : 1;
-	if (mParam1)
-		return mParam1->IsLiteral() ? 2 : 1;
+	//Blank and comment only lines emit nothing
+	if (mLine.OpCode().empty())
+		return 0;
+	//A single data byte
+	if (IsDataOp())
+		return 1;
+	//Labels are encoded as an immediate
+	//MOV [42], A has the immediate first
+	for (const auto& p : {mParam1, mParam2})
+	{
+		if (p && (p->IsLiteral() || p->IsLabel()))
+			return p->IsDereferenced() || IsJumpOp() || mLine.OpCode() == "CALL" ? 1 + W::addressBytes : 2;
+	}
 	return 1;
 }
 
-std::vector<uint8_t> Instruction::Encode(std::function<uint8_t(const std::string&)> resolveLabel) const
+uint8_t Instruction::Cycles(uint16_t cond) const
+{
+	const auto bytes = Encode([](const std::string&) {return 0;});
+	if (bytes.empty())
+		return 0;
+	return instruction_cycles(bytes[0], cond);
+}
+
+template <typename W>
+std::vector<uint8_t> Instruction::Encode(LabelResolver<W> resolveLabel) const
 {
 	if (IsMovOp())
 	{
-		return EncodeMov();
+		return EncodeMov<W>(resolveLabel);
 	}
 	if (IsJumpOp())
 	{
-		return EncodeJump(resolveLabel);
+		return EncodeJump<W>(resolveLabel);
 	}
 	if (IsAluOp())
 	{
-		return EncodeAlu();
+		return EncodeAlu<W>(resolveLabel);
 	}
 	if (IsAncillaryOpCode())
 	{
-		return EncodeAncillary();
+		return EncodeAncillary<W>(resolveLabel);
+	}
+	if (IsDataOp())
+	{
+		CheckCond(mParam1 && !mParam1->IsRegister(), "DB needs a value");
+		return {Value<W>(*mParam1, resolveLabel)};
 	}
 	return std::vector<uint8_t>();
 }
 
 
-std::vector<uint8_t> Instruction::EncodeAncillary() const
+template <typename W>
+std::vector<uint8_t> Instruction::EncodeAncillary(const LabelResolver<W>& resolveLabel) const
 {
 	const auto op = GetAncillaryOpCode(mLine.OpCode());
 
 	if (op == INSTR_PUSH || op == INSTR_POP)
 	{
-		assert(mParam1);
-		assert(mParam1->IsRegister());
+		CheckCond(mParam1 && mParam1->IsRegister() && !mParam1->IsDereferenced(), "PUSH and POP need a register");
+		//POP B encodes to RET and POP ALO to FILL
+		CheckCond(op == INSTR_PUSH || mParam1->Register() == R_A, "POP needs A");
 		return
 		{
 			make_ancillory_instruction_code(op,
-				encode_source_reg(mParam1->Register(), false))
+				SourceReg(*mParam1, false))
 		};
 	}
 
 	if (op == INSTR_CALL)
 	{
-		assert(mParam1);
+		CheckCond(mParam1.has_value(), "CALL needs a target");
 		if (mParam1->IsRegister())
 		{
 			return
 			{
 				make_ancillory_instruction_code(op,
-					encode_source_reg(mParam1->Register(), false))
+					SourceReg(*mParam1, false))
 			};
 		}
-		if (mParam1->IsLiteral())
+		if (mParam1->IsLiteral() || mParam1->IsLabel())
 		{
-			return
-			{
+			std::vector<uint8_t> bytes = {
 				make_ancillory_instruction_code(op,
-					encode_source_reg(R_PC, false)),
-				mParam1->Literal()
-			};
+					encode_source_reg(R_PC, false))};
+			AppendAddress<W>(bytes, *mParam1, resolveLabel);
+			return bytes;
 		}
 	}
 	// Instruction has no params
 	return {op};
 }
 
-std::vector<uint8_t> Instruction::EncodeAlu() const
+template <typename W>
+std::vector<uint8_t> Instruction::EncodeAlu(const LabelResolver<W>& resolveLabel) const
 {
-	assert(mParam1 && !mParam2);
+	CheckCond(mParam1 && !mParam2, "ALU operations take one parameter");
 	const auto op = GetAluOpCode(mLine.OpCode());
 
 	if (mParam1->IsRegister())
@@ -221,53 +323,57 @@ std::vector<uint8_t> Instruction::EncodeAlu() const
 		return {
 			make_alu_instruction_code(
 				GetAluOpCode(mLine.OpCode()),
-				encode_source_reg(mParam1->Register(), mParam1->IsDereferenced())) };
+				SourceReg(*mParam1, mParam1->IsDereferenced())) };
 		
 	}
-	else if (mParam1->IsLiteral())
+	else
 	{
 		//Add 12
-		return {
+		//Add #label
+		//Add [12]
+		//Add [#label]
+		if (mParam1->IsIndexed())
+			throw std::runtime_error("ALU operations can't be indexed");
+		std::vector<uint8_t> bytes = {
 			make_alu_instruction_code(
 				GetAluOpCode(mLine.OpCode()),
-				encode_source_reg(R_PC, false)),
-			mParam1->Literal() };
+				encode_source_reg(R_PC, mParam1->IsDereferenced()))};
+		if (mParam1->IsDereferenced())
+			AppendAddress<W>(bytes, *mParam1, resolveLabel);
+		else
+			bytes.push_back(Value<W>(*mParam1, resolveLabel));
+		return bytes;
 	}
 }
 
-std::vector<uint8_t> Instruction::EncodeJump(std::function<uint8_t(const std::string&)> resolveLabel) const
+template <typename W>
+std::vector<uint8_t> Instruction::EncodeJump(const LabelResolver<W>& resolveLabel) const
 {
-	assert(mParam1 && !mParam2);
+	CheckCond(mParam1 && !mParam2, "jumps take one parameter");
 
 	if (mParam1->IsRegister())
 	{
 		return {
 			make_ancillory_instruction_code(
 				GetJumpOpCode(mLine.OpCode()),
-				encode_source_reg(mParam1->Register(), false))};
-	}
-	else if (mParam1->IsLiteral())
-	{
-		return {
-			make_ancillory_instruction_code(
-				GetJumpOpCode(mLine.OpCode()),
-				encode_source_reg(R_PC, false)),
-			mParam1->Literal()};
+				SourceReg(*mParam1, false))};
 	}
-	else if (mParam1->IsLabel())
+	else if (mParam1->IsLiteral() || mParam1->IsLabel())
 	{
-		return {
+		std::vector<uint8_t> bytes = {
 			make_ancillory_instruction_code(
 				GetJumpOpCode(mLine.OpCode()),
-				encode_source_reg(R_PC, false)),
-			resolveLabel(mParam1->Label())};
+				encode_source_reg(R_PC, false))};
+		AppendAddress<W>(bytes, *mParam1, resolveLabel);
+		return bytes;
 	}
-	assert(false);
-	return std::vector<uint8_t>();
+	throw std::runtime_error("bad jump target");
 }
 
-std::vector<uint8_t> Instruction::EncodeMov() const
+template <typename W>
+std::vector<uint8_t> Instruction::EncodeMov(const LabelResolver<W>& resolveLabel) const
 {
+	CheckCond(mParam1 && mParam2, "MOV takes two parameters");
 	const auto& source = *mParam2;
 	const auto& dest = *mParam1;
 
@@ -276,25 +382,36 @@ std::vector<uint8_t> Instruction::EncodeMov() const
 		//storing
 		//MOV [imm], reg
 		//MOV [reg], reg
-		if (dest.IsLiteral())
+		if (dest.IsIndexed())
+		{
+			//MOV [imm+B], A
+			//MOV [#label+B], A
+			if (!source.IsRegister() || source.IsDereferenced() || source.Register() != R_A)
+				throw std::runtime_error("only A can be stored to an indexed address");
+			std::vector<uint8_t> bytes = {make_indexed_instruction_code(R_A, false)};
+			AppendAddress<W>(bytes, dest, resolveLabel);
+			return bytes;
+		}
+		if (!dest.IsRegister())
 		{
 			//MOV [imm], reg
-			assert(source.IsRegister());
-			return {
+			//MOV [#label], reg
+			CheckCond(source.IsRegister() && !source.IsDereferenced(), "only a register can be stored");
+			std::vector<uint8_t> bytes = {
 				make_mov_instruction_code(
 					encode_dest_reg(R_PC, true),
-					encode_source_reg(source.Register(), false)),
-				dest.Literal()};
+					SourceReg(source, false))};
+			AppendAddress<W>(bytes, dest, resolveLabel);
+			return bytes;
 		}
 		else
 		{
 			//MOV [reg], reg
-			assert(source.IsRegister());
-			assert(!source.IsDereferenced());
+			CheckCond(source.IsRegister() && !source.IsDereferenced(), "only a register can be stored");
 			return {
 				make_mov_instruction_code(
-					encode_dest_reg(dest.Register(), true),
-					encode_source_reg(source.Register(), false))};
+					DestReg(dest),
+					SourceReg(source, false))};
 		}
 	}
 	else
@@ -304,25 +421,44 @@ std::vector<uint8_t> Instruction::EncodeMov() const
 		//MOV reg, [reg]
 		//MOV reg, imm
 		//MOV reg, [imm]
+		//MOV reg, #label
+		//MOV reg, [#label]
+		//MOV reg, [imm+B]
+		//MOV reg, [#label+B]
+		CheckCond(dest.IsRegister(), "can't load into an immediate");
+		if (source.IsIndexed())
+		{
+			if (dest.Register() != R_A && dest.Register() != R_B)
+				throw std::runtime_error("only A and B can be loaded from an indexed address");
+			std::vector<uint8_t> bytes = {make_indexed_instruction_code(dest.Register(), true)};
+			AppendAddress<W>(bytes, source, resolveLabel);
+			return bytes;
+		}
 		if (source.IsRegister())
 		{
 			return {
 				make_mov_instruction_code(
-					encode_dest_reg(dest.Register(), false),
-					encode_source_reg(source.Register(), source.IsDereferenced()))};
+					DestReg(dest),
+					SourceReg(source, source.IsDereferenced()))};
 		}
 		else
 		{
-			assert(source.IsLiteral());
-			return {
+			std::vector<uint8_t> bytes = {
 				make_mov_instruction_code(
-					encode_dest_reg(dest.Register(), false),
-					encode_source_reg(R_PC, source.IsDereferenced())),
-				source.Literal()};
+					DestReg(dest),
+					encode_source_reg(R_PC, source.IsDereferenced()))};
+			if (source.IsDereferenced())
+				AppendAddress<W>(bytes, source, resolveLabel);
+			else
+				bytes.push_back(Value<W>(source, resolveLabel));
+			return bytes;
 		}
 	}
-	assert(false);
-	return std::vector<uint8_t>();
 }
 
+template uint8_t Instruction::EncodedLength<Width8>() const;
+template uint8_t Instruction::EncodedLength<Width16>() const;
+template std::vector<uint8_t> Instruction::Encode<Width8>(LabelResolver<Width8>) const;
+template std::vector<uint8_t> Instruction::Encode<Width16>(LabelResolver<Width16>) const;
+
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "source_line.h"
 
+#include <ctrl/width.h>
+
 #include <string>
 #include <optional>
 #include <functional>
@@ -16,7 +18,8 @@ public:
 	Parameter(const std::string& param);
 
 	bool IsLiteral() const {return mLiteral.has_value();}
-	uint8_t Literal() const {return *mLiteral;}
+	//Up to 16 bits, cut down to the width it is encoded at
+	uint16_t Literal() const {return *mLiteral;}
 
 	bool IsRegister() const {return mReg.has_value();}
 	uint8_t Register() const {return *mReg;}
@@ -24,33 +27,55 @@ public:
 	bool IsDereferenced() const {return mDeref;}
 	bool IsLabel() const {return mLabel.has_value();}
 	const std::string& Label() const {return *mLabel;}
+	//[42+B] or [#label+B], an immediate address plus B
+	bool IsIndexed() const {return mIndexed;}
 
 private:
-	std::optional<uint8_t> mLiteral;
+	std::optional<uint16_t> mLiteral;
 	std::optional<uint8_t> mReg;
 	std::optional<std::string> mLabel;
 	bool mDeref = false;
+	bool mIndexed = false;
 };
 
+//Resolves a label to its address for W
+template <typename W>
+using LabelResolver = std::function<typename W::Address (const std::string&)>;
+
+/*
+A line of source and its encoding. Immediate addresses, dereferenced immediates and jump or
+call targets, take W::addressBytes, immediate values a byte. Built for Width8 and Width16.
+*/
 class Instruction
 {
 public:
 	Instruction(const SourceLine& line);
+	template <typename W = Width8>
 	uint8_t EncodedLength() const;
-	std::vector<uint8_t> Encode(std::function<uint8_t (const std::string&)> resolveLabel) const;
+	template <typename W = Width8>
+	std::vector<uint8_t> Encode(LabelResolver<W> resolveLabel) const;
+	//Clock cycles from the microcode table for the given CND_ inputs, 0 if nothing is emitted
+	uint8_t Cycles(uint16_t cond = 0) const;
+
+	const SourceLine& Line() const {return mLine;}
 
 private:
 	//static void CheckCond(bool cond, const char* error);
 
-	std::vector<uint8_t> EncodeMov() const;
-	std::vector<uint8_t> EncodeJump(std::function<uint8_t(const std::string&)> resolveLabel) const;
-	std::vector<uint8_t> EncodeAlu() const;
-	std::vector<uint8_t> EncodeAncillary() const;
+	template <typename W>
+	std::vector<uint8_t> EncodeMov(const LabelResolver<W>& resolveLabel) const;
+	template <typename W>
+	std::vector<uint8_t> EncodeJump(const LabelResolver<W>& resolveLabel) const;
+	template <typename W>
+	std::vector<uint8_t> EncodeAlu(const LabelResolver<W>& resolveLabel) const;
+	template <typename W>
+	std::vector<uint8_t> EncodeAncillary(const LabelResolver<W>& resolveLabel) const;
 
 	bool IsMovOp() const;
 	bool IsAluOp() const;
 	bool IsJumpOp() const;
 	bool IsAncillaryOpCode() const;
+	bool IsDataOp() const;
 
 	SourceLine mLine;
 	std::optional<Parameter> mParam1;
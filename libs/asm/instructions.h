@@ -1,11 +1,18 @@
 #pragma once
 
-#include "../ctrl_eeprom/constants.h"
-
-namespace Cpu {
+#include <ctrl/constants.h>
 
+#include <string_view>
 
+namespace Cpu {
 
+//Mnemonic lookups shared by the encoders, each returns 0xFF if op is not in the group
+//Apart from GetAncillaryOpCode which returns 0, RETI is 0xFF
+uint8_t GetAncillaryOpCode(std::string_view op);
+uint8_t GetJumpOpCode(std::string_view op);
+uint8_t GetAluOpCode(std::string_view op);
+//Register names, A, B, ALO and OUT
+uint8_t GetRegister(std::string_view name);
 
 }
 
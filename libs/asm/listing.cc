@@ -0,0 +1,108 @@
+#include "listing.h"
+
+#include <ctrl/constants.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <vector>
+
+namespace Cpu
+{
+
+namespace
+{
+
+std::string range(unsigned min, unsigned max)
+{
+	return min == max ? std::to_string(min) : std::to_string(min) + "-" + std::to_string(max);
+}
+
+void pad(std::string& out, size_t column)
+{
+	const size_t length = out.size() - (out.rfind('\n') + 1);
+	out.append(length < column ? column - length : 1, ' ');
+}
+
+}
+
+std::string program_listing(const Program& program)
+{
+	const auto& labels = program.Labels();
+	auto lookup = [&labels](const std::string& label)
+	{
+		auto it = labels.find(label);
+		return it == labels.end() ? uint8_t(0) : it->second;
+	};
+
+	std::multimap<uint8_t, std::string> byAddress;
+	for (const auto& [label, address] : labels)
+		byAddress.emplace(address, label);
+
+	std::string out = "addr  bytes       cycles  total   source\n";
+	uint64_t total = 0;
+	auto label = byAddress.begin();
+	for (const auto& [address, instr] : program.Instructions())
+	{
+		const auto& line = instr.Line();
+		for (; label != byAddress.end() && label->first <= address; ++label)
+		{
+			total = 0;
+			if (label->first == address && line.Label() && *line.Label() == label->second)
+				continue;
+			out += label->second + ":\n";
+		}
+
+		char addr[8];
+		std::snprintf(addr, sizeof(addr), "%4u  ", unsigned(address));
+		out += addr;
+		for (const auto b : instr.Encode(lookup))
+			out += std::to_string(b) + " ";
+		pad(out, 18);
+
+		const std::string& op = line.OpCode();
+		if (op == "DB")
+		{
+			out += "-";
+		}
+		else if (op == "JZ" || op == "JE" || op == "JN" || op == "JC")
+		{
+			const uint16_t cond = op == "JC" ? CND_CR : CND_JMP;
+			const uint16_t other = op == "JC" ? CND_JMP : CND_CR;
+			const unsigned taken[] = {instr.Cycles(cond), instr.Cycles(cond | other)};
+			const unsigned skipped[] = {instr.Cycles(), instr.Cycles(other)};
+			out += range(std::min(taken[0], taken[1]), std::max(taken[0], taken[1])) + "/" +
+				range(std::min(skipped[0], skipped[1]), std::max(skipped[0], skipped[1]));
+			total += std::max(skipped[0], skipped[1]);
+		}
+		else
+		{
+			out += std::to_string(instr.Cycles());
+			total += instr.Cycles();
+		}
+		pad(out, 26);
+		out += std::to_string(total);
+		pad(out, 34);
+
+		std::ostringstream source;
+		line.Print(source);
+		out += source.str() + "\n";
+	}
+	for (; label != byAddress.end(); ++label)
+		out += label->second + ":\n";
+
+	if (!labels.empty())
+	{
+		out += "\n; symbols\n";
+		for (const auto& [address, name] : byAddress)
+		{
+			char addr[8];
+			std::snprintf(addr, sizeof(addr), "%4u  ", unsigned(address));
+			out += addr + name + "\n";
+		}
+	}
+	return out;
+}
+
+}
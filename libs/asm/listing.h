@@ -0,0 +1,26 @@
+#pragma once
+
+#include "program.h"
+
+#include <string>
+
+namespace Cpu
+{
+
+/*
+An assembler listing of a Program, one instruction per line:
+
+	addr  bytes       cycles  total   source
+	   6  206 10      4/3-4   14      		JZ #done
+	   8  238 2       4       18      		JMP #loop
+
+cycles is from the microcode table, conditional jumps show taken/not taken, and not taken
+depends on the other condition input. total runs through the instructions falling through
+each into the next, the worst case, and starts again at each label. Labels on lines of
+their own are listed before the address they name and a symbol table follows the code.
+
+Built up in a string so it can be written out in one go.
+*/
+std::string program_listing(const Program& program);
+
+}
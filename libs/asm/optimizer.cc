@@ -0,0 +1,234 @@
+#include "optimizer.h"
+#include "instruction.h"
+#include "instructions.h"
+
+#include <map>
+#include <set>
+
+namespace Cpu
+{
+
+namespace {
+
+bool IsEmpty(const SourceLine& line)
+{
+	return line.OpCode().empty();
+}
+
+//Index of the next line which emits an instruction, or lines.size()
+size_t NextInstruction(const std::vector<SourceLine>& lines, size_t from)
+{
+	while (from < lines.size() && IsEmpty(lines[from]))
+		from++;
+	return from;
+}
+
+//True if any of lines (from, to] carry a label, so control may enter at 'to' from elsewhere
+bool Labelled(const std::vector<SourceLine>& lines, size_t from, size_t to)
+{
+	for (size_t i = from + 1; i <= to; i++)
+	{
+		if (lines[i].Label())
+			return true;
+	}
+	return false;
+}
+
+bool HasLabel(const std::vector<SourceLine>& lines, size_t from, size_t to, const std::string& label)
+{
+	for (size_t i = from + 1; i <= to; i++)
+	{
+		if (lines[i].Label() == label)
+			return true;
+	}
+	return false;
+}
+
+void Remove(std::vector<SourceLine>& lines, size_t i)
+{
+	if (lines[i].Label())
+		lines[i] = SourceLine::Make(lines[i].Label(), "");
+	else
+		lines.erase(lines.begin() + i);
+}
+
+bool IsLiteral(const OptionalString& p)
+{
+	return p && Parameter(*p).IsLiteral() && !Parameter(*p).IsDereferenced();
+}
+
+//Label of a '#label' jump parameter
+OptionalString JumpTarget(const SourceLine& line)
+{
+	if (GetJumpOpCode(line.OpCode()) == 0xFF || !line.Param1() || (*line.Param1())[0] != '#')
+		return {};
+	return line.Param1()->substr(1);
+}
+
+void Measure(const std::vector<SourceLine>& lines, size_t& bytes, size_t& cycles)
+{
+	bytes = cycles = 0;
+	for (const auto& line : lines)
+	{
+		Instruction instr(line);
+		bytes += instr.EncodedLength();
+		cycles += instr.Cycles();
+	}
+}
+
+}
+
+std::vector<SourceLine> Optimizer::Optimize(const std::vector<SourceLine>& source)
+{
+	mReport = OptimizerReport();
+	Measure(source, mReport.bytesBefore, mReport.cyclesBefore);
+
+	std::vector<SourceLine> lines = source;
+	while (RemoveRedundantMoves(lines) ||
+		RemoveJumpsToNext(lines) ||
+		FoldImmediates(lines) ||
+		ThreadJumps(lines))
+	{
+	}
+
+	Measure(lines, mReport.bytesAfter, mReport.cyclesAfter);
+	return lines;
+}
+
+bool Optimizer::RemoveRedundantMoves(std::vector<SourceLine>& lines)
+{
+	for (size_t i = NextInstruction(lines, 0); i < lines.size(); i = NextInstruction(lines, i + 1))
+	{
+		const size_t j = NextInstruction(lines, i + 1);
+		if (j == lines.size())
+			break;
+		const auto& first = lines[i];
+		const auto& second = lines[j];
+		if (first.OpCode() != "MOV" || second.OpCode() != "MOV" || Labelled(lines, i, j))
+			continue;
+		if (!first.Param1() || !first.Param2() || !second.Param1() || !second.Param2())
+			continue;
+
+		const auto& dest = *first.Param1();
+		const auto& src = *first.Param2();
+		//MOV A, [A] and MOV B, [42+B] change the address they read from
+		const bool readsDest = src == "[" + dest + "]"
+			|| (src.size() > dest.size() + 2 && src.compare(src.size() - dest.size() - 2, std::string::npos, "+" + dest + "]") == 0);
+		if (readsDest || dest == "OUT")
+			continue;
+
+		const bool roundTrip = *second.Param1() == src && *second.Param2() == dest;
+		const bool repeat = *second.Param1() == dest && *second.Param2() == src;
+		if (roundTrip || repeat)
+		{
+			lines.erase(lines.begin() + j);
+			mReport.movesRemoved++;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Optimizer::RemoveJumpsToNext(std::vector<SourceLine>& lines)
+{
+	for (size_t i = NextInstruction(lines, 0); i < lines.size(); i = NextInstruction(lines, i + 1))
+	{
+		const auto target = JumpTarget(lines[i]);
+		if (lines[i].OpCode() != "JMP" || !target)
+			continue;
+		const size_t next = NextInstruction(lines, i + 1);
+		if (next < lines.size() && HasLabel(lines, i, next, *target))
+		{
+			Remove(lines, i);
+			mReport.jumpsRemoved++;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Optimizer::FoldImmediates(std::vector<SourceLine>& lines)
+{
+	for (size_t i = NextInstruction(lines, 0); i < lines.size(); i = NextInstruction(lines, i + 1))
+	{
+		const size_t j = NextInstruction(lines, i + 1);
+		const size_t k = NextInstruction(lines, j + 1);
+		if (k >= lines.size())
+			break;
+		const auto& load = lines[i];
+		const auto& alu = lines[j];
+		const auto& next = lines[k];
+
+		//MOV A, 42
+		if (load.OpCode() != "MOV" || load.Param1() != std::string("A") || !IsLiteral(load.Param2()))
+			continue;
+		//ADD A
+		if (GetAluOpCode(alu.OpCode()) == 0xFF || alu.Param1() != std::string("A") || Labelled(lines, i, j))
+			continue;
+		//A must be dead after the ALU op, MOV A, src where src does not read A
+		if (next.OpCode() != "MOV" || next.Param1() != std::string("A") || !next.Param2() ||
+			*next.Param2() == "A" || *next.Param2() == "[A]")
+			continue;
+
+		lines[i] = SourceLine::Make(load.Label(), alu.OpCode(), load.Param2());
+		lines.erase(lines.begin() + j);
+		mReport.immediatesFolded++;
+		return true;
+	}
+	return false;
+}
+
+bool Optimizer::ThreadJumps(std::vector<SourceLine>& lines)
+{
+	std::map<std::string, size_t> labels;
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		if (lines[i].Label())
+			labels[*lines[i].Label()] = i;
+	}
+
+	for (size_t i = NextInstruction(lines, 0); i < lines.size(); i = NextInstruction(lines, i + 1))
+	{
+		const auto target = JumpTarget(lines[i]);
+		if (!target)
+			continue;
+
+		//follow JMP #label chains, giving up on cycles
+		std::set<std::string> visited;
+		std::string label = *target;
+		bool threaded = false;
+		while (true)
+		{
+			auto it = labels.find(label);
+			if (it == labels.end() || !visited.insert(label).second)
+			{
+				threaded = false;
+				break;
+			}
+			const size_t t = NextInstruction(lines, it->second);
+			const auto next = t < lines.size() ? JumpTarget(lines[t]) : OptionalString();
+			if (!next || lines[t].OpCode() != "JMP")
+				break;
+			label = *next;
+			threaded = true;
+		}
+
+		if (threaded && label != *target)
+		{
+			lines[i] = SourceLine::Make(lines[i].Label(), lines[i].OpCode(), "#" + label);
+			mReport.jumpsThreaded++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void OptimizerReport::Print(std::ostream& str) const
+{
+	str << "; bytes " << bytesBefore << " -> " << bytesAfter
+		<< ", cycles " << cyclesBefore << " -> " << cyclesAfter << std::endl;
+	str << "; " << movesRemoved << " moves removed, " << jumpsRemoved << " jumps removed, "
+		<< immediatesFolded << " immediates folded, " << jumpsThreaded << " jumps threaded" << std::endl;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "source_line.h"
+
+#include <ostream>
+#include <vector>
+
+namespace Cpu
+{
+
+struct OptimizerReport
+{
+	size_t bytesBefore = 0;
+	size_t bytesAfter = 0;
+	//static cycle count, every instruction executed once with no conditions set
+	size_t cyclesBefore = 0;
+	size_t cyclesAfter = 0;
+
+	size_t movesRemoved = 0;
+	size_t jumpsRemoved = 0;
+	size_t immediatesFolded = 0;
+	size_t jumpsThreaded = 0;
+
+	void Print(std::ostream&) const;
+};
+
+/*
+Peephole optimiser run on the parsed source before it is added to a Program
+
+	MOV A, B / MOV B, A			second MOV removed
+	MOV [42], A / MOV A, [42]	second MOV removed
+	JMP #next / next: ...		JMP removed
+	MOV A, 42 / ADD A			ADD 42, when A is overwritten by the next instruction
+	JZ #l1 ... l1: JMP #l2		JZ #l2
+
+A pattern never spans a labelled instruction other than the target of a removed JMP.
+Removed lines which carried a label are replaced by a label only line.
+*/
+class Optimizer
+{
+public:
+	std::vector<SourceLine> Optimize(const std::vector<SourceLine>& lines);
+
+	const OptimizerReport& Report() const {return mReport;}
+
+private:
+	bool RemoveRedundantMoves(std::vector<SourceLine>& lines);
+	bool RemoveJumpsToNext(std::vector<SourceLine>& lines);
+	bool FoldImmediates(std::vector<SourceLine>& lines);
+	bool ThreadJumps(std::vector<SourceLine>& lines);
+
+	OptimizerReport mReport;
+};
+
+}
@@ -1,21 +1,34 @@
 #include "program.h"
 
+#include <stdexcept>
+
 namespace Cpu
 {
 
-void Program::AddLine(const SourceLine& line)
+template <typename W>
+void BasicProgram<W>::AddLine(const SourceLine& line)
 {
+	//blank and label only lines take no space
+	if (line.OpCode().empty())
+	{
+		if (line.Label())
+			mLabels[*line.Label()] = mNextAddress;
+		return;
+	}
 	const auto& instr = mInstructions.emplace(std::make_pair(mNextAddress, Instruction(line))).first->second;
 	if (line.Label())
 		mLabels[*line.Label()] = mNextAddress;
-	mNextAddress += instr.EncodedLength();
+	mNextAddress += instr.template EncodedLength<W>();
 }
 
-std::vector<uint8_t> Program::MachineCode() const
+template <typename W>
+std::vector<uint8_t> BasicProgram<W>::MachineCode() const
 {
 	auto labelLookup = [this](const std::string& label)
 	{
 		auto it = this->mLabels.find(label);
+		if (it == this->mLabels.end())
+			throw std::runtime_error("unknown label " + label);
 		return it->second;
 	};
 
@@ -23,12 +36,15 @@ std::vector<uint8_t> Program::MachineCode() const
 
 	for (const auto& instr : mInstructions)
 	{
-		const auto bytes = instr.second.Encode(labelLookup);
+		const auto bytes = instr.second.template Encode<W>(labelLookup);
 		result.insert(result.end(), bytes.begin(), bytes.end());
 	}
 
 	return result;
 }
 
+template class BasicProgram<Width8>;
+template class BasicProgram<Width16>;
+
 
 }
\ No newline at end of file
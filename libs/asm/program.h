@@ -10,17 +10,27 @@
 namespace Cpu
 {
 
-class Program
+//Source assembled at consecutive addresses of W, see width.h
+template <typename W>
+class BasicProgram
 {
 public:
+	using Address = typename W::Address;
+
 	void AddLine(const SourceLine& line);
 	std::vector<uint8_t> MachineCode() const;
+
+	const std::map<std::string, Address>& Labels() const {return mLabels;}
+	const std::map<Address, Instruction>& Instructions() const {return mInstructions;}
 private:
 	//label to address
-	std::map<std::string, uint8_t> mLabels;
+	std::map<std::string, Address> mLabels;
 	//address to instruction
-	std::map<uint8_t, Instruction> mInstructions;
-	uint8_t mNextAddress = 0;
+	std::map<Address, Instruction> mInstructions;
+	Address mNextAddress = 0;
 };
 
-}
\ No newline at end of file
+//The board's 8 bit address space
+using Program = BasicProgram<Width8>;
+
+}
@@ -52,12 +52,16 @@ bool SkipChar(char c)
 
 SourceLine SourceLine::Parse(const std::string& line)
 {
-	State state = line.find_first_of(':') != std::string::npos ? LABEL : OP;
+	//a ':' in the comment is not a label
+	State state = line.substr(0, line.find_first_of(';')).find_first_of(':') != std::string::npos ? LABEL : OP;
 	std::string op;
 	OptionalString label, p1, p2, comment;
 
 	std::string buff;
 	const char* c = line.c_str();
+	//indented lines, as Print writes them
+	while (*c && std::iswspace(*c))
+		c++;
 	do{
 		if (*c == ';')
 		{
@@ -93,6 +97,14 @@ SourceLine SourceLine::Parse(const std::string& line)
 	return SourceLine {label, op, p1, p2, comment};
 }
 
+SourceLine SourceLine::Make(const OptionalString& label,
+	const std::string& op,
+	const OptionalString& p1,
+	const OptionalString& p2)
+{
+	return SourceLine {label, op, p1, p2, {}};
+}
+
 SourceLine::SourceLine(const OptionalString& label,
 	const std::string& op,
 	const OptionalString& p1,
@@ -112,7 +124,7 @@ void SourceLine::Print(std::ostream& str) const
 		str << *mLabel << ":";
 	str << "\t\t" << mOpCode;
 	if (mParam1)
-		str << *mParam1;
+		str << " " << *mParam1;
 	if (mParam2)
 		str << ", " << *mParam2;
 	if (mComment)
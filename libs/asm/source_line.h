@@ -13,16 +13,21 @@ label:	MOV A, [42]
 		MOV A, 42
 		MOV A, #label
 		MOV [42], A
+		MOV [#label], A
 		MOV [A], B
+		MOV A, [42+B]
+		MOV [#label+B], A
 		
 		ADD A
 		ADD [A]
 		ADD 42
+		ADD #label
 		ADD [42]
-		ADC
+		ADC			;carry in from the carry flag
 		SUB
-		SBC
+		SBC			;borrows if the carry flag is clear
 		SFT
+		SFC			;carry flag into bit 0
 		CMP
 		NOT
 		AND
@@ -42,10 +47,17 @@ label:	MOV A, [42]
 
 		CALL A
 		CALL 42
+		CALL #label
 
 		RET
 		HALT
 		NOOP
+		FILL		;A to [ALO] up to [B]
+		EI			;enable interrupts, they jump to 2
+		DI
+		RETI		;RET and EI
+
+data:	DB 42		;a byte in the image
 
 */
 using OptionalString = std::optional<std::string>;
@@ -54,11 +66,17 @@ class SourceLine
 {
 public:
 	static SourceLine Parse(const std::string& line);
+	static SourceLine Make(const OptionalString& label,
+			const std::string& op,
+			const OptionalString& p1 = {},
+			const OptionalString& p2 = {});
 
 	const std::string& OpCode() const {return mOpCode;}
 	const std::optional<std::string>& Param1() const {return mParam1;}
 	const std::optional<std::string>& Param2() const {return mParam2;}
 	const std::optional<std::string>& Label() const { return mLabel; }
+	//Text after the ';', annotations such as loop bounds are read from here
+	const std::optional<std::string>& Comment() const { return mComment; }
 
 	void Print(std::ostream&) const;
 private:
@@ -0,0 +1,434 @@
+#include "timing_analyzer.h"
+
+#include <ctrl/constants.h>
+
+#include <algorithm>
+#include <bitset>
+#include <functional>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace Cpu
+{
+
+namespace
+{
+
+//graph nodes are addresses, plus where RET and HLT leave a function
+const int ret_node = 256;
+const int halt_node = 257;
+const uint64_t unreachable = UINT64_MAX;
+
+struct Edge
+{
+	int to;
+	uint64_t best;
+	uint64_t worst;
+};
+
+void merge_edge(std::vector<Edge>& edges, const Edge& e)
+{
+	for (auto& existing : edges)
+	{
+		if (existing.to == e.to)
+		{
+			existing.best = std::min(existing.best, e.best);
+			existing.worst = std::max(existing.worst, e.worst);
+			return;
+		}
+	}
+	edges.push_back(e);
+}
+
+struct Loop
+{
+	int header = 0;
+	std::bitset<256> nodes;
+	bool bounded = false;
+	uint32_t minBound = 0;
+	uint32_t maxBound = 0;
+	const Loop* parent = nullptr;
+
+	//from entering the header to leaving the loop, bounds included
+	std::vector<Edge> exits;
+	uint64_t bestIteration = 0;
+	uint64_t worstIteration = 0;
+};
+
+struct Function
+{
+	FunctionTiming timing;
+	//leaving by RET or by HLT, nullptr if it can't
+	std::optional<Edge> ret;
+	std::optional<Edge> halt;
+};
+
+//"bound 16" or "bound 4..16" in a comment
+bool parse_bound(const OptionalString& comment, uint32_t& min, uint32_t& max)
+{
+	if (!comment)
+		return false;
+	const auto pos = comment->find("bound");
+	if (pos == std::string::npos)
+		return false;
+	std::istringstream in(comment->substr(pos + 5));
+	if (!(in >> max))
+		throw std::runtime_error("expected a number after bound in '" + *comment + "'");
+	min = 0;
+	if (in.peek() == '.')
+	{
+		in.get();
+		if (in.get() != '.')
+			throw std::runtime_error("expected min..max in '" + *comment + "'");
+		min = max;
+		if (!(in >> max) || max < min)
+			throw std::runtime_error("expected min..max in '" + *comment + "'");
+	}
+	return true;
+}
+
+class Analysis
+{
+public:
+	explicit Analysis(const Program& program)
+	:	mProgram(program)
+	{
+	}
+
+	const Function& Analyze(uint8_t entry);
+	const std::map<uint8_t, Function>& Functions() const {return mFunctions;}
+
+private:
+	struct Region
+	{
+		std::vector<Edge> exits;
+		uint64_t bestIteration = unreachable;
+		uint64_t worstIteration = 0;
+	};
+
+	std::string Name(int address) const;
+	std::vector<Edge> Successors(uint8_t address);
+	Region Solve(int header, const std::bitset<256>& nodes, const Loop* self,
+		const std::map<int, std::vector<Edge>>& edges, const std::map<int, Loop>& loops) const;
+
+	const Program& mProgram;
+	std::map<uint8_t, Function> mFunctions;
+	std::set<uint8_t> mInProgress;
+};
+
+std::string Analysis::Name(int address) const
+{
+	for (const auto& [label, labelAddress] : mProgram.Labels())
+		if (labelAddress == address)
+			return label;
+	return std::to_string(address);
+}
+
+std::vector<Edge> Analysis::Successors(uint8_t address)
+{
+	const auto& instructions = mProgram.Instructions();
+	auto it = instructions.find(address);
+	if (it == instructions.end())
+		throw std::runtime_error("execution runs outside the program at " + std::to_string(address));
+
+	const Instruction& instr = it->second;
+	const std::string& op = instr.Line().OpCode();
+	if (op == "DB")
+		throw std::runtime_error("execution runs into data at " + Name(address));
+
+	const auto bytes = instr.Encode([this](const std::string& label)
+	{
+		auto l = mProgram.Labels().find(label);
+		if (l == mProgram.Labels().end())
+			throw std::runtime_error("unknown label " + label);
+		return l->second;
+	});
+	const int next = address + int(bytes.size());
+	const uint64_t cycles = instr.Cycles();
+
+	if (op == "RET" || op == "RETI")
+		return {{ret_node, cycles, cycles}};
+	if (op == "HLT")
+		return {{halt_node, cycles, cycles}};
+
+	const bool jump = op == "JMP" || op == "JZ" || op == "JE" || op == "JN" || op == "JC";
+	if ((jump || op == "CALL") && bytes.size() != 2)
+		throw std::runtime_error("indirect " + op + " at " + Name(address) + " can't be followed");
+
+	if (op == "JMP")
+		return {{bytes[1], cycles, cycles}};
+	if (jump)
+	{
+		//a skipped jump takes a cycle less when the other condition input is set
+		const uint16_t cond = op == "JC" ? CND_CR : CND_JMP;
+		const uint16_t other = op == "JC" ? CND_JMP : CND_CR;
+		const uint64_t taken[] = {instr.Cycles(cond), instr.Cycles(cond | other)};
+		const uint64_t skipped[] = {cycles, instr.Cycles(other)};
+		return {
+			{bytes[1], std::min(taken[0], taken[1]), std::max(taken[0], taken[1])},
+			{next, std::min(skipped[0], skipped[1]), std::max(skipped[0], skipped[1])}};
+	}
+	if (op == "FILL")
+	{
+		//loops in microcode, a cycle less for the last byte which skips the idle step
+		uint32_t min, max;
+		if (!parse_bound(instr.Line().Comment(), min, max))
+			throw std::runtime_error("FILL at " + Name(address) + " needs a bound on its byte count, eg ; bound 16");
+		auto fill = [&](uint32_t n) {return instr.Cycles(CND_JMP) + uint64_t(std::max<uint32_t>(n, 1) - 1) * cycles;};
+		return {{next, fill(min), fill(max)}};
+	}
+	if (op == "CALL")
+	{
+		const Function& callee = Analyze(bytes[1]);
+		std::vector<Edge> edges;
+		if (callee.ret)
+			edges.push_back({next, cycles + callee.ret->best, cycles + callee.ret->worst});
+		if (callee.halt)
+			edges.push_back({halt_node, cycles + callee.halt->best, cycles + callee.halt->worst});
+		return edges;
+	}
+	return {{next, cycles, cycles}};
+}
+
+/*
+Longest and shortest paths from header through nodes, which is acyclic once the jumps back
+to header are taken out and the loops directly inside are replaced by their exits.
+*/
+Analysis::Region Analysis::Solve(int header, const std::bitset<256>& nodes, const Loop* self,
+	const std::map<int, std::vector<Edge>>& edges, const std::map<int, Loop>& loops) const
+{
+	auto outEdges = [&](int v) -> const std::vector<Edge>&
+	{
+		auto l = loops.find(v);
+		if (l != loops.end() && &l->second != self && l->second.parent == self)
+			return l->second.exits;
+		return edges.at(v);
+	};
+	auto inside = [&](int v) {return v < 256 && nodes[v] && v != header;};
+
+	//reverse post order
+	std::vector<int> order;
+	std::vector<uint8_t> state(256, 0);
+	std::function<void(int)> visit = [&](int v)
+	{
+		state[v] = 1;
+		for (const auto& e : outEdges(v))
+		{
+			if (!inside(e.to))
+				continue;
+			if (state[e.to] == 1)
+				throw std::runtime_error("loop at " + Name(e.to) + " is entered other than through its first instruction");
+			if (state[e.to] == 0)
+				visit(e.to);
+		}
+		state[v] = 2;
+		order.push_back(v);
+	};
+	visit(header);
+	std::reverse(order.begin(), order.end());
+
+	std::vector<uint64_t> best(256, unreachable);
+	std::vector<uint64_t> worst(256, 0);
+	best[header] = 0;
+
+	Region result;
+	for (const int v : order)
+	{
+		for (const auto& e : outEdges(v))
+		{
+			const Edge path = {e.to, best[v] + e.best, worst[v] + e.worst};
+			if (self && e.to == header)
+			{
+				result.bestIteration = std::min(result.bestIteration, path.best);
+				result.worstIteration = std::max(result.worstIteration, path.worst);
+			}
+			else if (inside(e.to))
+			{
+				best[e.to] = std::min(best[e.to], path.best);
+				worst[e.to] = std::max(worst[e.to], path.worst);
+			}
+			else
+			{
+				merge_edge(result.exits, path);
+			}
+		}
+	}
+	return result;
+}
+
+const Function& Analysis::Analyze(uint8_t entry)
+{
+	auto done = mFunctions.find(entry);
+	if (done != mFunctions.end())
+		return done->second;
+	if (!mInProgress.insert(entry).second)
+		throw std::runtime_error("recursive call to " + Name(entry));
+
+	//every instruction reachable without following calls
+	std::map<int, std::vector<Edge>> edges;
+	std::map<int, std::vector<int>> preds;
+	std::vector<int> work = {entry};
+	while (!work.empty())
+	{
+		const int v = work.back();
+		work.pop_back();
+		if (edges.count(v))
+			continue;
+		edges[v] = Successors(uint8_t(v));
+		for (const auto& e : edges[v])
+		{
+			if (e.to >= 256)
+				continue;
+			preds[e.to].push_back(v);
+			work.push_back(e.to);
+		}
+	}
+
+	//jumps back to an instruction still on the depth first stack close a loop
+	std::map<int, Loop> loops;
+	std::vector<uint8_t> state(256, 0);
+	std::function<void(int)> visit = [&](int v)
+	{
+		state[v] = 1;
+		for (const auto& e : edges[v])
+		{
+			if (e.to >= 256)
+				continue;
+			if (state[e.to] == 1)
+			{
+				Loop& loop = loops[e.to];
+				loop.header = e.to;
+				loop.nodes.set(e.to);
+				std::vector<int> body = {v};
+				while (!body.empty())
+				{
+					const int n = body.back();
+					body.pop_back();
+					if (loop.nodes[n])
+						continue;
+					loop.nodes.set(n);
+					for (const int p : preds[n])
+						body.push_back(p);
+				}
+
+				uint32_t min, max;
+				if (parse_bound(mProgram.Instructions().at(uint8_t(v)).Line().Comment(), min, max))
+				{
+					loop.minBound = loop.bounded ? std::min(loop.minBound, min) : min;
+					loop.maxBound = loop.bounded ? std::max(loop.maxBound, max) : max;
+					loop.bounded = true;
+				}
+			}
+			else if (state[e.to] == 0)
+			{
+				visit(e.to);
+			}
+		}
+		state[v] = 2;
+	};
+	visit(entry);
+
+	//innermost first, each inside the smallest loop containing it
+	std::vector<Loop*> nested;
+	for (auto& [header, loop] : loops)
+		nested.push_back(&loop);
+	std::stable_sort(nested.begin(), nested.end(), [](const Loop* a, const Loop* b) {return a->nodes.count() < b->nodes.count();});
+	for (size_t i = 0; i < nested.size(); i++)
+	{
+		for (size_t j = i + 1; j < nested.size() && !nested[i]->parent; j++)
+			if ((nested[i]->nodes & ~nested[j]->nodes).none())
+				nested[i]->parent = nested[j];
+	}
+
+	Function f;
+	f.timing.entry = entry;
+	f.timing.name = Name(entry);
+	for (Loop* loop : nested)
+	{
+		const Region r = Solve(loop->header, loop->nodes, loop, edges, loops);
+		loop->bestIteration = r.bestIteration == unreachable ? 0 : r.bestIteration;
+		loop->worstIteration = r.worstIteration;
+		for (auto e : r.exits)
+		{
+			e.best += uint64_t(loop->minBound) * loop->bestIteration;
+			e.worst += uint64_t(loop->maxBound) * loop->worstIteration;
+			loop->exits.push_back(e);
+		}
+		//a loop that is never left, like one driving OUT, needs no bound
+		if (!loop->bounded && !loop->exits.empty())
+			throw std::runtime_error("loop at " + Name(loop->header) + " needs a bound, eg ; bound 10 on its last jump");
+
+		LoopTiming timing;
+		timing.header = uint8_t(loop->header);
+		timing.name = Name(loop->header);
+		timing.minBound = loop->minBound;
+		timing.maxBound = loop->bounded ? loop->maxBound : UINT32_MAX;
+		timing.bestIteration = loop->bestIteration;
+		timing.worstIteration = loop->worstIteration;
+		f.timing.loops.push_back(timing);
+	}
+	std::sort(f.timing.loops.begin(), f.timing.loops.end(), [](const LoopTiming& a, const LoopTiming& b) {return a.header < b.header;});
+
+	std::bitset<256> all;
+	for (const auto& [v, e] : edges)
+		all.set(v);
+	const Region r = Solve(entry, all, nullptr, edges, loops);
+	f.timing.best = unreachable;
+	for (const auto& e : r.exits)
+	{
+		(e.to == ret_node ? f.ret : f.halt) = e;
+		f.timing.best = std::min(f.timing.best, e.best);
+		f.timing.worst = std::max(f.timing.worst, e.worst);
+	}
+	if (r.exits.empty())
+		f.timing.best = 0;
+	f.timing.ends = !r.exits.empty();
+
+	mInProgress.erase(entry);
+	return mFunctions[entry] = f;
+}
+
+}
+
+TimingAnalyzer::TimingAnalyzer(const Program& program)
+:	mProgram(program)
+{
+}
+
+TimingReport TimingAnalyzer::Analyze() const
+{
+	Analysis analysis(mProgram);
+	TimingReport report;
+	if (mProgram.Instructions().empty())
+		return report;
+
+	analysis.Analyze(0);
+	for (const auto& [entry, f] : analysis.Functions())
+		report.functions.push_back(f.timing);
+	return report;
+}
+
+void TimingReport::Print(std::ostream& os) const
+{
+	for (const auto& f : functions)
+	{
+		os << "; " << f.name << " at " << unsigned(f.entry) << ": ";
+		if (f.ends)
+			os << f.best << ".." << f.worst << " cycles\n";
+		else
+			os << "never returns or halts\n";
+		for (const auto& l : f.loops)
+		{
+			os << ";   loop " << l.name << " at " << unsigned(l.header) << ", ";
+			if (l.maxBound == UINT32_MAX)
+				os << "forever";
+			else
+				os << "bound " << l.minBound << ".." << l.maxBound;
+			os << ": " << l.bestIteration << ".." << l.worstIteration << " cycles per iteration\n";
+		}
+	}
+}
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "program.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Cpu
+{
+
+struct LoopTiming
+{
+	//the loop's first instruction, the target of its backward jumps
+	uint8_t header = 0;
+	std::string name;
+	//times the backward jumps may be taken each time the loop is entered,
+	//maxBound is UINT32_MAX for a loop which is never left
+	uint32_t minBound = 0;
+	uint32_t maxBound = 0;
+	//cycles from the header round to the header
+	uint64_t bestIteration = 0;
+	uint64_t worstIteration = 0;
+};
+
+struct FunctionTiming
+{
+	uint8_t entry = 0;
+	std::string name;
+	//cycles from entry to RET, or HLT, callees included
+	uint64_t best = 0;
+	uint64_t worst = 0;
+	//false when it never leaves a loop without a bound, best and worst are 0
+	bool ends = true;
+	std::vector<LoopTiming> loops;
+};
+
+struct TimingReport
+{
+	//the program, from address 0, first
+	std::vector<FunctionTiming> functions;
+
+	void Print(std::ostream&) const;
+};
+
+/*
+Static best and worst case cycle counts from the control flow graph of a Program.
+
+Functions start at address 0 and at every CALL target and end at RET or HLT, CALLs add the
+callee's cycles. Each edge costs the cycles of the instruction it leaves, from the microcode
+table, so conditional jumps cost their taken or not taken count, the latter depending on the
+other condition input. Loops are found from the
+backward jumps and need a bound in the comment of the jump that closes them:
+
+	JZ #loop	; bound 16			taken at most 16 times each time the loop is entered
+	JMP #loop	; bound 4..16		at least 4, at most 16
+
+A loop costs its bound times its best or worst iteration plus the path out of it, innermost
+loops first. A loop with no way out, like one driving OUT for ever, needs no bound. Indirect
+jumps and calls, recursion, irreducible loops, loops with an exit but no bound and running
+into data throw std::runtime_error.
+*/
+class TimingAnalyzer
+{
+public:
+	explicit TimingAnalyzer(const Program& program);
+
+	TimingReport Analyze() const;
+
+private:
+	const Program& mProgram;
+};
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Cpu
+{
+
+struct Expr
+{
+	enum Kind
+	{
+		NUMBER,		//value
+		VARIABLE,	//name
+		INDEX,		//name[args[0]]
+		CALL,		//name(args)
+		UNARY,		//op args[0], op is ~ or -
+		BINARY		//args[0] op args[1], op is + - & | ^ or <<
+	};
+
+	Kind kind = NUMBER;
+	uint8_t value = 0;
+	std::string name;
+	std::string op;
+	std::vector<std::unique_ptr<Expr>> args;
+	int line = 0;
+};
+
+//lhs op rhs where op is == != < > <= >=, a lone expression is compared != 0
+struct Condition
+{
+	std::string op;
+	std::unique_ptr<Expr> lhs;
+	std::unique_ptr<Expr> rhs;
+};
+
+struct Statement
+{
+	enum Kind
+	{
+		BLOCK,		//body
+		DECLARE,	//byte name[size], value is the initialiser
+		ASSIGN,		//name[index] = value
+		IF,			//if (cond) body[0] else body[1]
+		WHILE,		//while (cond) body[0]
+		RETURN,		//return value
+		OUT,		//out(value)
+		EXPRESSION	//value, a function call
+	};
+
+	Kind kind = BLOCK;
+	std::string name;
+	uint8_t size = 0;	//0 for a scalar
+	std::unique_ptr<Expr> index;
+	std::unique_ptr<Expr> value;
+	Condition cond;
+	std::vector<std::unique_ptr<Statement>> body;
+	int line = 0;
+};
+
+struct Function
+{
+	std::string name;
+	bool returnsValue = false;
+	std::vector<std::string> params;
+	std::unique_ptr<Statement> body;
+	int line = 0;
+};
+
+struct Global
+{
+	std::string name;
+	uint8_t size = 0;	//0 for a scalar
+	std::vector<uint8_t> init;
+	int line = 0;
+};
+
+struct Unit
+{
+	std::vector<Global> globals;
+	std::vector<Function> functions;
+};
+
+}
@@ -0,0 +1,1027 @@
+#include "compiler.h"
+#include "parser.h"
+
+#include <asm/instruction.h>
+#include <asm/instructions.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+
+namespace Cpu
+{
+
+namespace
+{
+
+const uint8_t REG_A = 1;
+const uint8_t REG_B = 2;
+const uint8_t REG_ALO = 4;
+
+std::string RegName(uint8_t reg)
+{
+	if (reg == REG_A)
+		return "A";
+	if (reg == REG_B)
+		return "B";
+	return "ALO";
+}
+
+std::string Number(uint8_t value)
+{
+	return std::to_string(value);
+}
+
+std::string Address(const std::string& label)
+{
+	return "[#" + label + "]";
+}
+
+//label + B, see make_indexed_instruction_code
+std::string Indexed(const std::string& label)
+{
+	return "[#" + label + "+B]";
+}
+
+//Registers an instruction leaves changed
+uint8_t Writes(const std::string& op, const OptionalString& p1, const OptionalString& p2 = {})
+{
+	if (op == "MOV")
+	{
+		const uint8_t reg = *p1 == "A" ? REG_A : *p1 == "B" ? REG_B : 0;
+		//indexed addresses are added up in the ALU
+		const bool indexed = Parameter(*p1).IsIndexed() || (p2 && Parameter(*p2).IsIndexed());
+		return indexed ? reg | REG_ALO : reg;
+	}
+	if (GetAluOpCode(op) != 0xFF)
+		return REG_ALO;
+	//the stack pointer is moved through the ALU
+	if (op == "CALL")
+		return REG_A | REG_B | REG_ALO;
+	if (op == "PUSH" || op == "POP")
+		return REG_ALO | (op == "POP" ? Writes("MOV", p1) : 0);
+	return 0;
+}
+
+//Instructions with their cost in cycles and the registers they change
+struct Code
+{
+	std::vector<SourceLine> lines;
+	unsigned cycles = 0;
+	uint8_t clobbers = 0;
+	bool valid = true;
+
+	static Code Invalid()
+	{
+		Code c;
+		c.valid = false;
+		return c;
+	}
+
+	Code& Emit(const std::string& op, const OptionalString& p1 = {}, const OptionalString& p2 = {})
+	{
+		lines.push_back(SourceLine::Make({}, op, p1, p2));
+		cycles += Instruction(lines.back()).Cycles();
+		clobbers |= Writes(op, p1, p2);
+		return *this;
+	}
+
+	Code& Label(const std::string& label)
+	{
+		lines.push_back(SourceLine::Make(label, ""));
+		return *this;
+	}
+
+	Code& Append(const Code& other)
+	{
+		if (!other.valid)
+			valid = false;
+		lines.insert(lines.end(), other.lines.begin(), other.lines.end());
+		cycles += other.cycles;
+		clobbers |= other.clobbers;
+		return *this;
+	}
+};
+
+Code Join(const Code& a, const Code& b)
+{
+	Code c = a;
+	c.Append(b);
+	return c;
+}
+
+//The cheapest valid option leaving the registers in keep alone
+Code Cheapest(std::initializer_list<Code> options, uint8_t keep = 0)
+{
+	Code best = Code::Invalid();
+	for (const auto& c : options)
+		if (c.valid && !(c.clobbers & keep) && (!best.valid || c.cycles < best.cycles))
+			best = c;
+	return best;
+}
+
+Code Cheapest(const Code& a, const Code& b, uint8_t keep = 0)
+{
+	return Cheapest({a, b}, keep);
+}
+
+const char* AluOp(const std::string& op)
+{
+	if (op == "+")
+		return "ADD";
+	if (op == "-")
+		return "SUB";
+	if (op == "&")
+		return "AND";
+	if (op == "|")
+		return "OR";
+	if (op == "^")
+		return "XOR";
+	return "CMP";
+}
+
+bool IsNumber(const Expr& e, int value = -1)
+{
+	return e.kind == Expr::NUMBER && (value < 0 || e.value == value);
+}
+
+bool ContainsCall(const Expr& e)
+{
+	if (e.kind == Expr::CALL)
+		return true;
+	for (const auto& a : e.args)
+		if (ContainsCall(*a))
+			return true;
+	return false;
+}
+
+//Both operands constant, the result folded
+std::optional<uint8_t> Fold(const Expr& e)
+{
+	if (e.kind == Expr::NUMBER)
+		return e.value;
+	if (e.kind == Expr::UNARY)
+	{
+		const auto v = Fold(*e.args[0]);
+		if (!v)
+			return {};
+		return uint8_t(e.op == "~" ? ~*v : -*v);
+	}
+	if (e.kind != Expr::BINARY)
+		return {};
+	const auto l = Fold(*e.args[0]);
+	const auto r = Fold(*e.args[1]);
+	if (!l || !r)
+		return {};
+	if (e.op == "+")
+		return uint8_t(*l + *r);
+	if (e.op == "-")
+		return uint8_t(*l - *r);
+	if (e.op == "&")
+		return uint8_t(*l & *r);
+	if (e.op == "|")
+		return uint8_t(*l | *r);
+	if (e.op == "^")
+		return uint8_t(*l ^ *r);
+	return uint8_t(*r >= 8 ? 0 : *l << *r);
+}
+
+struct Symbol
+{
+	std::string label;
+	uint8_t size = 0;
+};
+
+class Generator
+{
+public:
+	Generator(const Unit& unit, const CompilerOptions& options);
+
+	std::vector<SourceLine> Generate();
+
+private:
+	[[noreturn]] void Error(int line, const std::string& message) const;
+	void CheckRecursion() const;
+	void AddData(const std::string& label, uint8_t size, const std::vector<uint8_t>& init = {});
+	std::string NewLabel();
+	const Symbol& Lookup(const std::string& name, int line) const;
+	const Function& LookupFunction(const std::string& name, int line) const;
+
+	Code CompileFunction(const Function& f);
+	Code CompileStatement(const Statement& s);
+	Code Branch(const Condition& c, const std::string& target, bool whenTrue);
+	Code Compare(const std::string& op, const Expr& lhs, const Expr& rhs, const std::string& target, bool whenTrue);
+	Code Jump(const std::string& jump, const std::string& target, bool fires, bool whenTrue);
+	Code Store(const Expr& e, const std::string& dest, int depth = 0);
+	Code StoreIndexed(const Statement& s);
+	Code Call(const Expr& e, int depth = 0);
+
+	//Optimised, the value of e into target without changing the registers in keep
+	Code Value(const Expr& e, uint8_t target, uint8_t keep, int depth);
+	Code DirectValue(const Expr& e, uint8_t target, uint8_t keep, int depth);
+	//ALU op with l on the bus and r in B, the result in ALO
+	Code Alu(const std::string& op, const Expr& l, const Expr& r, bool commutative, uint8_t keep, int depth);
+	//Naive, every value into A
+	Code NaiveValue(const Expr& e);
+
+	const Unit& mUnit;
+	CompilerOptions mOptions;
+	std::map<std::string, Symbol> mGlobals;
+	std::map<std::string, const Function*> mFunctions;
+	std::vector<SourceLine> mData;
+
+	//function being compiled
+	const Function* mFunction = nullptr;
+	std::map<std::string, Symbol> mLocals;
+	std::set<std::string> mTemps;
+	unsigned mNextLabel = 0;
+	std::map<std::tuple<const Expr*, uint8_t, uint8_t>, Code> mValues;
+	//rhs of a lone expression used as a condition
+	const Expr mZero;
+};
+
+Generator::Generator(const Unit& unit, const CompilerOptions& options)
+:	mUnit(unit),
+	mOptions(options)
+{
+	for (const auto& f : mUnit.functions)
+	{
+		if (!mFunctions.emplace(f.name, &f).second)
+			Error(f.line, "function " + f.name + " is already defined");
+	}
+	for (const auto& g : mUnit.globals)
+	{
+		if (mFunctions.count(g.name) || !mGlobals.emplace(g.name, Symbol{g.name, g.size}).second)
+			Error(g.line, g.name + " is already defined");
+		AddData(g.name, g.size, g.init);
+	}
+}
+
+void Generator::Error(int line, const std::string& message) const
+{
+	throw std::runtime_error("line " + std::to_string(line) + ": " + message);
+}
+
+void Generator::CheckRecursion() const
+{
+	std::map<std::string, std::set<std::string>> calls;
+	std::function<void(const Expr&, std::set<std::string>&)> exprCalls = [&](const Expr& e, std::set<std::string>& out)
+	{
+		if (e.kind == Expr::CALL)
+			out.insert(e.name);
+		for (const auto& a : e.args)
+			exprCalls(*a, out);
+	};
+	std::function<void(const Statement&, std::set<std::string>&)> statementCalls = [&](const Statement& s, std::set<std::string>& out)
+	{
+		for (const Expr* e : {s.index.get(), s.value.get(), s.cond.lhs.get(), s.cond.rhs.get()})
+			if (e)
+				exprCalls(*e, out);
+		for (const auto& b : s.body)
+			statementCalls(*b, out);
+	};
+	for (const auto& f : mUnit.functions)
+		statementCalls(*f.body, calls[f.name]);
+
+	//depth first, a function reached while on the path is recursive
+	std::set<std::string> done;
+	std::vector<std::string> path;
+	std::function<void(const std::string&)> visit = [&](const std::string& name)
+	{
+		if (std::find(path.begin(), path.end(), name) != path.end())
+			Error(mFunctions.at(name)->line, "recursion is not supported, " + name + " calls itself");
+		if (!done.insert(name).second)
+			return;
+		path.push_back(name);
+		for (const auto& callee : calls[name])
+			if (mFunctions.count(callee))
+				visit(callee);
+		path.pop_back();
+	};
+	for (const auto& f : mUnit.functions)
+		visit(f.name);
+}
+
+void Generator::AddData(const std::string& label, uint8_t size, const std::vector<uint8_t>& init)
+{
+	for (size_t i = 0; i < std::max<size_t>(size, 1); i++)
+	{
+		const uint8_t value = i < init.size() ? init[i] : 0;
+		mData.push_back(SourceLine::Make(i == 0 ? OptionalString(label) : OptionalString(), "DB", Number(value)));
+	}
+}
+
+std::string Generator::NewLabel()
+{
+	return mFunction->name + "__" + std::to_string(mNextLabel++);
+}
+
+const Symbol& Generator::Lookup(const std::string& name, int line) const
+{
+	auto it = mLocals.find(name);
+	if (it != mLocals.end())
+		return it->second;
+	it = mGlobals.find(name);
+	if (it != mGlobals.end())
+		return it->second;
+	Error(line, "unknown variable " + name);
+}
+
+const Function& Generator::LookupFunction(const std::string& name, int line) const
+{
+	const auto it = mFunctions.find(name);
+	if (it == mFunctions.end())
+		Error(line, "unknown function " + name);
+	return *it->second;
+}
+
+std::vector<SourceLine> Generator::Generate()
+{
+	const auto main = mFunctions.find("main");
+	if (main == mFunctions.end())
+		throw std::runtime_error("no main function");
+	if (!main->second->params.empty())
+		Error(main->second->line, "main takes no parameters");
+	CheckRecursion();
+
+	//main first so it starts at address 0
+	std::vector<SourceLine> result = CompileFunction(*main->second).lines;
+	for (const auto& f : mUnit.functions)
+	{
+		if (&f == main->second)
+			continue;
+		const auto lines = CompileFunction(f).lines;
+		result.insert(result.end(), lines.begin(), lines.end());
+	}
+	result.insert(result.end(), mData.begin(), mData.end());
+
+	size_t size = 0;
+	for (const auto& line : result)
+		size += Instruction(line).EncodedLength();
+	if (size > 256)
+		throw std::runtime_error("program is " + std::to_string(size) + " bytes, more than the 256 bytes of RAM");
+	return result;
+}
+
+Code Generator::CompileFunction(const Function& f)
+{
+	mFunction = &f;
+	mLocals.clear();
+	mTemps.clear();
+	mValues.clear();
+	mNextLabel = 0;
+
+	for (const auto& p : f.params)
+	{
+		const std::string label = f.name + "_" + p;
+		if (!mLocals.emplace(p, Symbol{label, 0}).second)
+			Error(f.line, "parameter " + p + " is already defined");
+		AddData(label, 0);
+	}
+
+	Code code;
+	code.Label(f.name);
+	code.Append(CompileStatement(*f.body));
+	if (f.body->body.empty() || f.body->body.back()->kind != Statement::RETURN)
+		code.Emit(f.name == "main" ? "HLT" : "RET");
+
+	//only the temporaries used by the code chosen need space
+	for (const auto& line : code.lines)
+	{
+		for (const auto& p : {line.Param1(), line.Param2()})
+		{
+			if (p && p->size() > 3 && mTemps.count(p->substr(2, p->size() - 3)))
+			{
+				AddData(p->substr(2, p->size() - 3), 0);
+				mTemps.erase(p->substr(2, p->size() - 3));
+			}
+		}
+	}
+	return code;
+}
+
+Code Generator::CompileStatement(const Statement& s)
+{
+	Code code;
+	switch (s.kind)
+	{
+	case Statement::BLOCK:
+		for (const auto& b : s.body)
+			code.Append(CompileStatement(*b));
+		break;
+
+	case Statement::DECLARE:
+	{
+		const std::string label = mFunction->name + "_" + s.name;
+		if (!mLocals.emplace(s.name, Symbol{label, s.size}).second)
+			Error(s.line, s.name + " is already defined");
+		AddData(label, s.size);
+		if (s.value)
+			code.Append(Store(*s.value, Address(label)));
+		break;
+	}
+
+	case Statement::ASSIGN:
+	{
+		const Symbol& symbol = Lookup(s.name, s.line);
+		if (symbol.size == 0 && s.index)
+			Error(s.line, s.name + " is not an array");
+		if (symbol.size != 0 && !s.index)
+			Error(s.line, s.name + " is an array");
+		if (s.index)
+			code.Append(StoreIndexed(s));
+		else
+			code.Append(Store(*s.value, Address(symbol.label)));
+		break;
+	}
+
+	case Statement::IF:
+	{
+		const std::string elseLabel = NewLabel();
+		code.Append(Branch(s.cond, elseLabel, false));
+		code.Append(CompileStatement(*s.body[0]));
+		if (s.body.size() > 1)
+		{
+			const std::string end = NewLabel();
+			code.Emit("JMP", "#" + end);
+			code.Label(elseLabel);
+			code.Append(CompileStatement(*s.body[1]));
+			code.Label(end);
+		}
+		else
+		{
+			code.Label(elseLabel);
+		}
+		break;
+	}
+
+	case Statement::WHILE:
+	{
+		const std::string top = NewLabel();
+		const std::string test = NewLabel();
+		if (mOptions.optimize)
+		{
+			//test at the bottom, one jump per iteration
+			code.Emit("JMP", "#" + test);
+			code.Label(top);
+			code.Append(CompileStatement(*s.body[0]));
+			code.Label(test);
+			code.Append(Branch(s.cond, top, true));
+		}
+		else
+		{
+			code.Label(top);
+			code.Append(Branch(s.cond, test, false));
+			code.Append(CompileStatement(*s.body[0]));
+			code.Emit("JMP", "#" + top);
+			code.Label(test);
+		}
+		break;
+	}
+
+	case Statement::RETURN:
+		if (s.value)
+		{
+			if (!mFunction->returnsValue && mFunction->name != "main")
+				Error(s.line, mFunction->name + " does not return a value");
+			code.Append(mOptions.optimize ? Value(*s.value, REG_A, 0, 0) : NaiveValue(*s.value));
+		}
+		else if (mFunction->returnsValue)
+		{
+			Error(s.line, mFunction->name + " must return a value");
+		}
+		code.Emit(mFunction->name == "main" ? "HLT" : "RET");
+		break;
+
+	case Statement::OUT:
+		code.Append(Store(*s.value, "OUT"));
+		break;
+
+	case Statement::EXPRESSION:
+		code.Append(Call(*s.value));
+		break;
+	}
+	return code;
+}
+
+Code Generator::Jump(const std::string& jump, const std::string& target, bool fires, bool whenTrue)
+{
+	Code code;
+	if (fires == whenTrue)
+	{
+		code.Emit(jump, "#" + target);
+	}
+	else
+	{
+		//no inverse jumps, skip over an unconditional one
+		const std::string skip = NewLabel();
+		code.Emit(jump, "#" + skip);
+		code.Emit("JMP", "#" + target);
+		code.Label(skip);
+	}
+	return code;
+}
+
+Code Generator::Branch(const Condition& c, const std::string& target, bool whenTrue)
+{
+	if (!c.op.empty())
+		return Compare(c.op, *c.lhs, *c.rhs, target, whenTrue);
+
+	//the ALU op computing the value sets Z
+	if (mOptions.optimize && c.lhs->kind == Expr::BINARY && !Fold(*c.lhs))
+	{
+		const Code code = Value(*c.lhs, REG_ALO, 0, 0);
+		if (code.valid)
+			return Join(code, Jump("JZ", target, false, whenTrue));
+	}
+	return Compare("!=", *c.lhs, mZero, target, whenTrue);
+}
+
+Code Generator::Compare(const std::string& op, const Expr& lhs, const Expr& rhs, const std::string& target, bool whenTrue)
+{
+	/*
+	CMP puts bus - B - 1 through the ALU, E is set when bus == B and carry when bus > B.
+	Each relation is one of those with the operands possibly swapped, and possibly negated
+	*/
+	const Expr* x = &lhs;
+	const Expr* y = &rhs;
+	std::string jump = "JC";
+	bool positive = true;
+	if (op == "==" || op == "!=")
+	{
+		jump = "JE";
+		positive = op == "==";
+	}
+	else if (op == "<" || op == ">=")
+	{
+		std::swap(x, y);
+		positive = op == "<";
+	}
+	else
+	{
+		positive = op == ">";
+	}
+
+	Code code;
+	if (mOptions.optimize)
+	{
+		code = Alu("CMP", *x, *y, jump == "JE", 0, 0);
+	}
+	else
+	{
+		code.Append(NaiveValue(*x));
+		code.Emit("PUSH", "A");
+		code.Append(NaiveValue(*y));
+		code.Emit("MOV", "B", "A");
+		code.Emit("POP", "A");
+		code.Emit("CMP", "A");
+	}
+	return code.Append(Jump(jump, target, positive, whenTrue));
+}
+
+Code Generator::Store(const Expr& e, const std::string& dest, int depth)
+{
+	Code code;
+	if (!mOptions.optimize)
+	{
+		code.Append(NaiveValue(e));
+		code.Emit("MOV", dest, "A");
+		return code;
+	}
+
+	//MOV OUT has immediate and direct forms
+	const auto folded = Fold(e);
+	if (dest == "OUT" && folded)
+		return code.Emit("MOV", dest, Number(*folded));
+	if (dest == "OUT" && e.kind == Expr::VARIABLE && Lookup(e.name, e.line).size == 0)
+		return code.Emit("MOV", dest, Address(Lookup(e.name, e.line).label));
+
+	Code best = Code::Invalid();
+	for (const auto reg : {REG_A, REG_B, REG_ALO})
+	{
+		Code c = Value(e, reg, 0, depth);
+		if (c.valid)
+			best = Cheapest(best, c.Emit("MOV", dest, RegName(reg)));
+	}
+	return best;
+}
+
+Code Generator::StoreIndexed(const Statement& s)
+{
+	const Symbol& symbol = Lookup(s.name, s.line);
+	const Expr& index = *s.index;
+	const Expr& value = *s.value;
+	const std::string base = "#" + symbol.label;
+
+	if (const auto i = Fold(index); i && *i >= symbol.size)
+		Error(s.line, "index out of range for " + s.name);
+
+	Code code;
+	if (!mOptions.optimize)
+	{
+		//PUSH and POP go through the ALU, the address is kept on the stack
+		code.Append(NaiveValue(index));
+		code.Emit("MOV", "B", "A");
+		code.Emit("MOV", "A", base);
+		code.Emit("ADD", "A");
+		code.Emit("MOV", "A", "ALO");
+		code.Emit("PUSH", "A");
+		code.Append(NaiveValue(value));
+		code.Emit("MOV", "B", "A");
+		code.Emit("POP", "A");
+		code.Emit("MOV", "[A]", "B");
+		return code;
+	}
+
+	if (const auto i = Fold(index); i && *i == 0)
+		return Store(value, Address(symbol.label));
+
+	//value in A, address in ALO
+	Code valueFirst = Value(value, REG_A, 0, 0);
+	valueFirst.Append(Value(index, REG_B, REG_A, 0));
+	valueFirst.Emit("ADD", base);
+	valueFirst.Emit("MOV", "[ALO]", "A");
+
+	//address in B, value in A
+	Code addressInB = Value(index, REG_B, 0, 0);
+	addressInB.Emit("ADD", base);
+	addressInB.Emit("MOV", "B", "ALO");
+	addressInB.Append(Value(value, REG_A, REG_B, 0));
+	addressInB.Emit("MOV", "[B]", "A");
+
+	//address in A, value in B
+	Code addressInA = Value(index, REG_B, 0, 0);
+	addressInA.Emit("ADD", base);
+	addressInA.Emit("MOV", "A", "ALO");
+	addressInA.Append(Value(value, REG_B, REG_A, 0));
+	addressInA.Emit("MOV", "[A]", "B");
+
+	//value in A, index in B
+	Code indexed = Value(value, REG_A, 0, 0);
+	indexed.Append(Value(index, REG_B, REG_A, 0));
+	indexed.Emit("MOV", Indexed(symbol.label), "A");
+
+	Code indexFirst = Value(index, REG_B, 0, 0);
+	indexFirst.Append(Value(value, REG_A, REG_B, 0));
+	indexFirst.Emit("MOV", Indexed(symbol.label), "A");
+
+	return Cheapest({valueFirst, addressInB, addressInA, indexed, indexFirst});
+}
+
+Code Generator::Call(const Expr& e, int depth)
+{
+	const Function& f = LookupFunction(e.name, e.line);
+	if (f.params.size() != e.args.size())
+		Error(e.line, f.name + " takes " + std::to_string(f.params.size()) + " arguments");
+
+	Code code;
+	if (!mOptions.optimize)
+	{
+		for (const auto& a : e.args)
+		{
+			code.Append(NaiveValue(*a));
+			code.Emit("PUSH", "A");
+		}
+		for (size_t i = e.args.size(); i-- > 0;)
+		{
+			code.Emit("POP", "A");
+			code.Emit("MOV", Address(f.name + "_" + f.params[i]), "A");
+		}
+		return code.Emit("CALL", "#" + f.name);
+	}
+
+	//a call in an argument would overwrite parameters already stored, all but the last go through temporaries
+	std::vector<size_t> withCalls;
+	for (size_t i = 0; i < e.args.size(); i++)
+		if (ContainsCall(*e.args[i]))
+			withCalls.push_back(i);
+
+	std::vector<std::pair<std::string, std::string>> copies;
+	for (size_t n = 0; n < withCalls.size(); n++)
+	{
+		const size_t i = withCalls[n];
+		const std::string param = f.name + "_" + f.params[i];
+		if (n + 1 == withCalls.size())
+		{
+			code.Append(Store(*e.args[i], Address(param), depth + 1));
+		}
+		else
+		{
+			const std::string temp = mFunction->name + "__c" + std::to_string(depth) + "_" + std::to_string(n);
+			mTemps.insert(temp);
+			code.Append(Store(*e.args[i], Address(temp), depth + 1));
+			copies.emplace_back(temp, param);
+		}
+	}
+	for (const auto& copy : copies)
+	{
+		code.Emit("MOV", "A", Address(copy.first));
+		code.Emit("MOV", Address(copy.second), "A");
+	}
+	for (size_t i = 0; i < e.args.size(); i++)
+		if (!ContainsCall(*e.args[i]))
+			code.Append(Store(*e.args[i], Address(f.name + "_" + f.params[i]), depth + 1));
+	return code.Emit("CALL", "#" + f.name);
+}
+
+Code Generator::Value(const Expr& e, uint8_t target, uint8_t keep, int depth)
+{
+	const auto key = std::make_tuple(&e, target, keep);
+	const auto it = mValues.find(key);
+	if (it != mValues.end())
+		return it->second;
+
+	//the value can't be left in a register being kept
+	if (target & keep)
+		return Code::Invalid();
+
+	Code best = Cheapest({DirectValue(e, target, keep, depth)}, keep);
+
+	if (keep)
+	{
+		//hold the kept registers in static temporaries while the value is computed
+		Code spill;
+		for (const auto reg : {REG_A, REG_B})
+		{
+			if (keep & reg)
+			{
+				const std::string temp = mFunction->name + "__t" + std::to_string(depth) + RegName(reg);
+				mTemps.insert(temp);
+				spill.Emit("MOV", Address(temp), RegName(reg));
+			}
+		}
+		spill.Append(Value(e, target, 0, depth));
+		for (const auto reg : {REG_A, REG_B})
+		{
+			if (keep & reg)
+				spill.Emit("MOV", RegName(reg), Address(mFunction->name + "__t" + std::to_string(depth) + RegName(reg)));
+		}
+		//the restore changes nothing kept
+		spill.clobbers &= ~keep;
+		best = Cheapest(best, spill);
+	}
+
+	mValues[key] = best;
+	return best;
+}
+
+Code Generator::DirectValue(const Expr& e, uint8_t target, uint8_t keep, int depth)
+{
+	const std::string t = RegName(target);
+
+	if (const auto folded = Fold(e))
+	{
+		if (target == REG_ALO)
+			return Code::Invalid();
+		return Code().Emit("MOV", t, Number(*folded));
+	}
+
+	switch (e.kind)
+	{
+	case Expr::NUMBER:
+		break;
+
+	case Expr::VARIABLE:
+	{
+		const Symbol& symbol = Lookup(e.name, e.line);
+		if (symbol.size != 0)
+			Error(e.line, e.name + " is an array");
+		if (target == REG_ALO)
+			return Code::Invalid();
+		return Code().Emit("MOV", t, Address(symbol.label));
+	}
+
+	case Expr::INDEX:
+	{
+		const Symbol& symbol = Lookup(e.name, e.line);
+		if (symbol.size == 0)
+			Error(e.line, e.name + " is not an array");
+		const auto i = Fold(*e.args[0]);
+		if (i && *i >= symbol.size)
+			Error(e.line, "index out of range for " + e.name);
+		if (target == REG_ALO)
+			return Code::Invalid();
+		if (i && *i == 0)
+			return Code().Emit("MOV", t, Address(symbol.label));
+
+		//base on the bus, index in B
+		Code indexInB = Value(*e.args[0], REG_B, keep, depth + 1);
+		indexInB.Emit("ADD", "#" + symbol.label);
+		indexInB.Emit("MOV", t, "[ALO]");
+
+		//index on the bus, base in B
+		Code indexInA = Value(*e.args[0], REG_A, keep, depth + 1);
+		indexInA.Emit("MOV", "B", "#" + symbol.label);
+		indexInA.Emit("ADD", "A");
+		indexInA.Emit("MOV", t, "[ALO]");
+
+		Code indexed = Value(*e.args[0], REG_B, keep, depth + 1);
+		indexed.Emit("MOV", t, Indexed(symbol.label));
+		return Cheapest({indexInB, indexInA, indexed}, keep);
+	}
+
+	case Expr::CALL:
+	{
+		const Function& f = LookupFunction(e.name, e.line);
+		if (!f.returnsValue)
+			Error(e.line, f.name + " does not return a value");
+		if (target == REG_ALO)
+			return Code::Invalid();
+		Code code = Call(e, depth);
+		if (target == REG_B)
+			code.Emit("MOV", "B", "A");
+		return code;
+	}
+
+	case Expr::UNARY:
+	{
+		Code code;
+		if (e.op == "~")
+		{
+			code = Value(*e.args[0], REG_A, keep, depth + 1);
+			code.Emit("NOT", "A");
+		}
+		else
+		{
+			//0 - x
+			code = Value(*e.args[0], REG_B, keep, depth + 1);
+			code.Emit("SUB", "0");
+		}
+		if (target != REG_ALO)
+			code.Emit("MOV", t, "ALO");
+		return code;
+	}
+
+	case Expr::BINARY:
+	{
+		const Expr& l = *e.args[0];
+		const Expr& r = *e.args[1];
+		Code code = Code::Invalid();
+		if (e.op == "<<")
+		{
+			if (r.value == 0)
+				return Value(l, target, keep, depth + 1);
+			code = Value(l, REG_A, keep, depth + 1);
+			for (unsigned n = 0; n < std::min<unsigned>(r.value, 8); n++)
+			{
+				if (n)
+					code.Emit("MOV", "A", "ALO");
+				code.Emit("SFT", "A");
+			}
+		}
+		else
+		{
+			code = Alu(e.op, l, r, e.op != "-", keep, depth);
+
+			//INC and DEC leave B alone
+			auto step = [&](const Expr& operand, const char* op)
+			{
+				Code c = Value(operand, REG_A, keep, depth + 1);
+				code = Cheapest(code, c.Emit(op, "A"), keep);
+			};
+			if (e.op == "+" && (IsNumber(r, 1) || IsNumber(l, 1)))
+				step(IsNumber(r, 1) ? l : r, "INC");
+			else if (e.op == "+" && (IsNumber(r, 255) || IsNumber(l, 255)))
+				step(IsNumber(r, 255) ? l : r, "DEC");
+			else if (e.op == "-" && IsNumber(r, 1))
+				step(l, "DEC");
+			else if (e.op == "-" && IsNumber(r, 255))
+				step(l, "INC");
+		}
+		if (code.valid && target != REG_ALO)
+			code.Emit("MOV", t, "ALO");
+		return code;
+	}
+	}
+	return Code::Invalid();
+}
+
+Code Generator::Alu(const std::string& op, const Expr& l, const Expr& r, bool commutative, uint8_t keep, int depth)
+{
+	const std::string alu = AluOp(op);
+	Code best = Code::Invalid();
+
+	auto consider = [&](const Expr& bus, const Expr& b)
+	{
+		//immediate on the bus
+		if (const auto folded = Fold(bus))
+		{
+			Code c = Value(b, REG_B, keep, depth + 1);
+			best = Cheapest(best, c.Emit(alu, Number(*folded)), keep);
+			return;
+		}
+
+		//variable read onto the bus from its address
+		if (bus.kind == Expr::VARIABLE && Lookup(bus.name, bus.line).size == 0)
+		{
+			Code c = Value(b, REG_B, keep, depth + 1);
+			best = Cheapest(best, c.Emit(alu, Address(Lookup(bus.name, bus.line).label)), keep);
+		}
+
+		Code busFirst = Value(bus, REG_A, keep, depth + 1);
+		busFirst.Append(Value(b, REG_B, keep | REG_A, depth + 1));
+		busFirst.Emit(alu, "A");
+
+		Code bFirst = Value(b, REG_B, keep, depth + 1);
+		bFirst.Append(Value(bus, REG_A, keep | REG_B, depth + 1));
+		bFirst.Emit(alu, "A");
+		best = Cheapest({best, busFirst, bFirst}, keep);
+	};
+
+	consider(l, r);
+	if (commutative)
+		consider(r, l);
+	return best;
+}
+
+Code Generator::NaiveValue(const Expr& e)
+{
+	Code code;
+	switch (e.kind)
+	{
+	case Expr::NUMBER:
+		code.Emit("MOV", "A", Number(e.value));
+		break;
+
+	case Expr::VARIABLE:
+	{
+		const Symbol& symbol = Lookup(e.name, e.line);
+		if (symbol.size != 0)
+			Error(e.line, e.name + " is an array");
+		code.Emit("MOV", "A", Address(symbol.label));
+		break;
+	}
+
+	case Expr::INDEX:
+	{
+		const Symbol& symbol = Lookup(e.name, e.line);
+		if (symbol.size == 0)
+			Error(e.line, e.name + " is not an array");
+		code.Append(NaiveValue(*e.args[0]));
+		code.Emit("MOV", "B", "A");
+		code.Emit("MOV", "A", "#" + symbol.label);
+		code.Emit("ADD", "A");
+		code.Emit("MOV", "A", "[ALO]");
+		break;
+	}
+
+	case Expr::CALL:
+		if (!LookupFunction(e.name, e.line).returnsValue)
+			Error(e.line, e.name + " does not return a value");
+		code.Append(Call(e));
+		break;
+
+	case Expr::UNARY:
+		code.Append(NaiveValue(*e.args[0]));
+		if (e.op == "~")
+		{
+			code.Emit("NOT", "A");
+		}
+		else
+		{
+			code.Emit("MOV", "B", "A");
+			code.Emit("SUB", "0");
+		}
+		code.Emit("MOV", "A", "ALO");
+		break;
+
+	case Expr::BINARY:
+		code.Append(NaiveValue(*e.args[0]));
+		if (e.op == "<<")
+		{
+			for (unsigned n = 0; n < std::min<unsigned>(e.args[1]->value, 8); n++)
+			{
+				code.Emit("SFT", "A");
+				code.Emit("MOV", "A", "ALO");
+			}
+			break;
+		}
+		code.Emit("PUSH", "A");
+		code.Append(NaiveValue(*e.args[1]));
+		code.Emit("MOV", "B", "A");
+		code.Emit("POP", "A");
+		code.Emit(AluOp(e.op), "A");
+		code.Emit("MOV", "A", "ALO");
+		break;
+	}
+	return code;
+}
+
+}
+
+Compiler::Compiler(const CompilerOptions& options)
+:	mOptions(options)
+{
+}
+
+std::vector<SourceLine> Compiler::Compile(const std::string& source) const
+{
+	const Unit unit = Parser(source).Parse();
+	return Generator(unit, mOptions).Generate();
+}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <asm/source_line.h>
+
+#include <string>
+#include <vector>
+
+namespace Cpu
+{
+
+struct CompilerOptions
+{
+	//false gives a naive translation, every value through A and PUSH / POP for temporaries
+	bool optimize = true;
+};
+
+/*
+Compiles a minimal C like language, see Parser for the grammar, to source for Program.
+
+Every value is a byte. Globals, parameters and locals are static, each has a DB in the data
+after the code, so functions may not be recursive. Arguments are stored to the callee's
+parameters, CALL / RET only push the return address and a result is returned in A.
+main is placed at address 0 and halts when it returns.
+
+When optimising, each expression is costed with the microcode cycle counts over the ways
+of getting its operands onto the ALU bus and into B, immediates, memory or registers, and
+the cheapest is used. Values held in A or B are spilled to static temporaries rather than
+the stack. Loops test their condition at the bottom.
+Errors throw std::runtime_error.
+*/
+class Compiler
+{
+public:
+	explicit Compiler(const CompilerOptions& options = {});
+
+	std::vector<SourceLine> Compile(const std::string& source) const;
+
+private:
+	CompilerOptions mOptions;
+};
+
+}
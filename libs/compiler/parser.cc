@@ -0,0 +1,423 @@
+#include "parser.h"
+
+#include <cctype>
+#include <stdexcept>
+
+namespace Cpu
+{
+
+namespace
+{
+
+std::unique_ptr<Expr> MakeBinary(const std::string& op, std::unique_ptr<Expr> lhs, std::unique_ptr<Expr> rhs)
+{
+	auto e = std::make_unique<Expr>();
+	e->kind = Expr::BINARY;
+	e->op = op;
+	e->line = lhs->line;
+	e->args.push_back(std::move(lhs));
+	e->args.push_back(std::move(rhs));
+	return e;
+}
+
+}
+
+Parser::Parser(const std::string& source)
+{
+	Tokenise(source);
+}
+
+void Parser::Tokenise(const std::string& source)
+{
+	int line = 1;
+	size_t i = 0;
+	while (i < source.size())
+	{
+		const char c = source[i];
+		if (c == '\n')
+		{
+			line++;
+			i++;
+		}
+		else if (std::isspace(static_cast<unsigned char>(c)))
+		{
+			i++;
+		}
+		else if (c == '/' && i + 1 < source.size() && source[i + 1] == '/')
+		{
+			while (i < source.size() && source[i] != '\n')
+				i++;
+		}
+		else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+		{
+			const size_t start = i;
+			while (i < source.size() && (std::isalnum(static_cast<unsigned char>(source[i])) || source[i] == '_'))
+				i++;
+			mTokens.push_back({Token::NAME, source.substr(start, i - start), 0, line});
+		}
+		else if (std::isdigit(static_cast<unsigned char>(c)))
+		{
+			size_t length = 0;
+			const unsigned value = std::stoul(source.substr(i), &length, 0);
+			mTokens.push_back({Token::NUMBER, source.substr(i, length), value, line});
+			i += length;
+		}
+		else
+		{
+			const std::string two = source.substr(i, 2);
+			if (two == "==" || two == "!=" || two == "<=" || two == ">=" || two == "<<")
+			{
+				mTokens.push_back({Token::SYMBOL, two, 0, line});
+				i += 2;
+			}
+			else
+			{
+				mTokens.push_back({Token::SYMBOL, std::string(1, c), 0, line});
+				i++;
+			}
+		}
+	}
+	mTokens.push_back({Token::END, "", 0, line});
+}
+
+const Parser::Token& Parser::Peek(size_t ahead) const
+{
+	return mTokens[std::min(mPos + ahead, mTokens.size() - 1)];
+}
+
+Parser::Token Parser::Next()
+{
+	const Token t = Peek();
+	if (t.kind != Token::END)
+		mPos++;
+	return t;
+}
+
+bool Parser::Accept(const std::string& text)
+{
+	if (Peek().kind == Token::NUMBER || Peek().text != text)
+		return false;
+	mPos++;
+	return true;
+}
+
+void Parser::Expect(const std::string& text)
+{
+	if (!Accept(text))
+		Error("expected '" + text + "'");
+}
+
+std::string Parser::ExpectName()
+{
+	if (Peek().kind != Token::NAME)
+		Error("expected a name");
+	return Next().text;
+}
+
+uint8_t Parser::ExpectNumber()
+{
+	if (Peek().kind != Token::NUMBER)
+		Error("expected a number");
+	return static_cast<uint8_t>(Next().value);
+}
+
+void Parser::Error(const std::string& message) const
+{
+	throw std::runtime_error("line " + std::to_string(Peek().line) + ": " + message +
+		(Peek().kind == Token::END ? " at end of input" : " at '" + Peek().text + "'"));
+}
+
+Unit Parser::Parse()
+{
+	Unit unit;
+	while (Peek().kind != Token::END)
+	{
+		//byte name ( starts a function
+		if (Peek().text == "void" || Peek(2).text == "(")
+			unit.functions.push_back(ParseFunction());
+		else
+			unit.globals.push_back(ParseGlobal());
+	}
+	return unit;
+}
+
+Global Parser::ParseGlobal()
+{
+	Global g;
+	g.line = Peek().line;
+	Expect("byte");
+	g.name = ExpectName();
+	if (Accept("["))
+	{
+		g.size = ExpectNumber();
+		if (g.size == 0)
+			Error("arrays need at least one element");
+		Expect("]");
+	}
+	if (Accept("="))
+	{
+		if (Accept("{"))
+		{
+			do
+			{
+				g.init.push_back(ExpectNumber());
+			} while (Accept(","));
+			Expect("}");
+		}
+		else
+		{
+			g.init.push_back(ExpectNumber());
+		}
+		if (g.init.size() > std::max<size_t>(g.size, 1))
+			Error("too many initialisers for " + g.name);
+	}
+	Expect(";");
+	return g;
+}
+
+Function Parser::ParseFunction()
+{
+	Function f;
+	f.line = Peek().line;
+	if (!Accept("void"))
+	{
+		Expect("byte");
+		f.returnsValue = true;
+	}
+	f.name = ExpectName();
+	Expect("(");
+	if (!Accept(")"))
+	{
+		do
+		{
+			Expect("byte");
+			f.params.push_back(ExpectName());
+		} while (Accept(","));
+		Expect(")");
+	}
+	f.body = ParseBlock();
+	return f;
+}
+
+std::unique_ptr<Statement> Parser::ParseBlock()
+{
+	auto s = std::make_unique<Statement>();
+	s->kind = Statement::BLOCK;
+	s->line = Peek().line;
+	Expect("{");
+	while (!Accept("}"))
+	{
+		if (Peek().kind == Token::END)
+			Error("expected '}'");
+		s->body.push_back(ParseStatement());
+	}
+	return s;
+}
+
+std::unique_ptr<Statement> Parser::ParseStatement()
+{
+	if (Peek().text == "{")
+		return ParseBlock();
+
+	auto s = std::make_unique<Statement>();
+	s->line = Peek().line;
+
+	if (Accept("byte"))
+	{
+		s->kind = Statement::DECLARE;
+		s->name = ExpectName();
+		if (Accept("["))
+		{
+			s->size = ExpectNumber();
+			if (s->size == 0)
+				Error("arrays need at least one element");
+			Expect("]");
+		}
+		else if (Accept("="))
+		{
+			s->value = ParseExpr();
+		}
+		Expect(";");
+	}
+	else if (Accept("if"))
+	{
+		s->kind = Statement::IF;
+		Expect("(");
+		s->cond = ParseCondition();
+		Expect(")");
+		s->body.push_back(ParseStatement());
+		if (Accept("else"))
+			s->body.push_back(ParseStatement());
+	}
+	else if (Accept("while"))
+	{
+		s->kind = Statement::WHILE;
+		Expect("(");
+		s->cond = ParseCondition();
+		Expect(")");
+		s->body.push_back(ParseStatement());
+	}
+	else if (Accept("return"))
+	{
+		s->kind = Statement::RETURN;
+		if (!Accept(";"))
+		{
+			s->value = ParseExpr();
+			Expect(";");
+		}
+	}
+	else if (Accept("out"))
+	{
+		s->kind = Statement::OUT;
+		Expect("(");
+		s->value = ParseExpr();
+		Expect(")");
+		Expect(";");
+	}
+	else if (Peek().kind == Token::NAME && Peek(1).text == "(")
+	{
+		s->kind = Statement::EXPRESSION;
+		s->value = ParsePrimary();
+		Expect(";");
+	}
+	else
+	{
+		s->kind = Statement::ASSIGN;
+		s->name = ExpectName();
+		if (Accept("["))
+		{
+			s->index = ParseExpr();
+			Expect("]");
+		}
+		Expect("=");
+		s->value = ParseExpr();
+		Expect(";");
+	}
+	return s;
+}
+
+Condition Parser::ParseCondition()
+{
+	Condition c;
+	c.lhs = ParseExpr();
+	for (const char* op : {"==", "!=", "<=", ">=", "<", ">"})
+	{
+		if (Accept(op))
+		{
+			c.op = op;
+			c.rhs = ParseExpr();
+			break;
+		}
+	}
+	return c;
+}
+
+std::unique_ptr<Expr> Parser::ParseExpr()
+{
+	auto e = ParseAnd();
+	while (Peek().text == "|" || Peek().text == "^")
+	{
+		const std::string op = Next().text;
+		e = MakeBinary(op, std::move(e), ParseAnd());
+	}
+	return e;
+}
+
+std::unique_ptr<Expr> Parser::ParseAnd()
+{
+	auto e = ParseSum();
+	while (Accept("&"))
+		e = MakeBinary("&", std::move(e), ParseSum());
+	return e;
+}
+
+std::unique_ptr<Expr> Parser::ParseSum()
+{
+	auto e = ParseShift();
+	while (Peek().text == "+" || Peek().text == "-")
+	{
+		const std::string op = Next().text;
+		e = MakeBinary(op, std::move(e), ParseShift());
+	}
+	return e;
+}
+
+std::unique_ptr<Expr> Parser::ParseShift()
+{
+	auto e = ParseUnary();
+	while (Accept("<<"))
+	{
+		auto n = std::make_unique<Expr>();
+		n->line = Peek().line;
+		n->value = ExpectNumber();
+		e = MakeBinary("<<", std::move(e), std::move(n));
+	}
+	return e;
+}
+
+std::unique_ptr<Expr> Parser::ParseUnary()
+{
+	if (Peek().text == "~" || Peek().text == "-")
+	{
+		auto e = std::make_unique<Expr>();
+		e->kind = Expr::UNARY;
+		e->line = Peek().line;
+		e->op = Next().text;
+		e->args.push_back(ParseUnary());
+		return e;
+	}
+	return ParsePrimary();
+}
+
+std::unique_ptr<Expr> Parser::ParsePrimary()
+{
+	auto e = std::make_unique<Expr>();
+	e->line = Peek().line;
+
+	if (Peek().kind == Token::NUMBER)
+	{
+		e->kind = Expr::NUMBER;
+		e->value = ExpectNumber();
+	}
+	else if (Accept("("))
+	{
+		e = ParseExpr();
+		Expect(")");
+	}
+	else
+	{
+		e->name = ExpectName();
+		if (Accept("["))
+		{
+			e->kind = Expr::INDEX;
+			e->args.push_back(ParseExpr());
+			Expect("]");
+		}
+		else if (Peek().text == "(")
+		{
+			e->kind = Expr::CALL;
+			e->args = ParseArgs();
+		}
+		else
+		{
+			e->kind = Expr::VARIABLE;
+		}
+	}
+	return e;
+}
+
+std::vector<std::unique_ptr<Expr>> Parser::ParseArgs()
+{
+	std::vector<std::unique_ptr<Expr>> args;
+	Expect("(");
+	if (Accept(")"))
+		return args;
+	do
+	{
+		args.push_back(ParseExpr());
+	} while (Accept(","));
+	Expect(")");
+	return args;
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ast.h"
+
+#include <string>
+#include <vector>
+
+namespace Cpu
+{
+
+/*
+Recursive descent parser for the language compiled by Compiler
+
+unit		:= (global | function)*
+global		:= 'byte' name ('[' number ']')? ('=' (number | '{' number (',' number)* '}'))? ';'
+function	:= ('byte' | 'void') name '(' ('byte' name (',' 'byte' name)*)? ')' block
+block		:= '{' statement* '}'
+statement	:= block | 'byte' name ('[' number ']')? ('=' expr)? ';' | name ('[' expr ']')? '=' expr ';'
+			 | name '(' args ')' ';' | 'if' '(' cond ')' statement ('else' statement)?
+			 | 'while' '(' cond ')' statement | 'return' expr? ';' | 'out' '(' expr ')' ';'
+cond		:= expr (('==' | '!=' | '<' | '>' | '<=' | '>=') expr)?
+expr		:= and (('|' | '^') and)*
+and			:= sum ('&' sum)*
+sum			:= shift (('+' | '-') shift)*
+shift		:= unary ('<<' number)*
+unary		:= ('~' | '-') unary | primary
+primary		:= number | name | name '[' expr ']' | name '(' args ')' | '(' expr ')'
+
+Numbers are decimal or 0x hex and wrap to 8 bits. Errors throw std::runtime_error with the line.
+*/
+class Parser
+{
+public:
+	explicit Parser(const std::string& source);
+
+	Unit Parse();
+
+private:
+	struct Token
+	{
+		enum Kind {NAME, NUMBER, SYMBOL, END};
+		Kind kind;
+		std::string text;
+		unsigned value = 0;
+		int line = 0;
+	};
+
+	void Tokenise(const std::string& source);
+
+	const Token& Peek(size_t ahead = 0) const;
+	Token Next();
+	bool Accept(const std::string& text);
+	void Expect(const std::string& text);
+	std::string ExpectName();
+	uint8_t ExpectNumber();
+	[[noreturn]] void Error(const std::string& message) const;
+
+	Global ParseGlobal();
+	Function ParseFunction();
+	std::unique_ptr<Statement> ParseBlock();
+	std::unique_ptr<Statement> ParseStatement();
+	Condition ParseCondition();
+	std::unique_ptr<Expr> ParseExpr();
+	std::unique_ptr<Expr> ParseAnd();
+	std::unique_ptr<Expr> ParseSum();
+	std::unique_ptr<Expr> ParseShift();
+	std::unique_ptr<Expr> ParseUnary();
+	std::unique_ptr<Expr> ParsePrimary();
+	std::vector<std::unique_ptr<Expr>> ParseArgs();
+
+	std::vector<Token> mTokens;
+	size_t mPos = 0;
+};
+
+}
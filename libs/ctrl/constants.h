@@ -4,18 +4,21 @@
 
 #include <assert.h>
 
-#define EEPROM_SIZE 8191
+#define EEPROM_SIZE 16383
 
 /*
 EEPROM Output
-8bit Control word, 8 bits each for ROM0, ROM1, ROM2, ROM3
+32bit Control word, 8 bits each for ROM0, ROM1, ROM2, ROM3
 			7	6	5	4	3	2	1	0		7	6	5	4	3	2	1	0
 bit:		31	30	29	28	27	26	25	24		23	22	21	20	19	18	17	16
 meaning:	MAW	MW	ME	RAW	RAE	RBW	RBE	IRW		PCW	PCC	PCE	MCR	HLT	SPE	SPW	OUTW
 
 			7	6	5	4	3	2	1	0		7	6	5	4	3	2	1	0
 bit:		15	14	13	12	11	10	9	8		7	6	5	4	3	2	1	0
-meaning:	AS3	AS2	AS1	AS0	ACR	AMD	ALE	ALW		--	--	--	--	--	--	--	--
+meaning:	AS3	AS2	AS1	AS0	ACR	AMD	ALE	ALW		IES	IEC	INA	AFX	--	--	--	--
+
+ROM3 drives the interrupt enable flip flop, acknowledge and the second ALO and flags registers,
+its signals are active high
 */
 
 #define MAW	((uint32_t)1 << 31) //Mem Address Write
@@ -45,6 +48,11 @@ meaning:	AS3	AS2	AS1	AS0	ACR	AMD	ALE	ALW		--	--	--	--	--	--	--	--
 #define ALE ((uint32_t)1 << 9)  //ALU Out Enable
 #define ALW ((uint32_t)1 << 8)	//ALU Write
 
+#define IES ((uint32_t)1 << 7) //Interrupt Enable Set
+#define IEC ((uint32_t)1 << 6) //Interrupt Enable Clear
+#define INA ((uint32_t)1 << 5) //Interrupt Acknowledge, clears the request and CND_INT
+#define AFX ((uint32_t)1 << 4) //ALO and Flags eXchange, swaps them with the second pair after any ALU write
+
 //First two cycles common to all instructions
 #define FETCH0 (MAW | PCE)		//Program counter to memory address register
 #define FETCH1 (ME | IRW | PCC) //Memory to instruction register, increment program counter 
@@ -59,9 +67,15 @@ inline uint32_t flip_active_low_signals(uint32_t ctrl_word)
 
 /*
 EEPROM Input
-13 address lines
-bit:		12	11	10	9	8	7	6	5	4	3	2	1	0
-meaning:	MC	MC	MC	CR	JMP	<---- instruction code  ---->		
+14 address lines
+bit:		13	12	11	10	9	8	7	6	5	4	3	2	1	0
+meaning:	INT	MC	MC	MC	CR	JMP	<---- instruction code  ---->		
+
+INT is an interrupt request with interrupts enabled, latched as the micro counter resets so it
+only changes at the start of an instruction. With it set step 0 loads the undriven bus into the
+instruction register and swaps ALO and the flags for the second pair, then instruction 0 with
+INT set pushes PC, clears the enable, acknowledges the request and jumps to INT_VECTOR. RETI
+swaps them back as it finishes.
 */
 
 //Micro Counter steps
@@ -77,6 +91,10 @@ meaning:	MC	MC	MC	CR	JMP	<---- instruction code  ---->
 //Conditional inputs
 #define CND_JMP ((uint16_t)1 << 8)	//Jump
 #define CND_CR ((uint16_t)1 << 9)	//Carry
+#define CND_INT ((uint16_t)1 << 13)	//Interrupt
+
+//Where an interrupt jumps to, after a two byte jump at reset
+#define INT_VECTOR 2
 
 inline bool condition_set(uint16_t cond, uint16_t addr)
 {
@@ -91,7 +109,7 @@ inline uint16_t add_condition(uint16_t cond, uint16_t addr)
 //return step number from eeprom address
 inline uint8_t step_no(uint16_t addr)
 {
-	return addr >> 10;
+	return (addr >> 10) & 7;
 }
 
 inline uint16_t make_address(uint16_t mc_step, uint8_t instruction)
@@ -151,29 +169,34 @@ ALU Commands
 INC		L	L	L	L	L	L
 DEC		H	H	H	H	L	H
 ADD		H	L	L	H	L	H
-ADD CR	H	L	L	H	L	L
+ADC		H	L	L	H	L	CF
 SUB		L	H	H	L	L	L
-SUB CR	L	H	H	L	L	H
+SBC		L	H	H	L	L	CF
 SHIFT	H	H	L	L	L	H
+SFC		H	H	L	L	L	CF
 CMP		L	H	H	L	L	H
 NOT		L	L	L	L	H	X
 AND		H	L	H	H	H	X
 OR		H	H	H	L	H	X
 XOR		L	H	H	L	H	X
+
+CF: carry in from the latched carry flag, the microcode has a word for each CND_CR input.
+C is active low, so L is a carry in. SUB and SBC leave the carry set when nothing was borrowed.
 */
 
 #define ALU_INC ((uint8_t) 0)	//Inc Bus
 #define ALU_DEC ((uint8_t) 1)	//Dec Bus
 #define ALU_ADD ((uint8_t) 2)	//Bus + B Register
-#define ALU_ADC ((uint8_t) 3)	//Bus + B Register + 1
+#define ALU_ADC ((uint8_t) 3)	//Bus + B Register + Carry
 #define ALU_SUB ((uint8_t) 4)	//Bus - B Register
-#define ALU_SBC ((uint8_t) 5)	//Bus - B Register - 1
+#define ALU_SBC ((uint8_t) 5)	//Bus - B Register - !Carry
 #define ALU_SFT ((uint8_t) 6)	//Shift Bus Left
 #define ALU_CMP ((uint8_t) 7)	//Compare Bus to B Register
 #define ALU_NOT ((uint8_t) 8)	//!Bus
 #define ALU_AND ((uint8_t) 9)	//Bus & xB Register
 #define ALU_OR  ((uint8_t) 10)	//Bus | B Register
 #define ALU_XOR ((uint8_t) 11)	//Bus ^ B Register
+#define ALU_SFC ((uint8_t) 12)	//Shift Bus Left, Carry into bit 0
 
 inline const char* alu_op_name(uint8_t aluOp)
 {
@@ -203,6 +226,8 @@ inline const char* alu_op_name(uint8_t aluOp)
 		return "OR";
 	case(ALU_XOR):
 		return "XOR";
+	case(ALU_SFC):
+		return "SFC";
 	}
 	return "";
 }
@@ -236,11 +261,26 @@ inline uint32_t alu_ctrl(uint8_t aluOp)
 		return ((uint32_t)AMD | AS3 | AS2 | AS1 | ALW);
 	case(ALU_XOR): 
 		return ((uint32_t)AMD | AS2 | AS1 | ALW);
+	case(ALU_SFC):
+		return ((uint32_t)AS3 | AS2 | ALW);
 	}
 	assert(false);
 	return 0;
 }
 
+//ADC, SBC and SFC chain multi-byte arithmetic, they take the carry in from the carry flag
+inline bool alu_uses_carry(uint8_t aluOp)
+{
+	return aluOp == ALU_ADC || aluOp == ALU_SBC || aluOp == ALU_SFC;
+}
+
+//The control signals for aluOp with carry in set or not
+inline uint32_t alu_ctrl(uint8_t aluOp, bool carry)
+{
+	const uint32_t ctrl = alu_ctrl(aluOp) & ~ACR;
+	return carry ? ctrl : ctrl | ACR;
+}
+
 #define INSTR_CALL		0xC0
 #define INSTR_JZ		0xC8
 #define INSTR_JE		0xD0
@@ -252,6 +292,10 @@ inline uint32_t alu_ctrl(uint8_t aluOp)
 #define INSTR_HALT		0xF9
 #define INSTR_RET		0xFA
 #define INSTR_NOOP		0xFB
+#define INSTR_FILL		0xFC
+#define INSTR_EI		0xFD
+#define INSTR_DI		0xFE
+#define INSTR_RETI		0xFF
 /*
 instruction encoding
 bit:				7	6	5	4	3	2	1	0
@@ -269,9 +313,15 @@ ancillary insts:	1	1	X	X	X	X	X	X
 	Halt:			1	1	1	1	1	0	0	1		0xF9
 	Ret:			1	1	1	1	1	0	1	0		0xFA
 	No op:			1	1	1	1	1	0	1	1		0xFB
+	Fill:			1	1	1	1	1	1	0	0		0xFC
+	EI:				1	1	1	1	1	1	0	1		0xFD
+	DI:				1	1	1	1	1	1	1	0		0xFE
+	Reti:			1	1	1	1	1	1	1	1		0xFF
 	
 * Jmp instructions allow a register or an immediate address
 * Immediate values are loaded by dereferencing the program counter
+* Fill writes A to [ALO] up to but not including [B], looping in microcode
+* Reti is Ret setting the interrupt enable
 
 Source register encoding
 reg		value
@@ -295,6 +345,13 @@ reg		value
 [ALO]	4
 OUT		5
 [[PC]]	6	(Write to an immediate address)
+[[PC]+B]	7	(Indexed, see below)
+
+Indexed instructions use destination 7, the source bits give the register, dereferenced to load
+	MOV [42+B], A	1	0	1	1	1	0	0	0		0xB8
+	MOV A, [42+B]	1	0	1	1	1	0	0	1		0xB9
+	MOV B, [42+B]	1	0	1	1	1	0	1	1		0xBB
+* The immediate is added to B in the ALU, ALO and the flags are changed
 
 */
 
@@ -377,6 +434,14 @@ inline uint8_t make_mov_instruction_code(uint8_t dest_reg, uint8_t src_reg)
 	return 128 | (dest_reg << 3) | src_reg;
 }
 
+#define INSTR_INDEXED	0xB8
+
+//load into reg from, or store reg to, an immediate address + B
+inline uint8_t make_indexed_instruction_code(uint8_t reg, bool load)
+{
+	return INSTR_INDEXED | encode_source_reg(reg, load);
+}
+
 /*
 ALU Instruction encoding
 
@@ -1,27 +1,38 @@
 #include "constants.h"
+#include "microcode.h"
 #include <iostream>
 #include <map>
 
-std::map<uint16_t, uint32_t> eeprom_values;
+namespace {
+//Instruction listing printed while generating, only enabled by generate_eeproms()
+std::ostream null_stream(nullptr);
+std::ostream* listing_stream = &null_stream;
+}
+
+std::ostream& listing()
+{
+	return *listing_stream;
+}
 
 void print_mov_instruction(uint8_t instr, const char* arg1, const char* arg2, const char* comment)
 {
-	std::cout << unsigned(instr) << "\t\tMOV " << arg1 << ", " << arg2 << "\t\t;" << comment << std::endl;
+	listing() << unsigned(instr) << "\t\tMOV " << arg1 << ", " << arg2 << "\t\t;" << comment << std::endl;
 }
 
 //MOV [address],SRC
 //eg MOV [12], A
-void make_store_immediate_instr(uint8_t source_reg)
+void make_store_immediate_instr(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t source_reg)
 {
 	uint8_t instr = make_mov_instruction_code(encode_dest_reg(R_PC, true), encode_source_reg(source_reg, false));
 	eeprom_values[make_address(MC_STEP2, instr)] = MAW | reg_read(R_PC); //program counter to address reg
-	eeprom_values[make_address(MC_STEP3, instr)] = reg_read(source_reg) | MW | PCC | MCR; //source_reg to mem, pcc
+	eeprom_values[make_address(MC_STEP3, instr)] = ME | MAW | PCC; //memory to address reg, PCC
+	eeprom_values[make_address(MC_STEP4, instr)] = reg_read(source_reg) | MW | MCR; //source_reg to mem
 	print_mov_instruction(instr, "[42]", source_reg_name(source_reg, false), "Move to litteral address");
 }
 
 //MOV DEST, [address]
 //eg MOV A, [12]
-void make_load_immediate_addr_instr(uint8_t dest_reg)
+void make_load_immediate_addr_instr(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t dest_reg)
 {
 	uint8_t instr = make_mov_instruction_code(encode_dest_reg(dest_reg, false), encode_source_reg(R_PC, true));
 	eeprom_values[make_address(MC_STEP2, instr)] = MAW | reg_read(R_PC); //program counter to address reg
@@ -32,7 +43,7 @@ void make_load_immediate_addr_instr(uint8_t dest_reg)
 
 //MOV DEST, immediate
 //eg MOV A, 12
-void make_load_immediate_instr(uint8_t dest_reg)
+void make_load_immediate_instr(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t dest_reg)
 {
 	uint8_t instr = make_mov_instruction_code(encode_dest_reg(dest_reg, false), encode_source_reg(R_PC, false));
 	eeprom_values[make_address(MC_STEP2, instr)] = MAW | reg_read(R_PC); //program counter to address reg
@@ -40,7 +51,7 @@ void make_load_immediate_instr(uint8_t dest_reg)
 	print_mov_instruction(instr, dest_reg_name(dest_reg, false), "42", "Move litteral");
 }
 
-void make_reg_reg_mov_instr(uint8_t src_reg, bool deref_src, uint8_t dest_reg, bool deref_dest)
+void make_reg_reg_mov_instr(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t src_reg, bool deref_src, uint8_t dest_reg, bool deref_dest)
 {
 	assert(!(deref_dest && deref_src));
 	uint8_t instr = make_mov_instruction_code(encode_dest_reg(dest_reg, deref_dest), encode_source_reg(src_reg, deref_src));
@@ -67,71 +78,125 @@ void make_reg_reg_mov_instr(uint8_t src_reg, bool deref_src, uint8_t dest_reg, b
 	}
 }
 
-void make_mov_instructions()
+//MOV DEST, [address + B]
+//eg MOV A, [12+B]
+void make_load_indexed_instr(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t dest_reg)
+{
+	uint8_t instr = make_indexed_instruction_code(dest_reg, true);
+	eeprom_values[make_address(MC_STEP2, instr)] = MAW | reg_read(R_PC); //program counter to address reg
+	eeprom_values[make_address(MC_STEP3, instr)] = ME | alu_ctrl(ALU_ADD) | PCC; //address + B, PCC
+	eeprom_values[make_address(MC_STEP4, instr)] = reg_read(R_ALO) | MAW; //ALO to address reg
+	eeprom_values[make_address(MC_STEP5, instr)] = reg_write(dest_reg) | ME | MCR; //memory to dest_reg
+	print_mov_instruction(instr, dest_reg_name(dest_reg, false), "[42+B]", "Move from indexed address");
+}
+
+//MOV [address + B], SRC
+//eg MOV [12+B], A
+void make_store_indexed_instr(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t source_reg)
+{
+	uint8_t instr = make_indexed_instruction_code(source_reg, false);
+	eeprom_values[make_address(MC_STEP2, instr)] = MAW | reg_read(R_PC); //program counter to address reg
+	eeprom_values[make_address(MC_STEP3, instr)] = ME | alu_ctrl(ALU_ADD) | PCC; //address + B, PCC
+	eeprom_values[make_address(MC_STEP4, instr)] = reg_read(R_ALO) | MAW; //ALO to address reg
+	eeprom_values[make_address(MC_STEP5, instr)] = reg_read(source_reg) | MW | MCR; //source_reg to mem
+	print_mov_instruction(instr, "[42+B]", source_reg_name(source_reg, false), "Move to indexed address");
+}
+
+void make_mov_instructions(std::map<uint16_t, uint32_t>& eeprom_values, const MicrocodeOptions& options)
 {
 	//From A
-	make_reg_reg_mov_instr(R_A, false, R_B, false);		//A to B
-	make_reg_reg_mov_instr(R_A, true, R_B, false);		//[A] to B
-	make_reg_reg_mov_instr(R_A, false, R_B, true);		//A to [B]
-	make_reg_reg_mov_instr(R_A, false, R_ALO, true);	//A to [ALO]
-	make_reg_reg_mov_instr(R_A, false, R_OUT, false);	//A to OUT
-	make_reg_reg_mov_instr(R_A, true, R_OUT, false);	//[A] to out	
-	make_store_immediate_instr(R_A);					//A to [[PC]] (write to immediate addr) MOV [42], A
+	make_reg_reg_mov_instr(eeprom_values, R_A, false, R_B, false);		//A to B
+	make_reg_reg_mov_instr(eeprom_values, R_A, true, R_B, false);		//[A] to B
+	make_reg_reg_mov_instr(eeprom_values, R_A, false, R_B, true);		//A to [B]
+	make_reg_reg_mov_instr(eeprom_values, R_A, false, R_ALO, true);	//A to [ALO]
+	make_reg_reg_mov_instr(eeprom_values, R_A, false, R_OUT, false);	//A to OUT
+	make_reg_reg_mov_instr(eeprom_values, R_A, true, R_OUT, false);	//[A] to out	
+	make_store_immediate_instr(eeprom_values, R_A);					//A to [[PC]] (write to immediate addr) MOV [42], A
 	
 	//From B
-	make_reg_reg_mov_instr(R_B, false, R_A, false);		//B to A
-	make_reg_reg_mov_instr(R_B, true, R_A, false);		//[B] to A
-	make_reg_reg_mov_instr(R_B, false, R_A, true);		//B to [A]
-	make_reg_reg_mov_instr(R_B, false, R_ALO, true);	//B to [ALO]
-	make_reg_reg_mov_instr(R_B, false, R_OUT, false);	//B to OUT
-	make_reg_reg_mov_instr(R_B, true, R_OUT, false);	//[B] to out
-	make_store_immediate_instr(R_B);					//B to [[PC]] (write to immediate addr)
+	make_reg_reg_mov_instr(eeprom_values, R_B, false, R_A, false);		//B to A
+	make_reg_reg_mov_instr(eeprom_values, R_B, true, R_A, false);		//[B] to A
+	make_reg_reg_mov_instr(eeprom_values, R_B, false, R_A, true);		//B to [A]
+	make_reg_reg_mov_instr(eeprom_values, R_B, false, R_ALO, true);	//B to [ALO]
+	make_reg_reg_mov_instr(eeprom_values, R_B, false, R_OUT, false);	//B to OUT
+	make_reg_reg_mov_instr(eeprom_values, R_B, true, R_OUT, false);	//[B] to out
+	make_store_immediate_instr(eeprom_values, R_B);					//B to [[PC]] (write to immediate addr)
 
     //From ALO
-	make_reg_reg_mov_instr(R_ALO, false, R_A, false);	//ALO to A
-	make_reg_reg_mov_instr(R_ALO, true, R_A, false);	//[ALO] to A
-	make_reg_reg_mov_instr(R_ALO, false, R_A, true);	//ALO to [A]
-	make_reg_reg_mov_instr(R_ALO, false, R_B, false);	//ALO to B
-	make_reg_reg_mov_instr(R_ALO, true, R_B, false);	//[ALO] to B
-	make_reg_reg_mov_instr(R_ALO, false, R_B, true);	//ALO to [B]
-	make_reg_reg_mov_instr(R_ALO, false, R_OUT, false);	//ALO to OUT
-	make_reg_reg_mov_instr(R_ALO, true, R_OUT, false);	//[ALO] to out
-	make_store_immediate_instr(R_ALO);					//ALO to [[PC]] write to immediate addr
+	make_reg_reg_mov_instr(eeprom_values, R_ALO, false, R_A, false);	//ALO to A
+	make_reg_reg_mov_instr(eeprom_values, R_ALO, true, R_A, false);	//[ALO] to A
+	make_reg_reg_mov_instr(eeprom_values, R_ALO, false, R_A, true);	//ALO to [A]
+	make_reg_reg_mov_instr(eeprom_values, R_ALO, false, R_B, false);	//ALO to B
+	make_reg_reg_mov_instr(eeprom_values, R_ALO, true, R_B, false);	//[ALO] to B
+	make_reg_reg_mov_instr(eeprom_values, R_ALO, false, R_B, true);	//ALO to [B]
+	make_reg_reg_mov_instr(eeprom_values, R_ALO, false, R_OUT, false);	//ALO to OUT
+	make_reg_reg_mov_instr(eeprom_values, R_ALO, true, R_OUT, false);	//[ALO] to out
+	make_store_immediate_instr(eeprom_values, R_ALO);					//ALO to [[PC]] write to immediate addr
 
 	//Load immediate (eg mov a, 42)
-	make_load_immediate_instr(R_A);
-	make_load_immediate_instr(R_B);
-	make_load_immediate_instr(R_OUT);
+	make_load_immediate_instr(eeprom_values, R_A);
+	make_load_immediate_instr(eeprom_values, R_B);
+	make_load_immediate_instr(eeprom_values, R_OUT);
 
 	//Load from immediate address (eg mov a, [42])
-	make_load_immediate_addr_instr(R_A);
-	make_load_immediate_addr_instr(R_B);
-	make_load_immediate_addr_instr(R_OUT);
+	make_load_immediate_addr_instr(eeprom_values, R_A);
+	make_load_immediate_addr_instr(eeprom_values, R_B);
+	make_load_immediate_addr_instr(eeprom_values, R_OUT);
+
+	//Indexed by B (eg mov a, [42+B]), the address is added up in the ALU
+	if (options.indexed)
+	{
+		make_load_indexed_instr(eeprom_values, R_A);
+		make_load_indexed_instr(eeprom_values, R_B);
+		make_store_indexed_instr(eeprom_values, R_A);
+	}
 }
 
-void make_alu_instructions()
+//An ALU step, ctrl plus the operation. Operations using the carry get a word for each CND_CR
+//input, the other conditions are filled in by make_jmp_instructions
+void make_alu_step(std::map<uint16_t, uint32_t>& eeprom_values, uint16_t addr, uint8_t aluOp, uint32_t ctrl)
+{
+	if (!alu_uses_carry(aluOp))
+	{
+		eeprom_values[addr] = ctrl | alu_ctrl(aluOp);
+		return;
+	}
+	for (const uint16_t jmp : {uint16_t(0), uint16_t(CND_JMP)})
+	{
+		eeprom_values[addr | jmp] = ctrl | alu_ctrl(aluOp, false);
+		eeprom_values[addr | jmp | CND_CR] = ctrl | alu_ctrl(aluOp, true);
+	}
+}
+
+void make_alu_instructions(std::map<uint16_t, uint32_t>& eeprom_values, const MicrocodeOptions& options)
 {
 	uint8_t instr;
-	for (uint8_t aluOp = ALU_INC; aluOp <= ALU_XOR; aluOp++)
+	for (uint8_t aluOp = ALU_INC; aluOp <= ALU_SFC; aluOp++)
 	{
 		const char* opName = alu_op_name(aluOp);
 		//eg ADD a
 		instr = make_alu_instruction_code(aluOp, encode_source_reg(R_A, false));
-		eeprom_values[make_address(MC_STEP2, instr)] = reg_read(R_A) | alu_ctrl(aluOp) | MCR; //Reg A, operation
-		std::cout << unsigned(instr) << "\t\t" << opName << " A" << std::endl;
+		make_alu_step(eeprom_values, make_address(MC_STEP2, instr), aluOp, reg_read(R_A) | MCR); //Reg A, operation
+		listing() << unsigned(instr) << "\t\t" << opName << " A" << std::endl;
 		//eg ADD [a]
 		instr = make_alu_instruction_code(aluOp, encode_source_reg(R_A, true));
 		eeprom_values[make_address(MC_STEP2, instr)] = reg_read(R_A) | MAW;	//Reg to to address
-		eeprom_values[make_address(MC_STEP3, instr)] = ME | alu_ctrl(aluOp) | MCR; //Mem, operation
-		std::cout << unsigned(instr) << "\t\t" << alu_op_name(aluOp) << " [A]" << std::endl;
+		make_alu_step(eeprom_values, make_address(MC_STEP3, instr), aluOp, ME | MCR); //Mem, operation
+		listing() << unsigned(instr) << "\t\t" << alu_op_name(aluOp) << " [A]" << std::endl;
 		//Eg ADD 12
 		instr = make_alu_instruction_code(aluOp, encode_source_reg(R_PC, false));
 		eeprom_values[make_address(MC_STEP2, instr)] = reg_read(R_PC) | MAW;	//PC to to address
-		eeprom_values[make_address(MC_STEP3, instr)] = ME | alu_ctrl(aluOp) | PCC | MCR; //Mem, operation
-		std::cout << unsigned(instr) << "\t\t" << alu_op_name(aluOp) << " 42" << std::endl;
+		make_alu_step(eeprom_values, make_address(MC_STEP3, instr), aluOp, ME | PCC | MCR); //Mem, operation
+		listing() << unsigned(instr) << "\t\t" << alu_op_name(aluOp) << " 42" << std::endl;
 
+		if (!options.aluMemory)
+			continue;
 		//Eg ADD [12]
-		//todo
+		instr = make_alu_instruction_code(aluOp, encode_source_reg(R_PC, true));
+		eeprom_values[make_address(MC_STEP2, instr)] = reg_read(R_PC) | MAW;	//PC to to address
+		eeprom_values[make_address(MC_STEP3, instr)] = ME | MAW | PCC; //memory to address reg, PCC
+		make_alu_step(eeprom_values, make_address(MC_STEP4, instr), aluOp, ME | MCR); //Mem, operation
+		listing() << unsigned(instr) << "\t\t" << alu_op_name(aluOp) << " [42]" << std::endl;
 	}		
 }
 
@@ -160,32 +225,32 @@ inline const char* jump_instr_name(uint8_t instr)
 }
 
 //Non-conditional jmp
-void make_reg_jmp_instr(uint8_t jmp, uint8_t src_reg)
+void make_reg_jmp_instr(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t jmp, uint8_t src_reg)
 {
 	uint8_t instr = make_ancillory_instruction_code(jmp, encode_source_reg(src_reg, false));
 	eeprom_values[make_address(MC_STEP2, instr)] = reg_read(src_reg) | reg_write(R_PC) | MCR;	//Reg to PC
-	std::cout << unsigned(instr) << "\t\t" << jump_instr_name(jmp) << " " << source_reg_name(src_reg, false) << std::endl;
+	listing() << unsigned(instr) << "\t\t" << jump_instr_name(jmp) << " " << source_reg_name(src_reg, false) << std::endl;
 }
 
-void make_immediate_jmp_instr(uint8_t jmp)
+void make_immediate_jmp_instr(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t jmp)
 {
 	uint8_t instr = make_ancillory_instruction_code(jmp, encode_source_reg(R_PC, false));
 	eeprom_values[make_address(MC_STEP2, instr)] = reg_read(R_PC) | MAW;	//PC to to address
 	eeprom_values[make_address(MC_STEP3, instr)] = ME | reg_write(R_PC) | MCR; //Mem to PC
-	std::cout << unsigned(instr) << "\t\t" << jump_instr_name(jmp) << " [address]" << std::endl;
+	listing() << unsigned(instr) << "\t\t" << jump_instr_name(jmp) << " [address]" << std::endl;
 }
 
-void make_cond_reg_jmp_instr(uint8_t jmp, uint8_t src_reg, uint16_t cond)
+void make_cond_reg_jmp_instr(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t jmp, uint8_t src_reg, uint16_t cond)
 {
 	uint8_t instr = make_ancillory_instruction_code(jmp, encode_source_reg(src_reg, false));
 	eeprom_values[make_address(MC_STEP2, instr) | cond] = reg_read(src_reg) | reg_write(R_PC) | MCR;	//Reg to PC
 	//cond can be CND_JMP or CND_CR, in either case the condition should still be true if both are set
 	eeprom_values[make_address(MC_STEP2, instr) | CND_CR | CND_JMP] = eeprom_values[make_address(MC_STEP2, instr) | cond];
 
-	std::cout << unsigned(instr) << "\t\t" << jump_instr_name(jmp) << " " << source_reg_name(src_reg, false) << std::endl;
+	listing() << unsigned(instr) << "\t\t" << jump_instr_name(jmp) << " " << source_reg_name(src_reg, false) << std::endl;
 }
 
-void make_cond_immediate_jmp_instr(uint8_t jmp, uint16_t cond)
+void make_cond_immediate_jmp_instr(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t jmp, uint16_t cond)
 {
 	uint16_t opposite_cond = cond == CND_CR ? CND_JMP : CND_CR;
 	uint8_t instr = make_ancillory_instruction_code(jmp, encode_source_reg(R_PC, false));
@@ -197,18 +262,18 @@ void make_cond_immediate_jmp_instr(uint8_t jmp, uint16_t cond)
 	//if no condition, or just the opposite condition, increment the PCC to skip the param
 	eeprom_values[make_address(MC_STEP2, instr) | opposite_cond] = PCC | MCR;
 	eeprom_values[make_address(MC_STEP3, instr)] = PCC | MCR;
-	std::cout << unsigned(instr) << "\t\t" << jump_instr_name(instr) << " [address]" << std::endl;
+	listing() << unsigned(instr) << "\t\t" << jump_instr_name(instr) << " [address]" << std::endl;
 }
 
-void make_jmp_instructions()
+void make_jmp_instructions(std::map<uint16_t, uint32_t>& eeprom_values)
 {
 	uint8_t jmp = INSTR_JMP;
 
 	//Non-conditional jmp
-	make_reg_jmp_instr(INSTR_JMP, R_A);
-	make_reg_jmp_instr(INSTR_JMP, R_B);
-	make_reg_jmp_instr(INSTR_JMP, R_ALO);
-	make_immediate_jmp_instr(INSTR_JMP);
+	make_reg_jmp_instr(eeprom_values, INSTR_JMP, R_A);
+	make_reg_jmp_instr(eeprom_values, INSTR_JMP, R_B);
+	make_reg_jmp_instr(eeprom_values, INSTR_JMP, R_ALO);
+	make_immediate_jmp_instr(eeprom_values, INSTR_JMP);
 
 	//For each existing non-conditional operation make equivilent versions for each condition
 	std::map<uint16_t, uint32_t> insert;
@@ -222,31 +287,31 @@ void make_jmp_instructions()
 
 	//Conditional jumps
 	//JZ
-	make_cond_reg_jmp_instr(INSTR_JZ, R_A, CND_JMP);
-	make_cond_reg_jmp_instr(INSTR_JZ, R_B, CND_JMP);
-	make_cond_reg_jmp_instr(INSTR_JZ, R_ALO, CND_JMP);
-	make_cond_immediate_jmp_instr(INSTR_JZ, CND_JMP);
+	make_cond_reg_jmp_instr(eeprom_values, INSTR_JZ, R_A, CND_JMP);
+	make_cond_reg_jmp_instr(eeprom_values, INSTR_JZ, R_B, CND_JMP);
+	make_cond_reg_jmp_instr(eeprom_values, INSTR_JZ, R_ALO, CND_JMP);
+	make_cond_immediate_jmp_instr(eeprom_values, INSTR_JZ, CND_JMP);
 
 	//JE
-	make_cond_reg_jmp_instr(INSTR_JE, R_A, CND_JMP);
-	make_cond_reg_jmp_instr(INSTR_JE, R_B, CND_JMP);
-	make_cond_reg_jmp_instr(INSTR_JE, R_ALO, CND_JMP);
-	make_cond_immediate_jmp_instr(INSTR_JE, CND_JMP);
+	make_cond_reg_jmp_instr(eeprom_values, INSTR_JE, R_A, CND_JMP);
+	make_cond_reg_jmp_instr(eeprom_values, INSTR_JE, R_B, CND_JMP);
+	make_cond_reg_jmp_instr(eeprom_values, INSTR_JE, R_ALO, CND_JMP);
+	make_cond_immediate_jmp_instr(eeprom_values, INSTR_JE, CND_JMP);
 
 	//JN
-	make_cond_reg_jmp_instr(INSTR_JN, R_A, CND_JMP);
-	make_cond_reg_jmp_instr(INSTR_JN, R_B, CND_JMP);
-	make_cond_reg_jmp_instr(INSTR_JN, R_ALO, CND_JMP);
-	make_cond_immediate_jmp_instr(INSTR_JN, CND_JMP);
+	make_cond_reg_jmp_instr(eeprom_values, INSTR_JN, R_A, CND_JMP);
+	make_cond_reg_jmp_instr(eeprom_values, INSTR_JN, R_B, CND_JMP);
+	make_cond_reg_jmp_instr(eeprom_values, INSTR_JN, R_ALO, CND_JMP);
+	make_cond_immediate_jmp_instr(eeprom_values, INSTR_JN, CND_JMP);
 
 	//JC
-	make_cond_reg_jmp_instr(INSTR_JC, R_A, CND_CR);
-	make_cond_reg_jmp_instr(INSTR_JC, R_B, CND_CR);
-	make_cond_reg_jmp_instr(INSTR_JC, R_ALO, CND_CR);
-	make_cond_immediate_jmp_instr(INSTR_JC, CND_CR);
+	make_cond_reg_jmp_instr(eeprom_values, INSTR_JC, R_A, CND_CR);
+	make_cond_reg_jmp_instr(eeprom_values, INSTR_JC, R_B, CND_CR);
+	make_cond_reg_jmp_instr(eeprom_values, INSTR_JC, R_ALO, CND_CR);
+	make_cond_immediate_jmp_instr(eeprom_values, INSTR_JC, CND_CR);
 }
 
-void make_push_instr(uint8_t reg)
+void make_push_instr(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t reg)
 {
 	//push
 	//sp on bus, dec
@@ -256,10 +321,19 @@ void make_push_instr(uint8_t reg)
 	eeprom_values[make_address(MC_STEP2, instr)] = reg_read(R_SP) | alu_ctrl(ALU_DEC);	//SP--
 	eeprom_values[make_address(MC_STEP3, instr)] = reg_read(R_ALO) | SPW | MAW;	//ALO to SP and Address
 	eeprom_values[make_address(MC_STEP4, instr)] = reg_read(reg) | MW | MCR; //Write src_reg to memory
-	std::cout << unsigned(instr) << "\t\tPUSH " << source_reg_name(reg, false) << std::endl;
+	listing() << unsigned(instr) << "\t\tPUSH " << source_reg_name(reg, false) << std::endl;
+}
+
+//Pop with the stack pointer on the bus to the address register and the ALU in the same step,
+//a step shorter than pop. The flags are left as pop leaves them.
+void make_stack_pop(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t instr, uint32_t write, uint32_t last = 0)
+{
+	eeprom_values[make_address(MC_STEP2, instr)] = reg_read(R_SP) | MAW | alu_ctrl(ALU_INC);	//SP to Address, SP++
+	eeprom_values[make_address(MC_STEP3, instr)] = ME | write;	//Memory to dest
+	eeprom_values[make_address(MC_STEP4, instr)] = reg_read(R_ALO) | reg_write(R_SP) | last | MCR; //ALO to SP
 }
 
-void make_pop_instr(uint8_t reg)
+void make_pop_instr(std::map<uint16_t, uint32_t>& eeprom_values, const MicrocodeOptions& options, uint8_t reg)
 {
 	//pop
 	//sp to address
@@ -267,26 +341,40 @@ void make_pop_instr(uint8_t reg)
 	//sp to bus, inc
 	//alo to sp
 	uint8_t instr = make_ancillory_instruction_code(INSTR_POP, encode_source_reg(reg, false));
+	listing() << unsigned(instr) << "\t\tPOP " << dest_reg_name(reg, false) << std::endl;
+	if (options.stackMerge)
+	{
+		make_stack_pop(eeprom_values, instr, reg_write(reg));
+		return;
+	}
 	eeprom_values[make_address(MC_STEP2, instr)] = reg_read(R_SP) | MAW;	//SP to Address
-	eeprom_values[make_address(MC_STEP3, instr)] = ME | encode_dest_reg(reg, false);	//Memory to dest
+	eeprom_values[make_address(MC_STEP3, instr)] = ME | reg_write(reg);	//Memory to dest
 	eeprom_values[make_address(MC_STEP4, instr)] = reg_read(R_SP) | alu_ctrl(ALU_INC); //SP++
 	eeprom_values[make_address(MC_STEP5, instr)] = reg_read(R_ALO) | reg_write(R_SP) | MCR; //ALO to SP
-	std::cout << unsigned(instr) << "\t\tPOP " << dest_reg_name(reg, false) << std::endl;
 }
 
-void make_call_instr(uint8_t src_reg, bool deref)
+void make_call_instr(std::map<uint16_t, uint32_t>& eeprom_values, uint8_t src_reg, bool deref)
 {
 	uint8_t instr = make_ancillory_instruction_code(INSTR_CALL, encode_source_reg(src_reg, false));
-	std::cout << unsigned(instr) << "\t\tCALL " << source_reg_name(src_reg, deref) << std::endl;
+	listing() << unsigned(instr) << "\t\tCALL " << source_reg_name(src_reg, deref) << std::endl;
 
 	//push PC
 	eeprom_values[make_address(MC_STEP2, instr)] = reg_read(R_SP) | alu_ctrl(ALU_DEC);	//SP--
 	eeprom_values[make_address(MC_STEP3, instr)] = reg_read(R_ALO) | SPW | MAW;	//ALO to SP and Address
+	if (src_reg == R_PC)
+	{
+		//PC points at the immediate, return to the instruction after it
+		eeprom_values[make_address(MC_STEP4, instr)] = reg_read(R_PC) | alu_ctrl(ALU_INC); //PC + 1
+		eeprom_values[make_address(MC_STEP5, instr)] = reg_read(R_ALO) | MW; //Write PC + 1 to memory
+		eeprom_values[make_address(MC_STEP6, instr)] = reg_read(R_PC) | MAW;
+		eeprom_values[make_address(MC_STEP7, instr)] = ME | reg_write(R_PC) | MCR;
+		return;
+	}
 	eeprom_values[make_address(MC_STEP4, instr)] = reg_read(R_PC) | MW; //Write PC to memory
 	//load into pc
-	if (deref || src_reg == R_PC)
+	if (deref)
 	{
-		//dereference a register, or load an immediate from R_PC
+		//dereference a register
 		eeprom_values[make_address(MC_STEP5, instr)] = reg_read(src_reg) | MAW;
 		eeprom_values[make_address(MC_STEP6, instr)] = ME | reg_write(R_PC) | MCR;
 	}
@@ -296,41 +384,136 @@ void make_call_instr(uint8_t src_reg, bool deref)
 	}
 }
 
-void make_ancillary_instructions()
+//ret, last is added to the final step
+void make_ret_instr(std::map<uint16_t, uint32_t>& eeprom_values, const MicrocodeOptions& options, uint8_t instr, uint32_t last)
+{
+	if (options.stackMerge)
+	{
+		make_stack_pop(eeprom_values, instr, reg_write(R_PC), last);
+		return;
+	}
+	eeprom_values[make_address(MC_STEP2, instr)] = reg_read(R_SP) | MAW;	//SP to Address
+	eeprom_values[make_address(MC_STEP3, instr)] = ME | reg_write(R_PC);	//Memory to dest
+	eeprom_values[make_address(MC_STEP4, instr)] = reg_read(R_SP) | alu_ctrl(ALU_INC); //SP++
+	eeprom_values[make_address(MC_STEP5, instr)] = reg_read(R_ALO) | reg_write(R_SP) | last | MCR; //ALO to SP
+}
+
+/*
+fill
+Writes A to every address from ALO up to but not including B, or to the top of memory, at
+least one byte. ALO is left at 0.
+The micro counter wraps round for each byte so steps 0 and 1 are looked up with FILL still
+in the instruction register. The zero flag from the last ALU step picks between doing nothing
+while looping and the fetch of the next instruction once done.
+*/
+void make_fill_instr(std::map<uint16_t, uint32_t>& eeprom_values)
 {
-	make_push_instr(R_A);
-	make_pop_instr(R_A);
-	make_push_instr(R_B);
-	make_pop_instr(R_B);
-	make_push_instr(R_ALO);
+	const uint8_t instr = INSTR_FILL;
+	for (const uint16_t cond : {uint16_t(0), uint16_t(CND_CR)})
+	{
+		const uint16_t done = cond | CND_JMP;
+		for (const uint16_t c : {cond, done})
+		{
+			eeprom_values[make_address(MC_STEP2, instr) | c] = reg_read(R_ALO) | MAW;	//ALO to address
+			eeprom_values[make_address(MC_STEP3, instr) | c] = reg_read(R_A) | MW;	//Write A to memory
+			eeprom_values[make_address(MC_STEP4, instr) | c] = reg_read(R_ALO) | alu_ctrl(ALU_INC); //ALO++
+			eeprom_values[make_address(MC_STEP5, instr) | c] = reg_read(R_ALO) | alu_ctrl(ALU_SUB); //ALO - B, zero at the end
+		}
+		//ALO - B + B puts the address back, zero if it went past 255
+		eeprom_values[make_address(MC_STEP6, instr) | cond] = reg_read(R_ALO) | alu_ctrl(ALU_ADD);
+		eeprom_values[make_address(MC_STEP6, instr) | done] = MCR;
+		eeprom_values[make_address(MC_STEP7, instr) | cond] = 0;
+		eeprom_values[make_address(MC_STEP7, instr) | done] = MCR;
+		eeprom_values[make_address(MC_STEP0, instr) | cond] = 0;
+		eeprom_values[make_address(MC_STEP0, instr) | done] = FETCH0;
+		eeprom_values[make_address(MC_STEP1, instr) | cond] = 0;
+		eeprom_values[make_address(MC_STEP1, instr) | done] = FETCH1;
+	}
+	listing() << unsigned(instr) << "\t\tFILL" << std::endl;
+}
 
-	make_call_instr(R_A, false);
-	make_call_instr(R_B, false);
-	make_call_instr(R_ALO, false);
-	make_call_instr(R_PC, false); //call immediate
+void make_ancillary_instructions(std::map<uint16_t, uint32_t>& eeprom_values, const MicrocodeOptions& options)
+{
+	make_push_instr(eeprom_values, R_A);
+	make_pop_instr(eeprom_values, options, R_A);
+	make_push_instr(eeprom_values, R_B);
+	make_pop_instr(eeprom_values, options, R_B);
+	make_push_instr(eeprom_values, R_ALO);
+
+	make_call_instr(eeprom_values, R_A, false);
+	make_call_instr(eeprom_values, R_B, false);
+	make_call_instr(eeprom_values, R_ALO, false);
+	make_call_instr(eeprom_values, R_PC, false); //call immediate
 	
-	//ret
-	eeprom_values[make_address(MC_STEP2, INSTR_RET)] = reg_read(R_SP) | MAW;	//SP to Address
-	eeprom_values[make_address(MC_STEP3, INSTR_RET)] = ME | reg_write(R_PC);	//Memory to dest
-	eeprom_values[make_address(MC_STEP4, INSTR_RET)] = reg_read(R_SP) | alu_ctrl(ALU_INC); //SP++
-	eeprom_values[make_address(MC_STEP5, INSTR_RET)] = reg_read(R_ALO) | reg_write(R_SP) | MCR; //ALO to SP
-	std::cout << unsigned(INSTR_RET) << "\t\tRET" << std::endl;
+	make_ret_instr(eeprom_values, options, INSTR_RET, 0);
+	listing() << unsigned(INSTR_RET) << "\t\tRET" << std::endl;
 
-	//halt
-	eeprom_values[make_address(MC_STEP2, INSTR_HALT)] = HLT;
-	std::cout << unsigned(INSTR_HALT) << "\t\tHLT" << std::endl;
+	//return from interrupt, enabling them again and swapping back the ALO and flags of the
+	//interrupted instructions once SP has been through the ALU
+	make_ret_instr(eeprom_values, options, INSTR_RETI, IES | AFX);
+	listing() << unsigned(INSTR_RETI) << "\t\tRETI" << std::endl;
+
+	eeprom_values[make_address(MC_STEP2, INSTR_EI)] = IES | MCR;
+	listing() << unsigned(INSTR_EI) << "\t\tEI" << std::endl;
+	eeprom_values[make_address(MC_STEP2, INSTR_DI)] = IEC | MCR;
+	listing() << unsigned(INSTR_DI) << "\t\tDI" << std::endl;
+
+	//halt, at the fetch of the next instruction so an interrupt can wake it
+	eeprom_values[make_address(MC_STEP2, INSTR_HALT)] = HLT | MCR;
+	listing() << unsigned(INSTR_HALT) << "\t\tHLT" << std::endl;
 
 	//no op
 	eeprom_values[make_address(MC_STEP2, INSTR_NOOP)] = MCR;
-	std::cout << unsigned(INSTR_NOOP) << "\t\tNOOP" << std::endl;
+	listing() << unsigned(INSTR_NOOP) << "\t\tNOOP" << std::endl;
+
+	if (options.fill)
+		make_fill_instr(eeprom_values);
+}
+
+/*
+Taking an interrupt, every entry with CND_INT set.
+Step 0 of whatever instruction went before loads 0 from the undriven bus into the instruction
+register and swaps ALO and the flags for the second pair, then steps 1 to 6 of instruction 0
+push PC and jump to INT_VECTOR as CALL does. SP goes through the ALU, as does anything the
+handler computes, on the second pair so the interrupted instructions see their own ALO and
+flags again after RETI. A handler which enables interrupts before RETI can be interrupted with
+them in the second pair and must not use the ALU once it has.
+A FILL still looping carries on as without CND_INT and the interrupt is taken once it is done.
+*/
+void make_interrupt_entry(std::map<uint16_t, uint32_t>& eeprom_values)
+{
+	const uint16_t conds[] = {0, CND_JMP, CND_CR, CND_JMP | CND_CR};
+	for (const auto cond : conds)
+	{
+		for (uint16_t instr = 0; instr < 256; instr++)
+			eeprom_values[make_address(MC_STEP0, uint8_t(instr)) | cond | CND_INT] = IRW | AFX;
+
+		const uint16_t entry = cond | CND_INT;
+		eeprom_values[make_address(MC_STEP1, 0) | entry] = reg_read(R_SP) | alu_ctrl(ALU_DEC);	//SP--
+		eeprom_values[make_address(MC_STEP2, 0) | entry] = reg_read(R_ALO) | SPW | MAW;	//ALO to SP and Address
+		eeprom_values[make_address(MC_STEP3, 0) | entry] = reg_read(R_PC) | MW; //Write PC to memory
+		eeprom_values[make_address(MC_STEP4, 0) | entry] = alu_ctrl(ALU_INC); //0 + 1
+		eeprom_values[make_address(MC_STEP5, 0) | entry] = reg_read(R_ALO) | alu_ctrl(ALU_INC); //INT_VECTOR
+		eeprom_values[make_address(MC_STEP6, 0) | entry] = reg_read(R_ALO) | reg_write(R_PC) | IEC | INA | MCR;
+	}
+	static_assert(INT_VECTOR == 2, "the vector is counted up from 0 in the ALU");
+
+	std::map<uint16_t, uint32_t> fill;
+	for (const auto& p : eeprom_values)
+		if ((p.first & 0xFF) == INSTR_FILL && !(p.first & CND_INT) && (step_no(p.first) > 1 || !(p.first & CND_JMP)))
+			fill[p.first | CND_INT] = p.second;
+	for (const auto& p : fill)
+		eeprom_values[p.first] = p.second;
+	listing() << "\t\tInterrupt to " << INT_VECTOR << std::endl;
 }
 
-void make_instructions()
+void make_instructions(std::map<uint16_t, uint32_t>& eeprom_values, const MicrocodeOptions& options)
 {
-	make_mov_instructions();
-	make_alu_instructions();
-	make_ancillary_instructions();
-	make_jmp_instructions();
+	make_mov_instructions(eeprom_values, options);
+	make_alu_instructions(eeprom_values, options);
+	make_ancillary_instructions(eeprom_values, options);
+	make_jmp_instructions(eeprom_values);
+	make_interrupt_entry(eeprom_values);
 }
 
 uint8_t get_eeprom_value(uint32_t ctrl_word, uint8_t eeprom)
@@ -345,35 +528,37 @@ void write_value(uint8_t eeprom, uint16_t address, uint32_t ctrl_word)
 	std::cout << address << " : " << unsigned(val) << std::endl;
 }
 
-void make_eeprom(uint8_t eeprom)
+void make_eeprom(const std::map<uint16_t, uint32_t>& eeprom_values, uint8_t eeprom)
 {
 	uint32_t nop = 0;
 
 	for (uint16_t addr = 0; addr < EEPROM_SIZE; addr++)
 	{
-		if (step_no(addr) == 0)
-			write_value(eeprom, addr, FETCH0);
-		if (step_no(addr) == 1)
-			write_value(eeprom, addr, FETCH1);
-
 		auto it = eeprom_values.find(addr);
 		if (it != eeprom_values.end())
 			write_value(eeprom, addr, it->second);
+		else if (step_no(addr) == 0)
+			write_value(eeprom, addr, FETCH0);
+		else if (step_no(addr) == 1)
+			write_value(eeprom, addr, FETCH1);
 	}
 }
 
-void generate_arduino_code()
+void generate_arduino_code(const std::map<uint16_t, uint32_t>& eeprom_values)
 {
 	std::cout << "/***********************************/" << std::endl;
 	std::cout << "#define CHIP0_NULL " << unsigned(get_eeprom_value(0, 0)) << std::endl;
 	std::cout << "#define CHIP1_NULL " << unsigned(get_eeprom_value(0, 1)) << std::endl;
 	std::cout << "#define CHIP2_NULL " << unsigned(get_eeprom_value(0, 2)) << std::endl;
+	std::cout << "#define CHIP3_NULL " << unsigned(get_eeprom_value(0, 3)) << std::endl;
 	std::cout << "#define CHIP0_STEP0 " << unsigned(get_eeprom_value(FETCH0, 0)) << std::endl;
 	std::cout << "#define CHIP0_STEP1 " << unsigned(get_eeprom_value(FETCH1, 0)) << std::endl;
 	std::cout << "#define CHIP1_STEP0 " << unsigned(get_eeprom_value(FETCH0, 1)) << std::endl;
 	std::cout << "#define CHIP1_STEP1 " << unsigned(get_eeprom_value(FETCH1, 1)) << std::endl;
 	std::cout << "#define CHIP2_STEP0 " << unsigned(get_eeprom_value(FETCH0, 2)) << std::endl;
 	std::cout << "#define CHIP2_STEP1 " << unsigned(get_eeprom_value(FETCH1, 2)) << std::endl;
+	std::cout << "#define CHIP3_STEP0 " << unsigned(get_eeprom_value(FETCH0, 3)) << std::endl;
+	std::cout << "#define CHIP3_STEP1 " << unsigned(get_eeprom_value(FETCH1, 3)) << std::endl;
 	std::cout << "//\t\t" << eeprom_values.size() << " values" << std::endl;
 	std::cout << "/***********************************/" << std::endl;
 
@@ -391,11 +576,60 @@ void generate_arduino_code()
 	for (const auto p : eeprom_values)
 		std::cout << "writeEEPROM(" << p.first << ", " << unsigned(get_eeprom_value(p.second, 2)) << ");" << std::endl;
 	std::cout << "#endif //CHIP2" << std::endl;
+
+	std::cout << "#ifdef CHIP3" << std::endl;
+	for (const auto p : eeprom_values)
+		std::cout << "writeEEPROM(" << p.first << ", " << unsigned(get_eeprom_value(p.second, 3)) << ");" << std::endl;
+	std::cout << "#endif //CHIP3" << std::endl;
+}
+
+const std::map<uint16_t, uint32_t>& microcode_table()
+{
+	static const std::map<uint16_t, uint32_t> table = make_microcode(MicrocodeOptions());
+	return table;
+}
+
+std::map<uint16_t, uint32_t> make_microcode(const MicrocodeOptions& options)
+{
+	std::map<uint16_t, uint32_t> table;
+	make_instructions(table, options);
+	return table;
+}
+
+uint32_t microcode_word(uint16_t addr)
+{
+	return microcode_word(microcode_table(), addr);
+}
+
+uint32_t microcode_word(const std::map<uint16_t, uint32_t>& table, uint16_t addr)
+{
+	//FILL and interrupts replace the fetch steps
+	auto it = table.find(addr);
+	if (it != table.end())
+		return it->second;
+	if (step_no(addr) == 0)
+		return FETCH0;
+	if (step_no(addr) == 1)
+		return FETCH1;
+	return 0;
+}
+
+uint8_t instruction_cycles(uint8_t instr, uint16_t cond)
+{
+	for (uint8_t step = 2; step < 8; step++)
+	{
+		if (microcode_word(make_address(step << 10, instr) | cond) & (MCR | HLT))
+			return step + 1;
+	}
+	//the micro counter wraps back to fetch
+	return 8;
 }
 
 void generate_eeproms()
 {
-	make_instructions();
-	generate_arduino_code();
+	listing_stream = &std::cout;
+	std::map<uint16_t, uint32_t> eeprom_values;
+	make_instructions(eeprom_values, MicrocodeOptions());
+	generate_arduino_code(eeprom_values);
 }
 
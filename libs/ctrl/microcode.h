@@ -0,0 +1,29 @@
+#pragma once
+
+#include "constants.h"
+
+#include <map>
+
+//Choices the instruction builders can make differently, the defaults are the board's microcode
+struct MicrocodeOptions
+{
+	bool indexed = true;		//MOV [imm+B] loads and stores
+	bool aluMemory = true;		//ALU operations on [imm]
+	bool fill = true;			//FILL
+	bool stackMerge = false;	//POP, RET and RETI count SP up as it is put in the address register
+};
+
+//eeprom address to control word, built once on first use
+const std::map<uint16_t, uint32_t>& microcode_table();
+
+//A table built with options instead of the defaults, microcode_table() is left as it was.
+//Each build fills its own table, builds can run on several threads at once.
+std::map<uint16_t, uint32_t> make_microcode(const MicrocodeOptions& options);
+
+//Control word at an eeprom address, including the fetch steps common to all
+//instructions but FILL and those taking an interrupt
+uint32_t microcode_word(uint16_t addr);
+uint32_t microcode_word(const std::map<uint16_t, uint32_t>& table, uint16_t addr);
+
+//Clock cycles taken by an instruction, including fetch, for the given CND_ inputs
+uint8_t instruction_cycles(uint8_t instr, uint16_t cond = 0);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+Widths the toolchain is built for, passed to templates as W.
+Width8 is the board, every address is a byte. Width16 is a variant with a 16 bit address
+space, immediate addresses and jump targets take two bytes, low byte first. Data and the
+registers a program can load, A, B and ALO, stay a byte wide in both so CALL A and JMP A only
+reach the first 256 bytes.
+*/
+struct Width8
+{
+	using Address = uint8_t;	//PC, SP, MAR and immediate addresses
+	using Word = uint8_t;		//data, A, B and ALO
+	static constexpr unsigned addressBytes = 1;
+	static constexpr size_t memorySize = 256;
+};
+
+struct Width16
+{
+	using Address = uint16_t;
+	using Word = uint8_t;
+	static constexpr unsigned addressBytes = 2;
+	static constexpr size_t memorySize = 65536;
+};
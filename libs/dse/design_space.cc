@@ -0,0 +1,200 @@
+#include "design_space.h"
+
+#include <asm/program.h>
+#include <sim/fast_simulator.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace Cpu
+{
+
+namespace
+{
+
+std::vector<uint8_t> run(FastSimulator& sim, const std::vector<uint8_t>& image, uint64_t maxCycles, uint64_t& cycles)
+{
+	std::vector<uint8_t> out;
+	sim.State() = Machine();
+	sim.Reset();
+	sim.Load(image);
+	sim.OnOut([&out](uint8_t value) {out.push_back(value);});
+	cycles = sim.Run(maxCycles);
+	sim.OnOut(nullptr);
+	return out;
+}
+
+//Has microcode for step 2, a conditional jump only with its condition set
+bool implemented(const std::map<uint16_t, uint32_t>& table, uint8_t opcode)
+{
+	for (const uint16_t cond : {uint16_t(0), uint16_t(CND_JMP), uint16_t(CND_CR)})
+		if (table.find(make_address(MC_STEP2, opcode) | cond) != table.end())
+			return true;
+	return false;
+}
+
+}
+
+DesignSpaceExplorer::DesignSpaceExplorer(std::vector<Workload> workloads)
+:	mWorkloads(std::move(workloads))
+{
+	FastSimulator sim;
+	for (const auto& w : mWorkloads)
+	{
+		if (w.sources.empty())
+			throw std::runtime_error(w.name + " has no source");
+		mAssembled.emplace_back();
+		for (const auto& source : w.sources)
+		{
+			Program p;
+			std::istringstream in(source);
+			std::string line;
+			while (std::getline(in, line))
+				p.AddLine(SourceLine::Parse(line));
+
+			Assembled a;
+			a.image = p.MachineCode();
+			for (const auto& [address, instr] : p.Instructions())
+				if (instr.Line().OpCode() != "DB" && instr.EncodedLength())
+					a.opcodes.push_back(a.image[address]);
+			mAssembled.back().push_back(std::move(a));
+		}
+
+		uint64_t cycles = 0;
+		mExpected.push_back(run(sim, mAssembled.back().front().image, w.maxCycles, cycles));
+		if (sim.Stopped() != Simulator::STOP_HALTED)
+			throw std::runtime_error(w.name + " doesn't halt within " + std::to_string(w.maxCycles) + " cycles");
+	}
+}
+
+std::vector<IsaVariant> DesignSpaceExplorer::AllVariants()
+{
+	std::vector<IsaVariant> result;
+	for (unsigned bits = 0; bits < 16; bits++)
+	{
+		IsaVariant v;
+		v.options.indexed = !(bits & 1);
+		v.options.aluMemory = !(bits & 2);
+		v.options.fill = !(bits & 4);
+		v.options.stackMerge = bits & 8;
+		std::string name;
+		if (!v.options.indexed)
+			name += "-indexed";
+		if (!v.options.aluMemory)
+			name += "-alumem";
+		if (!v.options.fill)
+			name += "-fill";
+		if (v.options.stackMerge)
+			name += "+stackmerge";
+		v.name = name.empty() ? "board" : name;
+		result.push_back(v);
+	}
+	return result;
+}
+
+VariantScore DesignSpaceExplorer::Score(const IsaVariant& variant, const std::vector<uint32_t>& rom, const std::map<uint16_t, uint32_t>& table) const
+{
+	VariantScore score;
+	score.variant = variant;
+	score.romEntries = table.size();
+	for (unsigned opcode = 0; opcode < 256; opcode++)
+		score.opcodes += implemented(table, uint8_t(opcode));
+
+	FastSimulator sim(rom.data());
+	for (size_t w = 0; w < mWorkloads.size(); w++)
+	{
+		const auto& sources = mAssembled[w];
+		const auto source = std::find_if(sources.begin(), sources.end(), [&table](const Assembled& a)
+		{
+			return std::all_of(a.opcodes.begin(), a.opcodes.end(), [&table](uint8_t op) {return implemented(table, op);});
+		});
+		score.workloadCycles.push_back(0);
+		score.workloadSource.push_back(source - sources.begin());
+		if (source == sources.end())
+		{
+			score.ok = false;
+			score.error = mWorkloads[w].name + ": no source for this instruction set";
+			return score;
+		}
+
+		uint64_t cycles = 0;
+		const auto out = run(sim, source->image, mWorkloads[w].maxCycles, cycles);
+		score.workloadCycles.back() = cycles;
+		score.cycles += cycles;
+		if (sim.Stopped() != Simulator::STOP_HALTED)
+		{
+			score.ok = false;
+			score.error = mWorkloads[w].name + ": no HLT";
+			return score;
+		}
+		if (out != mExpected[w])
+		{
+			score.ok = false;
+			score.error = mWorkloads[w].name + ": OUT differs";
+			return score;
+		}
+	}
+	return score;
+}
+
+std::vector<VariantScore> DesignSpaceExplorer::Explore(const std::vector<IsaVariant>& variants, unsigned threads) const
+{
+	//each variant's table is built by the thread which scores it
+	std::vector<VariantScore> scores(variants.size());
+	std::atomic<size_t> next {0};
+	auto work = [&]()
+	{
+		for (size_t i = next++; i < variants.size(); i = next++)
+		{
+			const auto table = make_microcode(variants[i].options);
+			scores[i] = Score(variants[i], make_rom(table), table);
+		}
+	};
+	std::vector<std::thread> pool;
+	for (unsigned i = 1; i < std::max(threads, 1u); i++)
+		pool.emplace_back(work);
+	work();
+	for (auto& t : pool)
+		t.join();
+
+	std::stable_sort(scores.begin(), scores.end(), [](const VariantScore& a, const VariantScore& b)
+	{
+		if (a.ok != b.ok)
+			return a.ok;
+		if (a.cycles != b.cycles)
+			return a.cycles < b.cycles;
+		return a.romEntries < b.romEntries;
+	});
+	return scores;
+}
+
+void DesignSpaceExplorer::Report(const std::vector<VariantScore>& scores, const std::vector<Workload>& workloads, std::ostream& out)
+{
+	out << std::left << std::setw(36) << "variant" << std::right << std::setw(10) << "cycles"
+		<< std::setw(8) << "ROM" << std::setw(7) << "fill" << std::setw(9) << "opcodes";
+	for (const auto& w : workloads)
+		out << "  " << w.name;
+	out << "\n";
+	for (const auto& s : scores)
+	{
+		out << std::left << std::setw(36) << s.variant.name << std::right << std::setw(10) << s.cycles
+			<< std::setw(8) << s.romEntries << std::setw(6) << std::fixed << std::setprecision(1)
+			<< 100.0 * s.romEntries / (EEPROM_SIZE + 1) << "%" << std::setw(9) << s.opcodes;
+		for (size_t w = 0; w < s.workloadCycles.size(); w++)
+		{
+			out << "  " << s.workloadCycles[w];
+			//ran a fallback source
+			if (s.workloadSource[w])
+				out << "/" << s.workloadSource[w];
+		}
+		if (!s.ok)
+			out << "  ; " << s.error;
+		out << "\n";
+	}
+}
+
+}
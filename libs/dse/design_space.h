@@ -0,0 +1,90 @@
+#pragma once
+
+#include <ctrl/microcode.h>
+
+#include <stdint.h>
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Cpu
+{
+
+//A microcode table to try, built with make_microcode()
+struct IsaVariant
+{
+	std::string name;
+	MicrocodeOptions options;
+};
+
+//A benchmark program, run from address 0 to HLT
+struct Workload
+{
+	std::string name;
+	//The same program written for smaller instruction sets, in order of preference. Each
+	//variant runs the first whose every instruction it implements.
+	std::vector<std::string> sources;
+	uint64_t maxCycles = 1000000;
+};
+
+struct VariantScore
+{
+	IsaVariant variant;
+	//Ran every workload to HLT writing the same values to OUT as the board's microcode
+	bool ok = true;
+	//Why not, the first workload it failed
+	std::string error;
+	uint64_t cycles = 0;
+	//Entries in the table and the opcodes with any microcode
+	size_t romEntries = 0;
+	unsigned opcodes = 0;
+	//Cycles for each workload and the source it ran
+	std::vector<uint64_t> workloadCycles;
+	std::vector<size_t> workloadSource;
+};
+
+/*
+Scores microcode variants on a suite of workloads.
+
+Each variant's table is built by the instruction builders with its options and flattened into
+a ROM for the fast simulator. A workload's sources are assembled once, a variant runs the first
+whose opcodes all have microcode in its table. Variants are shared out across threads, each
+with its own simulator, and ranked by total cycles then ROM entries. Those which can't run a
+workload, or which write different values to OUT than the board's microcode, are ranked last.
+*/
+class DesignSpaceExplorer
+{
+public:
+	explicit DesignSpaceExplorer(std::vector<Workload> workloads);
+
+	//Every combination of the options, the board's microcode first
+	static std::vector<IsaVariant> AllVariants();
+
+	//Scores every variant, best first
+	std::vector<VariantScore> Explore(const std::vector<IsaVariant>& variants,
+		unsigned threads = std::thread::hardware_concurrency()) const;
+
+	//Prints the ranking as a table
+	static void Report(const std::vector<VariantScore>& scores, const std::vector<Workload>& workloads, std::ostream& out);
+
+private:
+	struct Assembled
+	{
+		std::vector<uint8_t> image;
+		//opcodes of every instruction, data bytes excluded
+		std::vector<uint8_t> opcodes;
+	};
+
+	VariantScore Score(const IsaVariant& variant, const std::vector<uint32_t>& rom, const std::map<uint16_t, uint32_t>& table) const;
+
+	std::vector<Workload> mWorkloads;
+	//indexed by workload then source
+	std::vector<std::vector<Assembled>> mAssembled;
+	//values written to OUT by each workload's first source with the board's microcode
+	std::vector<std::vector<uint8_t>> mExpected;
+};
+
+}
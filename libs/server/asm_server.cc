@@ -0,0 +1,373 @@
+#include "asm_server.h"
+
+#include <asm/listing.h>
+#include <asm/optimizer.h>
+#include <asm/program.h>
+#include <asm/timing_analyzer.h>
+#include <sim/fast_simulator.h>
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace Cpu
+{
+
+namespace
+{
+
+//Cycles a SIMULATE request may run for, as sim's default
+const uint64_t max_cycles = 1000000;
+
+#ifndef _WIN32
+
+bool write_all(int fd, const char* data, size_t size)
+{
+	while (size)
+	{
+		const auto n = send(fd, data, size, MSG_NOSIGNAL);
+		if (n <= 0)
+			return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+bool read_all(int fd, char* data, size_t size)
+{
+	while (size)
+	{
+		const auto n = recv(fd, data, size, 0);
+		if (n <= 0)
+			return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+bool write_frame(int fd, const std::string& body)
+{
+	const uint32_t size = uint32_t(body.size());
+	const char header[4] = {char(size), char(size >> 8), char(size >> 16), char(size >> 24)};
+	return write_all(fd, header, sizeof(header)) && write_all(fd, body.data(), body.size());
+}
+
+//false when the connection closed
+bool read_frame(int fd, std::string& body)
+{
+	unsigned char header[4];
+	if (!read_all(fd, reinterpret_cast<char*>(header), sizeof(header)))
+		return false;
+	body.resize(header[0] | header[1] << 8 | header[2] << 16 | uint32_t(header[3]) << 24);
+	return read_all(fd, body.data(), body.size());
+}
+
+sockaddr_un socket_address(const std::string& path)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path))
+		throw std::runtime_error("socket path too long " + path);
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+	return address;
+}
+
+#endif
+
+std::string encode_request(const ServerRequest& request)
+{
+	return std::string{char(request.kind), char(request.flags)} + request.source;
+}
+
+ServerRequest decode_request(const std::string& body)
+{
+	if (body.size() < 2)
+		throw std::runtime_error("bad request");
+	return {ServerRequest::Kind(body[0]), uint8_t(body[1]), body.substr(2)};
+}
+
+std::string encode_response(const ServerResponse& response)
+{
+	const uint32_t size = uint32_t(response.out.size());
+	return std::string{char(response.status), char(size), char(size >> 8), char(size >> 16), char(size >> 24)}
+		+ response.out + response.err;
+}
+
+ServerResponse decode_response(const std::string& body)
+{
+	if (body.size() < 5)
+		throw std::runtime_error("bad response");
+	const auto* p = reinterpret_cast<const unsigned char*>(body.data());
+	const size_t size = p[1] | p[2] << 8 | p[3] << 16 | uint32_t(p[4]) << 24;
+	if (5 + size > body.size())
+		throw std::runtime_error("bad response");
+	return {p[0], body.substr(5, size), body.substr(5 + size)};
+}
+
+}
+
+AsmServer::AsmServer(unsigned threads, size_t cacheLimit)
+:	mCacheLimit(cacheLimit),
+	mPool(threads)
+{
+}
+
+AsmServer::~AsmServer()
+{
+	Stop();
+}
+
+size_t AsmServer::CachedLines() const
+{
+	std::shared_lock<std::shared_mutex> lock(mCacheMutex);
+	return mLines.size();
+}
+
+SourceLine AsmServer::Parse(const std::string& text)
+{
+	{
+		std::shared_lock<std::shared_mutex> lock(mCacheMutex);
+		const auto it = mLines.find(text);
+		if (it != mLines.end())
+		{
+			mCacheHits++;
+			return it->second;
+		}
+	}
+	//parsed outside the lock, another thread may parse the same line meanwhile
+	const auto line = SourceLine::Parse(text);
+	std::unique_lock<std::shared_mutex> lock(mCacheMutex);
+	if (mLines.size() >= mCacheLimit)
+		mLines.clear();
+	mLines.emplace(text, line);
+	return line;
+}
+
+ServerResponse AsmServer::Handle(const ServerRequest& request)
+{
+	mRequests++;
+	ServerResponse response;
+	try
+	{
+		//as asm reads stdin, the line after the last newline included
+		std::vector<SourceLine> lines;
+		size_t pos = 0;
+		while (true)
+		{
+			const auto end = request.source.find('\n', pos);
+			lines.push_back(Parse(request.source.substr(pos, end == std::string::npos ? end : end - pos)));
+			if (end == std::string::npos)
+				break;
+			pos = end + 1;
+		}
+
+		std::ostringstream err;
+		if (request.kind == ServerRequest::ASSEMBLE && (request.flags & ServerRequest::OPTIMIZE))
+		{
+			Optimizer optimizer;
+			lines = optimizer.Optimize(lines);
+			optimizer.Report().Print(err);
+		}
+
+		Program p;
+		for (const auto& line : lines)
+			p.AddLine(line);
+
+		switch (request.kind)
+		{
+		case ServerRequest::ASSEMBLE:
+			if (request.flags & ServerRequest::TIMING)
+			{
+				try
+				{
+					TimingAnalyzer(p).Analyze().Print(err);
+				}
+				catch (const std::exception& e)
+				{
+					err << "timing: " << e.what() << std::endl;
+				}
+			}
+			if (request.flags & ServerRequest::LISTING)
+			{
+				response.out = program_listing(p);
+			}
+			else
+			{
+				for (const auto b : p.MachineCode())
+					response.out += std::to_string(b) + "\n";
+			}
+			break;
+		case ServerRequest::SIMULATE:
+		{
+			FastSimulator sim;
+			sim.Load(p.MachineCode());
+			sim.OnOut([&response](uint8_t value) {response.out += std::to_string(value) + "\n";});
+			err << "; " << sim.Run(max_cycles) << " cycles" << std::endl;
+			break;
+		}
+		case ServerRequest::COST:
+		{
+			std::ostringstream out;
+			TimingAnalyzer(p).Analyze().Print(out);
+			response.out = out.str();
+			break;
+		}
+		default:
+			throw std::runtime_error("unknown request " + std::to_string(request.kind));
+		}
+		response.err = err.str();
+	}
+	catch (const std::exception& e)
+	{
+		response.status = 1;
+		response.out.clear();
+		response.err = std::string(e.what()) + "\n";
+	}
+	return response;
+}
+
+#ifdef _WIN32
+
+void AsmServer::Listen(const std::string&)
+{
+	throw std::runtime_error("the server needs Unix domain sockets");
+}
+
+void AsmServer::Stop()
+{
+}
+
+void AsmServer::Serve(int)
+{
+}
+
+AsmClient::AsmClient(const std::string&)
+{
+	throw std::runtime_error("the server needs Unix domain sockets");
+}
+
+AsmClient::~AsmClient()
+{
+}
+
+ServerResponse AsmClient::Send(const ServerRequest&)
+{
+	return {};
+}
+
+#else
+
+void AsmServer::Listen(const std::string& path)
+{
+	const auto address = socket_address(path);
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		throw std::runtime_error("can't create a socket");
+	unlink(path.c_str());
+	if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+	{
+		close(fd);
+		throw std::runtime_error("can't listen on " + path);
+	}
+	{
+		std::lock_guard<std::mutex> lock(mSocketMutex);
+		if (mStopping)
+		{
+			close(fd);
+			return;
+		}
+		mListener = fd;
+	}
+
+	while (true)
+	{
+		const int connection = accept(fd, nullptr, nullptr);
+		std::lock_guard<std::mutex> lock(mSocketMutex);
+		if (mStopping)
+		{
+			if (connection >= 0)
+				close(connection);
+			break;
+		}
+		if (connection < 0)
+			continue;
+		mConnections.insert(connection);
+		mPool.Submit([this, connection]() {Serve(connection);});
+	}
+
+	std::lock_guard<std::mutex> lock(mSocketMutex);
+	close(fd);
+	mListener = -1;
+	unlink(path.c_str());
+}
+
+void AsmServer::Stop()
+{
+	std::lock_guard<std::mutex> lock(mSocketMutex);
+	mStopping = true;
+	//wakes accept and any read, the sockets are closed by their owners
+	if (mListener >= 0)
+		shutdown(mListener, SHUT_RDWR);
+	for (const int fd : mConnections)
+		shutdown(fd, SHUT_RDWR);
+}
+
+void AsmServer::Serve(int fd)
+{
+	std::string body;
+	while (read_frame(fd, body))
+	{
+		ServerResponse response;
+		try
+		{
+			response = Handle(decode_request(body));
+		}
+		catch (const std::exception& e)
+		{
+			response = {1, "", std::string(e.what()) + "\n"};
+		}
+		if (!write_frame(fd, encode_response(response)))
+			break;
+	}
+	std::lock_guard<std::mutex> lock(mSocketMutex);
+	mConnections.erase(fd);
+	close(fd);
+}
+
+AsmClient::AsmClient(const std::string& path)
+{
+	const auto address = socket_address(path);
+	mSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (mSocket < 0 || connect(mSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		if (mSocket >= 0)
+			close(mSocket);
+		throw std::runtime_error("can't connect to " + path);
+	}
+}
+
+AsmClient::~AsmClient()
+{
+	close(mSocket);
+}
+
+ServerResponse AsmClient::Send(const ServerRequest& request)
+{
+	std::string body;
+	if (!write_frame(mSocket, encode_request(request)) || !read_frame(mSocket, body))
+		throw std::runtime_error("lost the connection to the server");
+	return decode_response(body);
+}
+
+#endif
+
+}
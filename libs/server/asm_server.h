@@ -0,0 +1,118 @@
+#pragma once
+
+#include "thread_pool.h"
+
+#include <asm/source_line.h>
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Cpu
+{
+
+struct ServerRequest
+{
+	enum Kind : uint8_t
+	{
+		//machine code, one byte a line as asm prints it
+		ASSEMBLE = 'a',
+		//every value written to OUT, as sim prints them
+		SIMULATE = 's',
+		//best and worst case cycles of each function from the microcode, see TimingAnalyzer
+		COST = 'c'
+	};
+	//asm's options, for ASSEMBLE
+	enum Flags : uint8_t
+	{
+		OPTIMIZE = 1,
+		TIMING = 2,
+		LISTING = 4
+	};
+
+	Kind kind = ASSEMBLE;
+	uint8_t flags = 0;
+	std::string source;
+};
+
+//What the tool would have written to stdout and stderr, status is its exit code
+struct ServerResponse
+{
+	uint8_t status = 0;
+	std::string out;
+	std::string err;
+};
+
+/*
+Assembles, runs and costs programs for clients connected over a Unix domain socket, keeping
+everything the tools build at start up resident between requests.
+
+Each message is framed as a 32 bit little endian length followed by that many bytes. A request
+is its kind, flags and source, a response its status, the length of out, out then err. A client
+may send any number of requests on one connection, each is answered before the next is read.
+Connections are served on a thread pool, a connection holds a worker while it is open.
+
+Parsed lines are cached by their text and shared by every request, the cache is emptied when
+it reaches its limit.
+*/
+class AsmServer
+{
+public:
+	explicit AsmServer(unsigned threads = std::thread::hardware_concurrency(), size_t cacheLimit = 1 << 16);
+	~AsmServer();
+
+	//Serves a single request, safe to call from any thread
+	ServerResponse Handle(const ServerRequest& request);
+
+	//Listens on path, replacing any socket already there, until Stop. Throws std::runtime_error
+	//when the socket can't be created.
+	void Listen(const std::string& path);
+	//Closes the socket and every connection, Listen returns
+	void Stop();
+
+	size_t CachedLines() const;
+	uint64_t CacheHits() const {return mCacheHits;}
+	uint64_t Requests() const {return mRequests;}
+
+private:
+	SourceLine Parse(const std::string& text);
+	void Serve(int fd);
+
+	const size_t mCacheLimit;
+	mutable std::shared_mutex mCacheMutex;
+	std::unordered_map<std::string, SourceLine> mLines;
+	std::atomic<uint64_t> mCacheHits = 0;
+	std::atomic<uint64_t> mRequests = 0;
+
+	std::mutex mSocketMutex;
+	int mListener = -1;
+	std::set<int> mConnections;
+	bool mStopping = false;
+	//last, so its destructor waits for the connections before the rest is destroyed
+	ThreadPool mPool;
+};
+
+//A connection to an AsmServer
+class AsmClient
+{
+public:
+	//Throws std::runtime_error when nothing is listening on path
+	explicit AsmClient(const std::string& path);
+	~AsmClient();
+
+	AsmClient(const AsmClient&) = delete;
+	AsmClient& operator=(const AsmClient&) = delete;
+
+	//Throws std::runtime_error when the connection is lost
+	ServerResponse Send(const ServerRequest& request);
+
+private:
+	int mSocket = -1;
+};
+
+}
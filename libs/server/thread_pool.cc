@@ -0,0 +1,53 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace Cpu
+{
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+	threads = std::max(1u, threads);
+	mWorkers.reserve(threads);
+	for (unsigned i = 0; i < threads; i++)
+		mWorkers.emplace_back([this]() {Work();});
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mReady.notify_all();
+	for (auto& worker : mWorkers)
+		worker.join();
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.push_back(std::move(task));
+	}
+	mReady.notify_one();
+}
+
+void ThreadPool::Work()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mReady.wait(lock, [this]() {return mStopping || !mTasks.empty();});
+			if (mTasks.empty())
+				return;
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+		task();
+	}
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Cpu
+{
+
+/*
+A fixed set of worker threads running tasks in the order they were submitted.
+The destructor runs every task already submitted before joining the workers.
+*/
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void Submit(std::function<void()> task);
+
+	size_t Threads() const {return mWorkers.size();}
+
+private:
+	void Work();
+
+	std::mutex mMutex;
+	std::condition_variable mReady;
+	std::deque<std::function<void()>> mTasks;
+	bool mStopping = false;
+	std::vector<std::thread> mWorkers;
+};
+
+}
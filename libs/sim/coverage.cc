@@ -0,0 +1,102 @@
+#include "coverage.h"
+
+#include <bitset>
+#include <cstring>
+#include <string>
+
+namespace Cpu
+{
+
+namespace
+{
+
+const char magic[8] = {'C', 'P', 'U', 'C', 'O', 'V', 'E', 'R'};
+
+}
+
+size_t MicrocodeCoverage::Merge(const MicrocodeCoverage& other)
+{
+	size_t added = 0;
+	for (size_t i = 0; i < ROM_SIZE / 64; i++)
+	{
+		added += std::bitset<64>(other.mBits[i] & ~mBits[i]).count();
+		mBits[i] |= other.mBits[i];
+	}
+	return added;
+}
+
+void MicrocodeCoverage::Clear()
+{
+	std::memset(mBits, 0, sizeof(mBits));
+}
+
+size_t MicrocodeCoverage::Count() const
+{
+	size_t count = 0;
+	for (const auto bits : mBits)
+		count += std::bitset<64>(bits).count();
+	return count;
+}
+
+size_t MicrocodeCoverage::Dead(const uint32_t* rom) const
+{
+	size_t dead = 0;
+	for (uint16_t addr = 0; addr < ROM_SIZE; addr++)
+		dead += rom[addr] != 0 && !Covered(addr);
+	return dead;
+}
+
+void MicrocodeCoverage::Write(std::ostream& os) const
+{
+	os.write(magic, sizeof(magic));
+	os.write(reinterpret_cast<const char*>(mBits), sizeof(mBits));
+}
+
+bool MicrocodeCoverage::Read(std::istream& is)
+{
+	char header[sizeof(magic)];
+	MicrocodeCoverage read;
+	if (!is.read(header, sizeof(header)) || std::memcmp(header, magic, sizeof(magic)) != 0 ||
+		!is.read(reinterpret_cast<char*>(read.mBits), sizeof(read.mBits)))
+		return false;
+	Merge(read);
+	return true;
+}
+
+void MicrocodeCoverage::Report(std::ostream& os, const uint32_t* rom) const
+{
+	const uint16_t conds[] = {0, CND_JMP, CND_CR, CND_JMP | CND_CR,
+		CND_INT, CND_JMP | CND_INT, CND_CR | CND_INT, CND_JMP | CND_CR | CND_INT};
+
+	size_t words = 0;
+	for (uint16_t addr = 0; addr < ROM_SIZE; addr++)
+		words += rom[addr] != 0;
+	const size_t dead = Dead(rom);
+
+	std::string out = "; " + std::to_string(Count()) + " of " + std::to_string(ROM_SIZE) + " entries hit, " +
+		std::to_string(words - dead) + " of " + std::to_string(words) + " control words\n";
+	out += "; op  --        J-        -C        JC        --I       J-I       -CI       JCI\n";
+	for (uint16_t instr = 0; instr < 256; instr++)
+	{
+		std::string line = std::to_string(instr);
+		line.insert(0, 5 - line.size(), ' ');
+		bool used = false;
+		for (const auto cond : conds)
+		{
+			line += ' ';
+			for (uint16_t step = 0; step < 8; step++)
+			{
+				const uint16_t addr = make_address(step << 10, uint8_t(instr)) | cond;
+				//every opcode has the fetch steps, only list those with a body
+				used = used || (step > 1 && rom[addr]);
+				line += Covered(addr) ? 'x' : rom[addr] ? '.' : ' ';
+			}
+			line += ' ';
+		}
+		if (used)
+			out += line + "\n";
+	}
+	os << out;
+}
+
+}
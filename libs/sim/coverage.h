@@ -0,0 +1,47 @@
+#pragma once
+
+#include "simulator.h"
+
+#include <istream>
+#include <ostream>
+
+namespace Cpu
+{
+
+/*
+A bit for every microcode ROM address, set when a simulator clocks the control word there.
+Fetch steps are recorded against the instruction and CND_ inputs they are looked up with,
+as the board does.
+
+Runs on separate threads or processes each keep their own and Merge them, Write and Read
+keep a bitmap in a file between runs. Entries holding a control word which are never hit
+are either dead, and need not be flashed, or untested.
+*/
+class MicrocodeCoverage
+{
+public:
+	void Hit(uint16_t address) {mBits[address >> 6] |= uint64_t(1) << (address & 63);}
+	bool Covered(uint16_t address) const {return mBits[address >> 6] & (uint64_t(1) << (address & 63));}
+
+	//Adds other's hits, returns the number of entries which were new
+	size_t Merge(const MicrocodeCoverage& other);
+	void Clear();
+
+	size_t Count() const;
+	//Entries with a non zero control word in rom which were never hit
+	size_t Dead(const uint32_t* rom = microcode_rom()) const;
+
+	void Write(std::ostream& os) const;
+	//Merges a bitmap written by Write, false if the stream doesn't hold one
+	bool Read(std::istream& is);
+
+	//Totals then a line per opcode with any control words, a column of steps 0 to 7 for
+	//each of the CND_ inputs, interrupt entry included, 'x' hit, '.' a control word never
+	//hit, ' ' empty and not hit
+	void Report(std::ostream& os, const uint32_t* rom = microcode_rom()) const;
+
+private:
+	uint64_t mBits[ROM_SIZE / 64] = {};
+};
+
+}
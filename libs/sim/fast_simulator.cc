@@ -0,0 +1,63 @@
+#include "fast_simulator.h"
+
+namespace Cpu
+{
+
+FastSimulator::FastSimulator(const uint32_t* rom)
+:	Simulator(rom)
+{
+	Decode();
+}
+
+void FastSimulator::Decode()
+{
+	const uint16_t conds[] = {0, CND_JMP, CND_CR, CND_JMP | CND_CR};
+
+	for (uint16_t instr = 0; instr < 256; instr++)
+	{
+		for (const auto cond : conds)
+		{
+			Decoded& d = mDecoded[cond | instr];
+			bool flagsWritten = false;
+			d.exact = true;
+			for (uint8_t step = 2; step < 8; step++)
+			{
+				const uint32_t ctrl = mRom[make_address(step << 10, instr) | cond];
+				//flags written part way through could select a different control word
+				for (const auto other : conds)
+					d.exact = d.exact && (!flagsWritten || ctrl == mRom[make_address(step << 10, instr) | other]);
+				flagsWritten = flagsWritten || (ctrl & (ALW | AFX));
+				d.ctrl[d.count++] = ctrl;
+				if (ctrl & (MCR | HLT))
+					break;
+			}
+
+			mStandardFetch[cond | instr] =
+				mRom[make_address(MC_STEP0, instr) | cond] == FETCH0 &&
+				mRom[make_address(MC_STEP1, instr) | cond] == FETCH1;
+		}
+	}
+}
+
+void FastSimulator::ClockInstruction()
+{
+	do
+	{
+		Clock();
+	} while (mMachine.mc != 0 && !mMachine.halted);
+}
+
+uint64_t FastSimulator::Run(uint64_t maxCycles)
+{
+	return Run(maxCycles, [](uint8_t, uint64_t) {});
+}
+
+std::unique_ptr<Simulator> FastSimulator::Fork() const
+{
+	auto fork = std::make_unique<FastSimulator>(*this);
+	fork->mTrace = nullptr;
+	fork->mCoverage = nullptr;
+	return fork;
+}
+
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "simulator.h"
+#include "coverage.h"
+
+namespace Cpu
+{
+
+/*
+Executes a whole instruction at a time.
+The control words for every instruction and condition are decoded from the ROM up front,
+so fetch is done directly and the body runs without any ROM lookups. Instructions whose
+microcode depends on flags changed part way through fall back to clocking each step.
+*/
+class FastSimulator : public Simulator
+{
+public:
+	explicit FastSimulator(const uint32_t* rom = microcode_rom());
+
+	uint64_t Run(uint64_t maxCycles) override;
+	//Copies the decoded tables too, about 30KB
+	std::unique_ptr<Simulator> Fork() const override;
+	//As Run, calling observer(pc, cycles) after each instruction with the address it was
+	//fetched from and the cycles it took, each pass of FILL with FILL's address. Inlined into the
+	//loop so profiling costs little.
+	template <typename Observer>
+	uint64_t Run(uint64_t maxCycles, Observer&& observer);
+	//A single instruction, fetch included
+	void Step();
+
+private:
+	struct Decoded
+	{
+		uint8_t count = 0;
+		//body can be run from the table, otherwise clock it from the ROM
+		bool exact = false;
+		uint32_t ctrl[6] = {};
+	};
+
+	void Decode();
+	void ClockInstruction();
+	//Step, checking the watchpoints on memory writes when Debug
+	template <bool Debug>
+	void Execute();
+	//Run, checking breakpoints and watchpoints when Debug
+	template <bool Debug, typename Observer>
+	uint64_t RunLoop(uint64_t maxCycles, Observer& observer);
+
+	//indexed by instruction | CND_ inputs
+	Decoded mDecoded[1024];
+	//the fetch steps following an instruction are FETCH0, FETCH1
+	bool mStandardFetch[1024];
+};
+
+inline void FastSimulator::Step()
+{
+	if (Debugging())
+		Execute<true>();
+	else
+		Execute<false>();
+}
+
+template <bool Debug>
+inline void FastSimulator::Execute()
+{
+	Machine& m = mMachine;
+	latch_interrupt(m);
+	//part way through an instruction, taking an interrupt or a fetch the table can't do
+	if (m.mc != 0 || m.intr || !mStandardFetch[rom_address(m)])
+	{
+		ClockInstruction();
+		return;
+	}
+
+	//FETCH0, FETCH1
+	if (mTrace)
+	{
+		mTrace->Record({mCycles, FETCH0, m.pc, m.ir, 0, m.pc, m.alo, m.flags, false});
+		mTrace->Record({mCycles + 1, FETCH1, m.pc, m.ir, 1, m.ram[m.pc], m.alo, m.flags, false});
+	}
+	if (mCoverage)
+	{
+		mCoverage->Hit(rom_address(m));
+		mCoverage->Hit(make_address(MC_STEP1, m.ir) | cond_inputs(m));
+	}
+	m.mar = m.pc;
+	m.ir = m.ram[m.mar];
+	m.pc++;
+	m.mc = 2;
+	const uint64_t before = mCycles;
+	mCycles += 2;
+
+	const Decoded& d = mDecoded[cond_inputs(m) | m.ir];
+	if (!d.exact)
+	{
+		Tick(before);
+		ClockInstruction();
+		return;
+	}
+
+	for (uint8_t i = 0; i < d.count && !m.halted; i++)
+	{
+		const uint32_t ctrl = d.ctrl[i];
+		const uint8_t pc = m.pc;
+		if (mCoverage)
+			mCoverage->Hit(rom_address(m));
+		if (Debug && (ctrl & MW) && IsWatchpoint(m.mar))
+			mWatchHit = true;
+		const uint8_t bus = microcode_step(m, ctrl);
+		if (mTrace)
+			mTrace->Record({mCycles, ctrl, pc, m.ir, uint8_t(2 + i), bus, m.alo, m.flags, false});
+		mCycles++;
+		if (ctrl & OUTW)
+			Out(bus);
+	}
+	Tick(before);
+}
+
+template <typename Observer>
+uint64_t FastSimulator::Run(uint64_t maxCycles, Observer&& observer)
+{
+	return Debugging() ? RunLoop<true>(maxCycles, observer) : RunLoop<false>(maxCycles, observer);
+}
+
+template <bool Debug, typename Observer>
+uint64_t FastSimulator::RunLoop(uint64_t maxCycles, Observer& observer)
+{
+	const uint64_t start = mCycles;
+	//carry on from a breakpoint
+	const bool resume = mStop == STOP_BREAKPOINT;
+	mStop = STOP_CYCLES;
+	mWatchHit = false;
+	do
+	{
+		while (!mMachine.halted && mCycles - start < maxCycles)
+		{
+			//a FILL pass is another go at the FILL before PC, not the instruction at PC
+			const bool looping = FillLooping();
+			const uint8_t pc = looping ? uint8_t(mMachine.pc - 1) : mMachine.pc;
+			if (Debug && mMachine.mc == 0 && !looping && !(resume && mCycles == start) && IsBreakpoint(pc))
+			{
+				mStop = STOP_BREAKPOINT;
+				return mCycles - start;
+			}
+			const uint64_t before = mCycles;
+			Execute<Debug>();
+			observer(pc, mCycles - before);
+			if (Debug && mWatchHit)
+			{
+				mStop = STOP_WATCHPOINT;
+				return mCycles - start;
+			}
+		}
+	} while (mMachine.halted && Wake(start + maxCycles));
+	if (mMachine.halted && !Waiting())
+		mStop = STOP_HALTED;
+	return mCycles - start;
+}
+
+}
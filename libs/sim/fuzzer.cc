@@ -0,0 +1,128 @@
+#include "fuzzer.h"
+
+#include <algorithm>
+
+namespace Cpu
+{
+
+namespace
+{
+
+const size_t max_image = 64;
+const uint64_t max_cycles = 2000;
+//programs which enable interrupts are interrupted, a period landing on a different step each time
+const uint32_t timer_period = 97;
+
+std::string describe(const char* name, unsigned fast, unsigned reference)
+{
+	return std::string(name) + " fast " + std::to_string(fast) + " microcode " + std::to_string(reference);
+}
+
+}
+
+DifferentialFuzzer::DifferentialFuzzer(uint32_t seed, const uint32_t* fastRom)
+:	mRng(seed),
+	mFast(fastRom)
+{
+	mFast.SetTimer(timer_period);
+	mReference.SetTimer(timer_period);
+	mReference.Cover(&mRunCoverage);
+}
+
+void DifferentialFuzzer::Run(uint64_t count)
+{
+	for (uint64_t i = 0; i < count; i++)
+	{
+		const auto image = Generate();
+		mRunCoverage.Clear();
+		const std::string difference = Check(image);
+		if (!difference.empty())
+			mMismatches.push_back({image, difference});
+		if (mCoverage.Merge(mRunCoverage) && mFeedback)
+			mCorpus.push_back(image);
+		mRuns++;
+	}
+}
+
+std::string DifferentialFuzzer::Check(const std::vector<uint8_t>& image)
+{
+	std::vector<uint8_t> ram(image);
+	ram.resize(sizeof(Machine::ram));
+
+	std::vector<uint8_t> fastOut, referenceOut;
+	mFast.Reset();
+	mFast.Load(ram);
+	mFast.OnOut([&fastOut](uint8_t v) {fastOut.push_back(v);});
+	mReference.Reset();
+	mReference.Load(ram);
+	mReference.OnOut([&referenceOut](uint8_t v) {referenceOut.push_back(v);});
+
+	//the fast engine stops at the end of an instruction
+	mFast.Run(max_cycles);
+	mReference.Run(mFast.Cycles());
+
+	const Machine& f = mFast.State();
+	const Machine& r = mReference.State();
+	if (mFast.Cycles() != mReference.Cycles())
+		return describe("cycles", unsigned(mFast.Cycles()), unsigned(mReference.Cycles()));
+	if (f.halted != r.halted)
+		return describe("halted", f.halted, r.halted);
+	const std::pair<const char*, uint8_t Machine::*> regs[] = {
+		{"a", &Machine::a}, {"b", &Machine::b}, {"alo", &Machine::alo}, {"pc", &Machine::pc},
+		{"sp", &Machine::sp}, {"mar", &Machine::mar}, {"ir", &Machine::ir}, {"out", &Machine::out},
+		{"mc", &Machine::mc}, {"flags", &Machine::flags}, {"alox", &Machine::alox}, {"flagsx", &Machine::flagsx}};
+	for (const auto& [name, reg] : regs)
+		if (f.*reg != r.*reg)
+			return describe(name, f.*reg, r.*reg);
+	const std::pair<const char*, bool Machine::*> lines[] = {
+		{"ie", &Machine::ie}, {"irq", &Machine::irq}, {"intr", &Machine::intr}};
+	for (const auto& [name, line] : lines)
+		if (f.*line != r.*line)
+			return describe(name, f.*line, r.*line);
+	for (size_t i = 0; i < sizeof(Machine::ram); i++)
+		if (f.ram[i] != r.ram[i])
+			return describe(("ram[" + std::to_string(i) + "]").c_str(), f.ram[i], r.ram[i]);
+	if (fastOut != referenceOut)
+		return describe("OUT writes", unsigned(fastOut.size()), unsigned(referenceOut.size()));
+	return std::string();
+}
+
+std::vector<uint8_t> DifferentialFuzzer::Generate()
+{
+	auto random = [this](size_t n) {return size_t(mRng() % n);};
+
+	if (mCorpus.empty() || random(2) == 0)
+	{
+		std::vector<uint8_t> image(1 + random(max_image));
+		for (auto& b : image)
+			b = uint8_t(mRng());
+		return image;
+	}
+
+	std::vector<uint8_t> image = mCorpus[random(mCorpus.size())];
+	const size_t mutations = 1 + random(3);
+	for (size_t i = 0; i < mutations; i++)
+	{
+		const size_t at = random(image.size());
+		switch (random(4))
+		{
+		case 0:
+			image[at] = uint8_t(mRng());
+			break;
+		case 1:
+			image[at] ^= uint8_t(1 << random(8));
+			break;
+		case 2:
+			if (image.size() < max_image)
+				image.insert(image.begin() + at, uint8_t(mRng()));
+			break;
+		case 3:
+			if (image.size() > 1)
+				image.erase(image.begin() + at);
+			break;
+		}
+	}
+	return image;
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "coverage.h"
+#include "fast_simulator.h"
+#include "microcode_simulator.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace Cpu
+{
+
+struct FuzzMismatch
+{
+	//RAM from address 0, the rest zero
+	std::vector<uint8_t> image;
+	std::string difference;
+};
+
+/*
+Runs random programs on the fast engine and on the microcode engine and reports any
+difference in the registers, interrupt lines, RAM, cycles or values written to OUT. A timer
+interrupts any program which enables them.
+
+The microcode engine's ROM coverage is the feedback: programs which hit entries no earlier
+program did are kept and later programs are mostly mutations of them, which reaches the
+condition expanded jumps and the rarer flag combinations far sooner than random bytes.
+Each fuzzer is single threaded, run one per thread with different seeds and Merge the
+coverage.
+*/
+class DifferentialFuzzer
+{
+public:
+	//fastRom is the ROM given to the fast engine, the one under test
+	explicit DifferentialFuzzer(uint32_t seed, const uint32_t* fastRom = microcode_rom());
+
+	//Runs count programs
+	void Run(uint64_t count);
+	//With feedback off every program is random
+	void SetFeedback(bool feedback) {mFeedback = feedback;}
+
+	uint64_t Runs() const {return mRuns;}
+	const MicrocodeCoverage& Coverage() const {return mCoverage;}
+	const std::vector<std::vector<uint8_t>>& Corpus() const {return mCorpus;}
+	const std::vector<FuzzMismatch>& Mismatches() const {return mMismatches;}
+
+	//Runs image on both engines, the difference or an empty string
+	std::string Check(const std::vector<uint8_t>& image);
+
+private:
+	std::vector<uint8_t> Generate();
+
+	std::mt19937 mRng;
+	bool mFeedback = true;
+	uint64_t mRuns = 0;
+	FastSimulator mFast;
+	MicrocodeSimulator mReference;
+	MicrocodeCoverage mCoverage;
+	MicrocodeCoverage mRunCoverage;
+	std::vector<std::vector<uint8_t>> mCorpus;
+	std::vector<FuzzMismatch> mMismatches;
+};
+
+}
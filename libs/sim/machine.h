@@ -0,0 +1,232 @@
+#pragma once
+
+#include <ctrl/constants.h>
+#include <ctrl/width.h>
+
+#include <stdint.h>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace Cpu
+{
+
+//ALU flags, latched whenever ALW is set
+#define FLAG_C ((uint8_t)1)	//Carry out
+#define FLAG_Z ((uint8_t)2)	//Result is zero
+#define FLAG_E ((uint8_t)4)	//A=B output, result is all ones (CMP computes Bus - B - 1)
+#define FLAG_N ((uint8_t)8)	//Result bit 7
+
+//Everything clocked on the board, plus the 256 bytes of RAM. The microcode moves addresses
+//over the 8 bit bus in one transfer so the board is Width8 only.
+struct Machine
+{
+	uint8_t a = 0;
+	uint8_t b = 0;
+	uint8_t alo = 0;
+	uint8_t pc = 0;
+	uint8_t sp = 0;
+	uint8_t mar = 0;
+	uint8_t ir = 0;
+	uint8_t out = 0;
+	uint8_t mc = 0;		//micro counter
+	uint8_t flags = 0;
+	uint8_t alox = 0;	//the second ALO and flags, swapped in while an interrupt is handled
+	uint8_t flagsx = 0;
+	bool halted = false;
+	bool ie = false;	//interrupts enabled
+	bool irq = false;	//interrupt requested, held until acknowledged
+	bool intr = false;	//CND_INT, irq and ie latched as the micro counter resets
+	uint8_t ram[Width8::memorySize] = {};
+};
+
+static_assert(std::is_trivially_copyable<Machine>::value, "Machine is copied as a block");
+static_assert(sizeof(Machine) == 16 + 256, "Machine has no padding, it is compared and hashed as bytes");
+
+inline bool operator==(const Machine& a, const Machine& b)
+{
+	return std::memcmp(&a, &b, sizeof(Machine)) == 0;
+}
+
+inline bool operator!=(const Machine& a, const Machine& b)
+{
+	return !(a == b);
+}
+
+//Hash of every register and RAM byte, for spotting states already explored
+inline uint64_t machine_hash(const Machine& m)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&m);
+	uint64_t h = 0x9e3779b97f4a7c15ull;
+	size_t i = 0;
+	for (; i + 8 <= sizeof(Machine); i += 8)
+	{
+		uint64_t word;
+		std::memcpy(&word, bytes + i, 8);
+		h = (h ^ word) * 0xff51afd7ed558ccdull;
+		h ^= h >> 32;
+	}
+	for (; i < sizeof(Machine); i++)
+		h = (h ^ bytes[i]) * 0x100000001b3ull;
+	return h ^ (h >> 29);
+}
+
+/*
+74181 in active high mode. The bus is the A input, register B the B input.
+ACR high means no carry in. Flags are returned through flags.
+*/
+inline uint8_t alu_result(uint32_t ctrl, uint8_t a, uint8_t b, uint8_t& flags)
+{
+	const uint8_t s = (ctrl >> 12) & 0xF;
+	const uint8_t nb = ~b;
+	unsigned f = 0;
+	bool carry = false;
+
+	if (ctrl & AMD)
+	{
+		switch (s)
+		{
+		case 0: f = ~a; break;
+		case 1: f = ~(a | b); break;
+		case 2: f = ~a & b; break;
+		case 3: f = 0; break;
+		case 4: f = ~(a & b); break;
+		case 5: f = nb; break;
+		case 6: f = a ^ b; break;
+		case 7: f = a & nb; break;
+		case 8: f = ~a | b; break;
+		case 9: f = ~(a ^ b); break;
+		case 10: f = b; break;
+		case 11: f = a & b; break;
+		case 12: f = 0xFF; break;
+		case 13: f = a | nb; break;
+		case 14: f = a | b; break;
+		case 15: f = a; break;
+		}
+		f &= 0xFF;
+	}
+	else
+	{
+		//F = P plus Q plus carry in
+		unsigned p = a, q = 0;
+		switch (s)
+		{
+		case 0: p = a; q = 0; break;
+		case 1: p = a | b; q = 0; break;
+		case 2: p = a | nb; q = 0; break;
+		case 3: p = 0; q = 0xFF; break;
+		case 4: p = a; q = a & nb; break;
+		case 5: p = a | b; q = a & nb; break;
+		case 6: p = a; q = nb; break;
+		case 7: p = a & nb; q = 0xFF; break;
+		case 8: p = a; q = a & b; break;
+		case 9: p = a; q = b; break;
+		case 10: p = a | nb; q = a & b; break;
+		case 11: p = a & b; q = 0xFF; break;
+		case 12: p = a; q = a; break;
+		case 13: p = a | b; q = a; break;
+		case 14: p = a | nb; q = a; break;
+		case 15: p = a; q = 0xFF; break;
+		}
+		const unsigned sum = p + q + ((ctrl & ACR) ? 0 : 1);
+		f = sum & 0xFF;
+		carry = sum > 0xFF;
+	}
+
+	flags = (carry ? FLAG_C : 0) |
+		(f == 0 ? FLAG_Z : 0) |
+		(f == 0xFF ? FLAG_E : 0) |
+		((f & 0x80) ? FLAG_N : 0);
+	return static_cast<uint8_t>(f);
+}
+
+/*
+Condition inputs to the microcode eeprom.
+CND_CR is the carry flag. CND_JMP is muxed by instruction bits 5-3, JE (010) selects E,
+JN (100) selects N and everything else selects Z.
+*/
+inline uint16_t cond_inputs(const Machine& m)
+{
+	uint16_t cond = (m.flags & FLAG_C) ? CND_CR : 0;
+	uint8_t jmpFlag = FLAG_Z;
+	switch ((m.ir >> 3) & 7)
+	{
+	case 2: jmpFlag = FLAG_E; break;
+	case 4: jmpFlag = FLAG_N; break;
+	}
+	if (m.flags & jmpFlag)
+		cond |= CND_JMP;
+	return cond;
+}
+
+//eeprom address for the current micro step
+inline uint16_t rom_address(const Machine& m)
+{
+	return make_address(m.mc << 10, m.ir) | cond_inputs(m) | (m.intr ? CND_INT : 0);
+}
+
+//At the start of an instruction, before its step 0 is looked up
+inline void latch_interrupt(Machine& m)
+{
+	if (m.mc == 0)
+		m.intr = m.irq && m.ie;
+}
+
+/*
+One clock of the board. Enabled registers drive the bus, everything written latches the
+bus value at the same edge. Returns the bus value.
+*/
+inline uint8_t microcode_step(Machine& m, uint32_t ctrl)
+{
+	uint8_t bus = 0;
+	if (ctrl & ME)
+		bus = m.ram[m.mar];
+	if (ctrl & RAE)
+		bus = m.a;
+	if (ctrl & RBE)
+		bus = m.b;
+	if (ctrl & PCE)
+		bus = m.pc;
+	if (ctrl & SPE)
+		bus = m.sp;
+	if (ctrl & ALE)
+		bus = m.alo;
+
+	if (ctrl & ALW)
+		m.alo = alu_result(ctrl, bus, m.b, m.flags);
+	if (ctrl & AFX)
+	{
+		std::swap(m.alo, m.alox);
+		std::swap(m.flags, m.flagsx);
+	}
+	if (ctrl & MW)
+		m.ram[m.mar] = bus;
+	if (ctrl & MAW)
+		m.mar = bus;
+	if (ctrl & RAW)
+		m.a = bus;
+	if (ctrl & RBW)
+		m.b = bus;
+	if (ctrl & IRW)
+		m.ir = bus;
+	if (ctrl & SPW)
+		m.sp = bus;
+	if (ctrl & OUTW)
+		m.out = bus;
+	if (ctrl & PCW)
+		m.pc = bus;
+	else if (ctrl & PCC)
+		m.pc++;
+	if (ctrl & HLT)
+		m.halted = true;
+	if (ctrl & IES)
+		m.ie = true;
+	if (ctrl & IEC)
+		m.ie = false;
+	if (ctrl & INA)
+		m.irq = m.intr = false;
+	m.mc = (ctrl & MCR) ? 0 : (m.mc + 1) & 7;
+	return bus;
+}
+
+}
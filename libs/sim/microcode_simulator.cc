@@ -0,0 +1,49 @@
+#include "microcode_simulator.h"
+
+namespace Cpu
+{
+
+uint64_t MicrocodeSimulator::Run(uint64_t maxCycles)
+{
+	const uint64_t start = mCycles;
+	//carry on from a breakpoint
+	const bool resume = mStop == STOP_BREAKPOINT;
+	mStop = STOP_CYCLES;
+	mWatchHit = false;
+	do
+	{
+		if (!Debugging())
+		{
+			while (!mMachine.halted && mCycles - start < maxCycles)
+				Clock();
+			continue;
+		}
+		while (!mMachine.halted && mCycles - start < maxCycles)
+		{
+			if (mMachine.mc == 0 && !FillLooping() && !(resume && mCycles == start) && IsBreakpoint(mMachine.pc))
+			{
+				mStop = STOP_BREAKPOINT;
+				return mCycles - start;
+			}
+			Clock();
+			if (mWatchHit)
+			{
+				mStop = STOP_WATCHPOINT;
+				return mCycles - start;
+			}
+		}
+	} while (mMachine.halted && Wake(start + maxCycles));
+	if (mMachine.halted && !Waiting())
+		mStop = STOP_HALTED;
+	return mCycles - start;
+}
+
+std::unique_ptr<Simulator> MicrocodeSimulator::Fork() const
+{
+	auto fork = std::make_unique<MicrocodeSimulator>(*this);
+	fork->mTrace = nullptr;
+	fork->mCoverage = nullptr;
+	return fork;
+}
+
+}
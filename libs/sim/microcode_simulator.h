@@ -0,0 +1,20 @@
+#pragma once
+
+#include "simulator.h"
+
+namespace Cpu
+{
+
+//Clocks the board one micro step at a time, looking every control word up in the ROM
+class MicrocodeSimulator : public Simulator
+{
+public:
+	using Simulator::Simulator;
+
+	uint64_t Run(uint64_t maxCycles) override;
+	std::unique_ptr<Simulator> Fork() const override;
+	//A single micro step
+	void Step() {Clock();}
+};
+
+}
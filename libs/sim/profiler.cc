@@ -0,0 +1,189 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace Cpu
+{
+
+namespace
+{
+
+bool is_jump(uint8_t ir)
+{
+	return ir >= INSTR_JZ && ir < INSTR_PUSH;
+}
+
+}
+
+Profiler::Profiler(FastSimulator& sim, const std::map<std::string, uint8_t>& labels)
+:	mSim(sim)
+{
+	for (const auto& [name, address] : labels)
+		mNames.emplace(address, name);
+}
+
+std::string Profiler::FunctionName(uint8_t address) const
+{
+	auto it = mNames.find(address);
+	if (it != mNames.end())
+		return it->second;
+	std::ostringstream os;
+	os << "0x" << std::hex << std::setw(2) << std::setfill('0') << unsigned(address);
+	return os.str();
+}
+
+void Profiler::Flush()
+{
+	const uint64_t now = mSim.Cycles();
+	mFrames[mCurrent].cycles += now - mFrameStart;
+	mFrameStart = now;
+}
+
+void Profiler::Enter(uint8_t address)
+{
+	Flush();
+	const auto [it, added] = mFrames[mCurrent].children.emplace(address, mFrames.size());
+	const size_t child = it->second;
+	if (added)
+	{
+		Frame f;
+		f.parent = mCurrent;
+		f.function = address;
+		mFrames.push_back(std::move(f));
+	}
+	mCurrent = child;
+}
+
+void Profiler::Leave()
+{
+	Flush();
+	//a RET with nothing called stays in the outermost frame
+	mCurrent = mFrames[mCurrent].parent;
+}
+
+uint64_t Profiler::Run(uint64_t maxCycles)
+{
+	Machine& m = mSim.State();
+	mFrameStart = mSim.Cycles();
+	if (mFrames.empty())
+	{
+		Frame root;
+		root.function = m.pc;
+		mFrames.push_back(std::move(root));
+	}
+	mInterruptsEnabled = m.ie;
+	mFilling = mSim.FillLooping();
+
+	const uint64_t executed = mSim.Run(maxCycles, [this, &m](uint8_t pc, uint64_t cycles)
+	{
+		if (!mFilling)
+			mExecutions[pc]++;
+		mCycles[pc] += cycles;
+		mFilling = mSim.FillLooping();
+
+		//only DI and taking an interrupt clear the enable, the entry leaves 0 in IR
+		const bool interrupted = mInterruptsEnabled && !m.ie && m.ir != INSTR_DI;
+		mInterruptsEnabled = m.ie;
+		if (interrupted)
+		{
+			Enter(m.pc);
+		}
+		//everything else that changes the flow of control is in the top block
+		else if (m.ir >= INSTR_CALL && !m.halted)
+		{
+			if (m.ir < INSTR_JZ)
+			{
+				Enter(m.pc);
+			}
+			else if (m.ir == INSTR_RET || m.ir == INSTR_RETI)
+			{
+				Leave();
+			}
+			else if (is_jump(m.ir) && m.pc <= pc)
+			{
+				if (!mBackJumps[pc]++ || m.pc < mLoopStart[pc])
+					mLoopStart[pc] = m.pc;
+			}
+		}
+	});
+	Flush();
+	return executed;
+}
+
+uint64_t Profiler::TotalCycles() const
+{
+	uint64_t total = 0;
+	for (const auto cycles : mCycles)
+		total += cycles;
+	return total;
+}
+
+std::vector<HotLoop> Profiler::HotLoops() const
+{
+	std::vector<HotLoop> loops;
+	for (unsigned end = 0; end < 256; end++)
+	{
+		if (!mBackJumps[end])
+			continue;
+		HotLoop loop;
+		loop.start = mLoopStart[end];
+		loop.end = end;
+		loop.iterations = mBackJumps[end];
+		for (unsigned pc = loop.start; pc <= loop.end; pc++)
+			loop.cycles += mCycles[pc];
+		loops.push_back(loop);
+	}
+	std::stable_sort(loops.begin(), loops.end(), [](const HotLoop& a, const HotLoop& b) {return a.cycles > b.cycles;});
+	return loops;
+}
+
+std::map<std::string, uint64_t> Profiler::Stacks() const
+{
+	std::map<std::string, uint64_t> stacks;
+	for (const auto& frame : mFrames)
+	{
+		if (!frame.cycles)
+			continue;
+		std::string stack = FunctionName(frame.function);
+		for (const Frame* f = &frame; f != &mFrames[0];)
+		{
+			f = &mFrames[f->parent];
+			stack = FunctionName(f->function) + ";" + stack;
+		}
+		stacks[stack] += frame.cycles;
+	}
+	return stacks;
+}
+
+void Profiler::WriteCollapsed(std::ostream& os) const
+{
+	for (const auto& [stack, cycles] : Stacks())
+		os << stack << " " << cycles << "\n";
+}
+
+void Profiler::WriteListing(std::ostream& os, const std::map<uint8_t, std::string>& source) const
+{
+	const uint64_t total = std::max<uint64_t>(TotalCycles(), 1);
+
+	os << "; addr     count    cycles      %\n";
+	for (const auto& [address, text] : source)
+	{
+		os << "; " << std::setw(4) << unsigned(address)
+			<< std::setw(10) << mExecutions[address]
+			<< std::setw(10) << mCycles[address]
+			<< std::setw(7) << std::fixed << std::setprecision(2) << 100.0 * mCycles[address] / total
+			<< "\t" << text << "\n";
+	}
+
+	for (const auto& loop : HotLoops())
+	{
+		os << "; loop " << unsigned(loop.start) << "-" << unsigned(loop.end)
+			<< " " << FunctionName(loop.start)
+			<< ", " << loop.iterations << " iterations, " << loop.cycles << " cycles "
+			<< std::setprecision(2) << 100.0 * loop.cycles / total << "%\n";
+	}
+}
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "fast_simulator.h"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Cpu
+{
+
+//A backward jump taken at least once, from the jump at end back to start
+struct HotLoop
+{
+	uint8_t start = 0;
+	uint8_t end = 0;
+	uint64_t iterations = 0;
+	//cycles spent on the instructions from start to end
+	uint64_t cycles = 0;
+};
+
+/*
+Runs a FastSimulator counting executions and cycles (micro steps) per PC, through the
+observer hook on its run loop. A shadow call stack follows CALL and RET so that cycles are
+attributed to the function entered, named by the label at the CALL target. Taking an interrupt
+enters INT_VECTOR and RETI leaves it as CALL and RET do. The first frame is named by the label
+at the starting PC.
+Call stacks are kept as a tree of frames and backward jumps are counted by the address of the
+jump, so nothing is allocated or looked up by name while running.
+*/
+class Profiler
+{
+public:
+	//labels as kept by Program, label to address
+	explicit Profiler(FastSimulator& sim, const std::map<std::string, uint8_t>& labels = {});
+
+	//Runs until HLT or until maxCycles have elapsed, returns the cycles executed
+	uint64_t Run(uint64_t maxCycles);
+
+	uint64_t Executions(uint8_t pc) const {return mExecutions[pc];}
+	uint64_t Cycles(uint8_t pc) const {return mCycles[pc];}
+	uint64_t TotalCycles() const;
+
+	//Self cycles per call stack, frames separated by ';' outermost first
+	std::map<std::string, uint64_t> Stacks() const;
+	//Most cycles first
+	std::vector<HotLoop> HotLoops() const;
+
+	//Collapsed stacks, one "main;f;g cycles" line each, for flamegraph.pl and speedscope
+	void WriteCollapsed(std::ostream& os) const;
+	//Address, executions, cycles and share of the total before each line of source,
+	//keyed by address. Followed by the hot loops.
+	void WriteListing(std::ostream& os, const std::map<uint8_t, std::string>& source) const;
+
+private:
+	struct Frame
+	{
+		size_t parent = 0;
+		uint8_t function = 0;
+		uint64_t cycles = 0;
+		//function address to frame
+		std::map<uint8_t, size_t> children;
+	};
+
+	std::string FunctionName(uint8_t address) const;
+	void Enter(uint8_t address);
+	void Leave();
+	void Flush();
+
+	FastSimulator& mSim;
+	//address to label, the first in order if several share an address
+	std::map<uint8_t, std::string> mNames;
+
+	uint64_t mExecutions[256] = {};
+	uint64_t mCycles[256] = {};
+
+	//the root is frame 0
+	std::vector<Frame> mFrames;
+	size_t mCurrent = 0;
+	uint64_t mFrameStart = 0;
+	//interrupts enabled after the last instruction, cleared by DI or by taking one
+	bool mInterruptsEnabled = false;
+	//FILL going round after the last instruction, its next pass isn't another execution
+	bool mFilling = false;
+
+	//by the address of the jump, times taken and the lowest target
+	uint64_t mBackJumps[256] = {};
+	uint8_t mLoopStart[256] = {};
+};
+
+}
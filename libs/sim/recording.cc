@@ -0,0 +1,257 @@
+#include "recording.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Cpu
+{
+
+namespace
+{
+
+const char magic[8] = {'C', 'P', 'U', 'R', 'E', 'C', 'R', 'D'};
+
+void write_varint(std::ostream& os, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		os.put(char(v | 0x80));
+		v >>= 7;
+	}
+	os.put(char(v));
+}
+
+uint64_t read_varint(std::istream& is)
+{
+	uint64_t v = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		const int c = is.get();
+		if (c == EOF)
+			throw std::runtime_error("recording is truncated");
+		v |= uint64_t(c & 0x7F) << shift;
+		if (!(c & 0x80))
+			return v;
+	}
+	throw std::runtime_error("bad number in recording");
+}
+
+template <typename T>
+void write_raw(std::ostream& os, const T& value)
+{
+	os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T read_raw(std::istream& is)
+{
+	T value;
+	if (!is.read(reinterpret_cast<char*>(&value), sizeof(value)))
+		throw std::runtime_error("recording is truncated");
+	return value;
+}
+
+void write_snapshot(std::ostream& os, const Snapshot& s)
+{
+	write_raw(os, s.machine);
+	write_raw(os, s.cycles);
+	write_raw(os, s.outHash);
+}
+
+Snapshot read_snapshot(std::istream& is)
+{
+	Snapshot s;
+	s.machine = read_raw<Machine>(is);
+	s.cycles = read_raw<uint64_t>(is);
+	s.outHash = read_raw<uint64_t>(is);
+	return s;
+}
+
+}
+
+void Recording::Write(std::ostream& os) const
+{
+	os.write(magic, sizeof(magic));
+	write_varint(os, checkInterval);
+	write_varint(os, timer);
+	write_snapshot(os, start);
+
+	//events and checks in cycle order, each cycle as the difference from the one before
+	uint64_t cycle = start.cycles;
+	auto event = events.begin();
+	auto check = checks.begin();
+	while (event != events.end() || check != checks.end())
+	{
+		if (check == checks.end() || (event != events.end() && event->cycle <= check->cycle))
+		{
+			os.put('E');
+			write_varint(os, event->cycle - cycle);
+			os.put(char(event->address));
+			os.put(char(event->value));
+			cycle = event->cycle;
+			++event;
+		}
+		else
+		{
+			os.put('C');
+			write_varint(os, check->cycle - cycle);
+			write_raw(os, check->outHash);
+			cycle = check->cycle;
+			++check;
+		}
+	}
+	os.put('Z');
+	write_snapshot(os, end);
+}
+
+Recording Recording::Read(std::istream& is)
+{
+	char header[sizeof(magic)];
+	if (!is.read(header, sizeof(header)) || std::memcmp(header, magic, sizeof(magic)) != 0)
+		throw std::runtime_error("not a recording");
+
+	Recording r;
+	r.checkInterval = read_varint(is);
+	r.timer = uint32_t(read_varint(is));
+	r.start = read_snapshot(is);
+	uint64_t cycle = r.start.cycles;
+	while (true)
+	{
+		const int tag = is.get();
+		if (tag == 'E')
+		{
+			Event e;
+			e.cycle = cycle += read_varint(is);
+			e.address = read_raw<uint8_t>(is);
+			e.value = read_raw<uint8_t>(is);
+			r.events.push_back(e);
+		}
+		else if (tag == 'C')
+		{
+			Check c;
+			c.cycle = cycle += read_varint(is);
+			c.outHash = read_raw<uint64_t>(is);
+			r.checks.push_back(c);
+		}
+		else if (tag == 'Z')
+		{
+			r.end = read_snapshot(is);
+			return r;
+		}
+		else
+		{
+			throw std::runtime_error(tag == EOF ? "recording is truncated" : "bad record in recording");
+		}
+	}
+}
+
+Recorder::Recorder(Simulator& sim, uint64_t checkInterval)
+:	mSim(sim)
+{
+	mRecording.checkInterval = std::max<uint64_t>(checkInterval, 1);
+	mRecording.timer = sim.Timer();
+	mRecording.start = sim.Save();
+	mLastHash = sim.OutHash();
+	mNextCheck = (sim.Cycles() / mRecording.checkInterval + 1) * mRecording.checkInterval;
+}
+
+uint64_t Recorder::Run(uint64_t maxCycles)
+{
+	const uint64_t start = mSim.Cycles();
+	while ((!mSim.State().halted || mSim.Waiting()) && mSim.Cycles() - start < maxCycles)
+	{
+		if (mSim.Cycles() < mNextCheck)
+			mSim.Run(std::min(mNextCheck - mSim.Cycles(), maxCycles - (mSim.Cycles() - start)));
+		else
+			mSim.Run(1);
+		if (mSim.Cycles() >= mNextCheck && (mSim.State().mc == 0 || mSim.State().halted))
+		{
+			if (mSim.OutHash() != mLastHash)
+			{
+				mLastHash = mSim.OutHash();
+				mRecording.checks.push_back({mSim.Cycles(), mLastHash});
+			}
+			mNextCheck = (mSim.Cycles() / mRecording.checkInterval + 1) * mRecording.checkInterval;
+		}
+		if (mSim.Stopped() == Simulator::STOP_BREAKPOINT || mSim.Stopped() == Simulator::STOP_WATCHPOINT)
+			break;
+	}
+	return mSim.Cycles() - start;
+}
+
+void Recorder::Inject(uint8_t address, uint8_t value)
+{
+	mRecording.events.push_back({mSim.Cycles(), address, value});
+	mSim.State().ram[address] = value;
+}
+
+const Recording& Recorder::Log()
+{
+	mRecording.end = mSim.Save();
+	return mRecording;
+}
+
+Replayer::Replayer(Simulator& sim, const Recording& recording)
+:	mSim(sim),
+	mRecording(recording)
+{
+}
+
+bool Replayer::Fail(const std::string& what)
+{
+	mMismatchCycle = mSim.Cycles();
+	mMismatch = what;
+	return false;
+}
+
+bool Replayer::Run()
+{
+	const Recording& r = mRecording;
+	mSim.Restore(r.start);
+	mSim.SetTimer(r.timer);
+
+	auto event = r.events.begin();
+	auto check = r.checks.begin();
+	uint64_t expected = r.start.outHash;
+	uint64_t nextCheck = (r.start.cycles / r.checkInterval + 1) * r.checkInterval;
+	while (true)
+	{
+		const uint64_t now = mSim.Cycles();
+		for (; event != r.events.end() && event->cycle == now; ++event)
+			mSim.State().ram[event->address] = event->value;
+		if (now >= r.end.cycles)
+			break;
+
+		//as the recorder, up to the interval boundary then on to the end of the instruction
+		uint64_t target = now < nextCheck ? std::min(nextCheck, r.end.cycles) : now + 1;
+		if (event != r.events.end())
+			target = std::min(target, event->cycle);
+		mSim.Run(target - now);
+
+		if (mSim.Cycles() < target && mSim.State().halted && !mSim.Waiting())
+			return Fail("halted early");
+		if (event != r.events.end() && mSim.Cycles() > event->cycle)
+			return Fail("passed the event at cycle " + std::to_string(event->cycle));
+		if (mSim.Cycles() < nextCheck || !(mSim.State().mc == 0 || mSim.State().halted))
+			continue;
+
+		if (check != r.checks.end() && check->cycle < mSim.Cycles())
+			return Fail("passed the check at cycle " + std::to_string(check->cycle));
+		if (check != r.checks.end() && check->cycle == mSim.Cycles())
+			expected = (check++)->outHash;
+		if (mSim.OutHash() != expected)
+			return Fail("OUT differs");
+		nextCheck = (mSim.Cycles() / r.checkInterval + 1) * r.checkInterval;
+	}
+
+	if (mSim.Cycles() != r.end.cycles)
+		return Fail("ended at a different cycle");
+	if (mSim.OutHash() != r.end.outHash)
+		return Fail("OUT differs");
+	if (mSim.State() != r.end.machine)
+		return Fail("state differs");
+	return true;
+}
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "simulator.h"
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Cpu
+{
+
+/*
+Everything needed to reproduce a run: the state it started from, every byte written into
+RAM from outside along the way and the OUT hash at intervals.
+
+The board has no input devices, so RAM written by a test harness or soak rig, standing in
+for DMA or a memory mapped input, is the only input once the program is loaded.
+*/
+struct Recording
+{
+	struct Event
+	{
+		uint64_t cycle = 0;
+		uint8_t address = 0;
+		uint8_t value = 0;
+	};
+
+	//OUT hash at the first instruction boundary after an interval, when it changed
+	struct Check
+	{
+		uint64_t cycle = 0;
+		uint64_t outHash = 0;
+	};
+
+	uint64_t checkInterval = 64;
+	//Simulator::Timer, replayed with the same period
+	uint32_t timer = 0;
+	Snapshot start;
+	std::vector<Event> events;
+	std::vector<Check> checks;
+	Snapshot end;
+
+	//Cycles are stored as differences, a few bytes an event or check
+	void Write(std::ostream& os) const;
+	//Throws std::runtime_error if the stream doesn't hold a recording
+	static Recording Read(std::istream& is);
+};
+
+/*
+Records a run of sim from its current state. Drive it through Run and write RAM through
+Inject. A check is added at the first instruction boundary after each check interval when
+the OUT hash has changed, so a replay notices a difference in OUT within about an interval.
+*/
+class Recorder
+{
+public:
+	explicit Recorder(Simulator& sim, uint64_t checkInterval = 64);
+
+	//As Simulator::Run
+	uint64_t Run(uint64_t maxCycles);
+	void Inject(uint8_t address, uint8_t value);
+
+	//The recording up to now
+	const Recording& Log();
+
+private:
+	Simulator& mSim;
+	Recording mRecording;
+	uint64_t mLastHash;
+	uint64_t mNextCheck;
+};
+
+/*
+Replays a Recording on sim, stopping where the recorder took checks and at every event. The fast
+engine can only stop between instructions, a recording made on it replays on the microcode
+engine but not the other way round.
+*/
+class Replayer
+{
+public:
+	Replayer(Simulator& sim, const Recording& recording);
+
+	//Runs to the end of the recording, false as soon as OUT or the timing differs
+	bool Run();
+	//Where the first difference was seen, and what it was
+	uint64_t MismatchCycle() const {return mMismatchCycle;}
+	const std::string& Mismatch() const {return mMismatch;}
+
+private:
+	bool Fail(const std::string& what);
+
+	Simulator& mSim;
+	const Recording& mRecording;
+	uint64_t mMismatchCycle = 0;
+	std::string mMismatch;
+};
+
+}
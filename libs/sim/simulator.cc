@@ -0,0 +1,118 @@
+#include "simulator.h"
+#include "coverage.h"
+
+#include <ctrl/microcode.h>
+
+#include <algorithm>
+
+namespace Cpu
+{
+
+const uint32_t* microcode_rom()
+{
+	static const std::vector<uint32_t> rom = make_rom(microcode_table());
+	return rom.data();
+}
+
+std::vector<uint32_t> make_rom(const std::map<uint16_t, uint32_t>& table)
+{
+	std::vector<uint32_t> result(ROM_SIZE);
+	for (uint32_t addr = 0; addr < ROM_SIZE; addr++)
+		result[addr] = microcode_word(table, uint16_t(addr));
+	return result;
+}
+
+Simulator::Simulator(const uint32_t* rom)
+:	mRom(rom)
+{
+}
+
+void Simulator::Load(const std::vector<uint8_t>& image, uint8_t address)
+{
+	const auto count = std::min<size_t>(image.size(), sizeof(mMachine.ram) - address);
+	std::copy(image.begin(), image.begin() + count, mMachine.ram + address);
+}
+
+void Simulator::Reset()
+{
+	Machine reset;
+	std::copy(std::begin(mMachine.ram), std::end(mMachine.ram), reset.ram);
+	mMachine = reset;
+	mCycles = 0;
+	mOutHash = 0;
+}
+
+namespace
+{
+
+bool set_bit(uint64_t* bits, uint8_t address, bool set)
+{
+	const uint64_t bit = uint64_t(1) << (address & 63);
+	const bool was = bits[address >> 6] & bit;
+	bits[address >> 6] = set ? bits[address >> 6] | bit : bits[address >> 6] & ~bit;
+	return was;
+}
+
+}
+
+void Simulator::SetBreakpoint(uint8_t address, bool set)
+{
+	if (set_bit(mBreakpoints, address, set) != set)
+		mDebugPoints += set ? 1 : -1;
+}
+
+void Simulator::SetWatchpoint(uint8_t address, bool set)
+{
+	if (set_bit(mWatchpoints, address, set) != set)
+		mDebugPoints += set ? 1 : -1;
+}
+
+void Simulator::ClearDebugPoints()
+{
+	std::fill(std::begin(mBreakpoints), std::end(mBreakpoints), 0);
+	std::fill(std::begin(mWatchpoints), std::end(mWatchpoints), 0);
+	mDebugPoints = 0;
+}
+
+void Simulator::Clock()
+{
+	latch_interrupt(mMachine);
+	const uint8_t pc = mMachine.pc;
+	const uint8_t ir = mMachine.ir;
+	const uint8_t mc = mMachine.mc;
+	const bool intr = mMachine.intr;
+	const uint16_t address = rom_address(mMachine);
+	if (mCoverage)
+		mCoverage->Hit(address);
+	const uint32_t ctrl = mRom[address];
+	if ((ctrl & MW) && mDebugPoints && IsWatchpoint(mMachine.mar))
+		mWatchHit = true;
+	const uint8_t bus = microcode_step(mMachine, ctrl);
+	if (mTrace)
+		mTrace->Record({mCycles, ctrl, pc, ir, mc, bus, mMachine.alo, mMachine.flags, intr});
+	mCycles++;
+	Tick(mCycles - 1);
+	if (ctrl & OUTW)
+		Out(bus);
+}
+
+bool Simulator::Wake(uint64_t limit)
+{
+	if (!Waiting())
+		return !mMachine.halted;
+	if (!mMachine.irq)
+	{
+		const uint64_t next = (mCycles / mTimer + 1) * mTimer;
+		if (next > limit)
+		{
+			mCycles = std::max(mCycles, limit);
+			return false;
+		}
+		mCycles = next;
+		mMachine.irq = true;
+	}
+	mMachine.halted = false;
+	return true;
+}
+
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "machine.h"
+#include "trace.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace Cpu
+{
+
+#define ROM_SIZE 16384
+
+class MicrocodeCoverage;
+
+//The generated microcode as a flat image, ROM_SIZE control words
+const uint32_t* microcode_rom();
+//A flat image of table, from microcode_table() or make_microcode()
+std::vector<uint32_t> make_rom(const std::map<uint16_t, uint32_t>& table);
+
+//Everything needed to put a simulator back to a point in a run
+struct Snapshot
+{
+	Machine machine;
+	uint64_t cycles = 0;
+	uint64_t outHash = 0;
+};
+
+/*
+State and clock shared by the simulator engines.
+Programs start with every register zeroed, they are loaded into RAM at address 0 by default.
+*/
+class Simulator
+{
+public:
+	explicit Simulator(const uint32_t* rom = microcode_rom());
+	virtual ~Simulator() = default;
+
+	Machine& State() {return mMachine;}
+	const Machine& State() const {return mMachine;}
+	uint64_t Cycles() const {return mCycles;}
+
+	Snapshot Save() const {return {mMachine, mCycles, mOutHash};}
+	void Restore(const Snapshot& snapshot) {mMachine = snapshot.machine; mCycles = snapshot.cycles; mOutHash = snapshot.outHash;}
+	//A copy of this simulator, ROM, state and OnOut included, to run on from here. Trace and
+	//Cover aren't carried over as the fork may run on another thread.
+	virtual std::unique_ptr<Simulator> Fork() const = 0;
+	//machine_hash of the current state, the cycle count isn't included
+	uint64_t Hash() const {return machine_hash(mMachine);}
+
+	void Load(const std::vector<uint8_t>& image, uint8_t address = 0);
+	//Zero every register and the cycle count, RAM is kept
+	void Reset();
+
+	//Called with the bus value whenever OUT is written
+	void OnOut(std::function<void(uint8_t)> f) {mOnOut = std::move(f);}
+	//Rolling hash of every value written to OUT and the cycle it was written on, 0 after Reset
+	uint64_t OutHash() const {return mOutHash;}
+	//Requests an interrupt every period cycles, counted from Reset, 0 for none
+	void SetTimer(uint32_t period) {mTimer = period;}
+	uint32_t Timer() const {return mTimer;}
+	//Halted with interrupts enabled and the timer running or a request pending, Run idles until
+	//the interrupt is taken rather than stopping
+	bool Waiting() const {return mMachine.halted && mMachine.ie && (mMachine.irq || mTimer);}
+	//FILL going round for its next byte, the micro counter is back at a step 0 which does nothing
+	//instead of a fetch and PC is already past FILL
+	bool FillLooping() const {return mMachine.mc == 0 && mRom[rom_address(mMachine)] == 0;}
+
+	//Records every micro step into buffer, nullptr to stop
+	void Trace(TraceBuffer* buffer) {mTrace = buffer;}
+	//Marks the ROM address of every micro step in coverage, nullptr to stop
+	void Cover(MicrocodeCoverage* coverage) {mCoverage = coverage;}
+
+	//Runs until HLT, a breakpoint or watchpoint, or until maxCycles have elapsed, returns the
+	//cycles executed, idle cycles while Waiting included
+	virtual uint64_t Run(uint64_t maxCycles) = 0;
+
+	enum Stop {STOP_CYCLES, STOP_HALTED, STOP_BREAKPOINT, STOP_WATCHPOINT};
+	//Why the last Run returned
+	Stop Stopped() const {return mStop;}
+
+	//Run stops before fetching from a breakpoint, unless the last Run stopped there, and after
+	//the step which writes a watched address. Only writes look at the watchpoints and the
+	//engines run without either check when none are set.
+	void SetBreakpoint(uint8_t address, bool set = true);
+	void SetWatchpoint(uint8_t address, bool set = true);
+	void ClearDebugPoints();
+	bool IsBreakpoint(uint8_t address) const {return mBreakpoints[address >> 6] & (uint64_t(1) << (address & 63));}
+	bool IsWatchpoint(uint8_t address) const {return mWatchpoints[address >> 6] & (uint64_t(1) << (address & 63));}
+	bool Debugging() const {return mDebugPoints != 0;}
+
+protected:
+	//A single micro step using the control word from the ROM
+	void Clock();
+	//The timer's request for the cycles from before to now
+	void Tick(uint64_t before)
+	{
+		if (mTimer && mCycles / mTimer != before / mTimer)
+			mMachine.irq = true;
+	}
+	//Idles while Waiting, up to the timer's next request or limit, false if still halted
+	bool Wake(uint64_t limit);
+	//OUT written with bus
+	void Out(uint8_t bus)
+	{
+		mOutHash = (mOutHash ^ (mCycles << 8 | bus)) * 0x100000001b3ull;
+		mOutHash ^= mOutHash >> 29;
+		if (mOnOut)
+			mOnOut(bus);
+	}
+
+	const uint32_t* mRom;
+	Machine mMachine;
+	uint64_t mCycles = 0;
+	std::function<void(uint8_t)> mOnOut;
+	uint64_t mOutHash = 0;
+	uint32_t mTimer = 0;
+	TraceBuffer* mTrace = nullptr;
+	MicrocodeCoverage* mCoverage = nullptr;
+
+	Stop mStop = STOP_CYCLES;
+	uint64_t mBreakpoints[4] = {};
+	uint64_t mWatchpoints[4] = {};
+	unsigned mDebugPoints = 0;
+	//set by a step which wrote a watched address
+	bool mWatchHit = false;
+};
+
+}
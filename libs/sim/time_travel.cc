@@ -0,0 +1,222 @@
+#include "time_travel.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+
+namespace Cpu
+{
+
+namespace
+{
+
+//checkpoints from one whole copy of RAM to the next
+const size_t key_interval = 32;
+
+static_assert(offsetof(Machine, ram) == sizeof(Machine) - sizeof(Machine::ram), "a checkpoint's registers are the bytes before RAM");
+
+}
+
+TimeTravel::TimeTravel(Simulator& sim, uint64_t interval, size_t maxBytes)
+:	mSim(sim),
+	mInterval(std::max<uint64_t>(interval, 1)),
+	mMaxBytes(maxBytes)
+{
+	Take();
+}
+
+uint64_t TimeTravel::Run(uint64_t maxCycles)
+{
+	DropFrom(mSim.Cycles() + 1);
+	if (mCheckpoints.empty())
+		Take();
+	const uint64_t start = mSim.Cycles();
+	while (!mSim.State().halted && mSim.Cycles() - start < maxCycles)
+	{
+		const uint64_t next = mCheckpoints.back().cycles + mInterval;
+		if (mSim.Cycles() >= next)
+		{
+			Take();
+			continue;
+		}
+		mSim.Run(std::min(next - mSim.Cycles(), maxCycles - (mSim.Cycles() - start)));
+		if (mSim.Stopped() == Simulator::STOP_BREAKPOINT || mSim.Stopped() == Simulator::STOP_WATCHPOINT)
+			break;
+	}
+	if (mSim.Cycles() >= mCheckpoints.back().cycles + mInterval)
+		Take();
+	return mSim.Cycles() - start;
+}
+
+void TimeTravel::Take()
+{
+	const Machine& m = mSim.State();
+	Checkpoint c;
+	c.cycles = mSim.Cycles();
+	c.outHash = mSim.OutHash();
+	std::memcpy(c.registers, &m, sizeof(c.registers));
+
+	size_t sinceKey = 0;
+	for (auto it = mCheckpoints.rbegin(); it != mCheckpoints.rend() && !it->key; ++it)
+		sinceKey++;
+	c.key = mCheckpoints.empty() || sinceKey + 1 >= key_interval;
+	if (c.key)
+	{
+		c.ram.assign(m.ram, m.ram + sizeof(m.ram));
+	}
+	else
+	{
+		for (size_t i = 0; i < sizeof(m.ram); i++)
+		{
+			if (m.ram[i] != mRam[i])
+			{
+				c.ram.push_back(uint8_t(i));
+				c.ram.push_back(m.ram[i]);
+			}
+		}
+	}
+	c.ram.shrink_to_fit();
+	std::memcpy(mRam, m.ram, sizeof(mRam));
+	mBytes += sizeof(Checkpoint) + c.ram.capacity();
+	mCheckpoints.push_back(std::move(c));
+
+	//drop the oldest key and the deltas on it, never the latest group
+	while (mBytes > mMaxBytes)
+	{
+		auto next = std::find_if(mCheckpoints.begin() + 1, mCheckpoints.end(), [](const Checkpoint& c) {return c.key;});
+		if (next == mCheckpoints.end())
+			break;
+		for (auto it = mCheckpoints.begin(); it != next; ++it)
+			mBytes -= sizeof(Checkpoint) + it->ram.capacity();
+		mCheckpoints.erase(mCheckpoints.begin(), next);
+	}
+}
+
+void TimeTravel::DropFrom(uint64_t cycles)
+{
+	if (mCheckpoints.empty() || mCheckpoints.back().cycles < cycles)
+		return;
+	while (!mCheckpoints.empty() && mCheckpoints.back().cycles >= cycles)
+	{
+		mBytes -= sizeof(Checkpoint) + mCheckpoints.back().ram.capacity();
+		mCheckpoints.pop_back();
+	}
+	if (!mCheckpoints.empty())
+		std::memcpy(mRam, Load(mCheckpoints.size() - 1).machine.ram, sizeof(mRam));
+}
+
+void TimeTravel::Modified()
+{
+	DropFrom(mSim.Cycles());
+	Take();
+}
+
+Snapshot TimeTravel::Load(size_t index) const
+{
+	size_t key = index;
+	while (!mCheckpoints[key].key)
+		key--;
+
+	Snapshot s;
+	std::copy(mCheckpoints[key].ram.begin(), mCheckpoints[key].ram.end(), s.machine.ram);
+	for (size_t i = key + 1; i <= index; i++)
+	{
+		const auto& delta = mCheckpoints[i].ram;
+		for (size_t j = 0; j < delta.size(); j += 2)
+			s.machine.ram[delta[j]] = delta[j + 1];
+	}
+	//Machine is trivially copyable, its bytes are written as those of any other array
+	std::memcpy(reinterpret_cast<unsigned char*>(&s.machine), mCheckpoints[index].registers, sizeof(Checkpoint::registers));
+	s.cycles = mCheckpoints[index].cycles;
+	s.outHash = mCheckpoints[index].outHash;
+	return s;
+}
+
+size_t TimeTravel::Before(uint64_t cycles) const
+{
+	auto it = std::lower_bound(mCheckpoints.begin(), mCheckpoints.end(), cycles,
+		[](const Checkpoint& c, uint64_t cycles) {return c.cycles < cycles;});
+	return size_t(it - mCheckpoints.begin()) - 1;
+}
+
+void TimeTravel::Replay(size_t index, uint64_t end, int address,
+	const std::function<void(const Snapshot&, bool, uint64_t)>& visit)
+{
+	if (!mReplay)
+	{
+		mReplay = mSim.Fork();
+		mReplay->OnOut(nullptr);
+		mReplay->ClearDebugPoints();
+		mReplayTrace = std::make_unique<TraceBuffer>(64);
+	}
+	mReplay->Restore(Load(index));
+	mReplay->Trace(address < 0 ? nullptr : mReplayTrace.get());
+
+	uint8_t mar = mReplay->State().mar;
+	std::vector<TraceRecord> records;
+	while (mReplay->Cycles() < end && !mReplay->State().halted)
+	{
+		const Snapshot before = mReplay->Save();
+		mReplay->Run(1);
+
+		bool wrote = false;
+		if (address >= 0)
+		{
+			records.clear();
+			mReplayTrace->Read(mReplayTrace->Consumed(), records);
+			mReplayTrace->Consume(mReplayTrace->Written());
+			//RAM is written at the address MAR held before the edge
+			for (const auto& r : records)
+			{
+				wrote = wrote || ((r.ctrl & MW) && mar == address);
+				if (r.ctrl & MAW)
+					mar = r.bus;
+			}
+		}
+		visit(before, wrote, mReplay->Cycles());
+	}
+}
+
+bool TimeTravel::SearchBack(int address, const std::function<bool(const Snapshot&, bool, uint64_t)>& match)
+{
+	uint64_t end = mSim.Cycles();
+	if (mCheckpoints.empty() || end <= Oldest())
+		return false;
+
+	for (size_t index = Before(end) + 1; index-- > 0;)
+	{
+		std::optional<Snapshot> found;
+		Replay(index, end, address, [&](const Snapshot& before, bool wrote, uint64_t after)
+		{
+			if (match(before, wrote, after))
+				found = before;
+		});
+		if (found)
+		{
+			mSim.Restore(*found);
+			return true;
+		}
+		end = mCheckpoints[index].cycles;
+	}
+	return false;
+}
+
+bool TimeTravel::ReverseStep()
+{
+	const uint64_t now = mSim.Cycles();
+	return SearchBack(-1, [now](const Snapshot&, bool, uint64_t after) {return after >= now;});
+}
+
+bool TimeTravel::ReverseContinue(const std::function<bool(const Machine&)>& stop)
+{
+	return SearchBack(-1, [&stop](const Snapshot& before, bool, uint64_t) {return stop(before.machine);});
+}
+
+bool TimeTravel::ReverseToWrite(uint8_t address)
+{
+	const uint64_t now = mSim.Cycles();
+	return SearchBack(address, [now](const Snapshot&, bool wrote, uint64_t after) {return wrote && after <= now;});
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "simulator.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace Cpu
+{
+
+/*
+Reverse execution by checkpoint and replay.
+
+Run drives the simulator forward, taking a checkpoint every interval cycles. The registers
+are kept whole, RAM as the bytes changed since the checkpoint before, with the whole of RAM
+every 32nd checkpoint. Once the checkpoints use more than maxBytes the oldest are dropped,
+a group at a time, so history starts later.
+
+Going back restores the nearest checkpoint before the target into a fork of the simulator
+and replays from there, so each reverse operation costs at most an interval or two of
+execution however long the run. Positions are the points between the engine's steps,
+instructions for the fast engine and micro steps for the microcode engine. Checkpoints after
+the current position are dropped when running forward again.
+*/
+class TimeTravel
+{
+public:
+	explicit TimeTravel(Simulator& sim, uint64_t interval = 100000, size_t maxBytes = 16 << 20);
+
+	//As Simulator::Run, stopping at breakpoints and watchpoints too
+	uint64_t Run(uint64_t maxCycles);
+	//Call after changing the simulator's state directly, takes a checkpoint of it
+	void Modified();
+
+	//Back to the start of the step before the current position, false at the start of history
+	bool ReverseStep();
+	//Back to the latest earlier position where stop is true, false if there is none
+	bool ReverseContinue(const std::function<bool(const Machine&)>& stop);
+	//Back to just before the latest step which wrote address, false if there is none
+	bool ReverseToWrite(uint8_t address);
+
+	size_t Checkpoints() const {return mCheckpoints.size();}
+	size_t MemoryUsed() const {return mBytes;}
+	//Cycle count of the oldest checkpoint, the furthest back we can go
+	uint64_t Oldest() const {return mCheckpoints.front().cycles;}
+
+private:
+	struct Checkpoint
+	{
+		uint64_t cycles = 0;
+		uint64_t outHash = 0;
+		uint8_t registers[sizeof(Machine) - sizeof(Machine::ram)];
+		//whole of RAM, or address, value pairs changed since the checkpoint before
+		bool key = false;
+		std::vector<uint8_t> ram;
+	};
+
+	void Take();
+	//drops the checkpoints at or after cycles
+	void DropFrom(uint64_t cycles);
+	Snapshot Load(size_t index) const;
+	//latest checkpoint before cycles
+	size_t Before(uint64_t cycles) const;
+	//Steps from checkpoint index until end, calling visit with the state before each step,
+	//whether it wrote address (if not -1) and the cycle count after it
+	void Replay(size_t index, uint64_t end, int address,
+		const std::function<void(const Snapshot&, bool, uint64_t)>& visit);
+	//Searches back a checkpoint at a time for the latest step before now that match picks
+	bool SearchBack(int address, const std::function<bool(const Snapshot&, bool, uint64_t)>& match);
+
+	Simulator& mSim;
+	const uint64_t mInterval;
+	const size_t mMaxBytes;
+	std::deque<Checkpoint> mCheckpoints;
+	size_t mBytes = 0;
+	//RAM at the last checkpoint
+	uint8_t mRam[sizeof(Machine::ram)];
+
+	std::unique_ptr<Simulator> mReplay;
+	std::unique_ptr<TraceBuffer> mReplayTrace;
+};
+
+}
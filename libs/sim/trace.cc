@@ -0,0 +1,346 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Cpu
+{
+
+namespace
+{
+
+const char trace_magic[8] = {'C', 'P', 'U', 'T', 'R', 'A', 'C', 'E'};
+
+void init_header(TraceHeader& header, uint64_t capacity)
+{
+	std::memcpy(header.magic, trace_magic, sizeof(header.magic));
+	header.recordSize = sizeof(TraceRecord);
+	header.reserved = 0;
+	header.capacity = capacity;
+	header.head.store(0);
+	header.tail.store(0);
+}
+
+//Where each register is read onto the bus
+struct Source
+{
+	uint32_t signal;
+	const char* name;
+};
+
+const Source sources[] = {
+	{ME, "[MAR]"}, {RAE, "A"}, {RBE, "B"}, {PCE, "PC"}, {SPE, "SP"}, {ALE, "ALO"}};
+
+//Every register written from the bus, ALW is described by the ALU op
+const Source dests[] = {
+	{MAW, "MAR"}, {MW, "[MAR]"}, {RAW, "A"}, {RBW, "B"}, {IRW, "IR"}, {PCW, "PC"}, {SPW, "SP"}, {OUTW, "OUT"}};
+
+const Source signals[] = {
+	{MAW, "MAW"}, {MW, "MW"}, {ME, "ME"}, {RAW, "RAW"}, {RAE, "RAE"}, {RBW, "RBW"}, {RBE, "RBE"}, {IRW, "IRW"},
+	{PCW, "PCW"}, {PCC, "PCC"}, {PCE, "PCE"}, {MCR, "MCR"}, {HLT, "HLT"}, {SPE, "SPE"}, {SPW, "SPW"}, {OUTW, "OUTW"},
+	{AS3, "AS3"}, {AS2, "AS2"}, {AS1, "AS1"}, {AS0, "AS0"}, {ACR, "ACR"}, {AMD, "AMD"}, {ALE, "ALE"}, {ALW, "ALW"},
+	{IES, "IES"}, {IEC, "IEC"}, {INA, "INA"}, {AFX, "AFX"}};
+
+const char* alu_name(uint32_t ctrl)
+{
+	const uint32_t mask = AS3 | AS2 | AS1 | AS0 | ACR | AMD | ALW;
+	for (uint8_t op = ALU_INC; op <= ALU_XOR; op++)
+	{
+		//logic ops ignore the carry in
+		const uint32_t m = alu_ctrl(op) & AMD ? mask & ~ACR : mask;
+		if ((ctrl & m) == (alu_ctrl(op) & m))
+			return alu_op_name(op);
+	}
+	return "ALU";
+}
+
+bool is_binary(const char* op)
+{
+	return std::strcmp(op, "INC") && std::strcmp(op, "DEC") && std::strcmp(op, "SHIFT") && std::strcmp(op, "NOT");
+}
+
+}
+
+TraceBuffer::TraceBuffer(size_t capacity)
+{
+	Map("", capacity);
+}
+
+TraceBuffer::TraceBuffer(const std::string& path, size_t capacity)
+{
+	if (path.empty())
+		throw std::invalid_argument("TraceBuffer needs a path");
+	Map(path, capacity);
+}
+
+void TraceBuffer::Map(const std::string& path, size_t capacity)
+{
+	size_t records = 2;
+	while (records < capacity + 1)
+		records <<= 1;
+	mMask = records - 1;
+	mSize = sizeof(TraceHeader) + records * sizeof(TraceRecord);
+
+	void* base = nullptr;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	if (!path.empty())
+	{
+		file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+			nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Unable to create " + path);
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(uint64_t(mSize) >> 32), static_cast<DWORD>(mSize), nullptr);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	if (!mapping)
+		throw std::runtime_error("Unable to map the trace buffer");
+	base = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, mSize);
+	CloseHandle(mapping);
+	if (!base)
+		throw std::runtime_error("Unable to map the trace buffer");
+#else
+	int fd = -1;
+	if (!path.empty())
+	{
+		fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0 || ftruncate(fd, mSize) != 0)
+		{
+			if (fd >= 0)
+				close(fd);
+			throw std::runtime_error("Unable to create " + path);
+		}
+	}
+	base = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED, fd, 0);
+	if (fd >= 0)
+		close(fd);
+	if (base == MAP_FAILED)
+		throw std::runtime_error("Unable to map the trace buffer");
+#endif
+
+	mMapping = base;
+	mHeader = new (base) TraceHeader;
+	init_header(*mHeader, records);
+	mRecords = reinterpret_cast<TraceRecord*>(static_cast<char*>(base) + sizeof(TraceHeader));
+}
+
+TraceBuffer::~TraceBuffer()
+{
+#ifdef _WIN32
+	UnmapViewOfFile(mMapping);
+#else
+	munmap(mMapping, mSize);
+#endif
+}
+
+uint64_t TraceBuffer::Read(uint64_t first, std::vector<TraceRecord>& out) const
+{
+	const uint64_t head = Written();
+	uint64_t start = std::max(first, head > Capacity() ? head - Capacity() : 0);
+	const size_t size = out.size();
+	for (uint64_t i = start; i < head; i++)
+		out.push_back(mRecords[i & mMask]);
+
+	//the producer may since have wrapped over the oldest
+	const uint64_t now = Written();
+	if (now > start + Capacity())
+	{
+		const uint64_t lost = std::min(now - Capacity() - start, head - start);
+		out.erase(out.begin() + size, out.begin() + size + lost);
+		start += lost;
+	}
+	return start;
+}
+
+TraceStreamer::TraceStreamer(TraceBuffer& buffer, const std::string& path)
+:	mBuffer(buffer)
+{
+	auto os = std::make_shared<std::ofstream>(path, std::ios::binary);
+	if (!*os)
+		throw std::runtime_error("Unable to create " + path);
+
+	TraceHeader header;
+	init_header(header, 0);
+	os->write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	mBuffer.Consume(mBuffer.Written());
+	mBuffer.SetBlocking(true);
+	mThread = std::thread([this, os]() {Drain(*os);});
+}
+
+TraceStreamer::~TraceStreamer()
+{
+	mStop = true;
+	mThread.join();
+	mBuffer.SetBlocking(false);
+}
+
+void TraceStreamer::Drain(std::ostream& os)
+{
+	std::vector<TraceRecord> records;
+	for (;;)
+	{
+		//stop is read first so nothing recorded before it was set is missed
+		const bool stop = mStop;
+		records.clear();
+		const uint64_t first = mBuffer.Read(mBuffer.Consumed(), records);
+		if (!records.empty())
+		{
+			os.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(TraceRecord));
+			mBuffer.Consume(first + records.size());
+			mStreamed += records.size();
+		}
+		else if (stop)
+		{
+			break;
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+	os.flush();
+}
+
+TraceReader::TraceReader(std::istream& is)
+:	mIs(is)
+{
+	TraceHeader header;
+	if (!mIs.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+		std::memcmp(header.magic, trace_magic, sizeof(trace_magic)) != 0 ||
+		header.recordSize != sizeof(TraceRecord))
+		throw std::runtime_error("Not a trace file");
+
+	mCapacity = header.capacity;
+	mRecords = mIs.tellg();
+	if (mCapacity)
+	{
+		mEnd = header.head.load();
+		mFirst = mEnd >= mCapacity ? mEnd - mCapacity + 1 : 0;
+		mNext = mFirst;
+	}
+}
+
+bool TraceReader::Next(TraceRecord& record)
+{
+	if (mCapacity)
+	{
+		if (mNext == mEnd)
+			return false;
+		mIs.seekg(mRecords + std::streamoff((mNext & (mCapacity - 1)) * sizeof(TraceRecord)));
+		mNext++;
+	}
+	return bool(mIs.read(reinterpret_cast<char*>(&record), sizeof(record)));
+}
+
+std::string trace_signals(uint32_t ctrl)
+{
+	std::string result;
+	for (const auto& s : signals)
+	{
+		if (ctrl & s.signal)
+		{
+			if (!result.empty())
+				result += ' ';
+			result += s.name;
+		}
+	}
+	return result;
+}
+
+std::string trace_transfer(const TraceRecord& record)
+{
+	const uint32_t ctrl = record.ctrl;
+	std::ostringstream os;
+
+	const char* bus = "0";
+	for (const auto& s : sources)
+		if (ctrl & s.signal)
+			bus = s.name;
+
+	auto separate = [&os]()
+	{
+		if (os.tellp() > 0)
+			os << ", ";
+	};
+
+	for (const auto& d : dests)
+	{
+		if (ctrl & d.signal)
+		{
+			separate();
+			os << bus << " -> " << d.name;
+		}
+	}
+	if (ctrl & ALW)
+	{
+		separate();
+		const char* op = alu_name(ctrl);
+		os << "ALO = " << op << " " << bus << (is_binary(op) ? ", B" : "");
+	}
+	if ((ctrl & PCC) && !(ctrl & PCW))
+	{
+		separate();
+		os << "PC++";
+	}
+	if (ctrl & HLT)
+	{
+		separate();
+		os << "HLT";
+	}
+	if (ctrl & (IES | IEC))
+	{
+		separate();
+		os << ((ctrl & IES) ? "IE = 1" : "IE = 0");
+	}
+	if (ctrl & INA)
+	{
+		separate();
+		os << "INT ack";
+	}
+	if (ctrl & AFX)
+	{
+		separate();
+		os << "swap ALO, flags";
+	}
+	return os.str();
+}
+
+void print_trace_record(std::ostream& os, const TraceRecord& record)
+{
+	const auto flags = os.flags();
+	os << std::setw(12) << record.cycle << std::hex << std::setfill('0')
+		<< "  pc " << std::setw(2) << unsigned(record.pc)
+		<< "  ir " << std::setw(2) << unsigned(record.ir)
+		<< "  mc " << unsigned(record.mc)
+		<< "  bus " << std::setw(2) << unsigned(record.bus)
+		<< std::setfill(' ') << "  " << std::left << std::setw(28) << trace_transfer(record) << std::right
+		<< "; " << trace_signals(record.ctrl);
+	if (record.ctrl & (ALW | AFX))
+		os << "  ALO " << std::setfill('0') << std::setw(2) << unsigned(record.alo) << " flags " << unsigned(record.flags);
+	if (record.intr)
+		os << "  INT";
+	os << "\n";
+	os.flags(flags);
+	os.fill(' ');
+}
+
+}
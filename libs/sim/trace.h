@@ -0,0 +1,161 @@
+#pragma once
+
+#include "machine.h"
+
+#include <atomic>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Cpu
+{
+
+/*
+One micro step. The machine state from before the step, the control word and the bus value
+driven during it. Every register written takes the bus value except ALO and the flags, which
+are recorded after the step, so the state can be followed from the records alone. intr is the
+CND_INT input the step was looked up with.
+*/
+struct TraceRecord
+{
+	uint64_t cycle;
+	uint32_t ctrl;
+	uint8_t pc;
+	uint8_t ir;
+	uint8_t mc;
+	uint8_t bus;
+	uint8_t alo;
+	uint8_t flags;
+	bool intr = false;
+	uint8_t reserved = 0;
+};
+
+static_assert(sizeof(TraceRecord) == 24, "TraceRecord is written to disk as is");
+
+/*
+Starts every trace file and the ring mapped by TraceBuffer.
+A ring has capacity slots, record n in slot n % capacity. It keeps the last capacity - 1
+records, the spare slot is the one being written. A stream has capacity 0 and the records
+follow in order.
+*/
+struct TraceHeader
+{
+	char magic[8];
+	uint32_t recordSize;
+	uint32_t reserved;
+	uint64_t capacity;
+	//records written
+	std::atomic<uint64_t> head;
+	//records taken by a TraceStreamer
+	std::atomic<uint64_t> tail;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "TraceHeader is shared through a mapping");
+
+/*
+Single producer ring of TraceRecords in memory mapped with the header, either anonymous or
+backed by a file so another process can read it while the simulator runs, or afterwards.
+Records are published by a release store of head, nothing is locked. By default the oldest
+records are overwritten, when blocking Record waits for the consumer instead.
+*/
+class TraceBuffer
+{
+public:
+	//Keeps at least capacity records, the slots are rounded up to a power of two
+	explicit TraceBuffer(size_t capacity);
+	TraceBuffer(const std::string& path, size_t capacity);
+	~TraceBuffer();
+
+	TraceBuffer(const TraceBuffer&) = delete;
+	TraceBuffer& operator=(const TraceBuffer&) = delete;
+
+	void Record(const TraceRecord& record)
+	{
+		const uint64_t head = mHeader->head.load(std::memory_order_relaxed);
+		if (mBlocking)
+		{
+			while (head - mHeader->tail.load(std::memory_order_acquire) >= mMask)
+				std::this_thread::yield();
+		}
+		mRecords[head & mMask] = record;
+		mHeader->head.store(head + 1, std::memory_order_release);
+	}
+
+	//records kept
+	size_t Capacity() const {return mMask;}
+	uint64_t Written() const {return mHeader->head.load(std::memory_order_acquire);}
+
+	//Appends the records from index first that are still in the ring to out and returns
+	//the index of the first one appended, later than first if some were overwritten
+	uint64_t Read(uint64_t first, std::vector<TraceRecord>& out) const;
+
+	void SetBlocking(bool blocking) {mBlocking = blocking;}
+	//Marks the records before index end as taken, making room when blocking
+	void Consume(uint64_t end) {mHeader->tail.store(end, std::memory_order_release);}
+	uint64_t Consumed() const {return mHeader->tail.load(std::memory_order_acquire);}
+
+private:
+	void Map(const std::string& path, size_t capacity);
+
+	TraceHeader* mHeader = nullptr;
+	TraceRecord* mRecords = nullptr;
+	uint64_t mMask = 0;
+	bool mBlocking = false;
+	size_t mSize = 0;
+	void* mMapping = nullptr;
+};
+
+/*
+Drains a TraceBuffer to a stream file on its own thread, for runs far longer than the ring.
+The buffer blocks while attached so nothing is lost.
+*/
+class TraceStreamer
+{
+public:
+	TraceStreamer(TraceBuffer& buffer, const std::string& path);
+	//Writes what is left and stops
+	~TraceStreamer();
+
+	uint64_t Streamed() const {return mStreamed;}
+
+private:
+	void Drain(std::ostream& os);
+
+	TraceBuffer& mBuffer;
+	std::atomic<bool> mStop{false};
+	std::atomic<uint64_t> mStreamed{0};
+	std::thread mThread;
+};
+
+/*
+Reads the records of a ring or stream file in order, oldest first.
+Throws std::runtime_error if the file is not a trace.
+*/
+class TraceReader
+{
+public:
+	explicit TraceReader(std::istream& is);
+
+	bool Next(TraceRecord& record);
+	//records overwritten before the file was read, only for a ring
+	uint64_t Lost() const {return mFirst;}
+
+private:
+	std::istream& mIs;
+	uint64_t mCapacity = 0;
+	uint64_t mFirst = 0;
+	uint64_t mNext = 0;
+	uint64_t mEnd = 0;
+	std::streampos mRecords;
+};
+
+//The control signals set, as their names from constants.h
+std::string trace_signals(uint32_t ctrl);
+//The register transfers of a step in the mnemonics of the listing, eg "PC -> MAR" or "ALO = ADD A, B"
+std::string trace_transfer(const TraceRecord& record);
+//cycle, pc, ir, mc, bus, transfer and signals on one line
+void print_trace_record(std::ostream& os, const TraceRecord& record);
+
+}
@@ -0,0 +1,150 @@
+#include "vcd_writer.h"
+
+namespace Cpu
+{
+
+namespace
+{
+
+//AFX, the lowest control line, the bits below it are unused
+const int low_bit = 4;
+
+//ids are single printable characters, the control lines from '!' by bit
+char ctrl_id(int bit)
+{
+	return char('!' + bit - low_bit);
+}
+
+const char bus_id = 'a';
+const char pc_id = 'p';
+const char ir_id = 'i';
+const char mc_id = 'm';
+const char jmp_id = 'j';
+const char cr_id = 'c';
+const char int_id = 'n';
+
+const size_t flush_size = 1 << 16;
+
+}
+
+VcdWriter::VcdWriter(std::ostream& os, const std::string& timescale)
+:	mOs(os)
+{
+	WriteHeader(timescale);
+}
+
+VcdWriter::~VcdWriter()
+{
+	if (mStarted)
+		mBuffer += "#" + std::to_string(mTime + 1) + "\n";
+	Flush();
+}
+
+void VcdWriter::WriteHeader(const std::string& timescale)
+{
+	mBuffer += "$version CPU simulator $end\n";
+	mBuffer += "$timescale " + timescale + " $end\n";
+	mBuffer += "$scope module cpu $end\n";
+	for (int bit = 31; bit >= low_bit; bit--)
+		mBuffer += std::string("$var wire 1 ") + ctrl_id(bit) + " " + trace_signals(uint32_t(1) << bit) + " $end\n";
+	mBuffer += std::string("$var wire 8 ") + bus_id + " bus [7:0] $end\n";
+	mBuffer += std::string("$var wire 8 ") + pc_id + " pc [7:0] $end\n";
+	mBuffer += std::string("$var wire 8 ") + ir_id + " ir [7:0] $end\n";
+	mBuffer += std::string("$var wire 3 ") + mc_id + " mc [2:0] $end\n";
+	mBuffer += std::string("$var wire 1 ") + jmp_id + " CND_JMP $end\n";
+	mBuffer += std::string("$var wire 1 ") + cr_id + " CND_CR $end\n";
+	mBuffer += std::string("$var wire 1 ") + int_id + " CND_INT $end\n";
+	mBuffer += "$upscope $end\n";
+	mBuffer += "$enddefinitions $end\n";
+}
+
+void VcdWriter::WriteScalar(bool value, char id)
+{
+	mBuffer += value ? '1' : '0';
+	mBuffer += id;
+	mBuffer += '\n';
+	mChanges++;
+}
+
+void VcdWriter::WriteVector(unsigned value, int bits, char id)
+{
+	mBuffer += 'b';
+	for (int bit = bits - 1; bit >= 0; bit--)
+		mBuffer += (value >> bit) & 1 ? '1' : '0';
+	mBuffer += ' ';
+	mBuffer += id;
+	mBuffer += '\n';
+	mChanges++;
+}
+
+void VcdWriter::Write(const TraceRecord& record)
+{
+	//the ROM sees the flags latched by the steps before
+	mCond.ir = record.ir;
+	mCond.flags = mFlags;
+	mFlags = record.flags;
+
+	Values v;
+	v.ctrl = record.ctrl;
+	v.bus = record.bus;
+	v.pc = record.pc;
+	v.ir = record.ir;
+	v.mc = record.mc;
+	v.cond = cond_inputs(mCond) | (record.intr ? CND_INT : 0);
+
+	const std::string time = "#" + std::to_string(record.cycle) + "\n";
+	if (!mStarted)
+	{
+		mStarted = true;
+		mBuffer += time + "$dumpvars\n";
+		for (int bit = 31; bit >= low_bit; bit--)
+			WriteScalar(v.ctrl & (uint32_t(1) << bit), ctrl_id(bit));
+		WriteVector(v.bus, 8, bus_id);
+		WriteVector(v.pc, 8, pc_id);
+		WriteVector(v.ir, 8, ir_id);
+		WriteVector(v.mc, 3, mc_id);
+		WriteScalar(v.cond & CND_JMP, jmp_id);
+		WriteScalar(v.cond & CND_CR, cr_id);
+		WriteScalar(v.cond & CND_INT, int_id);
+		mBuffer += "$end\n";
+	}
+	else
+	{
+		const Values& last = mLast;
+		const uint32_t changed = v.ctrl ^ last.ctrl;
+		if (changed || v.bus != last.bus || v.pc != last.pc || v.ir != last.ir || v.mc != last.mc || v.cond != last.cond)
+		{
+			mBuffer += time;
+			for (int bit = 31; bit >= low_bit; bit--)
+				if (changed & (uint32_t(1) << bit))
+					WriteScalar(v.ctrl & (uint32_t(1) << bit), ctrl_id(bit));
+			if (v.bus != last.bus)
+				WriteVector(v.bus, 8, bus_id);
+			if (v.pc != last.pc)
+				WriteVector(v.pc, 8, pc_id);
+			if (v.ir != last.ir)
+				WriteVector(v.ir, 8, ir_id);
+			if (v.mc != last.mc)
+				WriteVector(v.mc, 3, mc_id);
+			if ((v.cond ^ last.cond) & CND_JMP)
+				WriteScalar(v.cond & CND_JMP, jmp_id);
+			if ((v.cond ^ last.cond) & CND_CR)
+				WriteScalar(v.cond & CND_CR, cr_id);
+			if ((v.cond ^ last.cond) & CND_INT)
+				WriteScalar(v.cond & CND_INT, int_id);
+		}
+	}
+	mLast = v;
+	mTime = record.cycle;
+
+	if (mBuffer.size() > flush_size)
+		Flush();
+}
+
+void VcdWriter::Flush()
+{
+	mOs.write(mBuffer.data(), mBuffer.size());
+	mBuffer.clear();
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "trace.h"
+
+#include <ostream>
+#include <string>
+
+namespace Cpu
+{
+
+/*
+Writes a Value Change Dump of TraceRecords for GTKWave and logic analyser captures.
+Every control line from constants.h is a 1 bit wire, with the bus, PC, IR, micro counter
+and the CND_ inputs to the ROM. One clock is one timescale unit.
+
+Only values which change are written and the output is built up in a buffer before being
+written out. The CND_ inputs come from the flags of the record before, so a dump should
+start at cycle 0. CND_INT is taken from each record.
+*/
+class VcdWriter
+{
+public:
+	explicit VcdWriter(std::ostream& os, const std::string& timescale = "1us");
+	//Writes the time after the last record
+	~VcdWriter();
+
+	VcdWriter(const VcdWriter&) = delete;
+	VcdWriter& operator=(const VcdWriter&) = delete;
+
+	void Write(const TraceRecord& record);
+	void Flush();
+
+	uint64_t Changes() const {return mChanges;}
+
+private:
+	struct Values
+	{
+		uint32_t ctrl = 0;
+		uint8_t bus = 0;
+		uint8_t pc = 0;
+		uint8_t ir = 0;
+		uint8_t mc = 0;
+		uint16_t cond = 0;
+	};
+
+	void WriteHeader(const std::string& timescale);
+	void WriteScalar(bool value, char id);
+	void WriteVector(unsigned value, int bits, char id);
+
+	std::ostream& mOs;
+	std::string mBuffer;
+	bool mStarted = false;
+	uint64_t mTime = 0;
+	uint8_t mFlags = 0;
+	//only ir and flags, for cond_inputs
+	Machine mCond;
+	Values mLast;
+	uint64_t mChanges = 0;
+};
+
+}
@@ -0,0 +1,386 @@
+#include "superoptimizer.h"
+
+#include <ctrl/microcode.h>
+#include <sim/fast_simulator.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace Cpu
+{
+
+Location Location::Parse(const std::string& name)
+{
+	Location result;
+	if (name.size() > 2 && name.front() == '[' && name.back() == ']')
+	{
+		result.mMemory = true;
+		result.mAddress = uint8_t(std::stoi(name.substr(1, name.size() - 2)));
+	}
+	else if (name == "A")
+		result.mReg = R_A;
+	else if (name == "B")
+		result.mReg = R_B;
+	else if (name == "ALO")
+		result.mReg = R_ALO;
+	else if (name == "OUT")
+		result.mReg = R_OUT;
+	else
+		throw std::runtime_error("unknown location " + name);
+	return result;
+}
+
+uint8_t Location::Read(const Machine& m) const
+{
+	if (mMemory)
+		return m.ram[mAddress];
+	switch (mReg)
+	{
+	case R_A:
+		return m.a;
+	case R_B:
+		return m.b;
+	case R_ALO:
+		return m.alo;
+	}
+	return m.out;
+}
+
+void Location::Write(Machine& m, uint8_t value) const
+{
+	if (mMemory)
+	{
+		m.ram[mAddress] = value;
+		return;
+	}
+	switch (mReg)
+	{
+	case R_A:
+		m.a = value;
+		break;
+	case R_B:
+		m.b = value;
+		break;
+	case R_ALO:
+		m.alo = value;
+		break;
+	default:
+		m.out = value;
+	}
+}
+
+namespace
+{
+
+//Vectors checked during the search, beyond this only the final verification sees them
+const size_t SAMPLE_SIZE = 64;
+//Verification vectors when the inputs are too wide to check every value
+const size_t VERIFY_SIZE = 4096;
+
+void execute(FastSimulator& sim, Machine& m, const std::vector<uint8_t>& bytes)
+{
+	Machine& s = sim.State();
+	s = m;
+	std::copy(bytes.begin(), bytes.end(), s.ram + s.pc);
+	sim.Step();
+	m = s;
+}
+
+}
+
+struct Superoptimizer::SearchState
+{
+	std::atomic<unsigned> bestCost {~0u};
+	std::vector<size_t> best;
+	std::mutex mutex;
+	std::atomic<size_t> nextFirst {0};
+	std::atomic<uint64_t> candidates {0};
+	std::atomic<uint64_t> pruned {0};
+};
+
+struct Superoptimizer::Worker
+{
+	FastSimulator sim;
+	//prefix fingerprint to the cheapest cost it was reached at
+	std::unordered_map<std::string, unsigned> seen;
+	uint64_t candidates = 0;
+	uint64_t pruned = 0;
+};
+
+Superoptimizer::Superoptimizer(const SuperoptimizerSpec& spec)
+:	mSpec(spec)
+{
+	if (mSpec.inputs.empty() || mSpec.outputs.empty())
+		throw std::runtime_error("inputs and outputs are required");
+
+	//candidate code is placed at 0, at most two bytes an instruction
+	const size_t codeSize = std::max<size_t>(mSpec.reference.size(), mSpec.maxLength * 2);
+	auto checkAddress = [codeSize](const Location& l)
+	{
+		if (l.IsMemory() && l.Address() < codeSize)
+			throw std::runtime_error("RAM location " + std::to_string(l.Address()) + " overlaps the code");
+	};
+	std::for_each(mSpec.inputs.begin(), mSpec.inputs.end(), checkAddress);
+	std::for_each(mSpec.outputs.begin(), mSpec.outputs.end(), checkAddress);
+
+	std::vector<uint8_t> addresses;
+	for (const auto& l : mSpec.inputs)
+		if (l.IsMemory())
+			addresses.push_back(l.Address());
+	for (const auto& l : mSpec.outputs)
+		if (l.IsMemory())
+			addresses.push_back(l.Address());
+
+	const auto& table = microcode_table();
+	for (uint16_t instr = 0; instr < 0xC0; instr++)
+	{
+		if (table.find(make_address(MC_STEP2, uint8_t(instr))) == table.end())
+			continue;
+
+		bool operand = false;
+		bool address = false;
+		bool flow = false;
+		for (uint16_t step = 2; step < 8; step++)
+		{
+			const auto it = table.find(make_address(step << 10, uint8_t(instr)));
+			if (it == table.end())
+				break;
+			const uint32_t ctrl = it->second;
+			operand = operand || (ctrl & PCC);
+			//operand loaded into the memory address register
+			address = address || (ctrl & (ME | MAW)) == (ME | MAW);
+			flow = flow || (ctrl & (PCW | HLT));
+			if (ctrl & (MCR | HLT))
+				break;
+		}
+		if (flow)
+			continue;
+
+		const uint8_t cycles = instruction_cycles(uint8_t(instr));
+		if (!operand)
+			mAlphabet.push_back({{uint8_t(instr)}, cycles});
+		else
+			for (const auto value : address ? addresses : mSpec.constants)
+				mAlphabet.push_back({{uint8_t(instr), value}, cycles});
+	}
+
+	mSample = MakeVectors(SAMPLE_SIZE, false);
+	for (const auto& v : mSample)
+		mReferenceCycles = std::max(mReferenceCycles, v.cycles);
+	mVerify = MakeVectors(VERIFY_SIZE, true);
+}
+
+Machine Superoptimizer::MakeState(const std::vector<uint8_t>& values) const
+{
+	Machine m;
+	for (size_t i = 0; i < values.size(); i++)
+		mSpec.inputs[i].Write(m, values[i]);
+	return m;
+}
+
+std::vector<Superoptimizer::Vector> Superoptimizer::MakeVectors(size_t count, bool verify) const
+{
+	const size_t width = mSpec.inputs.size();
+	std::vector<std::vector<uint8_t>> inputs;
+
+	if (verify && width <= 2)
+	{
+		//every value
+		const size_t total = size_t(1) << (8 * width);
+		for (size_t n = 0; n < total; n++)
+		{
+			std::vector<uint8_t> values(width);
+			for (size_t i = 0; i < width; i++)
+				values[i] = uint8_t(n >> (8 * i));
+			inputs.push_back(values);
+		}
+	}
+	else
+	{
+		const uint8_t corners[] = {0, 1, 2, 0x7F, 0x80, 0xFE, 0xFF};
+		if (width <= 2)
+		{
+			for (const auto c0 : corners)
+				for (const auto c1 : corners)
+				{
+					inputs.push_back({c0, c1});
+					inputs.back().resize(width);
+					if (width == 1)
+						break;
+				}
+		}
+		else
+		{
+			for (const auto c : corners)
+				inputs.push_back(std::vector<uint8_t>(width, c));
+		}
+
+		std::mt19937 rng(verify ? 0x5EED : 1);
+		while (inputs.size() < count)
+		{
+			std::vector<uint8_t> values(width);
+			for (auto& v : values)
+				v = uint8_t(rng());
+			inputs.push_back(values);
+		}
+	}
+
+	FastSimulator sim;
+	std::vector<Vector> result;
+	result.reserve(inputs.size());
+	for (const auto& values : inputs)
+	{
+		sim.State() = MakeState(values);
+		sim.Load(mSpec.reference);
+		const auto cycles = sim.Run(mSpec.maxReferenceCycles);
+		if (!sim.State().halted)
+			throw std::runtime_error("reference did not halt within " + std::to_string(mSpec.maxReferenceCycles) + " cycles");
+
+		Vector v;
+		v.values = values;
+		for (const auto& l : mSpec.outputs)
+			v.expected.push_back(l.Read(sim.State()));
+		v.cycles = unsigned(cycles);
+		result.push_back(std::move(v));
+	}
+	return result;
+}
+
+bool Superoptimizer::Matches(const Machine& m, const Vector& v) const
+{
+	for (size_t i = 0; i < mSpec.outputs.size(); i++)
+		if (mSpec.outputs[i].Read(m) != v.expected[i])
+			return false;
+	return true;
+}
+
+bool Superoptimizer::Verify(FastSimulator& sim, const std::vector<size_t>& sequence) const
+{
+	for (const auto& v : mVerify)
+	{
+		Machine m = MakeState(v.values);
+		for (const auto i : sequence)
+			execute(sim, m, mAlphabet[i].bytes);
+		if (!Matches(m, v))
+			return false;
+	}
+	return true;
+}
+
+std::string Superoptimizer::Fingerprint(const std::vector<Machine>& states) const
+{
+	std::string key;
+	key.reserve(states.size() * (5 + mSpec.inputs.size() + mSpec.outputs.size()));
+	for (const auto& m : states)
+	{
+		key += char(m.a);
+		key += char(m.b);
+		key += char(m.alo);
+		key += char(m.out);
+		//ADC and SBC read the carry
+		key += char(m.flags);
+		for (const auto& l : mSpec.inputs)
+			if (l.IsMemory())
+				key += char(m.ram[l.Address()]);
+		for (const auto& l : mSpec.outputs)
+			if (l.IsMemory())
+				key += char(m.ram[l.Address()]);
+	}
+	return key;
+}
+
+void Superoptimizer::Try(SearchState& search, Worker& worker, std::vector<size_t>& sequence,
+	unsigned cost, const std::vector<Machine>& states, size_t i) const
+{
+	const Candidate& c = mAlphabet[i];
+	cost += c.cycles;
+	if (cost > search.bestCost)
+	{
+		worker.pruned++;
+		return;
+	}
+	worker.candidates++;
+
+	std::vector<Machine> next = states;
+	bool match = true;
+	for (size_t v = 0; v < next.size(); v++)
+	{
+		execute(worker.sim, next[v], c.bytes);
+		match = match && Matches(next[v], mSample[v]);
+	}
+
+	sequence.push_back(i);
+	if (match)
+	{
+		//anything longer costs more
+		if (Verify(worker.sim, sequence))
+		{
+			std::lock_guard<std::mutex> lock(search.mutex);
+			if (cost < search.bestCost || (cost == search.bestCost && sequence < search.best))
+			{
+				search.bestCost = cost;
+				search.best = sequence;
+			}
+		}
+	}
+	else if (sequence.size() < mSpec.maxLength && cost < search.bestCost)
+	{
+		std::string fingerprint = Fingerprint(next);
+		const auto it = worker.seen.find(fingerprint);
+		if (it != worker.seen.end() && it->second <= cost)
+		{
+			worker.pruned++;
+		}
+		else
+		{
+			worker.seen[std::move(fingerprint)] = cost;
+			for (size_t n = 0; n < mAlphabet.size(); n++)
+				Try(search, worker, sequence, cost, next, n);
+		}
+	}
+	sequence.pop_back();
+}
+
+SuperoptimizerResult Superoptimizer::Search(unsigned threads)
+{
+	SearchState search;
+	std::vector<Machine> initial;
+	for (const auto& v : mSample)
+		initial.push_back(MakeState(v.values));
+
+	auto work = [&]()
+	{
+		Worker worker;
+		std::vector<size_t> sequence;
+		//only the first instruction is shared out, the seen map is per worker
+		for (size_t first = search.nextFirst++; first < mAlphabet.size(); first = search.nextFirst++)
+			Try(search, worker, sequence, 0, initial, first);
+		search.candidates += worker.candidates;
+		search.pruned += worker.pruned;
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned i = 1; i < std::max(threads, 1u); i++)
+		pool.emplace_back(work);
+	work();
+	for (auto& t : pool)
+		t.join();
+
+	SuperoptimizerResult result;
+	result.found = !search.best.empty();
+	for (const auto i : search.best)
+		result.sequence.push_back(mAlphabet[i].bytes);
+	result.cycles = result.found ? unsigned(search.bestCost) : 0;
+	result.referenceCycles = mReferenceCycles;
+	result.candidates = search.candidates;
+	result.pruned = search.pruned;
+	return result;
+}
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <sim/machine.h>
+
+#include <stdint.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Cpu
+{
+
+class FastSimulator;
+
+//A register or RAM byte which is an input to, or output from, the function being searched for
+class Location
+{
+public:
+	//A, B, ALO, OUT or [address]
+	static Location Parse(const std::string& name);
+
+	uint8_t Read(const Machine& m) const;
+	void Write(Machine& m, uint8_t value) const;
+
+	bool IsMemory() const {return mMemory;}
+	uint8_t Address() const {return mAddress;}
+
+private:
+	bool mMemory = false;
+	uint8_t mReg = 0;
+	uint8_t mAddress = 0;
+};
+
+struct SuperoptimizerSpec
+{
+	//Machine code for the reference implementation, run to HLT on the fast simulator.
+	//It may loop, only its outputs are compared.
+	std::vector<uint8_t> reference;
+	std::vector<Location> inputs;
+	std::vector<Location> outputs;
+	//Immediates tried for instructions which take one, RAM locations are used as addresses
+	std::vector<uint8_t> constants = {0, 1, 255};
+	uint8_t maxLength = 3;
+	uint64_t maxReferenceCycles = 100000;
+};
+
+struct SuperoptimizerResult
+{
+	bool found = false;
+	//bytes of each instruction
+	std::vector<std::vector<uint8_t>> sequence;
+	unsigned cycles = 0;
+	//most cycles taken by the reference over the test vectors
+	unsigned referenceCycles = 0;
+	uint64_t candidates = 0;
+	uint64_t pruned = 0;
+};
+
+/*
+Exhaustive search for the cheapest straight line sequence equivalent to a reference.
+
+Candidates are drawn from every MOV and ALU encoding the microcode implements, costed
+with instruction_cycles(). Sequences are run on the fast simulator against a sample of
+input vectors, a prefix leaving the same registers, flags and RAM locations as a cheaper
+prefix already seen is pruned, as is any prefix costing more than the best solution so far.
+A sequence matching the sample is then checked against every input, or a large random
+sample when there are more than two input bytes.
+The first instruction is spread across threads.
+*/
+class Superoptimizer
+{
+public:
+	explicit Superoptimizer(const SuperoptimizerSpec& spec);
+
+	SuperoptimizerResult Search(unsigned threads = std::thread::hardware_concurrency());
+
+	struct Candidate
+	{
+		std::vector<uint8_t> bytes;
+		uint8_t cycles;
+	};
+	const std::vector<Candidate>& Alphabet() const {return mAlphabet;}
+
+private:
+	struct Vector
+	{
+		std::vector<uint8_t> values;
+		std::vector<uint8_t> expected;
+		unsigned cycles = 0;
+	};
+	struct SearchState;
+	struct Worker;
+
+	Machine MakeState(const std::vector<uint8_t>& values) const;
+	std::vector<Vector> MakeVectors(size_t count, bool verify) const;
+	bool Matches(const Machine& m, const Vector& v) const;
+	bool Verify(FastSimulator& sim, const std::vector<size_t>& sequence) const;
+	//A, B, ALO, OUT, the flags and the RAM locations of the spec, for each sample state
+	std::string Fingerprint(const std::vector<Machine>& states) const;
+	//Appends candidate i to sequence and searches on from there
+	void Try(SearchState& search, Worker& worker, std::vector<size_t>& sequence,
+		unsigned cost, const std::vector<Machine>& states, size_t i) const;
+
+	SuperoptimizerSpec mSpec;
+	std::vector<Candidate> mAlphabet;
+	std::vector<Vector> mSample;
+	std::vector<Vector> mVerify;
+	unsigned mReferenceCycles = 0;
+};
+
+}
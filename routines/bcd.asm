@@ -0,0 +1,35 @@
+;Binary to BCD
+;The led_eeprom decodes a byte written to OUT into three digits itself, this is for
+;showing digits some other way or building up wider numbers.
+;CALL and RET move SP through the ALU so the flags don't survive a return. A, B and ALO
+;are changed.
+
+;bcd8_hi:bcd8_lo = A in packed BCD, the hundreds in bcd8_hi, tens in the top half of
+;bcd8_lo and ones in the bottom half. Hundreds and tens are counted off by subtraction.
+;bcd8 budget: 369 cycles
+bcd8:	MOV B, 0
+		MOV [#bcd8_hi], B
+		MOV [#bcd8_lo], B
+		MOV B, 100
+bcd8_h:	SUB A
+		JC #bcd8_hundred
+		MOV B, 10
+bcd8_t:	SUB A
+		JC #bcd8_ten
+		MOV B, A
+		ADD [#bcd8_lo]
+		MOV [#bcd8_lo], ALO
+		RET
+bcd8_hundred:	MOV A, ALO
+		INC [#bcd8_hi]
+		MOV [#bcd8_hi], ALO
+		JMP #bcd8_h
+bcd8_ten:	MOV A, ALO
+		MOV B, 16
+		ADD [#bcd8_lo]
+		MOV [#bcd8_lo], ALO
+		MOV B, 10
+		JMP #bcd8_t
+
+bcd8_hi:	DB 0
+bcd8_lo:	DB 0
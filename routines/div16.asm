@@ -0,0 +1,35 @@
+;16 by 8 bit divide
+;CALL and RET move SP through the ALU so the flags don't survive a return. ALO is changed.
+
+;div16_lo:div16_hi /= B, the remainder in A. B is kept.
+;Restoring division, the quotient is shifted into div16 from the bottom as the dividend is
+;shifted out of the top into A. A carry out of A means the partial remainder went past
+;255 and B always goes into it.
+;B = 0 gives a quotient of 0xFFFF and the low byte of the dividend as the remainder.
+;div16 budget: 1154 cycles
+div16:	MOV A, 16
+		MOV [#div16_n], A
+		MOV A, 0
+div16_next:	SFT [#div16_lo]
+		MOV [#div16_lo], ALO
+		SFC [#div16_hi]
+		MOV [#div16_hi], ALO
+		SFC A
+		MOV A, ALO
+		JC #div16_big
+		SUB A
+		JC #div16_one
+div16_count:	DEC [#div16_n]
+		MOV [#div16_n], ALO
+		JZ #div16_done
+		JMP #div16_next
+div16_big:	SUB A
+div16_one:	MOV A, ALO
+		INC [#div16_lo]
+		MOV [#div16_lo], ALO
+		JMP #div16_count
+div16_done:	RET
+
+div16_lo:	DB 0
+div16_hi:	DB 0
+div16_n:	DB 0
@@ -0,0 +1,62 @@
+;16 bit arithmetic on x16 and y16, little endian words in RAM
+;ADC, SBC and SFC carry the low byte into the high one. CALL and RET move SP through the
+;ALU so the flags don't survive a return, results are left in x16 or A.
+;Every routine changes B and ALO.
+
+;x16 += y16
+add16:	MOV B, [#y16_lo]
+		ADD [#x16_lo]
+		MOV [#x16_lo], ALO
+		MOV B, [#y16_hi]
+		ADC [#x16_hi]
+		MOV [#x16_hi], ALO
+		RET
+
+;x16 -= y16
+sub16:	MOV B, [#y16_lo]
+		SUB [#x16_lo]
+		MOV [#x16_lo], ALO
+		MOV B, [#y16_hi]
+		SBC [#x16_hi]
+		MOV [#x16_hi], ALO
+		RET
+
+;x16 <<= 1
+shl16:	SFT [#x16_lo]
+		MOV [#x16_lo], ALO
+		SFC [#x16_hi]
+		MOV [#x16_hi], ALO
+		RET
+
+;A = 1 if x16 >= y16, otherwise 0
+cmp16:	MOV B, [#y16_lo]
+		SUB [#x16_lo]
+		MOV B, [#y16_hi]
+		SBC [#x16_hi]
+		MOV A, 0
+		JC #cmp16_ge
+		RET
+cmp16_ge:	MOV A, 1
+		RET
+
+;x16 += 1, the high byte only changes once in 256 so a branch beats ADC
+inc16:	INC [#x16_lo]
+		MOV [#x16_lo], ALO
+		JC #inc16_hi
+		RET
+inc16_hi:	INC [#x16_hi]
+		MOV [#x16_hi], ALO
+		RET
+
+;x16 -= 1
+dec16:	DEC [#x16_lo]
+		MOV [#x16_lo], ALO
+		JC #dec16_done
+		DEC [#x16_hi]
+		MOV [#x16_hi], ALO
+dec16_done:	RET
+
+x16_lo:	DB 0
+x16_hi:	DB 0
+y16_lo:	DB 0
+y16_hi:	DB 0
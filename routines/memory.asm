@@ -0,0 +1,86 @@
+;Block set, copy and compare
+;Addresses and lengths are passed in RAM. A block mustn't run past address 254, CALL
+;pushes the return address at 255.
+;memcpy and memcmp patch the immediate of their indexed loads and stores with the
+;addresses, so they aren't reentrant from an interrupt.
+;CALL and RET move SP through the ALU so the flags don't survive a return. A, B and ALO
+;are changed unless noted.
+
+;Sets memset_len bytes from memset_dst to A, none if memset_len is 0. A is kept.
+;memset budget: 44 + 8n cycles
+memset:	MOV B, 0
+		ADD [#memset_len]
+		JZ #memset_done
+		MOV B, [#memset_dst]
+		ADD [#memset_len]
+		MOV [#memset_end], ALO
+		ADD 0
+		MOV B, [#memset_end]
+		FILL
+memset_done:	RET
+
+memset_dst:	DB 0
+memset_len:	DB 0
+memset_end:	DB 0
+
+;Copies memcpy_len bytes from memcpy_src to memcpy_dst.
+;The last byte is copied first so the blocks may overlap with dst above src.
+;memcpy budget: 47 + 25n cycles
+memcpy:	MOV A, [#memcpy_src]
+		MOV [#memcpy_from], A
+		MOV A, [#memcpy_dst]
+		MOV [#memcpy_to], A
+		MOV A, [#memcpy_len]
+		JMP #memcpy_test
+;MOV A, [memcpy_src+B]
+memcpy_load:	DB 185
+memcpy_from:	DB 0
+;MOV [memcpy_dst+B], A
+		DB 184
+memcpy_to:	DB 0
+		MOV A, B
+memcpy_test:	DEC A
+		MOV B, ALO
+		JC #memcpy_load
+		RET
+
+memcpy_src:	DB 0
+memcpy_dst:	DB 0
+memcpy_len:	DB 0
+
+;Compares memcmp_len bytes at memcmp_a and memcmp_b, A = 0 when they match, otherwise
+;A = 1 if the first byte that differs is greater in memcmp_a and 255 if it is less.
+;memcmp budget: 48 + 50n cycles
+memcmp:	MOV A, [#memcmp_a]
+		MOV [#memcmp_pa], A
+		MOV A, [#memcmp_b]
+		MOV [#memcmp_pb], A
+		MOV B, 0
+memcmp_next:	MOV A, [#memcmp_len]
+		CMP A
+		JE #memcmp_same
+		MOV [#memcmp_i], B
+;MOV A, [memcmp_a+B]
+		DB 185
+memcmp_pa:	DB 0
+;MOV B, [memcmp_b+B]
+		DB 187
+memcmp_pb:	DB 0
+		CMP A
+		JE #memcmp_step
+		MOV A, 255
+		JC #memcmp_more
+		RET
+memcmp_more:	MOV A, 1
+		RET
+memcmp_step:	MOV A, [#memcmp_i]
+		INC A
+		MOV B, ALO
+		JMP #memcmp_next
+memcmp_same:	MOV A, 0
+		RET
+
+memcmp_a:	DB 0
+memcmp_b:	DB 0
+memcmp_len:	DB 0
+memcmp_i:	DB 0
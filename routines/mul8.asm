@@ -0,0 +1,39 @@
+;8x8 bit multiply
+;Arguments and results are in registers where they fit. CALL and RET move SP through the
+;ALU so the flags don't survive a return. ALO is changed.
+
+;A:[mul8_hi] = A * B, the low byte of the product in A. B is kept.
+;The multiplier is shifted out of mul8_m a bit at a time behind a marker bit, which
+;leaves it zero once all eight have gone, so no count is kept.
+;mul8 budget: 483 cycles
+mul8:	MOV [#mul8_m], A
+		MOV A, 0
+		MOV [#mul8_hi], A
+		INC 255
+		SFC [#mul8_m]
+		MOV [#mul8_m], ALO
+		JC #mul8_one
+mul8_zero:	SFT A
+		MOV A, ALO
+		SFC [#mul8_hi]
+		MOV [#mul8_hi], ALO
+mul8_next:	SFT [#mul8_m]
+		MOV [#mul8_m], ALO
+		JZ #mul8_done
+		JC #mul8_one
+		JMP #mul8_zero
+mul8_one:	SFT A
+		MOV A, ALO
+		SFC [#mul8_hi]
+		MOV [#mul8_hi], ALO
+		ADD A
+		MOV A, ALO
+		JC #mul8_carry
+		JMP #mul8_next
+mul8_carry:	INC [#mul8_hi]
+		MOV [#mul8_hi], ALO
+		JMP #mul8_next
+mul8_done:	RET
+
+mul8_m:		DB 0
+mul8_hi:	DB 0
@@ -0,0 +1,194 @@
+#include <asm/source_line.h>
+#include <asm/program.h>
+#include <sim/coverage.h>
+#include <sim/fast_simulator.h>
+#include <sim/microcode_simulator.h>
+#include <sim/profiler.h>
+#include <sim/recording.h>
+#include <sim/vcd_writer.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <memory>
+#include <string>
+
+//sim [--microcode] [--cycles n] [--timer n] [--profile file] [--trace file | --vcd file] [--coverage file] [--record file] < source
+//sim [--microcode] --replay file
+//Assembles the source, runs it and prints every value written to OUT
+//--timer requests an interrupt every n cycles, see EI
+//--profile writes collapsed stacks to file and an annotated listing to stderr, it uses the fast engine
+//--trace streams a record of every micro step to file, see the trace tool
+//--vcd writes every control line, the bus and the micro counter as a value change dump
+//--coverage merges the microcode ROM entries the run hit into file, see fuzz --report
+//--record writes the run to file, --replay runs it again and reports the first cycle OUT or the state differs
+int main(int argc, char** args)
+{
+	bool microcode = false;
+	uint64_t maxCycles = 1000000;
+	uint32_t timer = 0;
+	std::string profile;
+	std::string trace;
+	std::string vcd;
+	std::string coveragePath;
+	std::string record;
+	std::string replay;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = args[i];
+		if (arg == "--microcode")
+			microcode = true;
+		else if (arg == "--cycles" && i + 1 < argc)
+			maxCycles = std::stoull(args[++i]);
+		else if (arg == "--timer" && i + 1 < argc)
+			timer = uint32_t(std::stoul(args[++i]));
+		else if (arg == "--profile" && i + 1 < argc)
+			profile = args[++i];
+		else if (arg == "--trace" && i + 1 < argc)
+			trace = args[++i];
+		else if (arg == "--vcd" && i + 1 < argc)
+			vcd = args[++i];
+		else if (arg == "--coverage" && i + 1 < argc)
+			coveragePath = args[++i];
+		else if (arg == "--record" && i + 1 < argc)
+			record = args[++i];
+		else if (arg == "--replay" && i + 1 < argc)
+			replay = args[++i];
+	}
+
+	if (!replay.empty())
+	{
+		std::ifstream in(replay, std::ios::binary);
+		if (!in)
+		{
+			std::cerr << "can't open " << replay << std::endl;
+			return 1;
+		}
+		try
+		{
+			const Cpu::Recording recording = Cpu::Recording::Read(in);
+			std::unique_ptr<Cpu::Simulator> sim;
+			if (microcode)
+				sim = std::make_unique<Cpu::MicrocodeSimulator>();
+			else
+				sim = std::make_unique<Cpu::FastSimulator>();
+			sim->OnOut([](uint8_t value) {std::cout << unsigned(value) << "\n";});
+			Cpu::Replayer replayer(*sim, recording);
+			if (!replayer.Run())
+			{
+				std::cerr << "; " << replayer.Mismatch() << " at cycle " << replayer.MismatchCycle() << std::endl;
+				return 1;
+			}
+			std::cerr << "; replayed " << recording.end.cycles << " cycles" << std::endl;
+			return 0;
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	Cpu::Program p;
+	while (!std::cin.eof())
+	{
+		std::string s;
+		std::getline(std::cin, s);
+		p.AddLine(Cpu::SourceLine::Parse(s));
+	}
+
+	std::unique_ptr<Cpu::Simulator> sim;
+	if (microcode && profile.empty())
+		sim = std::make_unique<Cpu::MicrocodeSimulator>();
+	else
+		sim = std::make_unique<Cpu::FastSimulator>();
+
+	sim->Load(p.MachineCode());
+	sim->SetTimer(timer);
+	sim->OnOut([](uint8_t value) {std::cout << unsigned(value) << "\n";});
+
+	std::unique_ptr<Cpu::TraceBuffer> buffer;
+	std::unique_ptr<Cpu::TraceStreamer> streamer;
+	if (!trace.empty() && !vcd.empty())
+	{
+		std::cerr << "--trace and --vcd can't be used together" << std::endl;
+		return 1;
+	}
+	Cpu::MicrocodeCoverage coverage;
+	if (!coveragePath.empty())
+		sim->Cover(&coverage);
+
+	if (!trace.empty())
+	{
+		buffer = std::make_unique<Cpu::TraceBuffer>(1 << 16);
+		streamer = std::make_unique<Cpu::TraceStreamer>(*buffer, trace);
+		sim->Trace(buffer.get());
+	}
+
+	if (!vcd.empty())
+	{
+		//run in slices the ring can hold, converting each as it finishes
+		std::ofstream os(vcd);
+		Cpu::VcdWriter writer(os);
+		Cpu::TraceBuffer ring(1 << 16);
+		std::vector<Cpu::TraceRecord> records;
+		sim->Trace(&ring);
+		while ((!sim->State().halted || sim->Waiting()) && sim->Cycles() < maxCycles)
+		{
+			sim->Run(std::min<uint64_t>(maxCycles - sim->Cycles(), 1 << 15));
+			records.clear();
+			ring.Read(ring.Consumed(), records);
+			ring.Consume(ring.Written());
+			for (const auto& r : records)
+				writer.Write(r);
+		}
+		sim->Trace(nullptr);
+	}
+	else if (!record.empty())
+	{
+		Cpu::Recorder recorder(*sim);
+		recorder.Run(maxCycles);
+		std::ofstream os(record, std::ios::binary);
+		recorder.Log().Write(os);
+	}
+	else if (profile.empty())
+	{
+		sim->Run(maxCycles);
+	}
+	else
+	{
+		Cpu::Profiler profiler(static_cast<Cpu::FastSimulator&>(*sim), p.Labels());
+		profiler.Run(maxCycles);
+
+		std::ofstream collapsed(profile);
+		profiler.WriteCollapsed(collapsed);
+
+		std::map<uint8_t, std::string> source;
+		for (const auto& [address, instruction] : p.Instructions())
+		{
+			std::ostringstream os;
+			instruction.Line().Print(os);
+			source[address] = os.str();
+		}
+		profiler.WriteListing(std::cerr, source);
+	}
+	streamer.reset();
+
+	if (!coveragePath.empty())
+	{
+		std::ifstream in(coveragePath, std::ios::binary);
+		if (in)
+			coverage.Read(in);
+		in.close();
+		std::ofstream out(coveragePath, std::ios::binary);
+		coverage.Write(out);
+	}
+
+	const auto& m = sim->State();
+	const bool halted = m.halted && !sim->Waiting();
+	std::cerr << "; " << sim->Cycles() << " cycles" << (halted ? "" : ", not halted")
+		<< ", A " << unsigned(m.a) << ", B " << unsigned(m.b) << ", ALO " << unsigned(m.alo)
+		<< ", PC " << unsigned(m.pc) << ", SP " << unsigned(m.sp) << std::endl;
+	return halted ? 0 : 1;
+}
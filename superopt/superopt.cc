@@ -0,0 +1,91 @@
+#include <asm/source_line.h>
+#include <asm/program.h>
+#include <superopt/superoptimizer.h>
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+std::vector<std::string> Split(const std::string& list)
+{
+	std::vector<std::string> result;
+	std::stringstream ss(list);
+	std::string item;
+	while (std::getline(ss, item, ','))
+		result.push_back(item);
+	return result;
+}
+
+}
+
+//superopt --in A,B --out ALO [--const 0,1,255] [--length 3] [--threads n] < reference
+//Searches for the cheapest straight line sequence giving the same outputs as the reference,
+//which is assembled from stdin and must end with HLT. Locations are A, B, ALO, OUT or [address].
+int main(int argc, char** args)
+{
+	Cpu::SuperoptimizerSpec spec;
+	unsigned threads = std::thread::hardware_concurrency();
+	try
+	{
+		for (int i = 1; i + 1 < argc; i += 2)
+		{
+			const std::string arg = args[i];
+			const std::string value = args[i + 1];
+			if (arg == "--in")
+				for (const auto& l : Split(value))
+					spec.inputs.push_back(Cpu::Location::Parse(l));
+			else if (arg == "--out")
+				for (const auto& l : Split(value))
+					spec.outputs.push_back(Cpu::Location::Parse(l));
+			else if (arg == "--const")
+			{
+				spec.constants.clear();
+				for (const auto& c : Split(value))
+					spec.constants.push_back(uint8_t(std::stoi(c)));
+			}
+			else if (arg == "--length")
+				spec.maxLength = uint8_t(std::stoi(value));
+			else if (arg == "--threads")
+				threads = unsigned(std::stoi(value));
+		}
+
+		Cpu::Program p;
+		while (!std::cin.eof())
+		{
+			std::string s;
+			std::getline(std::cin, s);
+			p.AddLine(Cpu::SourceLine::Parse(s));
+		}
+		spec.reference = p.MachineCode();
+
+		const auto start = std::chrono::steady_clock::now();
+		Cpu::Superoptimizer optimizer(spec);
+		const auto result = optimizer.Search(threads);
+		const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+		std::cerr << "; " << optimizer.Alphabet().size() << " instructions, " << result.candidates << " candidates, "
+			<< result.pruned << " pruned, " << ms << "ms" << std::endl;
+		if (!result.found)
+		{
+			std::cerr << "; nothing within " << unsigned(spec.maxLength) << " instructions" << std::endl;
+			return 1;
+		}
+
+		//address : value, as the assembler writes it
+		unsigned address = 0;
+		for (const auto& instr : result.sequence)
+			for (const auto b : instr)
+				std::cout << address++ << " : " << unsigned(b) << "\n";
+		std::cerr << "; " << result.cycles << " cycles, reference " << result.referenceCycles << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,198 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <server/asm_server.h>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+//Writes 1, 2, 3 to OUT
+const std::string source = "MOV A, 1\nloop: MOV OUT, A\nINC A\nMOV A, ALO\nMOV B, 4\nCMP A\nJE #done\nJMP #loop ; bound 3\ndone: HLT\n";
+
+std::string Bytes(const std::vector<uint8_t>& image)
+{
+	std::string result;
+	for (const auto b : image)
+		result += std::to_string(b) + "\n";
+	return result;
+}
+
+std::vector<uint8_t> Assemble(const std::string& text)
+{
+	Program p;
+	std::istringstream in(text);
+	std::string s;
+	while (std::getline(in, s))
+		p.AddLine(SourceLine::Parse(s));
+	return p.MachineCode();
+}
+
+//Connects once the server is listening
+std::unique_ptr<AsmClient> Connect(const std::string& path)
+{
+	for (int i = 0; ; i++)
+	{
+		try
+		{
+			return std::make_unique<AsmClient>(path);
+		}
+		catch (const std::runtime_error&)
+		{
+			if (i == 500)
+				throw;
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+	}
+}
+
+}
+
+TEST(ThreadPool, runs_every_task)
+{
+	std::atomic<int> count = 0;
+	{
+		ThreadPool pool(4);
+		EXPECT_EQ(pool.Threads(), 4u);
+		for (int i = 0; i < 1000; i++)
+			pool.Submit([&count]() {count++;});
+	}
+	EXPECT_EQ(count, 1000);
+}
+
+TEST(AsmServer, assemble)
+{
+	AsmServer server(1);
+	const auto response = server.Handle({ServerRequest::ASSEMBLE, 0, source});
+	EXPECT_EQ(response.status, 0);
+	EXPECT_EQ(response.out, Bytes(Assemble(source)));
+	EXPECT_EQ(response.err, "");
+
+	//every line is cached, the empty one after the last newline included
+	EXPECT_EQ(server.CachedLines(), 10u);
+	EXPECT_EQ(server.CacheHits(), 0u);
+	server.Handle({ServerRequest::ASSEMBLE, ServerRequest::LISTING, source});
+	EXPECT_EQ(server.CacheHits(), 10u);
+	EXPECT_EQ(server.Requests(), 2u);
+}
+
+TEST(AsmServer, flags)
+{
+	AsmServer server(1);
+	const auto listing = server.Handle({ServerRequest::ASSEMBLE, ServerRequest::LISTING, source});
+	EXPECT_THAT(listing.out, HasSubstr("loop"));
+	const auto timing = server.Handle({ServerRequest::ASSEMBLE, ServerRequest::TIMING, source});
+	EXPECT_EQ(timing.out, Bytes(Assemble(source)));
+	EXPECT_NE(timing.err, "");
+}
+
+TEST(AsmServer, simulate_and_cost)
+{
+	AsmServer server(1);
+	const auto run = server.Handle({ServerRequest::SIMULATE, 0, source});
+	EXPECT_EQ(run.status, 0);
+	EXPECT_EQ(run.out, "1\n2\n3\n");
+	EXPECT_THAT(run.err, HasSubstr("cycles"));
+
+	const auto cost = server.Handle({ServerRequest::COST, 0, source});
+	EXPECT_EQ(cost.status, 0);
+	EXPECT_NE(cost.out, "");
+}
+
+TEST(AsmServer, errors)
+{
+	AsmServer server(1);
+	const auto response = server.Handle({ServerRequest::ASSEMBLE, 0, "MOV A, [B"});
+	EXPECT_EQ(response.status, 1);
+	EXPECT_EQ(response.out, "");
+	EXPECT_NE(response.err, "");
+	EXPECT_EQ(server.Handle({ServerRequest::Kind('x'), 0, source}).status, 1);
+}
+
+TEST(AsmServer, unknown_label)
+{
+	AsmServer server(1);
+	for (const auto kind : {ServerRequest::ASSEMBLE, ServerRequest::SIMULATE})
+	{
+		const auto response = server.Handle({kind, 0, "MOV A, 1\nJMP #missing"});
+		EXPECT_EQ(response.status, 1);
+		EXPECT_EQ(response.out, "");
+		EXPECT_THAT(response.err, HasSubstr("unknown label missing"));
+	}
+	EXPECT_EQ(server.Handle({ServerRequest::ASSEMBLE, 0, source}).out, Bytes(Assemble(source)));
+}
+
+TEST(AsmServer, bad_line_over_socket)
+{
+	const std::string path = (std::filesystem::temp_directory_path() / ("asm_server_bad." + std::to_string(::getpid()))).string();
+	AsmServer server(2);
+	std::thread listener([&server, &path]() {server.Listen(path);});
+
+	//lines the encoder can't encode are answered with an error, the server carries on
+	auto client = Connect(path);
+	for (const auto bad : {"PUSH 5", "MOV ALO, A", "CALL", "MOV [A], [B]"})
+	{
+		const auto response = client->Send({ServerRequest::ASSEMBLE, 0, bad});
+		EXPECT_EQ(response.status, 1) << bad;
+		EXPECT_NE(response.err, "") << bad;
+	}
+	EXPECT_EQ(client->Send({ServerRequest::ASSEMBLE, 0, source}).out, Bytes(Assemble(source)));
+	EXPECT_EQ(Connect(path)->Send({ServerRequest::SIMULATE, 0, source}).out, "1\n2\n3\n");
+
+	server.Stop();
+	listener.join();
+}
+
+TEST(AsmServer, cache_limit)
+{
+	AsmServer server(1, 4);
+	server.Handle({ServerRequest::ASSEMBLE, 0, source});
+	EXPECT_LE(server.CachedLines(), 4u);
+}
+
+TEST(AsmServer, socket)
+{
+	const std::string path = (std::filesystem::temp_directory_path() / ("asm_server_test." + std::to_string(::getpid()))).string();
+	AsmServer server(4);
+	std::thread listener([&server, &path]() {server.Listen(path);});
+
+	//several clients at once, each sending a few requests on its connection
+	const std::string expected = Bytes(Assemble(source));
+	std::atomic<int> answered = 0;
+	std::vector<std::thread> clients;
+	for (int i = 0; i < 4; i++)
+	{
+		clients.emplace_back([&]()
+		{
+			auto client = Connect(path);
+			for (int j = 0; j < 10; j++)
+			{
+				if (client->Send({ServerRequest::ASSEMBLE, 0, source}).out == expected
+					&& client->Send({ServerRequest::SIMULATE, 0, source}).out == "1\n2\n3\n")
+					answered++;
+			}
+		});
+	}
+	for (auto& t : clients)
+		t.join();
+	EXPECT_EQ(answered, 40);
+
+	//an idle connection doesn't keep Listen from returning
+	auto idle = Connect(path);
+	server.Stop();
+	listener.join();
+	EXPECT_FALSE(std::filesystem::exists(path));
+	EXPECT_THROW(idle->Send({ServerRequest::ASSEMBLE, 0, source}), std::runtime_error);
+}
+
+}}
@@ -0,0 +1,156 @@
+#include "gmock/gmock.h"
+#include <asm/batch_assembler.h>
+#include <asm/program.h>
+
+#include <memory_resource>
+#include <sstream>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+std::vector<uint8_t> AssembleProgram(const std::string& source)
+{
+	Program p;
+	std::istringstream in(source);
+	std::string s;
+	while (std::getline(in, s))
+		p.AddLine(SourceLine::Parse(s));
+	return p.MachineCode();
+}
+
+const std::vector<std::string> sources =
+{
+	"ADD A\nlabel: ADD A\nJC #label\nHLT",
+	"MOV A, 42\nMOV B, [12]\nMOV [12], A\t\t;store\nMOV [A], B\nMOV OUT, [A]",
+	"start:\tMOV A, ALO\nAND 122\nSUB [A]\nJE #end\nJMP #start\nend: HLT",
+	"PUSH A\nPOP A\nCALL 124\nCALL B\nRET\nNOOP\n",
+	"CALL #f\nHLT\nf: MOV A, [#x]\nADD #x\nMOV [#x], ALO\nMOV B, #f\nRET\nx: DB 7\nDB 8",
+	"ADD [12]\nSBC [#x]\nMOV A, [42+B]\nMOV B, [#x+B]\nMOV [42+B], A\nMOV [#x+B], A\nx: DB 0",
+};
+
+//Counts what the arena takes from the heap
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+	size_t allocations = 0;
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		allocations++;
+		return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override
+	{
+		std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+}
+
+TEST(BatchAssembler, matches_program)
+{
+	std::byte buffer[4096];
+	std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer));
+	BatchAssembler assembler(arena);
+
+	for (const auto& source : sources)
+	{
+		std::vector<uint8_t> output;
+		assembler.Assemble(source, output);
+		EXPECT_EQ(output, AssembleProgram(source)) << source;
+	}
+}
+
+TEST(BatchAssembler, offsets)
+{
+	std::byte buffer[4096];
+	std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer));
+	BatchAssembler assembler(arena);
+
+	std::vector<std::string_view> views(sources.begin(), sources.end());
+	std::vector<uint8_t> output;
+	std::vector<uint32_t> offsets;
+	assembler.Assemble(views.data(), views.size(), output, offsets);
+
+	ASSERT_EQ(offsets.size(), sources.size() + 1);
+	EXPECT_EQ(offsets.back(), output.size());
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		std::vector<uint8_t> program(output.begin() + offsets[i], output.begin() + offsets[i + 1]);
+		EXPECT_EQ(program, AssembleProgram(sources[i]));
+	}
+}
+
+TEST(BatchAssembler, reuses_scratch)
+{
+	CountingResource upstream;
+	std::pmr::monotonic_buffer_resource arena(&upstream);
+	BatchAssembler assembler(arena);
+
+	std::vector<std::string_view> views(sources.begin(), sources.end());
+	std::vector<uint8_t> output;
+	std::vector<uint32_t> offsets;
+	assembler.Assemble(views.data(), views.size(), output, offsets);
+	const size_t warm = upstream.allocations;
+	EXPECT_GT(warm, 0u);
+
+	for (int i = 0; i < 100; i++)
+	{
+		output.clear();
+		assembler.Assemble(views.data(), views.size(), output, offsets);
+		EXPECT_THROW(assembler.Assemble("ADD A\nJMP #nowhere", output), std::runtime_error);
+	}
+	EXPECT_EQ(upstream.allocations, warm);
+
+	output.clear();
+	assembler.Assemble(sources[4], output);
+	EXPECT_EQ(output, AssembleProgram(sources[4]));
+}
+
+TEST(BatchAssembler, unknown_label)
+{
+	std::pmr::monotonic_buffer_resource arena;
+	BatchAssembler assembler(arena);
+	std::vector<uint8_t> output;
+	EXPECT_THROW(assembler.Assemble("JMP #nowhere", output), std::runtime_error);
+}
+
+TEST(BatchAssembler, bad_parameters)
+{
+	std::pmr::monotonic_buffer_resource arena;
+	BatchAssembler assembler(arena);
+	std::vector<uint8_t> output;
+	for (const auto s : {"MOV A, 42+B", "MOV A, [42B]", "ADD [12+B]", "MOV [A+B], A", "MOV [42+B], B", "MOV OUT, [42+B]"})
+		EXPECT_THROW(assembler.Assemble(s, output), std::runtime_error) << s;
+}
+
+//Lines the encoders can't encode throw as they do for Instruction, the assembler carries on
+TEST(BatchAssembler, malformed_lines)
+{
+	std::pmr::monotonic_buffer_resource arena;
+	BatchAssembler assembler(arena);
+	std::vector<uint8_t> output;
+	for (const auto s : {"MOV", "MOV A", "ADD", "ADD A, B", "JMP", "JMP A, B", "CALL", "DB", "DB A", "PUSH 5", "POP [A]",
+		"POP B", "POP ALO", "PUSH OUT", "CALL OUT", "ADD OUT", "JMP OUT", "MOV A, []", "MOV [], A", "MOV A, [+B]",
+		"MOV [A], [B]", "MOV [42], 5", "MOV 5, A", "MOV ALO, A", "MOV [OUT], A", "MOV A, OUT"})
+	{
+		EXPECT_THROW(assembler.Assemble(s, output), std::runtime_error) << s;
+		EXPECT_ANY_THROW(AssembleProgram(s)) << s;
+	}
+	EXPECT_TRUE(output.empty());
+
+	assembler.Assemble(sources[4], output);
+	EXPECT_EQ(output, AssembleProgram(sources[4]));
+}
+
+}}
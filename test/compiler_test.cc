@@ -0,0 +1,249 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <compiler/compiler.h>
+#include <sim/fast_simulator.h>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+struct RunResult
+{
+	std::vector<uint8_t> out;
+	uint64_t cycles = 0;
+};
+
+RunResult CompileAndRun(const std::string& source, bool optimize)
+{
+	CompilerOptions options;
+	options.optimize = optimize;
+	Program p;
+	for (const auto& line : Compiler(options).Compile(source))
+		p.AddLine(line);
+
+	FastSimulator sim;
+	RunResult result;
+	sim.OnOut([&](uint8_t v) {result.out.push_back(v);});
+	sim.Load(p.MachineCode());
+	result.cycles = sim.Run(1000000);
+	EXPECT_TRUE(sim.State().halted);
+	return result;
+}
+
+//Both translations must agree, the optimised one by a clear margin
+RunResult Benchmark(const std::string& source)
+{
+	const auto optimized = CompileAndRun(source, true);
+	const auto naive = CompileAndRun(source, false);
+	EXPECT_EQ(optimized.out, naive.out);
+	EXPECT_LT(optimized.cycles * 4, naive.cycles * 3) << optimized.cycles << " vs " << naive.cycles;
+	return optimized;
+}
+
+const char* sum_and_multiply = R"(
+byte data[8] = {3, 1, 4, 1, 5, 9, 2, 6};
+
+byte sum(byte n)
+{
+	byte i = 0;
+	byte total = 0;
+	while (i < n)
+	{
+		total = total + data[i];
+		i = i + 1;
+	}
+	return total;
+}
+
+byte mul(byte a, byte b)
+{
+	byte r = 0;
+	while (b)
+	{
+		r = r + a;
+		b = b - 1;
+	}
+	return r;
+}
+
+void main()
+{
+	out(sum(8));
+	out(mul(7, 6));
+	out(mul(sum(4), sum(2) + 1));
+}
+)";
+
+const char* gcd = R"(
+byte gcd(byte a, byte b)
+{
+	while (a != b)
+	{
+		if (a > b)
+			a = a - b;
+		else
+			b = b - a;
+	}
+	return a;
+}
+
+void main()
+{
+	out(gcd(48, 18));
+	out(gcd(gcd(100, 75), 15));
+	out(gcd(17, 5));
+}
+)";
+
+const char* sort = R"(
+byte values[6] = {9, 200, 3, 0, 77, 3};
+
+void main()
+{
+	byte i = 0;
+	while (i < 5)
+	{
+		byte j;
+		j = 0;
+		while (j < 5 - i)
+		{
+			byte a = values[j];
+			byte b = values[j + 1];
+			if (a > b)
+			{
+				values[j] = b;
+				values[j + 1] = a;
+			}
+			j = j + 1;
+		}
+		i = i + 1;
+	}
+	i = 0;
+	while (i <= 5)
+	{
+		out(values[i]);
+		i = i + 1;
+	}
+}
+)";
+
+const char* fibonacci = R"(
+byte fib[13];
+
+void main()
+{
+	byte n = 2;
+	fib[0] = 0;
+	fib[1] = 1;
+	while (n < 13)
+	{
+		fib[n] = fib[n - 1] + fib[n - 2];
+		n = n + 1;
+	}
+	out(fib[12]);
+	out(fib[7]);
+}
+)";
+
+}
+
+TEST(Compiler, benchmarks)
+{
+	EXPECT_EQ(Benchmark(sum_and_multiply).out, (std::vector<uint8_t>{31, 42, 45}));
+	EXPECT_EQ(Benchmark(gcd).out, (std::vector<uint8_t>{6, 5, 1}));
+	EXPECT_EQ(Benchmark(sort).out, (std::vector<uint8_t>{0, 3, 3, 9, 77, 200}));
+	EXPECT_EQ(Benchmark(fibonacci).out, (std::vector<uint8_t>{144, 13}));
+}
+
+TEST(Compiler, expressions)
+{
+	const char* source = R"(
+byte x = 12;
+byte y = 5;
+byte f(byte a, byte b) { return a - b; }
+void main()
+{
+	byte z = 3;
+	out(x + y);
+	out(x - (y - (z - 1)));
+	out((x & 4) | (y ^ 1));
+	out(~x);
+	out(-y);
+	out(y << 3);
+	out(255 + x);
+	out(f(f(20, 3), f(x, y)));
+	out(x + f(y, 1) - f(z, z));
+	out(2 + 3 + 0x10);
+}
+)";
+	const auto expected = std::vector<uint8_t>{17, 9, 4 | 4, uint8_t(~12), uint8_t(-5), 40, 11, 10, 16, 21};
+	EXPECT_EQ(CompileAndRun(source, true).out, expected);
+	EXPECT_EQ(CompileAndRun(source, false).out, expected);
+}
+
+TEST(Compiler, conditions)
+{
+	const char* source = R"(
+void test(byte a, byte b)
+{
+	byte r = 0;
+	if (a == b) r = r | 1;
+	if (a != b) r = r | 2;
+	if (a < b) r = r | 4;
+	if (a > b) r = r | 8;
+	if (a <= b) r = r | 16;
+	if (a >= b) r = r | 32;
+	if (a - b) r = r | 64;
+	if (a) r = r | 128;
+	out(r);
+}
+void main()
+{
+	test(3, 3);
+	test(2, 200);
+	test(200, 2);
+	test(0, 255);
+}
+)";
+	const auto expected = std::vector<uint8_t>{1 | 16 | 32 | 128, 2 | 4 | 16 | 64 | 128, 2 | 8 | 32 | 64 | 128, 2 | 4 | 16 | 64};
+	EXPECT_EQ(CompileAndRun(source, true).out, expected);
+	EXPECT_EQ(CompileAndRun(source, false).out, expected);
+}
+
+TEST(Compiler, immediate_forms)
+{
+	const auto lines = Compiler().Compile("byte x; void main() { out(5); out(x); x = 1; }");
+	ASSERT_GE(lines.size(), 4u);
+	EXPECT_EQ(lines[1].OpCode(), "MOV");
+	EXPECT_EQ(*lines[1].Param1(), "OUT");
+	EXPECT_EQ(*lines[1].Param2(), "5");
+	EXPECT_EQ(*lines[2].Param2(), "[#x]");
+}
+
+TEST(Compiler, memory_forms)
+{
+	const auto lines = Compiler().Compile("byte a[4]; byte x; byte i; void main() { a[i] = x; out(a[i] + x); }");
+	std::vector<std::string> params;
+	for (const auto& line : lines)
+		for (const auto& p : {line.Param1(), line.Param2()})
+			if (p)
+				params.push_back(*p);
+	//indexed loads and stores, x added straight from memory
+	EXPECT_THAT(params, Contains("[#a+B]").Times(2));
+	EXPECT_EQ(std::count(params.begin(), params.end(), "[#x]"), 2);
+}
+
+TEST(Compiler, errors)
+{
+	EXPECT_THROW(Compiler().Compile("void f() {}"), std::runtime_error);
+	EXPECT_THROW(Compiler().Compile("void main() { out(y); }"), std::runtime_error);
+	EXPECT_THROW(Compiler().Compile("void main() { f(); }"), std::runtime_error);
+	EXPECT_THROW(Compiler().Compile("byte f(byte a) { return f(a); } void main() { out(f(1)); }"), std::runtime_error);
+	EXPECT_THROW(Compiler().Compile("byte a[2]; void main() { a[2] = 1; }"), std::runtime_error);
+	EXPECT_THROW(Compiler().Compile("void main() { out(1) }"), std::runtime_error);
+	EXPECT_THROW(Compiler().Compile("byte big[255]; void main() { out(1); }"), std::runtime_error);
+}
+
+}}
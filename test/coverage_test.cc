@@ -0,0 +1,157 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <sim/fuzzer.h>
+
+#include <ctrl/microcode.h>
+
+#include <sstream>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+std::vector<uint8_t> Assemble(const std::string& source)
+{
+	Program p;
+	std::istringstream in(source);
+	std::string s;
+	while (std::getline(in, s))
+		p.AddLine(SourceLine::Parse(s));
+	return p.MachineCode();
+}
+
+const char* countdown = R"(MOV A, 3
+loop: MOV B, 1
+SUB A
+MOV A, ALO
+JZ #done
+JMP #loop
+done: PUSH A
+POP A
+HLT)";
+
+template <typename Sim>
+MicrocodeCoverage Cover(const std::vector<uint8_t>& image)
+{
+	MicrocodeCoverage coverage;
+	Sim sim;
+	sim.Load(image);
+	sim.Cover(&coverage);
+	sim.Run(10000);
+	EXPECT_TRUE(sim.State().halted);
+	return coverage;
+}
+
+}
+
+TEST(MicrocodeCoverage, engines_agree)
+{
+	const auto image = Assemble(countdown);
+	const auto fast = Cover<FastSimulator>(image);
+	const auto microcode = Cover<MicrocodeSimulator>(image);
+
+	MicrocodeCoverage merged = fast;
+	EXPECT_EQ(merged.Merge(microcode), 0u);
+	EXPECT_EQ(fast.Count(), microcode.Count());
+
+	//MOV A, 3 is fetched with the reset IR and no conditions, its body at step 2
+	EXPECT_TRUE(fast.Covered(make_address(MC_STEP0, 0)));
+	EXPECT_TRUE(fast.Covered(make_address(MC_STEP2, image[0])));
+	//JZ is skipped twice then taken
+	const uint8_t jz = image[6];
+	EXPECT_TRUE(fast.Covered(make_address(MC_STEP2, jz) | CND_CR));
+	EXPECT_TRUE(fast.Covered(make_address(MC_STEP2, jz) | CND_JMP | CND_CR));
+	EXPECT_FALSE(fast.Covered(make_address(MC_STEP2, jz) | CND_JMP));
+	EXPECT_GT(fast.Dead(), 0u);
+}
+
+TEST(MicrocodeCoverage, merge_and_files)
+{
+	MicrocodeCoverage a, b;
+	a.Hit(1);
+	a.Hit(8191);
+	b.Hit(1);
+	b.Hit(64);
+	EXPECT_EQ(a.Merge(b), 1u);
+	EXPECT_EQ(a.Count(), 3u);
+	EXPECT_TRUE(a.Covered(64));
+	EXPECT_FALSE(a.Covered(63));
+
+	std::stringstream file;
+	a.Write(file);
+	MicrocodeCoverage read;
+	read.Hit(2);
+	EXPECT_TRUE(read.Read(file));
+	EXPECT_EQ(read.Count(), 4u);
+
+	std::istringstream bad("not a bitmap");
+	EXPECT_FALSE(read.Read(bad));
+	EXPECT_EQ(read.Count(), 4u);
+}
+
+TEST(MicrocodeCoverage, report)
+{
+	const auto image = Assemble(countdown);
+	std::ostringstream os;
+	Cover<MicrocodeSimulator>(image).Report(os);
+	EXPECT_THAT(os.str(), StartsWith("; "));
+	EXPECT_THAT(os.str(), HasSubstr("control words\n; op  --"));
+	//JZ skipped twice with carry set then taken, its no condition step 2 is empty
+	EXPECT_THAT(os.str(), HasSubstr("\n  206 .. .      ....      xxx       xxxx      ..        ..        ..        ..       \n"));
+	EXPECT_THAT(os.str(), HasSubstr("control words\n; op  --        J-        -C        JC        --I       J-I       -CI       JCI\n"));
+}
+
+//Interrupt entry is in the CND_INT columns, against instruction 0 after step 0
+TEST(MicrocodeCoverage, report_interrupts)
+{
+	MicrocodeCoverage coverage;
+	MicrocodeSimulator sim;
+	sim.Load(Assemble("JMP #main\nisr: RETI\nmain: EI\nloop: JMP #loop"));
+	sim.SetTimer(50);
+	sim.Cover(&coverage);
+	sim.Run(1000);
+
+	std::ostringstream os;
+	coverage.Report(os);
+	const auto entry = os.str().find("\n    0 ");
+	ASSERT_NE(entry, std::string::npos);
+	const std::string line = os.str().substr(entry + 1, os.str().find('\n', entry + 1) - entry - 1);
+	//the four columns without CND_INT then the four with
+	ASSERT_EQ(line.size(), 6u + 8 * 10 - 1);
+	EXPECT_THAT(line.substr(6 + 4 * 10), HasSubstr(".xxxxxx"));
+	EXPECT_THAT(line.substr(6, 4 * 10), Not(HasSubstr(".xxxxxx")));
+}
+
+TEST(DifferentialFuzzer, engines_agree)
+{
+	DifferentialFuzzer fuzzer(7);
+	fuzzer.Run(3000);
+	EXPECT_EQ(fuzzer.Runs(), 3000u);
+	EXPECT_THAT(fuzzer.Mismatches(), IsEmpty());
+	EXPECT_GT(fuzzer.Corpus().size(), 10u);
+	EXPECT_GT(fuzzer.Coverage().Count(), 1000u);
+
+	//some programs enable interrupts and take one
+	bool interrupted = false;
+	for (uint16_t cond : {0, int(CND_JMP), int(CND_CR), int(CND_JMP | CND_CR)})
+		interrupted = interrupted || fuzzer.Coverage().Covered(make_address(MC_STEP6, 0) | cond | CND_INT);
+	EXPECT_TRUE(interrupted);
+}
+
+TEST(DifferentialFuzzer, finds_differences)
+{
+	//a fast engine whose ADD sets no flags
+	std::vector<uint32_t> rom(microcode_rom(), microcode_rom() + ROM_SIZE);
+	const auto add = Assemble("ADD A")[0];
+	for (uint16_t cond : {0, int(CND_JMP), int(CND_CR), int(CND_JMP | CND_CR)})
+		rom[make_address(MC_STEP2, add) | cond] &= ~ALW;
+
+	DifferentialFuzzer fuzzer(7, rom.data());
+	EXPECT_NE(fuzzer.Check(Assemble("MOV A, 1\nMOV B, 1\nADD A\nHLT")), "");
+	fuzzer.Run(2000);
+	EXPECT_THAT(fuzzer.Mismatches(), Not(IsEmpty()));
+}
+
+}}
@@ -0,0 +1,144 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <dse/design_space.h>
+#include <sim/fast_simulator.h>
+#include <sim/microcode_simulator.h>
+
+#include <thread>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+std::string Join(const std::vector<std::string>& lines)
+{
+	std::string result;
+	for (const auto& l : lines)
+		result += l + "\n";
+	return result;
+}
+
+std::vector<uint8_t> Assemble(const std::vector<std::string>& source)
+{
+	Program p;
+	for (const auto& s : source)
+		p.AddLine(SourceLine::Parse(s));
+	return p.MachineCode();
+}
+
+const std::vector<std::string> calls = {"loop: CALL #bump", "MOV A, [#n]", "MOV B, 10", "CMP A", "JE #done", "JMP #loop",
+	"done: MOV OUT, A", "HLT",
+	"bump: PUSH A", "MOV A, [#n]", "INC A", "MOV [#n], ALO", "POP A", "RET", "n: DB 0"};
+
+//[100, 110) = 42 then the last byte to OUT
+const std::vector<std::string> fill = {"MOV A, 100", "MOV B, 0", "ADD A", "MOV B, 110", "MOV A, 42", "FILL",
+	"MOV A, [109]", "MOV OUT, A", "HLT"};
+const std::vector<std::string> fillLoop = {"MOV A, 100", "loop: MOV B, 42", "MOV [A], B", "INC A", "MOV A, ALO",
+	"MOV B, 110", "CMP A", "JE #done", "JMP #loop", "done: MOV A, [109]", "MOV OUT, A", "HLT"};
+
+IsaVariant Variant(const std::string& name)
+{
+	for (const auto& v : DesignSpaceExplorer::AllVariants())
+		if (v.name == name)
+			return v;
+	throw std::runtime_error("no variant " + name);
+}
+
+}
+
+TEST(DesignSpace, default_options)
+{
+	EXPECT_EQ(make_microcode(MicrocodeOptions()), microcode_table());
+
+	MicrocodeOptions options;
+	options.fill = false;
+	const auto table = make_microcode(options);
+	EXPECT_LT(table.size(), microcode_table().size());
+	EXPECT_EQ(table.count(make_address(MC_STEP2, INSTR_FILL)), 0u);
+	//left as it was
+	EXPECT_EQ(microcode_table().count(make_address(MC_STEP2, INSTR_FILL)), 1u);
+}
+
+//Tables built on several threads while the default one is read
+TEST(DesignSpace, concurrent_builds)
+{
+	const auto& board = microcode_table();
+	const auto expected = board;
+	const auto variants = DesignSpaceExplorer::AllVariants();
+	std::vector<std::map<uint16_t, uint32_t>> tables(variants.size());
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < variants.size(); i++)
+		threads.emplace_back([&, i]() {tables[i] = make_microcode(variants[i].options);});
+	for (int i = 0; i < 1000; i++)
+		ASSERT_EQ(microcode_word(make_address(MC_STEP2, INSTR_FILL)), expected.at(make_address(MC_STEP2, INSTR_FILL)));
+	for (auto& t : threads)
+		t.join();
+
+	EXPECT_EQ(board, expected);
+	for (size_t i = 0; i < variants.size(); i++)
+		EXPECT_EQ(tables[i], make_microcode(variants[i].options)) << variants[i].name;
+	EXPECT_EQ(tables.front(), board);
+}
+
+TEST(DesignSpace, variants)
+{
+	const auto variants = DesignSpaceExplorer::AllVariants();
+	EXPECT_EQ(variants.size(), 16u);
+	EXPECT_EQ(variants.front().name, "board");
+	EXPECT_THAT(variants, Contains(Field(&IsaVariant::name, "-indexed-alumem-fill+stackmerge")));
+}
+
+TEST(DesignSpace, stack_merge)
+{
+	//a step shorter and the same on both engines
+	MicrocodeOptions options;
+	options.stackMerge = true;
+	const auto rom = make_rom(make_microcode(options));
+	const auto image = Assemble(calls);
+	FastSimulator board, fast(rom.data());
+	MicrocodeSimulator slow(rom.data());
+	for (Simulator* sim : std::initializer_list<Simulator*>{&board, &fast, &slow})
+	{
+		sim->Load(image);
+		sim->Run(100000);
+		EXPECT_EQ(sim->State().out, 10);
+		EXPECT_EQ(sim->State().sp, 0);
+	}
+	EXPECT_EQ(fast.Cycles(), slow.Cycles());
+	EXPECT_EQ(fast.Cycles() + 10 * 2, board.Cycles());
+	EXPECT_EQ(fast.Hash(), slow.Hash());
+}
+
+TEST(DesignSpace, explore)
+{
+	DesignSpaceExplorer explorer({{"calls", {Join(calls)}}, {"fill", {Join(fill), Join(fillLoop)}}});
+	const auto scores = explorer.Explore({Variant("board"), Variant("-fill"), Variant("+stackmerge")}, 2);
+	ASSERT_EQ(scores.size(), 3u);
+	EXPECT_EQ(scores[0].variant.name, "+stackmerge");
+	EXPECT_EQ(scores[1].variant.name, "board");
+	EXPECT_EQ(scores[2].variant.name, "-fill");
+	for (const auto& s : scores)
+		EXPECT_TRUE(s.ok) << s.error;
+
+	//without FILL the loop is run
+	EXPECT_THAT(scores[2].workloadSource, ElementsAre(0, 1));
+	EXPECT_GT(scores[2].workloadCycles[1], scores[1].workloadCycles[1]);
+	EXPECT_LT(scores[2].romEntries, scores[1].romEntries);
+	EXPECT_EQ(scores[1].cycles, scores[1].workloadCycles[0] + scores[1].workloadCycles[1]);
+}
+
+TEST(DesignSpace, unsupported)
+{
+	//no source without FILL, ranked last
+	DesignSpaceExplorer explorer({{"fill", {Join(fill)}}});
+	const auto scores = explorer.Explore({Variant("-fill"), Variant("board")}, 1);
+	EXPECT_TRUE(scores[0].ok);
+	EXPECT_FALSE(scores[1].ok);
+	EXPECT_THAT(scores[1].error, HasSubstr("fill"));
+
+	EXPECT_THROW(DesignSpaceExplorer({{"loop", {"loop: JMP #loop"}, 1000}}), std::runtime_error);
+}
+
+}}
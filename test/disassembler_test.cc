@@ -0,0 +1,142 @@
+#include "gmock/gmock.h"
+#include <asm/disassembler.h>
+#include <asm/program.h>
+#include <ctrl/constants.h>
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+std::vector<uint8_t> Assemble(const std::string& source)
+{
+	Program p;
+	std::istringstream in(source);
+	std::string s;
+	while (std::getline(in, s))
+		p.AddLine(SourceLine::Parse(s));
+	return p.MachineCode();
+}
+
+std::vector<uint8_t> Encode(const std::string& line)
+{
+	return Instruction(SourceLine::Parse(line)).Encode<Width8>([](const std::string& label) -> uint8_t
+	{
+		throw std::runtime_error("unexpected label " + label);
+	});
+}
+
+}
+
+TEST(Disassembler, table)
+{
+	const auto& table = decode_table();
+	EXPECT_STREQ(table[INSTR_RET].mnemonic, "RET");
+	EXPECT_STREQ(table[INSTR_FILL].mnemonic, "FILL");
+	EXPECT_STREQ(table[INSTR_POP].mnemonic, "POP");
+
+	const auto& indexed = table[make_indexed_instruction_code(R_B, true)];
+	EXPECT_STREQ(indexed.mnemonic, "MOV");
+	EXPECT_EQ(indexed.length, 2);
+	EXPECT_STREQ(indexed.operands[0].reg, "B");
+	EXPECT_EQ(indexed.operands[1].kind, Operand::INDEXED);
+
+	//no ALU operation 13
+	EXPECT_EQ(table[make_alu_instruction_code(13, 0)].mnemonic, nullptr);
+	EXPECT_EQ(Disassembler::Disassemble(std::vector<uint8_t>{make_alu_instruction_code(13, 0)}), "DB 104\n");
+}
+
+//Parse, Encode, disassemble and Parse again for every opcode the assembler encodes, with
+//every immediate
+TEST(Disassembler, every_instruction)
+{
+	unsigned defined = 0;
+	for (unsigned opcode = 0; opcode < 256; opcode++)
+	{
+		const auto& info = decode_table()[opcode];
+		if (!info.mnemonic)
+			continue;
+		defined++;
+		for (unsigned immediate = 0; immediate < (info.length == 2 ? 256u : 1u); immediate++)
+		{
+			const DecodedInstruction instr{0, uint8_t(opcode), uint8_t(immediate), info.length};
+			const std::string text = Disassembler::Format(instr);
+			const auto bytes = Encode(text);
+			ASSERT_EQ(bytes.size(), info.length) << text;
+			ASSERT_EQ(bytes[0], opcode) << text;
+			if (info.length == 2)
+			{
+				ASSERT_EQ(bytes[1], immediate) << text;
+			}
+
+			std::vector<DecodedInstruction> decoded;
+			Disassembler::Decode(bytes.data(), bytes.size(), decoded);
+			ASSERT_EQ(decoded.size(), 1u);
+			ASSERT_EQ(Disassembler::Format(decoded[0]), text);
+		}
+	}
+	//13 ALU operations on 8 sources, 39 moves, 24 jumps and CALLs, 4 PUSH and POP, 7 more
+	EXPECT_EQ(defined, 13u * 8 + 39 + 24 + 4 + 7);
+}
+
+TEST(Disassembler, source_forms)
+{
+	for (const auto& s : {"MOV A, B", "MOV B, [ALO]", "MOV OUT, [A]", "MOV [B], ALO", "MOV [ALO], A", "MOV [200], B",
+		"MOV A, 42", "MOV OUT, [7]", "MOV [30+B], A", "MOV A, [30+B]", "ADD [B]", "SFT ALO", "CMP 9", "XOR [250]",
+		"JMP A", "JC ALO", "JN 12", "CALL B", "CALL 77", "PUSH ALO", "POP A", "HLT", "RET", "NOOP", "FILL", "EI", "DI", "RETI"})
+	{
+		const auto bytes = Encode(s);
+		EXPECT_EQ(Disassembler::Disassemble(bytes, {0, false}), std::string(s) + "\n");
+	}
+}
+
+TEST(Disassembler, labels)
+{
+	const auto image = Assemble("MOV A, 0\nloop: INC A\nMOV A, ALO\nCALL #f\nJMP #loop\nf: RET\nJMP 1\nJMP 200");
+	EXPECT_EQ(Disassembler::Disassemble(image),
+		"MOV A, 0\nloc_2: INC A\nMOV A, ALO\nCALL #loc_8\nJMP #loc_2\nloc_8: RET\nJMP 1\nJMP 200\n");
+
+	Disassembler::Options options;
+	options.labels = false;
+	options.addresses = true;
+	options.origin = 100;
+	EXPECT_THAT(Disassembler::Disassemble(image, options), StartsWith("MOV A, 0\t; 100: 134 0\nINC A\t; 102: 0\n"));
+}
+
+TEST(Disassembler, truncated)
+{
+	//an immediate past the end of the image
+	EXPECT_EQ(Disassembler::Disassemble(std::vector<uint8_t>{INSTR_HALT, make_mov_instruction_code(encode_dest_reg(R_A, false), encode_source_reg(R_PC, false))}),
+		"HLT\nDB 134\n");
+	EXPECT_EQ(Disassembler::Disassemble({}), "");
+}
+
+//Any image assembles back to itself, data and all
+TEST(Disassembler, round_trip)
+{
+	std::mt19937 rng(50);
+	for (int i = 0; i < 2000; i++)
+	{
+		std::vector<uint8_t> image(rng() % 257);
+		for (auto& b : image)
+			b = uint8_t(rng());
+		ASSERT_EQ(Assemble(Disassembler::Disassemble(image)), image);
+	}
+
+	for (const auto& entry : std::filesystem::directory_iterator(ROUTINES_DIR))
+	{
+		std::ifstream in(entry.path());
+		std::stringstream source;
+		source << in.rdbuf();
+		const auto image = Assemble(source.str());
+		EXPECT_EQ(Assemble(Disassembler::Disassemble(image)), image) << entry.path();
+	}
+}
+
+}}
@@ -0,0 +1,115 @@
+#include "gmock/gmock.h"
+#include <asm/incremental_program.h>
+#include <asm/program.h>
+
+#include <random>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+std::vector<uint8_t> Assemble(const std::vector<std::string>& source)
+{
+	Program p;
+	for (const auto& s : source)
+		p.AddLine(SourceLine::Parse(s));
+	return p.MachineCode();
+}
+
+}
+
+TEST(IncrementalProgram, first_update_matches_program)
+{
+	std::vector<std::string> source = {"ADD A", "label: ADD A", "JC #label", "HLT"};
+	IncrementalProgram p;
+
+	const auto patches = p.Update(source);
+	ASSERT_EQ(patches.size(), 1);
+	EXPECT_EQ(patches[0].address, 0);
+	EXPECT_EQ(patches[0].bytes, Assemble(source));
+	EXPECT_EQ(p.Image(), Assemble(source));
+	EXPECT_EQ(p.EncodedLines(), 4);
+}
+
+TEST(IncrementalProgram, unchanged_source)
+{
+	std::vector<std::string> source = {"ADD A", "label: ADD A", "JC #label", "HLT"};
+	IncrementalProgram p;
+	p.Update(source);
+
+	EXPECT_TRUE(p.Update(source).empty());
+	EXPECT_EQ(p.EncodedLines(), 0);
+}
+
+TEST(IncrementalProgram, comment_edit)
+{
+	IncrementalProgram p;
+	p.Update({"ADD A ;one", "HLT"});
+
+	EXPECT_TRUE(p.Update({"ADD A ;two", "HLT"}).empty());
+	EXPECT_EQ(p.EncodedLines(), 0);
+}
+
+TEST(IncrementalProgram, changed_line)
+{
+	IncrementalProgram p;
+	p.Update({"ADD A", "ADD A", "HLT"});
+
+	const auto patches = p.Update({"ADD A", "AND A", "HLT"});
+	ASSERT_EQ(patches.size(), 1);
+	EXPECT_EQ(patches[0].address, 1);
+	EXPECT_EQ(patches[0].bytes, std::vector<uint8_t>{72});
+	EXPECT_EQ(p.EncodedLines(), 1);
+}
+
+TEST(IncrementalProgram, label_moved)
+{
+	std::vector<std::string> source = {"JMP #end", "ADD A", "end: HLT"};
+	IncrementalProgram p;
+	p.Update(source);
+
+	//inserting a line moves 'end' and the lines after it, JMP must be re-encoded
+	source.insert(source.begin() + 1, "ADD 12");
+	const auto patches = p.Update(source);
+	EXPECT_EQ(p.Image(), Assemble(source));
+	EXPECT_EQ(p.EncodedLines(), 4);
+	ASSERT_EQ(patches.size(), 1);
+	EXPECT_EQ(patches[0].address, 1);
+	EXPECT_EQ(patches[0].bytes, (std::vector<uint8_t>{5, 22, 12, 16, 249}));
+}
+
+//Random edits, the image always matches a full assembly
+TEST(IncrementalProgram, edits)
+{
+	const std::vector<std::string> pool = {"ADD A", "ADD  A", "ADD A ;x", "ADD B", "MOV A, 3", "MOV A, 4",
+		"JMP #a", "JMP #b", "JC #a", "MOV [#b], A", "MOV A, [#a+B]", "", "; nothing", "HLT"};
+	std::vector<std::string> source = {"a: ADD A", "b: ADD A", "HLT"};
+	IncrementalProgram p;
+	p.Update(source);
+	std::mt19937 rng(26);
+	for (int i = 0; i < 500; i++)
+	{
+		//lines are added anywhere, moving the labels, only unlabelled lines are changed
+		const size_t at = rng() % (source.size() + 1);
+		const bool labelled = at < source.size() && source[at].find(':') != std::string::npos;
+		const auto& text = pool[rng() % pool.size()];
+		if (at == source.size() || (labelled && source.size() < 40))
+			source.insert(source.begin() + at, text);
+		else if (!labelled && rng() % 2)
+			source[at] = text;
+		else if (!labelled)
+			source.erase(source.begin() + at);
+		p.Update(source);
+		ASSERT_EQ(p.Image(), Assemble(source)) << i;
+	}
+}
+
+TEST(IncrementalProgram, unknown_label)
+{
+	IncrementalProgram p;
+	EXPECT_THROW(p.Update({"JMP #nowhere"}), std::runtime_error);
+}
+
+}}
@@ -23,6 +23,18 @@ TEST(Instruction, NOOP)
 	ExpectEncoding("NOOP", { 251 });
 }
 
+TEST(Instruction, FILL)
+{
+	ExpectEncoding("FILL", { 252 });
+}
+
+TEST(Instruction, interrupts)
+{
+	ExpectEncoding("EI", { 253 });
+	ExpectEncoding("DI", { 254 });
+	ExpectEncoding("RETI", { 255 });
+}
+
 TEST(Instruction, RET)
 {
 	ExpectEncoding("RET", { 250 });
@@ -34,7 +46,6 @@ TEST(Instruction, PUSH_POP)
 	ExpectEncoding("PUSH B", { 242 });
 	ExpectEncoding("PUSH ALO", { 244 });
 	ExpectEncoding("POP A", { 248 });
-	ExpectEncoding("POP B", { 250 });
 }
 
 TEST(Instruction, CALL)
@@ -113,10 +124,87 @@ TEST(Instruction, MOV_REG_ADDR)
 	ExpectEncoding("MOV A, [42]", { 135, 42 });
 }
 
+TEST(Instruction, MOV_INDEXED)
+{
+	ExpectEncoding("MOV A, [42+B]", {185, 42});
+	ExpectEncoding("MOV B, [42+B]", {187, 42});
+	ExpectEncoding("MOV [42+B], A", {184, 42});
+	EXPECT_EQ(Instruction(SourceLine::Parse("MOV A, [#label+B]")).Encode([](const std::string&) {return 12;}),
+		(std::vector<uint8_t>{185, 12}));
+	EXPECT_EQ(Instruction(SourceLine::Parse("MOV A, [#label+B]")).EncodedLength(), 2);
+
+	auto encode = [](const std::string& code)
+	{
+		Instruction(SourceLine::Parse(code)).Encode([](const std::string&) {return 0;});
+	};
+	EXPECT_THROW(encode("MOV [42+B], B"), std::runtime_error);
+	EXPECT_THROW(encode("MOV OUT, [42+B]"), std::runtime_error);
+	EXPECT_THROW(encode("MOV A, [A+B]"), std::runtime_error);
+	EXPECT_THROW(encode("ADD [42+B]"), std::runtime_error);
+}
+
+TEST(Instruction, bad_operands)
+{
+	auto encode = [](const std::string& code)
+	{
+		Instruction(SourceLine::Parse(code)).Encode([](const std::string&) {return 0;});
+	};
+	for (const auto code : {"PUSH 5", "POP [A]", "PUSH OUT", "CALL", "CALL OUT", "ADD", "ADD A, B", "ADD OUT", "JMP",
+		"JMP OUT", "MOV A", "MOV [42], [A]", "MOV [42], 5", "MOV [A], [B]", "MOV ALO, A", "MOV [OUT], A", "MOV 5, A",
+		"MOV A, OUT", "DB", "DB A", "POP B", "POP ALO"})
+		EXPECT_THROW(encode(code), std::runtime_error) << code;
+}
+
+TEST(Instruction, ALU_ADDR)
+{
+	ExpectEncoding("ADD [42]", {23, 42});
+	ExpectEncoding("XOR [42]", {95, 42});
+}
+
+TEST(Instruction, MOV_LABEL)
+{
+	auto resolve = [](const std::string& label)
+	{
+		EXPECT_EQ(label, "label");
+		return 12;
+	};
+	EXPECT_EQ(Instruction(SourceLine::Parse("MOV A, #label")).Encode(resolve), (std::vector<uint8_t>{134, 12}));
+	EXPECT_EQ(Instruction(SourceLine::Parse("MOV B, [#label]")).Encode(resolve), (std::vector<uint8_t>{151, 12}));
+	EXPECT_EQ(Instruction(SourceLine::Parse("MOV [#label], ALO")).Encode(resolve), (std::vector<uint8_t>{180, 12}));
+	EXPECT_EQ(Instruction(SourceLine::Parse("ADD #label")).Encode(resolve), (std::vector<uint8_t>{22, 12}));
+	EXPECT_EQ(Instruction(SourceLine::Parse("CALL #label")).Encode(resolve), (std::vector<uint8_t>{198, 12}));
+}
+
+TEST(Instruction, DB)
+{
+	ExpectEncoding("DB 42", {42});
+	EXPECT_EQ(Instruction(SourceLine::Parse("data: DB 0")).EncodedLength(), 1);
+}
+
 TEST(Instruction, MOV_REG_DEREF_REG)
 {
 	ExpectEncoding("MOV [A], B", { 138});
 	ExpectEncoding("MOV [A], ALO", { 140 });
 }
 
-}}
\ No newline at end of file
+TEST(Instruction, Cycles)
+{
+	EXPECT_EQ(Instruction(SourceLine::Parse("ADD A")).Cycles(), 3);
+	EXPECT_EQ(Instruction(SourceLine::Parse("ADD [A]")).Cycles(), 4);
+	EXPECT_EQ(Instruction(SourceLine::Parse("MOV A, [42]")).Cycles(), 5);
+	EXPECT_EQ(Instruction(SourceLine::Parse("ADD [42]")).Cycles(), 5);
+	EXPECT_EQ(Instruction(SourceLine::Parse("MOV A, [42+B]")).Cycles(), 6);
+	EXPECT_EQ(Instruction(SourceLine::Parse("MOV [42+B], A")).Cycles(), 6);
+	EXPECT_EQ(Instruction(SourceLine::Parse("JMP 12")).Cycles(), 4);
+	//not taken, then taken with CND_JMP set
+	EXPECT_EQ(Instruction(SourceLine::Parse("JZ 12")).Cycles(), 4);
+	EXPECT_EQ(Instruction(SourceLine::Parse("JZ 12")).Cycles(1 << 8), 4);
+	EXPECT_EQ(Instruction(SourceLine::Parse("CALL A")).Cycles(), 6);
+	EXPECT_EQ(Instruction(SourceLine::Parse("HLT")).Cycles(), 3);
+	//a byte, then the last byte with the zero flag set
+	EXPECT_EQ(Instruction(SourceLine::Parse("FILL")).Cycles(), 8);
+	EXPECT_EQ(Instruction(SourceLine::Parse("FILL")).Cycles(1 << 8), 7);
+	EXPECT_EQ(Instruction(SourceLine::Parse("")).Cycles(), 0);
+}
+
+}}
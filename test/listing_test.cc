@@ -0,0 +1,71 @@
+#include "gmock/gmock.h"
+#include <asm/listing.h>
+
+#include <sstream>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+Program Assemble(const std::string& source)
+{
+	Program p;
+	std::istringstream in(source);
+	std::string s;
+	while (std::getline(in, s))
+		p.AddLine(SourceLine::Parse(s));
+	return p;
+}
+
+std::vector<std::string> Lines(const std::string& s)
+{
+	std::vector<std::string> lines;
+	std::istringstream in(s);
+	std::string line;
+	while (std::getline(in, line))
+		lines.push_back(line);
+	return lines;
+}
+
+}
+
+TEST(Listing, columns)
+{
+	const Program p = Assemble(R"(start: MOV A, 3
+loop:
+MOV B, 1
+SUB A
+MOV A, ALO
+JZ #done
+JMP #loop ;back
+done: HLT
+data: DB 7)");
+	const auto lines = Lines(program_listing(p));
+	ASSERT_GE(lines.size(), 10u);
+	EXPECT_THAT(lines[0], StartsWith("addr  bytes"));
+	EXPECT_THAT(lines[1], StartsWith("   0  134 3       4       4       start:"));
+	//a label on its own line
+	EXPECT_EQ(lines[2], "loop:");
+	EXPECT_THAT(lines[3], StartsWith("   2  150 1       4       4 "));
+	EXPECT_THAT(lines[4], StartsWith("   4  32          3       7 "));
+	//taken/not taken, the running total takes the longer fall through
+	EXPECT_THAT(lines[6], StartsWith("   6  206 10      4/3-4   14 "));
+	EXPECT_THAT(lines[7], AllOf(StartsWith("   8  238 2       4       18 "), HasSubstr("JMP #loop"), HasSubstr("; back")));
+	//the total starts again at each label
+	EXPECT_THAT(lines[8], StartsWith("  10  249         3       3 "));
+	EXPECT_THAT(lines[9], StartsWith("  11  7           -       0 "));
+}
+
+TEST(Listing, symbols)
+{
+	const Program p = Assemble("start: MOV A, 3\nJMP #start\nend:");
+	const std::string listing = program_listing(p);
+	EXPECT_THAT(listing, HasSubstr("\nend:\n"));
+	EXPECT_THAT(listing, EndsWith("; symbols\n   0  start\n   4  end\n"));
+
+	EXPECT_THAT(program_listing(Assemble("NOOP")), Not(HasSubstr("symbols")));
+}
+
+}}
@@ -0,0 +1,95 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <sim/fast_simulator.h>
+#include <sim/microcode_simulator.h>
+
+#include <fstream>
+#include <random>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+//Calls the routine at target, with routines/math16.asm after the driver
+const Program& Library()
+{
+	static const Program p = []()
+	{
+		Program p;
+		for (const char* s : {"MOV A, [#target]", "CALL A", "HLT", "target: DB 0"})
+			p.AddLine(SourceLine::Parse(s));
+		std::ifstream in(ROUTINES_DIR "/math16.asm");
+		std::string s;
+		while (std::getline(in, s))
+			p.AddLine(SourceLine::Parse(s));
+		return p;
+	}();
+	return p;
+}
+
+struct Result
+{
+	uint16_t x;
+	uint8_t a;
+};
+
+template <typename Sim>
+Result Call(const std::string& routine, uint16_t x, uint16_t y)
+{
+	static const auto image = Library().MachineCode();
+	const auto& labels = Library().Labels();
+	Sim sim;
+	sim.Load(image);
+	Machine& m = sim.State();
+	m.ram[labels.at("target")] = labels.at(routine);
+	m.ram[labels.at("x16_lo")] = x & 0xFF;
+	m.ram[labels.at("x16_hi")] = x >> 8;
+	m.ram[labels.at("y16_lo")] = y & 0xFF;
+	m.ram[labels.at("y16_hi")] = y >> 8;
+	//flags left over from the caller mustn't matter
+	m.flags = 0xFF;
+	sim.Run(10000);
+	EXPECT_TRUE(m.halted);
+	return {uint16_t(m.ram[labels.at("x16_lo")] | m.ram[labels.at("x16_hi")] << 8), m.a};
+}
+
+void Check(uint16_t x, uint16_t y)
+{
+	EXPECT_EQ(Call<FastSimulator>("add16", x, y).x, uint16_t(x + y)) << x << " + " << y;
+	EXPECT_EQ(Call<FastSimulator>("sub16", x, y).x, uint16_t(x - y)) << x << " - " << y;
+	EXPECT_EQ(Call<FastSimulator>("shl16", x, y).x, uint16_t(x << 1)) << x;
+	EXPECT_EQ(Call<FastSimulator>("inc16", x, y).x, uint16_t(x + 1)) << x;
+	EXPECT_EQ(Call<FastSimulator>("dec16", x, y).x, uint16_t(x - 1)) << x;
+	EXPECT_EQ(Call<FastSimulator>("cmp16", x, y).a, x >= y ? 1 : 0) << x << " >= " << y;
+}
+
+}
+
+TEST(Math16, edges)
+{
+	for (const uint16_t x : {0, 1, 0xFF, 0x100, 0x7FFF, 0x8000, 0xFEFF, 0xFFFF})
+		for (const uint16_t y : {0, 1, 0xFF, 0x100, 0x01FF, 0xFFFF})
+			Check(x, y);
+}
+
+TEST(Math16, random)
+{
+	std::mt19937 rng(16);
+	for (int i = 0; i < 500; i++)
+		Check(uint16_t(rng()), uint16_t(rng()));
+}
+
+TEST(Math16, engines_agree)
+{
+	for (const char* routine : {"add16", "sub16", "shl16", "cmp16"})
+	{
+		const auto fast = Call<FastSimulator>(routine, 0x12F0, 0x0F20);
+		const auto slow = Call<MicrocodeSimulator>(routine, 0x12F0, 0x0F20);
+		EXPECT_EQ(fast.x, slow.x);
+		EXPECT_EQ(fast.a, slow.a);
+	}
+}
+
+}}
@@ -0,0 +1,93 @@
+#include "gmock/gmock.h"
+#include <asm/optimizer.h>
+#include <asm/program.h>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+std::vector<uint8_t> Optimize(const std::vector<std::string>& source, Optimizer& optimizer)
+{
+	std::vector<SourceLine> lines;
+	for (const auto& s : source)
+		lines.push_back(SourceLine::Parse(s));
+
+	Program p;
+	for (const auto& line : optimizer.Optimize(lines))
+		p.AddLine(line);
+	return p.MachineCode();
+}
+
+std::vector<uint8_t> Assemble(const std::vector<std::string>& source)
+{
+	Program p;
+	for (const auto& s : source)
+		p.AddLine(SourceLine::Parse(s));
+	return p.MachineCode();
+}
+
+}
+
+TEST(Optimizer, mov_round_trip)
+{
+	Optimizer o;
+	EXPECT_EQ(Optimize({"MOV B, A", "MOV A, B", "HLT"}, o), Assemble({"MOV B, A", "HLT"}));
+	EXPECT_EQ(Optimize({"MOV [42], A", "MOV A, [42]", "HLT"}, o), Assemble({"MOV [42], A", "HLT"}));
+	EXPECT_EQ(o.Report().movesRemoved, 1);
+	EXPECT_EQ(o.Report().bytesBefore - o.Report().bytesAfter, 2);
+	EXPECT_GT(o.Report().cyclesBefore, o.Report().cyclesAfter);
+}
+
+TEST(Optimizer, mov_kept)
+{
+	Optimizer o;
+	//second MOV is a jump target
+	EXPECT_EQ(Optimize({"MOV B, A", "l: MOV A, B", "JMP #l"}, o), Assemble({"MOV B, A", "l: MOV A, B", "JMP #l"}));
+	//MOV A, [A] changes A
+	EXPECT_EQ(Optimize({"MOV A, [A]", "MOV [A], A"}, o), Assemble({"MOV A, [A]", "MOV [A], A"}));
+	//and MOV B, [42+B] changes the address the second reads
+	EXPECT_EQ(Optimize({"MOV B, [42+B]", "MOV B, [42+B]"}, o), Assemble({"MOV B, [42+B]", "MOV B, [42+B]"}));
+	EXPECT_EQ(Optimize({"MOV B, [#t+B]", "MOV B, [#t+B]", "t: DB 0"}, o), Assemble({"MOV B, [#t+B]", "MOV B, [#t+B]", "t: DB 0"}));
+	EXPECT_EQ(o.Report().movesRemoved, 0);
+}
+
+TEST(Optimizer, jump_to_next)
+{
+	Optimizer o;
+	EXPECT_EQ(Optimize({"ADD A", "JMP #next", "next: HLT"}, o), Assemble({"ADD A", "HLT"}));
+	EXPECT_EQ(o.Report().jumpsRemoved, 1);
+
+	//the removed jump's own label moves to the next instruction
+	EXPECT_EQ(Optimize({"JMP #l2", "l1: JMP #next", "next: HLT", "l2: JZ #l1"}, o), Assemble({"JMP #l2", "l1: HLT", "l2: JZ #l1"}));
+}
+
+TEST(Optimizer, fold_immediate)
+{
+	Optimizer o;
+	EXPECT_EQ(Optimize({"MOV A, 12", "ADD A", "MOV A, ALO", "HLT"}, o), Assemble({"ADD 12", "MOV A, ALO", "HLT"}));
+	EXPECT_EQ(o.Report().immediatesFolded, 1);
+	EXPECT_EQ(o.Report().bytesBefore - o.Report().bytesAfter, 1);
+
+	//A is still needed
+	EXPECT_EQ(Optimize({"MOV A, 12", "ADD A", "MOV OUT, A"}, o), Assemble({"MOV A, 12", "ADD A", "MOV OUT, A"}));
+	EXPECT_EQ(o.Report().immediatesFolded, 0);
+}
+
+TEST(Optimizer, thread_jumps)
+{
+	Optimizer o;
+	EXPECT_EQ(Optimize({"JZ #a", "HLT", "a: JMP #b", "HLT", "b: JMP #c", "HLT", "c: HLT"}, o),
+		Assemble({"JZ #c", "HLT", "JMP #c", "HLT", "JMP #c", "HLT", "c: HLT"}));
+	EXPECT_EQ(o.Report().jumpsThreaded, 2);
+}
+
+TEST(Optimizer, jump_cycle)
+{
+	Optimizer o;
+	const std::vector<std::string> source = {"JZ #a", "HLT", "a: JMP #b", "HLT", "b: JMP #a"};
+	EXPECT_EQ(Optimize(source, o), Assemble(source));
+}
+
+}}
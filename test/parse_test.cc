@@ -16,4 +16,18 @@ TEST(Parse, add)
 	SourceLine::Parse("POP [B]	; comment");
 }
 
+TEST(Parse, comment)
+{
+	const auto line = SourceLine::Parse("JMP #loop ; bound 10: see above");
+	EXPECT_FALSE(line.Label());
+	EXPECT_EQ(line.OpCode(), "JMP");
+	EXPECT_EQ(*line.Param1(), "#loop");
+	EXPECT_EQ(*line.Comment(), " bound 10: see above");
+
+	const auto labelled = SourceLine::Parse("loop: ADD A ;note");
+	EXPECT_EQ(*labelled.Label(), "loop");
+	EXPECT_EQ(*labelled.Comment(), "note");
+	EXPECT_FALSE(SourceLine::Parse("RET").Comment());
+}
+
 }}
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <sim/profiler.h>
+
+#include <sstream>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+Program Assemble(const std::string& source)
+{
+	Program p;
+	std::istringstream in(source);
+	std::string s;
+	while (std::getline(in, s))
+		p.AddLine(SourceLine::Parse(s));
+	return p;
+}
+
+const char* countdown = R"(start: MOV A, 3
+loop: CALL #dec
+MOV B, 0
+ADD A
+JZ #done
+JMP #loop
+done: MOV OUT, A
+HLT
+dec: MOV B, 1
+SUB A
+MOV A, ALO
+RET)";
+
+}
+
+TEST(Profiler, counts)
+{
+	const Program p = Assemble(countdown);
+	FastSimulator sim;
+	sim.Load(p.MachineCode());
+	Profiler profiler(sim, p.Labels());
+
+	const uint64_t cycles = profiler.Run(100000);
+	EXPECT_TRUE(sim.State().halted);
+	EXPECT_EQ(cycles, sim.Cycles());
+	EXPECT_EQ(profiler.TotalCycles(), sim.Cycles());
+
+	const uint8_t loop = p.Labels().at("loop");
+	const uint8_t dec = p.Labels().at("dec");
+	EXPECT_EQ(profiler.Executions(0), 1u);
+	EXPECT_EQ(profiler.Executions(loop), 3u);
+	EXPECT_EQ(profiler.Executions(dec), 3u);
+	EXPECT_EQ(profiler.Executions(p.Labels().at("done")), 1u);
+	EXPECT_GT(profiler.Cycles(loop), 3u * 2);
+
+	//the whole run is split between the two stacks
+	const auto& stacks = profiler.Stacks();
+	ASSERT_EQ(stacks.size(), 2u);
+	EXPECT_EQ(stacks.at("start") + stacks.at("start;dec"), sim.Cycles());
+	uint64_t inDec = 0;
+	for (uint8_t pc = dec; pc < dec + 6; pc++)
+		inDec += profiler.Cycles(pc);
+	EXPECT_EQ(stacks.at("start;dec"), inDec);
+}
+
+//A handler entered by the timer is a frame of its own under whatever it interrupted
+TEST(Profiler, interrupts)
+{
+	const Program p = Assemble(R"(start: JMP #main
+isr: PUSH A
+MOV A, [100]
+INC A
+MOV [100], ALO
+POP A
+RETI
+main: EI
+loop: CALL #work
+JMP #loop
+work: NOOP
+NOOP
+RET)");
+	FastSimulator sim;
+	sim.Load(p.MachineCode());
+	sim.SetTimer(100);
+	Profiler profiler(sim, p.Labels());
+	profiler.Run(10000);
+	EXPECT_GT(sim.State().ram[100], 50);
+
+	const auto& stacks = profiler.Stacks();
+	EXPECT_THAT(stacks, Contains(Key("start;isr")));
+	EXPECT_THAT(stacks, Contains(Key("start;work;isr")));
+	uint64_t inIsr = 0;
+	for (uint8_t pc = p.Labels().at("isr"); pc < p.Labels().at("main"); pc++)
+		inIsr += profiler.Cycles(pc);
+	uint64_t total = 0;
+	for (const auto& [stack, cycles] : stacks)
+	{
+		EXPECT_THAT(stack, AnyOf("start", "start;work", "start;isr", "start;work;isr"));
+		total += cycles;
+	}
+	EXPECT_EQ(stacks.at("start;isr") + stacks.at("start;work;isr"), inIsr);
+	EXPECT_EQ(total, sim.Cycles());
+}
+
+//Every pass of FILL is billed to FILL, as one execution
+TEST(Profiler, fill)
+{
+	const Program p = Assemble(R"(MOV A, 100
+MOV B, 0
+ADD A
+MOV B, 110
+MOV A, 42
+fill: FILL
+next: MOV OUT, A
+HLT)");
+	FastSimulator sim;
+	sim.Load(p.MachineCode());
+	Profiler profiler(sim, p.Labels());
+	profiler.Run(100000);
+	EXPECT_TRUE(sim.State().halted);
+
+	const uint8_t fill = p.Labels().at("fill");
+	const uint8_t next = p.Labels().at("next");
+	EXPECT_EQ(profiler.Executions(fill), 1u);
+	EXPECT_EQ(profiler.Executions(next), 1u);
+	EXPECT_EQ(profiler.Cycles(next), 3u);
+	EXPECT_GT(profiler.Cycles(fill), 10u * 6);
+	EXPECT_EQ(profiler.TotalCycles(), sim.Cycles());
+	EXPECT_TRUE(profiler.HotLoops().empty());
+}
+
+TEST(Profiler, hot_loops)
+{
+	const Program p = Assemble(countdown);
+	FastSimulator sim;
+	sim.Load(p.MachineCode());
+	Profiler profiler(sim, p.Labels());
+	profiler.Run(100000);
+
+	const auto loops = profiler.HotLoops();
+	ASSERT_EQ(loops.size(), 1u);
+	EXPECT_EQ(loops[0].start, p.Labels().at("loop"));
+	EXPECT_EQ(loops[0].end, p.Labels().at("done") - 2);
+	EXPECT_EQ(loops[0].iterations, 2u);
+}
+
+TEST(Profiler, output)
+{
+	const Program p = Assemble(countdown);
+	FastSimulator sim;
+	sim.Load(p.MachineCode());
+	Profiler profiler(sim, p.Labels());
+	profiler.Run(100000);
+
+	std::ostringstream collapsed;
+	profiler.WriteCollapsed(collapsed);
+	EXPECT_THAT(collapsed.str(), StartsWith("start " + std::to_string(profiler.Stacks().at("start")) + "\n"));
+	EXPECT_THAT(collapsed.str(), HasSubstr("\nstart;dec "));
+
+	std::ostringstream listing;
+	profiler.WriteListing(listing, {{0, "MOV A, 3"}, {p.Labels().at("dec"), "MOV B, 1"}});
+	EXPECT_THAT(listing.str(), HasSubstr("         3"));
+	EXPECT_THAT(listing.str(), HasSubstr("\tMOV B, 1\n"));
+	EXPECT_THAT(listing.str(), HasSubstr("; loop 2-"));
+}
+
+TEST(Profiler, max_cycles)
+{
+	const Program p = Assemble("start: JMP #start");
+	FastSimulator sim;
+	sim.Load(p.MachineCode());
+	Profiler profiler(sim, p.Labels());
+
+	EXPECT_GE(profiler.Run(1000), 1000u);
+	EXPECT_FALSE(sim.State().halted);
+	EXPECT_EQ(profiler.Stacks().at("start"), sim.Cycles());
+	EXPECT_EQ(profiler.HotLoops()[0].iterations, profiler.Executions(0));
+}
+
+}}
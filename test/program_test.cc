@@ -18,4 +18,43 @@ TEST(Program, foo)
 	EXPECT_EQ(p.MachineCode(), expected);
 }
 
+TEST(Program, width16)
+{
+	BasicProgram<Width16> p;
+	p.AddLine(SourceLine::Parse("JMP #far"));
+	for (int i = 0; i < 300; i++)
+		p.AddLine(SourceLine::Parse("NOOP"));
+	p.AddLine(SourceLine::Parse("far: MOV A, [#x]"));
+	p.AddLine(SourceLine::Parse("ADD 5"));
+	p.AddLine(SourceLine::Parse("MOV [#x+B], A"));
+	p.AddLine(SourceLine::Parse("CALL 258"));
+	p.AddLine(SourceLine::Parse("x: DB 7"));
+
+	//addresses take two bytes, low first, immediate values one
+	EXPECT_EQ(p.Labels().at("far"), 303);
+	EXPECT_EQ(p.Labels().at("x"), 303 + 3 + 2 + 3 + 3);
+	const auto code = p.MachineCode();
+	ASSERT_EQ(code.size(), 315u);
+	EXPECT_EQ(std::vector<uint8_t>(code.begin(), code.begin() + 3), (std::vector<uint8_t>{238, 47, 1}));
+	EXPECT_EQ(std::vector<uint8_t>(code.begin() + 303, code.end()),
+		(std::vector<uint8_t>{135, 58, 1, 22, 5, 184, 58, 1, 198, 2, 1, 7}));
+
+	//the 8 bit build is unchanged
+	Program small;
+	small.AddLine(SourceLine::Parse("JMP #x"));
+	small.AddLine(SourceLine::Parse("x: MOV A, [#x]"));
+	EXPECT_EQ(small.MachineCode(), (std::vector<uint8_t>{238, 2, 135, 2}));
+}
+
+TEST(Program, width16_byte_values)
+{
+	//A label above 255 can't be loaded into an 8 bit register
+	BasicProgram<Width16> p;
+	p.AddLine(SourceLine::Parse("MOV A, #far"));
+	for (int i = 0; i < 300; i++)
+		p.AddLine(SourceLine::Parse("DB 0"));
+	p.AddLine(SourceLine::Parse("far: HLT"));
+	EXPECT_THROW(p.MachineCode(), std::runtime_error);
+}
+
 }}
\ No newline at end of file
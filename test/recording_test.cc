@@ -0,0 +1,170 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <sim/fast_simulator.h>
+#include <sim/microcode_simulator.h>
+#include <sim/recording.h>
+
+#include <random>
+#include <sstream>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+//echoes whatever is written into 200, counting the values seen
+const char* echo = R"(loop: MOV A, [200]
+MOV OUT, A
+MOV B, 1
+MOV A, [201]
+ADD A
+MOV [201], ALO
+JMP #loop)";
+
+std::vector<uint8_t> Assemble(const std::string& source)
+{
+	Program p;
+	std::istringstream in(source);
+	std::string s;
+	while (std::getline(in, s))
+		p.AddLine(SourceLine::Parse(s));
+	return p.MachineCode();
+}
+
+//Runs echo in uneven slices, injecting a new input after each
+Recording Record(Simulator& sim, uint64_t checkInterval = 64)
+{
+	sim.Load(Assemble(echo));
+	Recorder recorder(sim, checkInterval);
+	std::mt19937 rng(3);
+	for (int i = 0; i < 200; i++)
+	{
+		recorder.Run(rng() % 500);
+		recorder.Inject(200, uint8_t(rng()));
+	}
+	recorder.Run(1000);
+	return recorder.Log();
+}
+
+}
+
+TEST(Recording, replay)
+{
+	FastSimulator fast;
+	const Recording r = Record(fast);
+	EXPECT_EQ(r.events.size(), 200u);
+	EXPECT_GT(r.checks.size(), 100u);
+	EXPECT_EQ(r.end.cycles, fast.Cycles());
+	EXPECT_NE(r.end.outHash, 0u);
+
+	FastSimulator replay;
+	Replayer replayer(replay, r);
+	EXPECT_TRUE(replayer.Run()) << replayer.Mismatch();
+	EXPECT_TRUE(replay.State() == fast.State());
+	EXPECT_EQ(replay.OutHash(), fast.OutHash());
+
+	//the microcode engine can stop everywhere the fast one can
+	MicrocodeSimulator micro;
+	Replayer microReplayer(micro, r);
+	EXPECT_TRUE(microReplayer.Run()) << microReplayer.Mismatch() << " at " << microReplayer.MismatchCycle();
+	EXPECT_EQ(micro.Cycles(), fast.Cycles());
+}
+
+TEST(Recording, microcode)
+{
+	MicrocodeSimulator sim;
+	const Recording r = Record(sim, 10);
+	MicrocodeSimulator replay;
+	Replayer replayer(replay, r);
+	EXPECT_TRUE(replayer.Run()) << replayer.Mismatch();
+	EXPECT_EQ(replay.Hash(), sim.Hash());
+}
+
+TEST(Recording, timer)
+{
+	//halts between interrupts, writing a count to OUT
+	FastSimulator sim;
+	sim.Load(Assemble("JMP #main\nMOV B, 1\nADD [100]\nMOV [100], ALO\nMOV OUT, ALO\nRETI\nmain: EI\nwait: HLT\nJMP #wait"));
+	sim.SetTimer(77);
+	Recorder recorder(sim);
+	recorder.Run(5000);
+	const Recording r = recorder.Log();
+	EXPECT_EQ(r.timer, 77u);
+	EXPECT_EQ(r.end.cycles, 5000u);
+	EXPECT_EQ(sim.State().ram[100], 5000 / 77);
+
+	std::stringstream ss;
+	r.Write(ss);
+	const Recording read = Recording::Read(ss);
+	MicrocodeSimulator replay;
+	Replayer replayer(replay, read);
+	EXPECT_TRUE(replayer.Run()) << replayer.Mismatch() << " at " << replayer.MismatchCycle();
+	EXPECT_EQ(replay.Timer(), 77u);
+}
+
+TEST(Recording, round_trip)
+{
+	FastSimulator sim;
+	const Recording r = Record(sim);
+	std::stringstream ss;
+	r.Write(ss);
+	//deltas keep it small
+	EXPECT_LT(ss.str().size(), 2 * sizeof(Machine) + 6 * r.events.size() + 12 * r.checks.size());
+
+	const Recording read = Recording::Read(ss);
+	EXPECT_EQ(read.checkInterval, r.checkInterval);
+	EXPECT_TRUE(read.start.machine == r.start.machine);
+	EXPECT_TRUE(read.end.machine == r.end.machine);
+	EXPECT_EQ(read.end.cycles, r.end.cycles);
+	ASSERT_EQ(read.events.size(), r.events.size());
+	ASSERT_EQ(read.checks.size(), r.checks.size());
+	for (size_t i = 0; i < r.events.size(); i++)
+	{
+		EXPECT_EQ(read.events[i].cycle, r.events[i].cycle);
+		EXPECT_EQ(read.events[i].value, r.events[i].value);
+	}
+	for (size_t i = 0; i < r.checks.size(); i++)
+		EXPECT_EQ(read.checks[i].outHash, r.checks[i].outHash);
+
+	FastSimulator replay;
+	EXPECT_TRUE(Replayer(replay, read).Run());
+
+	std::istringstream bad("CPURECRD\x40");
+	EXPECT_THROW(Recording::Read(bad), std::runtime_error);
+	std::istringstream other("not a recording");
+	EXPECT_THROW(Recording::Read(other), std::runtime_error);
+}
+
+TEST(Recording, mismatch)
+{
+	FastSimulator sim;
+	Recording r = Record(sim);
+
+	//a different input shows up in OUT within an interval of being read
+	auto& event = r.events[50];
+	event.value ^= 1;
+	FastSimulator replay;
+	Replayer replayer(replay, r);
+	EXPECT_FALSE(replayer.Run());
+	EXPECT_EQ(replayer.Mismatch(), "OUT differs");
+	EXPECT_GT(replayer.MismatchCycle(), event.cycle);
+	EXPECT_LE(replayer.MismatchCycle(), event.cycle + 2 * r.checkInterval);
+	event.value ^= 1;
+
+	//so does a different ROM
+	std::vector<uint32_t> rom(microcode_rom(), microcode_rom() + ROM_SIZE);
+	for (uint32_t& ctrl : rom)
+		ctrl &= ~OUTW;
+	FastSimulator broken(rom.data());
+	Replayer brokenReplayer(broken, r);
+	EXPECT_FALSE(brokenReplayer.Run());
+	EXPECT_LE(brokenReplayer.MismatchCycle(), r.checks[0].cycle);
+
+	//an event part way through an instruction can't be reached by the fast engine
+	r.events[10].cycle++;
+	FastSimulator late;
+	EXPECT_FALSE(Replayer(late, r).Run());
+}
+
+}}
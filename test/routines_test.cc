@@ -0,0 +1,256 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <sim/fast_simulator.h>
+#include <sim/microcode_simulator.h>
+
+#include <fstream>
+#include <random>
+#include <regex>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+//The return address is pushed at 255, blocks are kept below it
+const unsigned STACK = 255;
+
+//A cycle budget from a routine's spec, base + perByte * length
+struct Budget
+{
+	uint64_t base = 0;
+	uint64_t perByte = 0;
+};
+
+/*
+Calls a routine in routines/file with A and B loaded from arg_a and arg_b. The library is
+assembled after the driver so its labels resolve as they would in any other program.
+Every call starts from the state just after loading, and the cycles counted are from the
+CALL up to and including the RET.
+*/
+template <typename Sim = FastSimulator>
+class Routine
+{
+public:
+	Routine(const std::string& file, const std::string& name)
+	{
+		std::vector<std::string> source = {"MOV B, [#arg_b]", "MOV A, [#arg_a]", "CALL #" + name, "HLT",
+			"arg_a: DB 0", "arg_b: DB 0"};
+		for (const auto& s : source)
+		{
+			const Instruction instr{SourceLine::Parse(s)};
+			if (s.rfind("CALL", 0) != 0)
+				mOverhead += instr.Cycles();
+		}
+		std::ifstream in(ROUTINES_DIR "/" + file);
+		std::string s;
+		while (std::getline(in, s))
+		{
+			source.push_back(s);
+			std::smatch match;
+			if (std::regex_match(s, match, std::regex(";(\\w+) budget: (\\d+)( \\+ (\\d+)n)? cycles")) && match[1] == name)
+				mBudget = {std::stoull(match[2]), match[4].matched ? std::stoull(match[4]) : 0};
+		}
+		EXPECT_GT(mBudget.base, 0u) << name << " has no budget";
+
+		for (const auto& l : source)
+			mProgram.AddLine(SourceLine::Parse(l));
+		mSim.Load(mProgram.MachineCode());
+		//flags left over from the caller mustn't matter
+		mSim.State().flags = 0xFF;
+		mStart = mSim.Save();
+	}
+
+	Machine& State() {return mSim.State();}
+	uint8_t& Ram(const std::string& label) {return mSim.State().ram[Label(label)];}
+	uint8_t Label(const std::string& label) const {return mProgram.Labels().at(label);}
+	//End of the program, blocks are put above it
+	uint8_t End() const {return uint8_t(mProgram.MachineCode().size());}
+
+	//Back to the state after loading, arguments are then set with Ram
+	void Reset() {mSim.Restore(mStart);}
+
+	//Calls the routine, checking it returns within length bytes of budget
+	Machine& Call(uint8_t a, uint8_t b, unsigned length = 0)
+	{
+		Ram("arg_a") = a;
+		Ram("arg_b") = b;
+		const uint64_t cycles = mSim.Run(100000) - mOverhead;
+		EXPECT_TRUE(mSim.State().halted);
+		EXPECT_LE(cycles, mBudget.base + mBudget.perByte * length) << "over budget, length " << length;
+		mMost = std::max(mMost, cycles);
+		return mSim.State();
+	}
+
+	//Most cycles taken by any call
+	uint64_t Most() const {return mMost;}
+	const Budget& Limit() const {return mBudget;}
+
+private:
+	Program mProgram;
+	Sim mSim;
+	Snapshot mStart;
+	Budget mBudget;
+	uint64_t mOverhead = 0;
+	uint64_t mMost = 0;
+};
+
+}
+
+TEST(Routines, mul8)
+{
+	Routine r("mul8.asm", "mul8");
+	for (unsigned a = 0; a < 256; a++)
+	{
+		for (unsigned b = 0; b < 256; b++)
+		{
+			r.Reset();
+			const Machine& m = r.Call(a, b);
+			const uint16_t product = m.a | r.Ram("mul8_hi") << 8;
+			ASSERT_EQ(product, a * b) << a << " * " << b;
+			ASSERT_EQ(m.b, b);
+		}
+	}
+	//the budget is the worst case, lower it when the routine gets faster
+	EXPECT_EQ(r.Most(), r.Limit().base);
+}
+
+TEST(Routines, div16)
+{
+	Routine r("div16.asm", "div16");
+	auto check = [&r](unsigned x, unsigned d)
+	{
+		r.Reset();
+		r.Ram("div16_lo") = x & 0xFF;
+		r.Ram("div16_hi") = x >> 8;
+		const Machine& m = r.Call(0, d);
+		const unsigned q = r.Ram("div16_lo") | r.Ram("div16_hi") << 8;
+		ASSERT_EQ(q, d ? x / d : 0xFFFF) << x << " / " << d;
+		ASSERT_EQ(m.a, d ? x % d : x & 0xFF) << x << " % " << d;
+		ASSERT_EQ(m.b, d);
+	};
+
+	//every divisor with every value of each dividend byte, then every dividend for one divisor.
+	//All 2^24 take minutes.
+	std::mt19937 rng(47);
+	std::vector<unsigned> dividends = {0x7FFF, 0x8000, 0xFF00, 0xFFFE};
+	for (unsigned k = 0; k < 256; k++)
+		dividends.push_back(k * 257);
+	for (int i = 0; i < 100; i++)
+		dividends.push_back(rng() & 0xFFFF);
+	for (const auto x : dividends)
+		for (unsigned d = 0; d < 256; d++)
+			check(x, d);
+	for (unsigned x = 0; x < 0x10000; x++)
+		check(x, 7);
+	EXPECT_EQ(r.Most(), r.Limit().base);
+}
+
+TEST(Routines, bcd8)
+{
+	Routine r("bcd.asm", "bcd8");
+	for (unsigned a = 0; a < 256; a++)
+	{
+		r.Reset();
+		r.Call(a, 0);
+		EXPECT_EQ(r.Ram("bcd8_hi"), a / 100) << a;
+		EXPECT_EQ(r.Ram("bcd8_lo"), (a / 10 % 10) << 4 | a % 10) << a;
+	}
+	EXPECT_EQ(r.Most(), r.Limit().base);
+}
+
+TEST(Routines, memset)
+{
+	Routine r("memory.asm", "memset");
+	//every block between the program and the stack, each with a different value
+	const unsigned start = r.End();
+	for (unsigned dst = start; dst < STACK; dst++)
+	{
+		for (unsigned len = 0; dst + len <= STACK; len++)
+		{
+			r.Reset();
+			r.Ram("memset_dst") = dst;
+			r.Ram("memset_len") = len;
+			const uint8_t value = uint8_t(dst + len + 1);
+			const Machine& m = r.Call(value, 0, len);
+			for (unsigned i = start; i < STACK; i++)
+				ASSERT_EQ(m.ram[i], i >= dst && i < dst + len ? value : 0) << dst << " " << len << " at " << i;
+			ASSERT_EQ(m.a, value);
+		}
+	}
+}
+
+TEST(Routines, memcpy)
+{
+	Routine r("memory.asm", "memcpy");
+	const unsigned start = r.End();
+	//every length and placement of two blocks in a 64 byte window, overlapping with dst above
+	const unsigned window = 64;
+	for (unsigned len = 0; len <= window / 2; len++)
+	{
+		for (unsigned src = start; src + len <= start + window; src++)
+		{
+			for (unsigned dst = start; dst + len <= start + window; dst++)
+			{
+				if (dst < src && dst + len > src)
+					continue;
+				r.Reset();
+				Machine& m = r.State();
+				for (unsigned i = start; i < 256; i++)
+					m.ram[i] = uint8_t(i * 7 + 3);
+				std::vector<uint8_t> expected(m.ram, m.ram + 256);
+				std::copy(m.ram + src, m.ram + src + len, expected.begin() + dst);
+				r.Ram("memcpy_src") = src;
+				r.Ram("memcpy_dst") = dst;
+				r.Ram("memcpy_len") = len;
+				r.Call(0, 0, len);
+				for (unsigned i = start; i < STACK; i++)
+					ASSERT_EQ(m.ram[i], expected[i]) << src << " to " << dst << " " << len << " at " << i;
+			}
+		}
+	}
+}
+
+TEST(Routines, memcmp)
+{
+	Routine r("memory.asm", "memcmp");
+	const unsigned a = r.End();
+	const unsigned b = a + 64;
+	//a single difference at each place, either way, in blocks of every length up to 64
+	for (unsigned len = 0; len <= 64; len++)
+	{
+		for (unsigned diff = 0; diff <= len; diff++)
+		{
+			for (const int delta : {-1, 1, 128})
+			{
+				r.Reset();
+				Machine& m = r.State();
+				for (unsigned i = 0; i < 64; i++)
+					m.ram[a + i] = m.ram[b + i] = uint8_t(i * 37 + len);
+				//past the end, it shouldn't be looked at
+				m.ram[b + diff] = uint8_t(m.ram[a + diff] + delta);
+				r.Ram("memcmp_a") = a;
+				r.Ram("memcmp_b") = b;
+				r.Ram("memcmp_len") = len;
+				r.Call(0, 0, len);
+				const uint8_t expected = diff == len ? 0 : m.ram[a + diff] > m.ram[b + diff] ? 1 : 255;
+				ASSERT_EQ(m.a, expected) << len << " " << diff << " " << delta;
+			}
+		}
+	}
+}
+
+TEST(Routines, engines_agree)
+{
+	Routine<FastSimulator> fast("mul8.asm", "mul8");
+	Routine<MicrocodeSimulator> slow("mul8.asm", "mul8");
+	for (const unsigned a : {0, 1, 127, 200, 255})
+	{
+		fast.Reset();
+		slow.Reset();
+		EXPECT_EQ(fast.Call(a, 211), slow.Call(a, 211));
+	}
+}
+
+}}
@@ -0,0 +1,446 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <sim/fast_simulator.h>
+#include <sim/microcode_simulator.h>
+
+#include <cstring>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+std::vector<uint8_t> Assemble(const std::vector<std::string>& source)
+{
+	Program p;
+	for (const auto& s : source)
+		p.AddLine(SourceLine::Parse(s));
+	return p.MachineCode();
+}
+
+//Runs on both engines, checks they agree and returns the values written to OUT
+std::vector<uint8_t> RunBoth(const std::vector<std::string>& source, Machine* state = nullptr, uint32_t timer = 0)
+{
+	MicrocodeSimulator slow;
+	FastSimulator fast;
+	slow.SetTimer(timer);
+	fast.SetTimer(timer);
+	std::vector<uint8_t> slowOut, fastOut;
+	slow.OnOut([&](uint8_t v) {slowOut.push_back(v);});
+	fast.OnOut([&](uint8_t v) {fastOut.push_back(v);});
+	slow.Load(Assemble(source));
+	fast.Load(Assemble(source));
+	slow.Run(10000);
+	fast.Run(10000);
+
+	EXPECT_TRUE(slow.State().halted);
+	EXPECT_TRUE(fast.State().halted);
+	EXPECT_EQ(slow.Cycles(), fast.Cycles());
+	EXPECT_EQ(slowOut, fastOut);
+	EXPECT_EQ(0, memcmp(&slow.State(), &fast.State(), sizeof(Machine)));
+	if (state)
+		*state = fast.State();
+	return fastOut;
+}
+
+}
+
+TEST(Simulator, load_immediate)
+{
+	Machine m;
+	EXPECT_EQ(RunBoth({"MOV A, 42", "MOV B, 7", "MOV OUT, A", "HLT"}, &m), std::vector<uint8_t>{42});
+	EXPECT_EQ(m.a, 42);
+	EXPECT_EQ(m.b, 7);
+}
+
+TEST(Simulator, memory)
+{
+	Machine m;
+	RunBoth({"MOV A, 42", "MOV [100], A", "MOV B, [100]", "MOV A, 101", "MOV [A], B", "MOV OUT, [A]", "HLT"}, &m);
+	EXPECT_EQ(m.ram[100], 42);
+	EXPECT_EQ(m.ram[101], 42);
+	EXPECT_EQ(m.out, 42);
+}
+
+TEST(Simulator, alu)
+{
+	EXPECT_EQ(RunBoth({"MOV A, 5", "MOV B, 3", "ADD A", "MOV OUT, ALO",
+		"SUB A", "MOV OUT, ALO",
+		"INC A", "MOV OUT, ALO",
+		"DEC A", "MOV OUT, ALO",
+		"SFT A", "MOV OUT, ALO",
+		"AND A", "MOV OUT, ALO",
+		"OR A", "MOV OUT, ALO",
+		"XOR A", "MOV OUT, ALO",
+		"NOT A", "MOV OUT, ALO",
+		"ADD 250", "MOV OUT, ALO",
+		"HLT"}), (std::vector<uint8_t>{8, 2, 6, 4, 10, 1, 7, 6, 250, 253}));
+}
+
+TEST(Simulator, alu_memory)
+{
+	Machine m;
+	EXPECT_EQ(RunBoth({"MOV A, 9", "MOV [100], A", "MOV B, 4", "MOV A, 1",
+		"ADD [100]", "MOV OUT, ALO",
+		"SUB [#x]", "MOV OUT, ALO",
+		"HLT", "x: DB 6"}, &m), (std::vector<uint8_t>{13, 2}));
+	//operands come from memory, A is left alone
+	EXPECT_EQ(m.a, 1);
+}
+
+TEST(Simulator, carry)
+{
+	//ADC, SBC and SFC take the carry left by the instruction before
+	EXPECT_EQ(RunBoth({"MOV B, 1",
+		"MOV A, 255", "ADD A", "MOV A, 3", "ADC A", "MOV OUT, ALO",
+		"MOV A, 1", "ADD A", "MOV A, 3", "ADC A", "MOV OUT, ALO",
+		"MOV A, 0", "SUB A", "MOV A, 3", "SBC A", "MOV OUT, ALO",
+		"MOV A, 1", "SUB A", "MOV A, 3", "SBC A", "MOV OUT, ALO",
+		"MOV A, 128", "SFT A", "MOV A, 3", "SFC A", "MOV OUT, ALO",
+		"MOV A, 3", "SFC A", "MOV OUT, ALO",
+		"HLT"}), (std::vector<uint8_t>{5, 4, 1, 2, 7, 6}));
+}
+
+TEST(Simulator, indexed)
+{
+	Machine m;
+	//copy table into 100.. backwards, then read it back
+	EXPECT_EQ(RunBoth({"MOV B, 2",
+		"loop: MOV A, [#table+B]", "MOV [100+B], A",
+		"MOV A, B", "MOV B, 1", "SUB A", "MOV B, ALO", "JC #loop",
+		"MOV B, 1", "MOV B, [100+B]", "MOV OUT, B", "HLT",
+		"table: DB 7", "DB 8", "DB 9"}, &m), (std::vector<uint8_t>{8}));
+	EXPECT_EQ(m.ram[100], 7);
+	EXPECT_EQ(m.ram[101], 8);
+	EXPECT_EQ(m.ram[102], 9);
+	//the address is added up in the ALU
+	EXPECT_EQ(m.alo, 101);
+}
+
+TEST(Simulator, fill)
+{
+	Machine m;
+	//[100, 110) = 42
+	RunBoth({"MOV A, 100", "MOV B, 0", "ADD A", "MOV B, 110", "MOV A, 42", "FILL", "HLT"}, &m);
+	for (int i = 99; i <= 110; i++)
+		EXPECT_EQ(m.ram[i], i >= 100 && i < 110 ? 42 : 0) << i;
+	EXPECT_EQ(m.alo, 0);
+
+	//a single byte when B is next, up to the top of memory when B is below
+	RunBoth({"MOV A, 200", "MOV B, 0", "ADD A", "MOV B, 201", "MOV A, 7", "FILL", "HLT"}, &m);
+	EXPECT_EQ(m.ram[200], 7);
+	EXPECT_EQ(m.ram[201], 0);
+	RunBoth({"MOV A, 250", "MOV B, 0", "ADD A", "MOV B, 20", "MOV A, 7", "FILL", "HLT"}, &m);
+	for (int i = 250; i < 256; i++)
+		EXPECT_EQ(m.ram[i], 7);
+	EXPECT_EQ(m.alo, 0);
+	EXPECT_EQ(m.ram[20], 0);
+}
+
+TEST(Simulator, fill_cycles)
+{
+	//the same 64 bytes with a loop of indexed stores
+	Machine m;
+	FastSimulator loop, fill;
+	loop.Load(Assemble({"MOV A, 0", "MOV B, 64",
+		"next: MOV A, B", "MOV B, 1", "SUB A", "MOV B, ALO", "MOV A, 42", "MOV [100+B], A",
+		"MOV A, B", "CMP 0", "JE #done", "JMP #next", "done: HLT"}));
+	fill.Load(Assemble({"MOV A, 100", "MOV B, 0", "ADD A", "MOV B, 164", "MOV A, 42", "FILL", "HLT"}));
+	loop.Run(100000);
+	fill.Run(100000);
+	EXPECT_EQ(0, memcmp(loop.State().ram + 100, fill.State().ram + 100, 64));
+	EXPECT_EQ(fill.State().ram[163], 42);
+	EXPECT_GT(loop.Cycles(), 3 * fill.Cycles());
+}
+
+//Counts interrupts in 100, halting between them until there have been at least three.
+//The handler changes B so they are disabled around the test.
+const std::vector<std::string> ticks = {"JMP #main",
+	"isr: MOV B, 1", "ADD [100]", "MOV [100], ALO", "MOV OUT, ALO", "RETI",
+	"main: EI", "HLT", "DI", "MOV A, [100]", "MOV B, 3", "SUB A", "JC #done", "JMP #main",
+	"done: HLT"};
+
+TEST(Simulator, interrupt)
+{
+	Machine m;
+	EXPECT_EQ(RunBoth(ticks, &m, 100), (std::vector<uint8_t>{1, 2, 3}));
+	EXPECT_EQ(m.sp, 0);
+	EXPECT_FALSE(m.ie);
+	EXPECT_FALSE(m.irq);
+
+	//every period longer than the handler lands on a different step, one can be taken
+	//between EI and HLT
+	for (uint32_t timer = 40; timer < 120; timer++)
+	{
+		RunBoth(ticks, &m, timer);
+		EXPECT_GE(m.ram[100], 3) << timer;
+	}
+}
+
+TEST(Simulator, interrupt_entry)
+{
+	FastSimulator sim;
+	sim.Load(Assemble({"JMP #main", "MOV OUT, A", "RETI", "main: MOV A, 7", "DI", "EI", "MOV A, 8", "HLT"}));
+	//requested while disabled, taken straight after EI
+	sim.State().irq = true;
+	sim.Run(1000);
+	EXPECT_EQ(sim.State().out, 7);
+	EXPECT_EQ(sim.State().a, 8);
+	EXPECT_TRUE(sim.State().halted);
+	EXPECT_TRUE(sim.State().ie);
+	EXPECT_FALSE(sim.Waiting());
+
+	//pushes the address of the next instruction, the vector is counted up in the ALU
+	sim.Reset();
+	sim.State().irq = true;
+	sim.State().ie = true;
+	sim.State().pc = 4;
+	const uint64_t cycles = sim.Run(7);
+	EXPECT_EQ(cycles, 7u);
+	EXPECT_EQ(sim.State().pc, INT_VECTOR);
+	EXPECT_EQ(sim.State().sp, 255);
+	EXPECT_EQ(sim.State().ram[255], 4);
+	EXPECT_EQ(sim.State().alo, INT_VECTOR);
+	EXPECT_FALSE(sim.State().ie);
+	EXPECT_FALSE(sim.State().irq);
+}
+
+//A 16 bit sum with the carry, ALO and the zero flag used instructions after the ALU wrote them,
+//interrupted by a handler which uses the ALU as well
+TEST(Simulator, interrupt_keeps_alu_state)
+{
+	const std::vector<std::string> sum = {"JMP #main",
+		"isr: PUSH A", "MOV A, [100]", "INC A", "MOV [100], ALO", "POP A", "RETI",
+		"main: MOV A, 20", "MOV [104], A", "EI",
+		"loop: MOV B, 37", "ADD [102]", "MOV [102], ALO", "MOV B, 0", "ADC [103]", "MOV [103], ALO",
+		"MOV A, [104]", "DEC A", "MOV [104], ALO", "JZ #done", "JMP #loop",
+		"done: DI", "MOV OUT, [102]", "MOV OUT, [103]", "HLT"};
+	EXPECT_EQ(RunBoth(sum), (std::vector<uint8_t>{740 & 0xFF, 740 >> 8}));
+
+	//every period longer than the handler lands on a different step
+	Machine m;
+	for (uint32_t timer = 60; timer < 140; timer++)
+	{
+		EXPECT_EQ(RunBoth(sum, &m, timer), (std::vector<uint8_t>{740 & 0xFF, 740 >> 8})) << timer;
+		EXPECT_GT(m.ram[100], 0) << timer;
+	}
+}
+
+TEST(Simulator, interrupt_fill)
+{
+	//a fill isn't cut short, the interrupt requested part way is taken once it is done
+	Machine m;
+	EXPECT_EQ(RunBoth({"JMP #main", "MOV OUT, B", "RETI",
+		"main: MOV A, 100", "MOV B, 0", "ADD A", "MOV B, 200", "MOV A, 9", "EI", "FILL",
+		"DI", "HLT"}, &m, 400), std::vector<uint8_t>{200});
+	for (int i = 100; i < 200; i++)
+		EXPECT_EQ(m.ram[i], 9);
+	EXPECT_EQ(m.ram[200], 0);
+}
+
+TEST(Simulator, waiting)
+{
+	MicrocodeSimulator slow;
+	FastSimulator fast;
+	for (Simulator* sim : std::initializer_list<Simulator*>{&slow, &fast})
+	{
+		sim->Load(Assemble(ticks));
+		sim->SetTimer(1000);
+		//halted until the first interrupt at 1000
+		EXPECT_EQ(sim->Run(500), 500u);
+		EXPECT_TRUE(sim->State().halted);
+		EXPECT_TRUE(sim->Waiting());
+		EXPECT_EQ(sim->Stopped(), Simulator::STOP_CYCLES);
+		sim->Run(100000);
+		EXPECT_EQ(sim->Stopped(), Simulator::STOP_HALTED);
+		EXPECT_EQ(sim->State().ram[100], 3);
+		EXPECT_GT(sim->Cycles(), 3000u);
+		EXPECT_LT(sim->Cycles(), 3100u);
+	}
+	EXPECT_EQ(slow.Cycles(), fast.Cycles());
+}
+
+TEST(Simulator, flags)
+{
+	Machine m;
+	RunBoth({"MOV A, 5", "MOV B, 5", "CMP A", "HLT"}, &m);
+	EXPECT_TRUE(m.flags & FLAG_E);
+	RunBoth({"MOV A, 255", "INC A", "HLT"}, &m);
+	EXPECT_TRUE(m.flags & FLAG_Z);
+	EXPECT_TRUE(m.flags & FLAG_C);
+	RunBoth({"MOV A, 127", "INC A", "HLT"}, &m);
+	EXPECT_EQ(m.flags, FLAG_N);
+}
+
+TEST(Simulator, conditional_jumps)
+{
+	EXPECT_EQ(RunBoth({"MOV A, 3",
+		"loop: DEC A",
+		"MOV A, ALO",
+		"MOV OUT, A",
+		"JZ #end",
+		"JMP #loop",
+		"end: HLT"}), (std::vector<uint8_t>{2, 1, 0}));
+
+	EXPECT_EQ(RunBoth({"MOV A, 9", "MOV B, 9", "CMP A", "JE #eq", "MOV OUT, B", "eq: HLT"}), std::vector<uint8_t>{});
+	EXPECT_EQ(RunBoth({"MOV A, 9", "MOV B, 8", "CMP A", "JE #eq", "MOV OUT, B", "eq: HLT"}), std::vector<uint8_t>{8});
+	EXPECT_EQ(RunBoth({"MOV A, 255", "INC A", "JC #c", "MOV OUT, A", "c: HLT"}), std::vector<uint8_t>{});
+	EXPECT_EQ(RunBoth({"MOV A, 128", "INC A", "JN #n", "MOV OUT, A", "n: HLT"}), std::vector<uint8_t>{});
+}
+
+TEST(Simulator, push)
+{
+	Machine m;
+	RunBoth({"MOV A, 42", "PUSH A", "HLT"}, &m);
+	EXPECT_EQ(m.sp, 255);
+	EXPECT_EQ(m.ram[255], 42);
+}
+
+TEST(Simulator, pop)
+{
+	Machine m;
+	RunBoth({"MOV A, 42", "PUSH A", "MOV A, 1", "POP A", "HLT"}, &m);
+	EXPECT_EQ(m.sp, 0);
+	EXPECT_EQ(m.a, 42);
+}
+
+TEST(Simulator, call)
+{
+	EXPECT_EQ(RunBoth({"CALL 4", "MOV OUT, A", "HLT", "MOV A, 7", "RET"}), std::vector<uint8_t>{7});
+	EXPECT_EQ(RunBoth({"MOV A, 5", "CALL A", "MOV OUT, B", "HLT", "MOV B, 9", "RET"}), std::vector<uint8_t>{9});
+}
+
+TEST(Simulator, cycles)
+{
+	FastSimulator sim;
+	sim.Load(Assemble({"MOV A, [42]", "ADD A", "HLT"}));
+	EXPECT_EQ(sim.Run(100), 5 + 3 + 3);
+}
+
+TEST(Simulator, snapshot)
+{
+	FastSimulator sim;
+	sim.Load(Assemble({"MOV A, 1", "MOV B, 2", "ADD A", "MOV [100], ALO", "HLT"}));
+	sim.Step();
+	const Snapshot s = sim.Save();
+	const uint64_t hash = sim.Hash();
+	sim.Run(100);
+	EXPECT_EQ(sim.State().ram[100], 3);
+	EXPECT_NE(sim.Hash(), hash);
+
+	sim.Restore(s);
+	EXPECT_EQ(sim.Cycles(), s.cycles);
+	EXPECT_EQ(sim.Hash(), hash);
+	EXPECT_TRUE(sim.State() == s.machine);
+
+	//a different value for B
+	sim.State().ram[3] = 5;
+	sim.Run(100);
+	EXPECT_EQ(sim.State().ram[100], 6);
+}
+
+TEST(Simulator, fork)
+{
+	const auto image = Assemble({"MOV B, 1", "MOV A, [50]", "ADD A", "MOV OUT, ALO", "HLT"});
+	MicrocodeSimulator slow;
+	FastSimulator fast;
+	for (Simulator* sim : std::initializer_list<Simulator*>{&slow, &fast})
+	{
+		std::vector<uint8_t> out;
+		sim->OnOut([&out](uint8_t v) {out.push_back(v);});
+		TraceBuffer buffer(64);
+		sim->Trace(&buffer);
+		sim->Load(image);
+		sim->Run(4);
+
+		//each branch sees a different input from the same point
+		for (uint8_t value = 0; value < 3; value++)
+		{
+			auto fork = sim->Fork();
+			fork->State().ram[50] = value;
+			EXPECT_EQ(fork->Cycles(), sim->Cycles());
+			fork->Run(100);
+			EXPECT_TRUE(fork->State().halted);
+		}
+		EXPECT_EQ(out, (std::vector<uint8_t>{1, 2, 3}));
+		//only the parent traces
+		EXPECT_EQ(buffer.Written(), 4u);
+		EXPECT_FALSE(sim->State().halted);
+	}
+}
+
+TEST(Simulator, hash)
+{
+	Machine a, b;
+	EXPECT_EQ(machine_hash(a), machine_hash(b));
+	for (size_t i = 0; i < sizeof(Machine); i++)
+	{
+		b = a;
+		reinterpret_cast<uint8_t*>(&b)[i] ^= 1;
+		EXPECT_NE(machine_hash(a), machine_hash(b)) << "byte " << i;
+		EXPECT_TRUE(a != b);
+	}
+}
+
+TEST(Simulator, breakpoints)
+{
+	//loop is at 2
+	const auto image = Assemble({"MOV A, 3", "loop: MOV B, 1", "SUB A", "MOV A, ALO", "MOV [100], A", "JZ #done", "JMP #loop", "done: HLT"});
+	MicrocodeSimulator slow;
+	FastSimulator fast;
+	for (Simulator* sim : std::initializer_list<Simulator*>{&slow, &fast})
+	{
+		sim->Load(image);
+		sim->SetBreakpoint(2);
+		EXPECT_TRUE(sim->Debugging());
+		sim->Run(10000);
+		EXPECT_EQ(sim->Stopped(), Simulator::STOP_BREAKPOINT);
+		EXPECT_EQ(sim->State().pc, 2);
+		EXPECT_EQ(sim->State().a, 3);
+
+		//carries on from the breakpoint to the next time round
+		sim->Run(10000);
+		EXPECT_EQ(sim->Stopped(), Simulator::STOP_BREAKPOINT);
+		EXPECT_EQ(sim->State().a, 2);
+
+		sim->SetBreakpoint(2, false);
+		sim->SetWatchpoint(100);
+		sim->Run(10000);
+		EXPECT_EQ(sim->Stopped(), Simulator::STOP_WATCHPOINT);
+		EXPECT_EQ(sim->State().ram[100], 1);
+
+		sim->ClearDebugPoints();
+		EXPECT_FALSE(sim->Debugging());
+		sim->Run(10000);
+		EXPECT_EQ(sim->Stopped(), Simulator::STOP_HALTED);
+		EXPECT_EQ(sim->State().ram[100], 0);
+	}
+	EXPECT_EQ(slow.Cycles(), fast.Cycles());
+}
+
+//FILL goes round once a byte with PC already at the next instruction, which is only reached
+//once the fill is done
+TEST(Simulator, breakpoint_after_fill)
+{
+	//FILL is at 9
+	const auto image = Assemble({"MOV A, 100", "MOV B, 0", "ADD A", "MOV B, 110", "MOV A, 42", "FILL", "next: MOV OUT, A", "HLT"});
+	MicrocodeSimulator slow;
+	FastSimulator fast;
+	for (Simulator* sim : std::initializer_list<Simulator*>{&slow, &fast})
+	{
+		sim->Load(image);
+		sim->SetBreakpoint(10);
+		sim->Run(10000);
+		EXPECT_EQ(sim->Stopped(), Simulator::STOP_BREAKPOINT);
+		EXPECT_EQ(sim->State().pc, 10);
+		for (int i = 100; i < 110; i++)
+			EXPECT_EQ(sim->State().ram[i], 42) << i;
+
+		sim->Run(10000);
+		EXPECT_EQ(sim->Stopped(), Simulator::STOP_HALTED);
+	}
+	EXPECT_EQ(slow.Cycles(), fast.Cycles());
+}
+
+}}
@@ -0,0 +1,122 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <ctrl/microcode.h>
+#include <superopt/superoptimizer.h>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+std::vector<uint8_t> Assemble(const std::vector<std::string>& source)
+{
+	Program p;
+	for (const auto& s : source)
+		p.AddLine(SourceLine::Parse(s));
+	return p.MachineCode();
+}
+
+SuperoptimizerSpec MakeSpec(const std::vector<std::string>& reference, const std::vector<std::string>& in,
+	const std::vector<std::string>& out, uint8_t maxLength)
+{
+	SuperoptimizerSpec spec;
+	spec.reference = Assemble(reference);
+	for (const auto& l : in)
+		spec.inputs.push_back(Location::Parse(l));
+	for (const auto& l : out)
+		spec.outputs.push_back(Location::Parse(l));
+	spec.maxLength = maxLength;
+	return spec;
+}
+
+}
+
+TEST(Superoptimizer, location)
+{
+	Machine m;
+	Location::Parse("A").Write(m, 1);
+	Location::Parse("ALO").Write(m, 2);
+	Location::Parse("[200]").Write(m, 3);
+	EXPECT_EQ(m.a, 1);
+	EXPECT_EQ(m.alo, 2);
+	EXPECT_EQ(m.ram[200], 3);
+	EXPECT_EQ(Location::Parse("[200]").Read(m), 3);
+	EXPECT_TRUE(Location::Parse("[200]").IsMemory());
+	EXPECT_THROW(Location::Parse("C"), std::runtime_error);
+}
+
+TEST(Superoptimizer, alphabet)
+{
+	Superoptimizer s(MakeSpec({"HLT"}, {"A"}, {"A"}, 1));
+	for (const auto& c : s.Alphabet())
+	{
+		//no jumps, calls, stack or halt
+		EXPECT_LT(c.bytes[0], 0xC0);
+		EXPECT_EQ(c.cycles, instruction_cycles(c.bytes[0]));
+	}
+	EXPECT_THAT(s.Alphabet(), Contains(Field(&Superoptimizer::Candidate::bytes, Assemble({"ADD A"}))));
+	EXPECT_THAT(s.Alphabet(), Contains(Field(&Superoptimizer::Candidate::bytes, Assemble({"MOV A, 255"}))));
+}
+
+TEST(Superoptimizer, single_instruction)
+{
+	//a round trip through memory before the add
+	Superoptimizer s(MakeSpec({"MOV [200], A", "MOV A, [200]", "ADD A", "HLT"}, {"A", "B"}, {"ALO"}, 2));
+	const auto result = s.Search(2);
+	ASSERT_TRUE(result.found);
+	EXPECT_EQ(result.sequence, std::vector<std::vector<uint8_t>>{Assemble({"ADD A"})});
+	EXPECT_EQ(result.cycles, instruction_cycles(Assemble({"ADD A"})[0]));
+	EXPECT_LT(result.cycles, result.referenceCycles);
+}
+
+TEST(Superoptimizer, sequence)
+{
+	//OUT = A - 1, the reference subtracts a loaded constant
+	Superoptimizer s(MakeSpec({"MOV B, 1", "SUB A", "MOV OUT, ALO", "HLT"}, {"A"}, {"OUT"}, 2));
+	const auto result = s.Search(1);
+	ASSERT_TRUE(result.found);
+	ASSERT_EQ(result.sequence.size(), 2u);
+	EXPECT_EQ(result.sequence[0], Assemble({"DEC A"}));
+	EXPECT_EQ(result.sequence[1], Assemble({"MOV OUT, ALO"}));
+}
+
+TEST(Superoptimizer, carry)
+{
+	//the carry of A + B, the cheapest way reads it back through the flags
+	Superoptimizer s(MakeSpec({"ADD A", "MOV A, 0", "MOV B, 0", "ADC A", "HLT"}, {"A", "B"}, {"ALO"}, 2));
+	const auto result = s.Search();
+	ASSERT_TRUE(result.found);
+	ASSERT_EQ(result.sequence.size(), 2u);
+	EXPECT_EQ(result.sequence[0], Assemble({"ADD A"}));
+	EXPECT_LT(result.cycles, result.referenceCycles);
+}
+
+TEST(Superoptimizer, memory_output)
+{
+	Superoptimizer s(MakeSpec({"MOV B, [200]", "MOV A, B", "MOV [201], A", "HLT"}, {"[200]"}, {"[201]"}, 2));
+	const auto result = s.Search();
+	ASSERT_TRUE(result.found);
+	EXPECT_LE(result.cycles, result.referenceCycles);
+}
+
+TEST(Superoptimizer, not_found)
+{
+	//A + B + 2 needs more than one instruction
+	Superoptimizer s(MakeSpec({"ADD A", "MOV A, ALO", "INC A", "MOV A, ALO", "INC A", "HLT"}, {"A", "B"}, {"ALO"}, 1));
+	EXPECT_FALSE(s.Search().found);
+}
+
+TEST(Superoptimizer, overlapping_location)
+{
+	EXPECT_THROW(Superoptimizer(MakeSpec({"HLT"}, {"[0]"}, {"A"}, 1)), std::runtime_error);
+}
+
+TEST(Superoptimizer, reference_must_halt)
+{
+	auto spec = MakeSpec({"JMP 0"}, {"A"}, {"A"}, 1);
+	spec.maxReferenceCycles = 100;
+	EXPECT_THROW(Superoptimizer{spec}, std::runtime_error);
+}
+
+}}
@@ -0,0 +1,176 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <sim/fast_simulator.h>
+#include <sim/microcode_simulator.h>
+#include <sim/time_travel.h>
+
+#include <sstream>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+//counts for ever, storing every value
+const char* counter = R"(MOV A, 0
+loop: MOV B, 1
+ADD A
+MOV A, ALO
+MOV [100], A
+MOV OUT, A
+JMP #loop)";
+
+std::vector<uint8_t> Assemble(const std::string& source)
+{
+	Program p;
+	std::istringstream in(source);
+	std::string s;
+	while (std::getline(in, s))
+		p.AddLine(SourceLine::Parse(s));
+	return p.MachineCode();
+}
+
+//The state before every step of the first cycles
+template <typename Sim>
+std::vector<Snapshot> Record(uint64_t cycles)
+{
+	Sim sim;
+	sim.Load(Assemble(counter));
+	std::vector<Snapshot> log;
+	while (sim.Cycles() < cycles)
+	{
+		log.push_back(sim.Save());
+		sim.Run(1);
+	}
+	log.push_back(sim.Save());
+	return log;
+}
+
+void ExpectAt(const Simulator& sim, const Snapshot& expected)
+{
+	EXPECT_EQ(sim.Cycles(), expected.cycles);
+	EXPECT_TRUE(sim.State() == expected.machine) << "at " << sim.Cycles();
+	EXPECT_EQ(sim.OutHash(), expected.outHash) << "at " << sim.Cycles();
+}
+
+}
+
+TEST(TimeTravel, reverse_step)
+{
+	const auto log = Record<FastSimulator>(20000);
+	FastSimulator sim;
+	sim.Load(Assemble(counter));
+	TimeTravel tt(sim, 1000);
+	tt.Run(log.back().cycles);
+	ExpectAt(sim, log.back());
+	EXPECT_GE(tt.Checkpoints(), 19u);
+
+	//back over several checkpoints
+	for (size_t i = log.size() - 1; i-- > log.size() - 400;)
+	{
+		ASSERT_TRUE(tt.ReverseStep());
+		ExpectAt(sim, log[i]);
+	}
+
+	//and forward again the same way
+	tt.Run(log.back().cycles - sim.Cycles());
+	ExpectAt(sim, log.back());
+}
+
+TEST(TimeTravel, micro_steps)
+{
+	const auto log = Record<MicrocodeSimulator>(3000);
+	MicrocodeSimulator sim;
+	sim.Load(Assemble(counter));
+	TimeTravel tt(sim, 256);
+	tt.Run(3000);
+	for (size_t i = log.size() - 1; i-- > log.size() - 300;)
+	{
+		ASSERT_TRUE(tt.ReverseStep());
+		ExpectAt(sim, log[i]);
+	}
+}
+
+TEST(TimeTravel, reverse_continue)
+{
+	FastSimulator sim;
+	std::vector<uint8_t> out;
+	sim.OnOut([&out](uint8_t v) {out.push_back(v);});
+	const auto image = Assemble(counter);
+	sim.Load(image);
+	TimeTravel tt(sim, 1000);
+	tt.Run(50000);
+	const size_t written = out.size();
+
+	const uint8_t loop = 2;
+	EXPECT_TRUE(tt.ReverseContinue([](const Machine& m) {return m.pc == loop && m.a == 7;}));
+	EXPECT_EQ(sim.State().pc, loop);
+	EXPECT_EQ(sim.State().a, 7);
+	const uint64_t at = sim.Cycles();
+	EXPECT_LT(at, 50000u);
+
+	//earlier, A has wrapped round since the start
+	EXPECT_TRUE(tt.ReverseContinue([](const Machine& m) {return m.pc == loop && m.a == 7;}));
+	EXPECT_LT(sim.Cycles(), at);
+	EXPECT_FALSE(tt.ReverseContinue([](const Machine& m) {return m.pc == 200;}));
+
+	//replays don't write OUT
+	EXPECT_EQ(out.size(), written);
+	//at the start of history
+	EXPECT_TRUE(tt.ReverseContinue([](const Machine& m) {return m.pc == 0;}));
+	EXPECT_EQ(sim.Cycles(), 0u);
+	EXPECT_FALSE(tt.ReverseStep());
+}
+
+TEST(TimeTravel, reverse_to_write)
+{
+	FastSimulator sim;
+	sim.Load(Assemble(counter));
+	TimeTravel tt(sim, 1000);
+	tt.Run(30000);
+	const uint8_t value = sim.State().ram[100];
+
+	ASSERT_TRUE(tt.ReverseToWrite(100));
+	//just before MOV [100], A
+	EXPECT_EQ(sim.State().ram[sim.State().pc], Assemble("MOV [100], A")[0]);
+	EXPECT_EQ(sim.State().a, value);
+	const uint8_t before = sim.State().ram[100];
+	EXPECT_EQ(uint8_t(before + 1), value);
+
+	//the write before that one
+	ASSERT_TRUE(tt.ReverseToWrite(100));
+	EXPECT_EQ(sim.State().a, before);
+	EXPECT_FALSE(tt.ReverseToWrite(101));
+}
+
+TEST(TimeTravel, bounded)
+{
+	FastSimulator sim;
+	sim.Load(Assemble(counter));
+	TimeTravel tt(sim, 100, 16 << 10);
+	tt.Run(1000000);
+	EXPECT_LE(tt.MemoryUsed(), size_t(16 << 10));
+	EXPECT_GT(tt.Oldest(), 900000u);
+
+	//history has gone
+	EXPECT_FALSE(tt.ReverseContinue([](const Machine& m) {return m.pc == 0;}));
+	EXPECT_TRUE(tt.ReverseStep());
+	EXPECT_GE(sim.Cycles(), tt.Oldest());
+}
+
+TEST(TimeTravel, modified)
+{
+	FastSimulator sim;
+	sim.Load(Assemble(counter));
+	TimeTravel tt(sim, 1000);
+	tt.Run(5500);
+	sim.State().a = 0;
+	tt.Modified();
+	tt.Run(100);
+	ASSERT_TRUE(tt.ReverseToWrite(100));
+	//the count started again
+	EXPECT_LT(sim.State().a, 20);
+}
+
+}}
@@ -0,0 +1,164 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <asm/timing_analyzer.h>
+#include <sim/fast_simulator.h>
+
+#include <sstream>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+Program Assemble(const std::string& source)
+{
+	Program p;
+	std::istringstream in(source);
+	std::string s;
+	while (std::getline(in, s))
+		p.AddLine(SourceLine::Parse(s));
+	return p;
+}
+
+uint64_t Simulate(const Program& p)
+{
+	FastSimulator sim;
+	sim.Load(p.MachineCode());
+	sim.Run(100000);
+	EXPECT_TRUE(sim.State().halted);
+	return sim.Cycles();
+}
+
+std::string Countdown(const std::string& bound)
+{
+	return R"(start: MOV A, 3
+loop: CALL #dec
+MOV B, 0
+ADD A
+JZ #done
+JMP #loop ;)" + bound + R"(
+done: MOV OUT, A
+HLT
+dec: MOV B, 1
+SUB A
+MOV A, ALO
+RET)";
+}
+
+}
+
+TEST(TimingAnalyzer, countdown)
+{
+	//3 iterations, jumping back twice
+	const Program p = Assemble(Countdown("bound 2..2"));
+	const auto report = TimingAnalyzer(p).Analyze();
+
+	ASSERT_EQ(report.functions.size(), 2u);
+	const auto& main = report.functions[0];
+	EXPECT_EQ(main.name, "start");
+	EXPECT_TRUE(main.ends);
+	//ADD never carries here so each skipped JZ takes the long path
+	EXPECT_EQ(main.worst, Simulate(p));
+	EXPECT_LT(main.best, main.worst);
+
+	ASSERT_EQ(main.loops.size(), 1u);
+	EXPECT_EQ(main.loops[0].name, "loop");
+	EXPECT_EQ(main.loops[0].minBound, 2u);
+	EXPECT_EQ(main.loops[0].maxBound, 2u);
+	EXPECT_EQ(main.loops[0].worstIteration - main.loops[0].bestIteration, 1u);
+
+	const auto& dec = report.functions[1];
+	EXPECT_EQ(dec.name, "dec");
+	EXPECT_EQ(dec.entry, p.Labels().at("dec"));
+	EXPECT_EQ(dec.best, dec.worst);
+	EXPECT_TRUE(dec.loops.empty());
+}
+
+TEST(TimingAnalyzer, range)
+{
+	const Program p = Assemble(Countdown(" bound 5"));
+	const auto main = TimingAnalyzer(p).Analyze().functions[0];
+	EXPECT_LT(main.best, Simulate(p));
+	EXPECT_GT(main.worst, Simulate(p));
+	EXPECT_EQ(main.loops[0].minBound, 0u);
+	EXPECT_EQ(main.loops[0].maxBound, 5u);
+}
+
+TEST(TimingAnalyzer, nested)
+{
+	//2 outer iterations of 3 inner
+	const Program p = Assemble(R"(MOV A, 2
+outer: PUSH A
+MOV A, 3
+inner: MOV B, 1
+SUB A
+MOV A, ALO
+JZ #next
+JMP #inner ;bound 2..2
+next: POP A
+MOV B, 1
+SUB A
+MOV A, ALO
+JZ #end
+JMP #outer ;bound 1..1
+end: HLT)");
+	const auto main = TimingAnalyzer(p).Analyze().functions[0];
+	//SUB without a borrow sets carry so each skipped JZ takes the short path
+	EXPECT_EQ(main.best, Simulate(p));
+	EXPECT_GT(main.worst, Simulate(p));
+	ASSERT_EQ(main.loops.size(), 2u);
+	EXPECT_EQ(main.loops[0].name, "outer");
+	EXPECT_GT(main.loops[0].worstIteration, 3 * main.loops[1].worstIteration);
+}
+
+TEST(TimingAnalyzer, forever)
+{
+	const Program p = Assemble(R"(MOV A, 0
+loop: MOV OUT, A
+MOV B, 1
+ADD A
+MOV A, ALO
+JMP #loop)");
+	const auto main = TimingAnalyzer(p).Analyze().functions[0];
+	EXPECT_FALSE(main.ends);
+	ASSERT_EQ(main.loops.size(), 1u);
+	EXPECT_EQ(main.loops[0].maxBound, UINT32_MAX);
+	EXPECT_GT(main.loops[0].worstIteration, 0u);
+
+	std::ostringstream os;
+	TimingReport{{main}}.Print(os);
+	EXPECT_THAT(os.str(), HasSubstr("never returns or halts"));
+	EXPECT_THAT(os.str(), HasSubstr("loop loop at 2, forever"));
+}
+
+TEST(TimingAnalyzer, fill)
+{
+	const Program p = Assemble("MOV A, 100\nMOV B, 0\nADD A\nMOV B, 116\nMOV A, 1\nFILL ; bound 1..16\nHLT");
+	const auto report = TimingAnalyzer(p).Analyze();
+	ASSERT_EQ(report.functions.size(), 1u);
+	EXPECT_EQ(report.functions[0].worst, Simulate(p));
+	EXPECT_EQ(report.functions[0].worst - report.functions[0].best, 15u * 8);
+}
+
+TEST(TimingAnalyzer, errors)
+{
+	auto analyze = [](const std::string& source)
+	{
+		const Program p = Assemble(source);
+		TimingAnalyzer(p).Analyze();
+	};
+	//no bound
+	EXPECT_THROW(analyze("loop: MOV B, 1\nSUB A\nMOV A, ALO\nJZ #end\nJMP #loop\nend: HLT"), std::runtime_error);
+	//indirect jump
+	EXPECT_THROW(analyze("MOV A, 4\nJMP A\nHLT"), std::runtime_error);
+	//recursion
+	EXPECT_THROW(analyze("CALL #f\nHLT\nf: CALL #f\nRET"), std::runtime_error);
+	//data
+	EXPECT_THROW(analyze("MOV A, 1\nx: DB 3"), std::runtime_error);
+	EXPECT_THROW(analyze("loop: JMP #loop ; bound x"), std::runtime_error);
+	//a fill without a bound
+	EXPECT_THROW(analyze("FILL\nHLT"), std::runtime_error);
+}
+
+}}
@@ -0,0 +1,232 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <sim/fast_simulator.h>
+#include <sim/microcode_simulator.h>
+#include <sim/trace.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+const char* source = R"(start: MOV A, 3
+MOV [100], A
+loop: CALL #dec
+MOV OUT, A
+MOV B, 0
+ADD A
+JZ #done
+JMP #loop
+done: PUSH A
+POP A
+HLT
+dec: MOV B, 1
+SUB A
+MOV A, ALO
+RET)";
+
+std::vector<uint8_t> Assemble()
+{
+	Program p;
+	std::istringstream in(source);
+	std::string s;
+	while (std::getline(in, s))
+		p.AddLine(SourceLine::Parse(s));
+	return p.MachineCode();
+}
+
+std::vector<TraceRecord> Record(Simulator& sim)
+{
+	TraceBuffer buffer(4096);
+	sim.Load(Assemble());
+	sim.Trace(&buffer);
+	sim.Run(10000);
+	EXPECT_TRUE(sim.State().halted);
+
+	std::vector<TraceRecord> records;
+	EXPECT_EQ(buffer.Read(0, records), 0u);
+	return records;
+}
+
+bool Equal(const TraceRecord& a, const TraceRecord& b)
+{
+	return std::memcmp(&a, &b, sizeof(TraceRecord)) == 0;
+}
+
+}
+
+TEST(Trace, engines_agree)
+{
+	MicrocodeSimulator microcode;
+	FastSimulator fast;
+	const auto expected = Record(microcode);
+	const auto actual = Record(fast);
+
+	ASSERT_EQ(expected.size(), microcode.Cycles());
+	ASSERT_EQ(actual.size(), expected.size());
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		EXPECT_EQ(actual[i].cycle, i);
+		EXPECT_TRUE(Equal(actual[i], expected[i])) << "cycle " << i << ": "
+			<< trace_transfer(actual[i]) << " vs " << trace_transfer(expected[i]);
+	}
+}
+
+//Everything but RAM reads can be followed from the records
+TEST(Trace, replay)
+{
+	FastSimulator sim;
+	const auto records = Record(sim);
+
+	Machine m;
+	for (const auto& r : records)
+	{
+		EXPECT_EQ(r.pc, m.pc);
+		EXPECT_EQ(r.mc, m.mc);
+		if (r.ctrl & MW)
+			m.ram[m.mar] = r.bus;
+		if (r.ctrl & MAW)
+			m.mar = r.bus;
+		if (r.ctrl & RAW)
+			m.a = r.bus;
+		if (r.ctrl & RBW)
+			m.b = r.bus;
+		if (r.ctrl & IRW)
+			m.ir = r.bus;
+		if (r.ctrl & SPW)
+			m.sp = r.bus;
+		if (r.ctrl & OUTW)
+			m.out = r.bus;
+		if (r.ctrl & PCW)
+			m.pc = r.bus;
+		else if (r.ctrl & PCC)
+			m.pc++;
+		m.alo = r.alo;
+		m.flags = r.flags;
+		m.mc = (r.ctrl & MCR) ? 0 : (m.mc + 1) & 7;
+	}
+
+	const Machine& expected = sim.State();
+	EXPECT_EQ(m.a, expected.a);
+	EXPECT_EQ(m.b, expected.b);
+	EXPECT_EQ(m.pc, expected.pc);
+	EXPECT_EQ(m.sp, expected.sp);
+	EXPECT_EQ(m.out, expected.out);
+	EXPECT_EQ(m.ram[100], 3);
+	EXPECT_EQ(m.ram[255], expected.ram[255]);
+}
+
+TEST(Trace, ring_overwrites)
+{
+	TraceBuffer buffer(10);
+	EXPECT_EQ(buffer.Capacity(), 15u);
+	for (uint64_t i = 0; i < 40; i++)
+		buffer.Record({i, 0, 0, 0, 0, 0, 0, 0});
+
+	std::vector<TraceRecord> records;
+	EXPECT_EQ(buffer.Read(0, records), 25u);
+	ASSERT_EQ(records.size(), 15u);
+	EXPECT_EQ(records.front().cycle, 25u);
+	EXPECT_EQ(records.back().cycle, 39u);
+
+	records.clear();
+	EXPECT_EQ(buffer.Read(38, records), 38u);
+	EXPECT_EQ(records.size(), 2u);
+}
+
+TEST(Trace, stream_to_file)
+{
+	const std::string path = "trace_test_stream.bin";
+	FastSimulator sim;
+	sim.Load(Assemble());
+	{
+		//a ring smaller than the run, the streamer keeps up through blocking
+		TraceBuffer buffer(8);
+		TraceStreamer streamer(buffer, path);
+		sim.Trace(&buffer);
+		sim.Run(10000);
+	}
+	FastSimulator reference;
+	const auto expected = Record(reference);
+
+	std::ifstream in(path, std::ios::binary);
+	TraceReader reader(in);
+	EXPECT_EQ(reader.Lost(), 0u);
+	std::vector<TraceRecord> actual;
+	TraceRecord r;
+	while (reader.Next(r))
+		actual.push_back(r);
+	in.close();
+	std::remove(path.c_str());
+
+	ASSERT_EQ(actual.size(), expected.size());
+	for (size_t i = 0; i < expected.size(); i++)
+		EXPECT_TRUE(Equal(actual[i], expected[i])) << "cycle " << i;
+}
+
+TEST(Trace, ring_file)
+{
+	const std::string path = "trace_test_ring.bin";
+	uint64_t cycles = 0;
+	uint64_t kept = 0;
+	{
+		TraceBuffer buffer(path, 32);
+		kept = buffer.Capacity();
+		FastSimulator sim;
+		sim.Load(Assemble());
+		sim.Trace(&buffer);
+		cycles = sim.Run(10000);
+	}
+
+	std::ifstream in(path, std::ios::binary);
+	TraceReader reader(in);
+	EXPECT_EQ(reader.Lost(), cycles - kept);
+	TraceRecord r;
+	uint64_t next = cycles - kept;
+	while (reader.Next(r))
+		EXPECT_EQ(r.cycle, next++);
+	EXPECT_EQ(next, cycles);
+	EXPECT_EQ(r.ctrl & HLT, HLT);
+	in.close();
+	std::remove(path.c_str());
+
+	std::istringstream bad("not a trace at all, not a trace at all, not a trace at all");
+	EXPECT_THROW(TraceReader reader(bad), std::runtime_error);
+}
+
+TEST(Trace, describe)
+{
+	TraceRecord r = {0, FETCH0, 4, 0, 0, 4, 0, 0};
+	EXPECT_EQ(trace_transfer(r), "PC -> MAR");
+	EXPECT_EQ(trace_signals(r.ctrl), "MAW PCE");
+
+	r.ctrl = FETCH1;
+	EXPECT_EQ(trace_transfer(r), "[MAR] -> IR, PC++");
+
+	r.ctrl = RAE | alu_ctrl(ALU_ADD);
+	EXPECT_EQ(trace_transfer(r), "ALO = ADD A, B");
+	r.ctrl = SPE | alu_ctrl(ALU_DEC);
+	EXPECT_EQ(trace_transfer(r), "ALO = DEC SP");
+	r.ctrl = ALE | SPW | MCR;
+	EXPECT_EQ(trace_transfer(r), "ALO -> SP");
+	r.ctrl = ALE | PCW | IEC | INA | MCR;
+	EXPECT_EQ(trace_transfer(r), "ALO -> PC, IE = 0, INT ack");
+	EXPECT_EQ(trace_signals(r.ctrl), "PCW MCR ALE IEC INA");
+	r.ctrl = IRW | AFX;
+	EXPECT_EQ(trace_transfer(r), "0 -> IR, swap ALO, flags");
+
+	std::ostringstream os;
+	print_trace_record(os, {1234, RAE | OUTW | MCR, 0x1f, 0xa8, 2, 7, 0, 0});
+	EXPECT_THAT(os.str(), HasSubstr("1234  pc 1f  ir a8  mc 2  bus 07  A -> OUT"));
+	EXPECT_THAT(os.str(), HasSubstr("; RAE MCR OUTW"));
+	print_trace_record(os, {1235, IRW | AFX, 0x20, 0xa8, 0, 0, 0, 0, true});
+	EXPECT_THAT(os.str(), HasSubstr("; IRW AFX  ALO 00 flags 0  INT\n"));
+}
+
+}}
@@ -0,0 +1,176 @@
+#include "gmock/gmock.h"
+#include <asm/program.h>
+#include <sim/microcode_simulator.h>
+#include <sim/vcd_writer.h>
+
+#include <map>
+#include <sstream>
+
+namespace Cpu { namespace Test {
+
+using namespace ::testing;
+
+namespace {
+
+const char* source = R"(start: MOV A, 200
+loop: MOV B, 17
+ADD A
+MOV A, ALO
+JC #done
+MOV OUT, A
+JMP #loop
+done: HLT)";
+
+std::vector<TraceRecord> Record(const char* text = source, uint32_t timer = 0)
+{
+	Program p;
+	std::istringstream in(text);
+	std::string s;
+	while (std::getline(in, s))
+		p.AddLine(SourceLine::Parse(s));
+
+	MicrocodeSimulator sim;
+	TraceBuffer buffer(4096);
+	sim.SetTimer(timer);
+	sim.Load(p.MachineCode());
+	sim.Trace(&buffer);
+	sim.Run(10000);
+	EXPECT_TRUE(sim.State().halted);
+
+	std::vector<TraceRecord> records;
+	buffer.Read(0, records);
+	return records;
+}
+
+//Values by signal name at the start of every cycle
+std::vector<std::map<std::string, unsigned>> Parse(const std::string& vcd, std::map<std::string, int>& widths)
+{
+	std::istringstream in(vcd);
+	std::map<char, std::string> names;
+	std::map<std::string, unsigned> values;
+	std::vector<std::map<std::string, unsigned>> cycles;
+	std::string line;
+	while (std::getline(in, line))
+	{
+		std::istringstream ls(line);
+		std::string word;
+		ls >> word;
+		if (word == "$var")
+		{
+			std::string type, id, name;
+			int width;
+			ls >> type >> width >> id >> name;
+			names[id[0]] = name;
+			widths[name] = width;
+		}
+		else if (word[0] == '#')
+		{
+			const size_t time = std::stoul(word.substr(1));
+			if (!cycles.empty() || time > 0)
+				while (cycles.size() < time)
+					cycles.push_back(values);
+		}
+		else if (word[0] == 'b')
+		{
+			std::string id;
+			ls >> id;
+			values[names.at(id[0])] = std::stoul(word.substr(1), nullptr, 2);
+		}
+		else if (word[0] == '0' || word[0] == '1')
+		{
+			values[names.at(word[1])] = word[0] - '0';
+		}
+	}
+	return cycles;
+}
+
+}
+
+TEST(VcdWriter, round_trip)
+{
+	const auto records = Record();
+	std::ostringstream os;
+	{
+		VcdWriter writer(os);
+		for (const auto& r : records)
+			writer.Write(r);
+	}
+
+	std::map<std::string, int> widths;
+	const auto cycles = Parse(os.str(), widths);
+	EXPECT_EQ(widths.size(), 28u + 7u);
+	EXPECT_EQ(widths["MAW"], 1);
+	EXPECT_EQ(widths["ALW"], 1);
+	EXPECT_EQ(widths["bus"], 8);
+	EXPECT_EQ(widths["mc"], 3);
+	EXPECT_EQ(widths["CND_CR"], 1);
+	EXPECT_EQ(widths["CND_INT"], 1);
+	EXPECT_EQ(widths["AFX"], 1);
+
+	ASSERT_EQ(cycles.size(), records.size());
+	bool carry = false;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const auto& r = records[i];
+		const auto& v = cycles[i];
+		EXPECT_EQ(v.at("bus"), r.bus) << "cycle " << i;
+		EXPECT_EQ(v.at("pc"), r.pc) << "cycle " << i;
+		EXPECT_EQ(v.at("mc"), r.mc) << "cycle " << i;
+		EXPECT_EQ(v.at("ME"), (r.ctrl & ME) ? 1u : 0u) << "cycle " << i;
+		EXPECT_EQ(v.at("PCC"), (r.ctrl & PCC) ? 1u : 0u) << "cycle " << i;
+		EXPECT_EQ(v.at("AS0"), (r.ctrl & AS0) ? 1u : 0u) << "cycle " << i;
+		carry = carry || v.at("CND_CR");
+	}
+	//the loop ends on JC
+	EXPECT_TRUE(carry);
+}
+
+TEST(VcdWriter, interrupt)
+{
+	const auto records = Record("JMP #main\nMOV OUT, A\nRETI\nmain: MOV A, 5\nEI\nHLT\nDI\nHLT", 50);
+	std::ostringstream os;
+	{
+		VcdWriter writer(os);
+		for (const auto& r : records)
+			writer.Write(r);
+	}
+
+	std::map<std::string, int> widths;
+	const auto cycles = Parse(os.str(), widths);
+	//halted until the timer, the cycles in between have no record
+	ASSERT_EQ(cycles.size(), records.back().cycle + 1);
+	unsigned interrupted = 0, acknowledged = 0, enabled = 0;
+	for (const auto& r : records)
+	{
+		const auto& v = cycles[r.cycle];
+		EXPECT_EQ(v.at("CND_INT"), r.intr ? 1u : 0u) << "cycle " << r.cycle;
+		EXPECT_EQ(v.at("AFX"), (r.ctrl & AFX) ? 1u : 0u) << "cycle " << r.cycle;
+		interrupted += v.at("CND_INT");
+		acknowledged += v.at("INA");
+		enabled += v.at("IES");
+	}
+	//the entry is 7 steps, EI and RETI set the enable
+	EXPECT_EQ(interrupted, 7u);
+	EXPECT_EQ(acknowledged, 1u);
+	EXPECT_EQ(enabled, 2u);
+}
+
+TEST(VcdWriter, only_changes)
+{
+	const auto records = Record();
+	std::ostringstream os;
+	uint64_t changes = 0;
+	{
+		VcdWriter writer(os);
+		for (const auto& r : records)
+			writer.Write(r);
+		changes = writer.Changes();
+	}
+	//every signal every cycle would be 35 per record
+	EXPECT_LT(changes, records.size() * 35 / 3);
+	EXPECT_THAT(os.str(), StartsWith("$version"));
+	EXPECT_THAT(os.str(), HasSubstr("$enddefinitions $end\n#0\n$dumpvars\n"));
+	EXPECT_THAT(os.str(), EndsWith("#" + std::to_string(records.size()) + "\n"));
+}
+
+}}
@@ -0,0 +1,97 @@
+#include <asm/source_line.h>
+#include <asm/program.h>
+#include <sim/trace.h>
+#include <sim/vcd_writer.h>
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+//trace [--source file] [--from cycle] [--count n] [--vcd file] trace_file
+//Decodes a trace written by sim --trace, or a ring file, one micro step per line
+//--source prints each line of the program as its instruction is fetched
+//--vcd converts the records to a value change dump instead
+int main(int argc, char** args)
+{
+	std::string sourcePath;
+	std::string tracePath;
+	std::string vcdPath;
+	uint64_t from = 0;
+	uint64_t count = UINT64_MAX;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = args[i];
+		if (arg == "--source" && i + 1 < argc)
+			sourcePath = args[++i];
+		else if (arg == "--from" && i + 1 < argc)
+			from = std::stoull(args[++i]);
+		else if (arg == "--count" && i + 1 < argc)
+			count = std::stoull(args[++i]);
+		else if (arg == "--vcd" && i + 1 < argc)
+			vcdPath = args[++i];
+		else
+			tracePath = arg;
+	}
+	if (tracePath.empty())
+	{
+		std::cerr << "trace [--source file] [--from cycle] [--count n] [--vcd file] trace_file" << std::endl;
+		return 1;
+	}
+
+	Cpu::Program p;
+	if (!sourcePath.empty())
+	{
+		std::ifstream source(sourcePath);
+		std::string s;
+		while (std::getline(source, s))
+			p.AddLine(Cpu::SourceLine::Parse(s));
+	}
+
+	std::ifstream in(tracePath, std::ios::binary);
+	try
+	{
+		Cpu::TraceReader reader(in);
+		if (reader.Lost())
+			std::cout << "; " << reader.Lost() << " records overwritten" << std::endl;
+
+		std::ofstream vcd;
+		std::unique_ptr<Cpu::VcdWriter> writer;
+		if (!vcdPath.empty())
+		{
+			vcd.open(vcdPath);
+			writer = std::make_unique<Cpu::VcdWriter>(vcd);
+		}
+
+		Cpu::TraceRecord record;
+		while (count && reader.Next(record))
+		{
+			if (record.cycle < from)
+				continue;
+			if (writer)
+			{
+				writer->Write(record);
+				count--;
+				continue;
+			}
+			if (record.ctrl & IRW)
+			{
+				auto it = p.Instructions().find(record.pc);
+				if (it != p.Instructions().end())
+				{
+					std::cout << "; ";
+					it->second.Line().Print(std::cout);
+					std::cout << "\n";
+				}
+			}
+			Cpu::print_trace_record(std::cout, record);
+			count--;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << tracePath << ": " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}